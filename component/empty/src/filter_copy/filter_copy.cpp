@@ -8,7 +8,7 @@ namespace mf {
  */
 
 filter_copy::worker_main::worker_main(filter_copy *c)
-	: component_worker(c), comp(c)
+	: component_worker(c), comp(c), f_held_in(false), stamp(0)
 {
 }
 
@@ -21,54 +21,144 @@ const char *filter_copy::worker_main::get_name() const
 	return "filt_copy::wrk_main";
 }
 
+bool filter_copy::worker_main::is_light_flush_supported() const
+{
+	return true;
+}
+
+void filter_copy::worker_main::handle_flush(OMX_U32 port_index)
+{
+	//出力バッファを待っている入力バッファを返却する
+	if (f_held_in && (port_index == OMX_ALL ||
+		port_index == comp->in_port_video->get_port_index())) {
+		pb_in.header->nFilledLen = 0;
+		pb_in.header->nOffset = 0;
+		comp->in_port_video->empty_buffer_done(&pb_in);
+		f_held_in = false;
+	}
+}
+
 void filter_copy::worker_main::run()
 {
 	OMX_ERRORTYPE result;
-	port_buffer pb_in, pb_out;
-	OMX_U32 off_in, off_out, len_in, len_out;
-	OMX_TICKS stamp = 0;
+	port_buffer pb_out;
+
+	//前回のメイン処理で保持していたバッファは、
+	//execute_flush によって返却済み
+	f_held_in = false;
+	stamp = 0;
 
 	while (is_running()) {
 		if (is_request_flush()) {
 			return;
 		}
-
-		result = comp->in_port_video->pop_buffer(&pb_in);
-		if (result != OMX_ErrorNone) {
-			errprint("in_port_video.pop_buffer().\n");
-			continue;
+		accept_flush();
+
+		if (!f_held_in) {
+			result = comp->in_port_video->pop_buffer(&pb_in);
+			if (result != OMX_ErrorNone) {
+				if (is_interrupted_by_request()) {
+					dprint("in_port_video.pop_buffer() interrupted.\n");
+				} else {
+					errprint("in_port_video.pop_buffer().\n");
+				}
+				continue;
+			}
+			f_held_in = true;
 		}
 
 		result = comp->out_port_video->pop_buffer(&pb_out);
 		if (result != OMX_ErrorNone) {
-			errprint("out_port_video.pop_buffer().\n");
+			if (is_interrupted_by_request()) {
+				dprint("out_port_video.pop_buffer() interrupted.\n");
+			} else {
+				errprint("out_port_video.pop_buffer().\n");
+			}
 			continue;
 		}
 
-		//memset(pb_out.header->pBuffer, 0, pb_out.header->nAllocLen);
+		copy_buffer(&pb_out);
+	}
+}
 
-		off_in = pb_in.header->nOffset;
-		len_in = pb_in.header->nFilledLen;
-		off_out = pb_out.header->nOffset;
-		len_out = pb_out.header->nAllocLen - off_out;
+bool filter_copy::worker_main::is_step_supported() const
+{
+	return true;
+}
 
-		len_out = std::min(len_in, len_out);
-		memmove(&pb_out.header->pBuffer[off_out],
-			&pb_in.header->pBuffer[off_in], len_out);
+void filter_copy::worker_main::begin_step()
+{
+	//前回のメイン処理で保持していたバッファは、
+	//execute_flush によって返却済み
+	f_held_in = false;
+	stamp = 0;
+}
 
-		//NOTE: gst-openmax は nOffset を戻さないとおかしな挙動をする？？
-		pb_in.header->nOffset = 0;
-		comp->in_port_video->empty_buffer_done(&pb_in);
+bool filter_copy::worker_main::run_step()
+{
+	OMX_ERRORTYPE result;
+	port_buffer pb_out;
 
-		pb_out.header->nFilledLen = len_out;
-		pb_out.header->nOffset    = 0;
-		pb_out.header->nTimeStamp = stamp;
-		pb_out.header->nFlags     = 0;
-		comp->out_port_video->fill_buffer_done(&pb_out);
+	//入力バッファと出力バッファが揃うまで待たずに戻る
+	if (!f_held_in) {
+		result = comp->in_port_video->try_pop_buffer(&pb_in);
+		if (result != OMX_ErrorNone) {
+			return false;
+		}
+		f_held_in = true;
+	}
 
-		//16ms
-		stamp += 16000;
+	result = comp->out_port_video->try_pop_buffer(&pb_out);
+	if (result != OMX_ErrorNone) {
+		return false;
 	}
+
+	copy_buffer(&pb_out);
+
+	return true;
+}
+
+
+/*
+ * protected functions
+ */
+
+bool filter_copy::worker_main::is_interrupted_by_request() const
+{
+	//停止、フラッシュ、軽量フラッシュ、一時停止の要求で
+	//ポートの待機が解除された場合はエラーではない
+	return !is_running() || is_request_flush() ||
+		is_request_accept_flush();
+}
+
+void filter_copy::worker_main::copy_buffer(port_buffer *pb_out)
+{
+	OMX_U32 off_in, off_out, len_in, len_out;
+
+	//memset(pb_out->header->pBuffer, 0, pb_out->header->nAllocLen);
+
+	off_in = pb_in.header->nOffset;
+	len_in = pb_in.header->nFilledLen;
+	off_out = pb_out->header->nOffset;
+	len_out = pb_out->header->nAllocLen - off_out;
+
+	len_out = std::min(len_in, len_out);
+	memmove(&pb_out->header->pBuffer[off_out],
+		&pb_in.header->pBuffer[off_in], len_out);
+
+	//NOTE: gst-openmax は nOffset を戻さないとおかしな挙動をする？？
+	pb_in.header->nOffset = 0;
+	comp->in_port_video->empty_buffer_done(&pb_in);
+	f_held_in = false;
+
+	pb_out->header->nFilledLen = len_out;
+	pb_out->header->nOffset    = 0;
+	pb_out->header->nTimeStamp = stamp;
+	pb_out->header->nFlags     = 0;
+	comp->out_port_video->fill_buffer_done(pb_out);
+
+	//16ms
+	stamp += 16000;
 }
 
 
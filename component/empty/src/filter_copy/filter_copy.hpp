@@ -19,10 +19,38 @@ class filter_copy : public component {
 		virtual ~worker_main();
 
 		virtual const char *get_name() const;
+		virtual bool is_light_flush_supported() const;
+		virtual void handle_flush(OMX_U32 port_index);
 		virtual void run();
+		virtual bool is_step_supported() const;
+		virtual void begin_step();
+		virtual bool run_step();
+
+	protected:
+		/**
+		 * ポートの待機が停止やフラッシュ、一時停止の要求によって
+		 * 解除されたかどうかを取得します。
+		 *
+		 * @return 要求によって解除されたならば true、
+		 * そうでなければ false
+		 */
+		virtual bool is_interrupted_by_request() const;
+
+		/**
+		 * 保持している入力バッファを出力バッファにコピーし、
+		 * 両方のバッファを返却します。
+		 *
+		 * @param pb_out 出力バッファ
+		 */
+		virtual void copy_buffer(port_buffer *pb_out);
 
 	private:
 		filter_copy *comp;
+		//出力バッファを待っている入力バッファ
+		port_buffer pb_in;
+		bool f_held_in;
+		//出力バッファのタイムスタンプ
+		OMX_TICKS stamp;
 
 	};
 
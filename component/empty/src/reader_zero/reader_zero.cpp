@@ -21,6 +21,11 @@ const char *reader_zero::worker_main::get_name() const
 	return "read_zero::wrk_main";
 }
 
+bool reader_zero::worker_main::is_light_flush_supported() const
+{
+	return true;
+}
+
 void reader_zero::worker_main::run()
 {
 	OMX_ERRORTYPE result;
@@ -33,6 +38,7 @@ void reader_zero::worker_main::run()
 		if (is_request_flush()) {
 			return;
 		}
+		accept_flush();
 
 		result = comp->out_port_video->pop_buffer(&pb_out);
 		if (result != OMX_ErrorNone) {
@@ -21,6 +21,11 @@ const char *renderer_null::worker_main::get_name() const
 	return "rend_null::wrk_main";
 }
 
+bool renderer_null::worker_main::is_light_flush_supported() const
+{
+	return true;
+}
+
 void renderer_null::worker_main::run()
 {
 	OMX_ERRORTYPE result;
@@ -30,6 +35,7 @@ void renderer_null::worker_main::run()
 		if (is_request_flush()) {
 			return;
 		}
+		accept_flush();
 
 		result = comp->in_port_video->pop_buffer(&pb_in);
 		if (result != OMX_ErrorNone) {
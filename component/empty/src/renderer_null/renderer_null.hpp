@@ -19,6 +19,7 @@ class renderer_null : public component {
 		virtual ~worker_main();
 
 		virtual const char *get_name() const;
+		virtual bool is_light_flush_supported() const;
 		virtual void run();
 
 	private:
@@ -211,6 +211,7 @@ OMX_ERRORTYPE reader_binary::SetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTY
 
 		uri_target = (char *)p_uri->contentURI;
 
+		err = OMX_ErrorNone;
 		break;
 	}
 	default:
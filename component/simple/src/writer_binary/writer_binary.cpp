@@ -3,6 +3,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <cstring>
 
 #include "writer_binary/writer_binary.hpp"
 
@@ -138,6 +139,63 @@ void writer_binary::set_uri(std::string& uri)
 	uri_target = uri;
 }
 
+OMX_ERRORTYPE writer_binary::GetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nParamIndex, OMX_PTR pComponentParameterStructure)
+{
+	scoped_log_begin;
+	void *ptr = nullptr;
+	OMX_ERRORTYPE err;
+
+	ptr = pComponentParameterStructure;
+
+	switch (nParamIndex) {
+	case OMX_IndexParamContentURI: {
+		OMX_PARAM_CONTENTURITYPE *p_uri = static_cast<OMX_PARAM_CONTENTURITYPE *>(ptr);
+		size_t len_uri;
+
+		len_uri = p_uri->nSize - sizeof(OMX_PARAM_CONTENTURITYPE);
+		if (len_uri < uri_target.size()) {
+			errprint("length %d is too short, needs %d.\n",
+				(int)len_uri, (int)uri_target.size());
+			return OMX_ErrorBadParameter;
+		}
+		strcpy((char *)p_uri->contentURI, uri_target.c_str());
+
+		err = OMX_ErrorNone;
+		break;
+	}
+	default:
+		err = super::GetParameter(hComponent, nParamIndex, pComponentParameterStructure);
+		break;
+	}
+
+	return err;
+}
+
+OMX_ERRORTYPE writer_binary::SetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nParamIndex, OMX_PTR pComponentParameterStructure)
+{
+	scoped_log_begin;
+	void *ptr = nullptr;
+	OMX_ERRORTYPE err;
+
+	ptr = pComponentParameterStructure;
+
+	switch (nParamIndex) {
+	case OMX_IndexParamContentURI: {
+		OMX_PARAM_CONTENTURITYPE *p_uri = static_cast<OMX_PARAM_CONTENTURITYPE *>(ptr);
+
+		uri_target = (char *)p_uri->contentURI;
+
+		err = OMX_ErrorNone;
+		break;
+	}
+	default:
+		err = super::SetParameter(hComponent, nParamIndex, pComponentParameterStructure);
+		break;
+	}
+
+	return err;
+}
+
 /*
  * protected functions
  */
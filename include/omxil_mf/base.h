@@ -28,6 +28,16 @@
 #    endif
 #endif
 
+#if defined(_WINDOWS)
+#    ifdef __OMX_MF_EXPORTS
+#        define OMX_MF_API_DATA extern __declspec(dllexport)
+#    else
+#        define OMX_MF_API_DATA extern __declspec(dllimport)
+#    endif
+#else
+#    define OMX_MF_API_DATA extern
+#endif
+
 #if defined(_WINDOWS)
 #    ifdef __OMX_MF_EXPORTS
 #        define OMX_MF_API_CLASS __declspec(dllexport)
@@ -2,6 +2,7 @@
 #define OMX_MF_COMPONENT_HPP__
 
 #include <map>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
@@ -19,7 +20,14 @@
 #include <omxil_mf/port.hpp>
 
 //コマンドを受け渡すバッファの深さ
-#define OMX_MF_CMD_DEPTH    1
+//OMX_SendCommand はブロックしないため、一杯になるとエラーを返します
+#define OMX_MF_CMD_DEPTH    64
+//1つのコマンドにまとめられる後続のコマンド数の上限
+#define OMX_MF_CMD_ABSORB_MAX    8
+//フラッシュでバッファの返却を待つ時間の既定値（ミリ秒）
+#define OMX_MF_FLUSH_TIMEOUT_DEFAULT    1000
+//ポート番号で引く表に許す、使われない番号の数
+#define OMX_MF_PORT_TABLE_SLACK    64
 
 
 namespace mf {
@@ -38,6 +46,10 @@ struct OMX_MF_CMD {
 	OMX_U32 param;
 	//OMX_SendCommand の第 4引数です
 	OMX_PTR data;
+	//このコマンドにまとめられた後続のコマンドの第 3引数です
+	OMX_U32 absorbed[OMX_MF_CMD_ABSORB_MAX];
+	//このコマンドにまとめられた後続のコマンドの数です
+	OMX_U32 n_absorbed;
 };
 
 /**
@@ -52,8 +64,29 @@ public:
 	typedef bounded_buffer<command_ring_t, OMX_MF_CMD> command_bound_t;
 	//ワーカースレッド一覧表の型
 	typedef std::vector<component_worker *> workerlist_t;
-	//ポート一覧表の型
-	typedef std::map<OMX_U32, port&> portmap_t;
+	//ポート一覧表の型（ポート番号順）
+	typedef std::vector<port *> portlist_t;
+
+	/**
+	 * ポート一覧表の一部を指す範囲です。
+	 *
+	 * 範囲はコンポーネントが保持する一覧表を指すため、
+	 * 取得してもメモリを確保しません。
+	 */
+	struct port_range {
+		port * const *first;
+		port * const *last;
+
+		port * const *begin() const
+		{
+			return first;
+		}
+
+		port * const *end() const
+		{
+			return last;
+		}
+	};
 
 	//disable default constructor
 	component() = delete;
@@ -82,9 +115,21 @@ public:
 	 */
 	virtual void shutdown();
 
+	/**
+	 * コンポーネントと全てのポート、ワーカーのスレッドに終了を指示します。
+	 *
+	 * 破棄する直前に呼び出します。スレッドの終了は待たないため、
+	 * 続くデストラクタでは各スレッドの終了を並行して待つことになります。
+	 * 呼び出した後は、コマンドもバッファも受け付けません。
+	 */
+	virtual void shutdown_threads();
+
 	/**
 	 * OpenMAX コンポーネントの状態を取得します。
 	 *
+	 * ロックを取らないため、
+	 * 状態遷移中に繰り返し呼び出しても遷移を妨げません。
+	 *
 	 * @return コンポーネントの状態
 	 */
 	virtual OMX_STATETYPE get_state() const;
@@ -100,11 +145,23 @@ public:
 	 * OpenMAX コンポーネントの状態変化を待ちます。
 	 *
 	 * wait_state_multiple(1, s) と同様の効果を持ちます。
+	 * 既に指定した状態であれば、ロックを取らずに戻ります。
 	 *
 	 * @param s 待ちたいコンポーネントの状態
 	 */
 	virtual void wait_state(OMX_STATETYPE s) const;
 
+	/**
+	 * OpenMAX コンポーネントの状態変化を、指定した時間だけ待ちます。
+	 *
+	 * 既に指定した状態であれば、ロックを取らずに戻ります。
+	 *
+	 * @param s    待ちたいコンポーネントの状態
+	 * @param msec 待つ時間（ミリ秒）
+	 * @return 指定した状態になれば true、時間が過ぎれば false
+	 */
+	virtual bool wait_state_for(OMX_STATETYPE s, OMX_U32 msec) const;
+
 	/**
 	 * OpenMAX コンポーネントの状態変化を待ちます。
 	 * 引数は 16個まで指定できます。
@@ -150,6 +207,19 @@ public:
 	 */
 	virtual port *find_port(OMX_U32 index);
 
+	/**
+	 * 指定した条件に一致するポートの範囲を取得します。
+	 *
+	 * 一覧表を作らないため、メモリを確保しません。
+	 * 範囲はポートを追加、削除するまで有効です。
+	 *
+	 * @param port_index ポート番号、
+	 * 	OMX_ALL は全てのポートを表す
+	 * @param range      ポートの範囲
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE filter_ports(OMX_U32 port_index, port_range *range) const;
+
 	/**
 	 * 指定した条件に一致するポートの一覧を取得します。
 	 *
@@ -176,6 +246,135 @@ public:
 	 */
 	virtual void wait_port_buffer_returned(OMX_U32 port_index) const;
 
+	/**
+	 * 指定された有効なポートがバッファを返却するまで、
+	 * 全てのポートを同時に待ちます。
+	 *
+	 * 返却が済んだポートから順に func_port_done を呼び出します。
+	 * get_flush_timeout() の時間が過ぎても返却されないポートは、
+	 * port::return_buffers_force() でバッファを強制的に返却し、
+	 * EventHandler(OMX_EventError, OMX_ErrorTimeout, ポート番号,
+	 * 返却されていなかったバッファ数) で通知してから func_port_done を呼び出します。
+	 *
+	 * @param port_index     バッファを返却するポート番号、
+	 * 	OMX_ALL は全てのポートを表す
+	 * @param func_port_done ポートの返却が済んだときの処理
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE wait_port_buffer_returned_for(OMX_U32 port_index, std::function<void(port *)> func_port_done);
+
+	/**
+	 * ポートの全てのバッファが返却されたことを通知します。
+	 *
+	 * port::add_returned_waiter() を呼び出したポートから呼ばれます。
+	 */
+	virtual void notify_port_buffer_returned();
+
+	/**
+	 * フラッシュでバッファの返却を待つ時間を取得します。
+	 *
+	 * @return 待つ時間（ミリ秒）
+	 */
+	virtual OMX_U32 get_flush_timeout() const;
+
+	/**
+	 * フラッシュでバッファの返却を待つ時間を設定します。
+	 *
+	 * @param msec 待つ時間（ミリ秒）
+	 */
+	virtual void set_flush_timeout(OMX_U32 msec);
+
+	/**
+	 * コマンドを専用のスレッドで処理するかどうかを取得します。
+	 *
+	 * @return 専用のスレッドで処理する場合は OMX_TRUE、
+	 * 	全てのコンポーネントが共有するスレッドで処理する場合は OMX_FALSE
+	 */
+	virtual OMX_BOOL get_command_thread_dedicated() const;
+
+	/**
+	 * コマンドを専用のスレッドで処理するかどうかを設定します。
+	 *
+	 * 最初のコマンドを受け付けた後は変更できません。
+	 * コンポーネント自身が設定する場合は、コンストラクタで設定します。
+	 *
+	 * @param v 専用のスレッドで処理する場合は OMX_TRUE、
+	 * 	全てのコンポーネントが共有するスレッドで処理する場合は OMX_FALSE
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE set_command_thread_dedicated(OMX_BOOL v);
+
+	/**
+	 * ワーカーを全てのコンポーネントが共有するワーカープールで
+	 * 実行するかどうかを取得します。
+	 *
+	 * @return ワーカープールで実行する場合は OMX_TRUE、
+	 * 	ワーカー毎のスレッドで実行する場合は OMX_FALSE
+	 */
+	virtual OMX_BOOL get_worker_pooled() const;
+
+	/**
+	 * ワーカープールで実行する際に優先するレーンを取得します。
+	 *
+	 * @return レーン番号
+	 */
+	virtual OMX_S32 get_worker_lane() const;
+
+	/**
+	 * ワーカーを全てのコンポーネントが共有するワーカープールで
+	 * 実行するかどうかを設定します。
+	 *
+	 * OMX_StateLoaded 状態でのみ変更できます。
+	 * ワーカープールで実行するには、全てのワーカーが
+	 * 単位処理（component_worker::run_step）に対応している必要があります。
+	 *
+	 * @param v    ワーカープールで実行する場合は OMX_TRUE、
+	 * 	ワーカー毎のスレッドで実行する場合は OMX_FALSE
+	 * @param lane 優先するレーン番号、負の値ならば自動で割り当てる
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE set_worker_pooled(OMX_BOOL v, OMX_S32 lane);
+
+	/**
+	 * ワーカープールで実行するワーカーの処理をプールに投入します。
+	 *
+	 * ポートにバッファが届いたときなどに呼び出されます。
+	 * ワーカー毎のスレッドで実行する場合は何もしません。
+	 *
+	 * @see component_worker::schedule()
+	 */
+	virtual void schedule_pooled_workers();
+
+	/**
+	 * コンポーネントの現在の設定を、生成直後の設定として保存します。
+	 *
+	 * プールで再利用するインスタンスの生成直後に一度だけ呼び出します。
+	 * 保存した設定は reset_to_defaults() で戻すときに使います。
+	 */
+	virtual void save_defaults();
+
+	/**
+	 * save_defaults() で設定を保存済みかどうかを取得します。
+	 *
+	 * @return 保存済みならば true、そうでなければ false
+	 */
+	virtual bool has_saved_defaults() const;
+
+	/**
+	 * コンポーネントを save_defaults() で保存した設定に戻します。
+	 *
+	 * コールバック関数、各ポートの definition data、
+	 * トンネル接続、ワーカーの実行方法を戻します。
+	 * OMX_StateLoaded 状態で、処理中のコマンドがなく、
+	 * 全てのポートにバッファが無いときのみ戻せます。
+	 *
+	 * 派生クラスが独自の設定を持つ場合は、
+	 * オーバーライドしてその設定も戻してください。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE reset_to_defaults();
+
 	//----------
 	//OpenMAX member functions
 	//----------
@@ -206,6 +405,7 @@ public:
 	virtual OMX_ERRORTYPE EmptyBufferDone(port_buffer *pb);
 	virtual OMX_ERRORTYPE FillBufferDone(OMX_BUFFERHEADERTYPE *pBuffer);
 	virtual OMX_ERRORTYPE FillBufferDone(port_buffer *pb);
+	virtual OMX_ERRORTYPE BuffersDone(OMX_MF_BUFFERSDONE_FUNC func, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE **ppBuffers, OMX_U32 nBuffers);
 
 
 protected:
@@ -233,6 +433,70 @@ protected:
 	 */
 	virtual OMX_ERRORTYPE free_static_resouces();
 
+	/**
+	 * ベンダー拡張のパラメータを取得します。
+	 *
+	 * OMX_GetParameter にて、
+	 * OMX_IndexVendorStartUnused 以降のインデックスを指定された場合に、
+	 * GetParameter から呼び出されます。
+	 *
+	 * 独自の拡張を追加する場合は派生クラスにてオーバライドし、
+	 * 知らないインデックスは基底クラスの実装に渡してください。
+	 *
+	 * @param nParamIndex                 パラメータのインデックス
+	 * @param pComponentParameterStructure パラメータ
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE get_vendor_parameter(OMX_INDEXTYPE nParamIndex, OMX_PTR pComponentParameterStructure);
+
+	/**
+	 * ベンダー拡張のパラメータを設定します。
+	 *
+	 * OMX_SetParameter にて、
+	 * OMX_IndexVendorStartUnused 以降のインデックスを指定された場合に、
+	 * SetParameter から呼び出されます。
+	 *
+	 * 独自の拡張を追加する場合は派生クラスにてオーバライドし、
+	 * 知らないインデックスは基底クラスの実装に渡してください。
+	 *
+	 * @param nParamIndex                 パラメータのインデックス
+	 * @param pComponentParameterStructure パラメータ
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE set_vendor_parameter(OMX_INDEXTYPE nParamIndex, OMX_PTR pComponentParameterStructure);
+
+	/**
+	 * ベンダー拡張の設定を取得します。
+	 *
+	 * OMX_GetConfig にて、
+	 * OMX_IndexVendorStartUnused 以降のインデックスを指定された場合に、
+	 * GetConfig から呼び出されます。
+	 *
+	 * 独自の拡張を追加する場合は派生クラスにてオーバライドし、
+	 * 知らないインデックスは基底クラスの実装に渡してください。
+	 *
+	 * @param nIndex                    設定のインデックス
+	 * @param pComponentConfigStructure 設定
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE get_vendor_config(OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure);
+
+	/**
+	 * ベンダー拡張の設定を変更します。
+	 *
+	 * OMX_SetConfig にて、
+	 * OMX_IndexVendorStartUnused 以降のインデックスを指定された場合に、
+	 * SetConfig から呼び出されます。
+	 *
+	 * 独自の拡張を追加する場合は派生クラスにてオーバライドし、
+	 * 知らないインデックスは基底クラスの実装に渡してください。
+	 *
+	 * @param nIndex                    設定のインデックス
+	 * @param pComponentConfigStructure 設定
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE set_vendor_config(OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure);
+
 	/**
 	 * コンポーネント内の未処理のバッファを全て破棄、
 	 * 返却（フラッシュ）するように要求します。
@@ -481,14 +745,34 @@ protected:
 
 	/**
 	 * 登録されたワーカースレッドを全て開始します。
+	 *
+	 * 待機しているスレッドは新たに生成せず、再開させます。
 	 */
 	virtual void start_all_worker_threads();
 
 	/**
 	 * 登録されたワーカースレッドを全て停止します。
+	 *
+	 * スレッドは終了せず、再開されるまで待機します。
 	 */
 	virtual void stop_all_worker_threads();
 
+	/**
+	 * 登録されたワーカースレッドを全て一時停止させ、
+	 * 安全な位置で待機するまで待ちます。
+	 *
+	 * 事前にポートの pop_buffer の待機を解除しておいてください。
+	 * ワーカースレッドは保持しているバッファを返却しません。
+	 *
+	 * @see component_worker::wait_paused()
+	 */
+	virtual void pause_all_worker_threads();
+
+	/**
+	 * 一時停止しているワーカースレッドを全て再開させます。
+	 */
+	virtual void resume_all_worker_threads();
+
 	/**
 	 * 登録されたワーカースレッドを強制的に停止します。
 	 *
@@ -497,14 +781,73 @@ protected:
 	virtual void break_all_worker_threads();
 
 	/**
-	 * OMX_SendCommand にて送られたコマンドを処理します。
+	 * OMX_SendCommand にて送られたコマンドを処理し続けます。
 	 *
-	 * OpenMAX API の処理関数と別のスレッドで実行されます。
+	 * コマンドを専用のスレッドで処理する場合に、
+	 * そのスレッドで実行されます。
 	 *
 	 * @return 常に nullptr
 	 */
 	virtual void *accept_command();
 
+	/**
+	 * OMX_SendCommand にて送られたコマンドを一つ処理します。
+	 *
+	 * OpenMAX API の処理関数と別のスレッドで実行されます。
+	 * 同じコンポーネントのコマンドが同時に処理されることはありません。
+	 *
+	 * @param cmd コマンド
+	 */
+	virtual void process_command(const OMX_MF_CMD& cmd);
+
+	/**
+	 * コマンドを処理するスレッドを確定します。
+	 *
+	 * 専用のスレッドで処理する場合は、ここでスレッドを生成します。
+	 * コマンド受け渡し用リングバッファのロックを確保してから呼び出します。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE start_command_thread();
+
+	/**
+	 * 積まれているコマンドを全て処理します（strand）。
+	 *
+	 * 全てのコンポーネントが共有するスレッドで処理する場合に、
+	 * command_executor のスレッドで実行されます。
+	 * 積まれたコマンドがなくなると戻ります。
+	 */
+	virtual void run_command_strand();
+
+	/**
+	 * 未処理のコマンドに、後から送られたコマンドをまとめます。
+	 *
+	 * 下記の場合にまとめます。
+	 * - 同じ状態への OMX_CommandStateSet が続く場合
+	 * - OMX_CommandFlush(OMX_ALL) に OMX_CommandFlush が続く場合
+	 * - OMX_CommandFlush に OMX_CommandFlush(OMX_ALL) が続く場合
+	 *   （未処理のコマンドを OMX_ALL に広げます）
+	 * - 同じポートへの OMX_CommandFlush が続く場合
+	 *
+	 * まとめたコマンドの完了は notify_absorbed_commands にて通知します。
+	 * コマンド受け渡し用リングバッファのロックを確保してから呼び出します。
+	 *
+	 * @param pending 未処理のコマンド
+	 * @param cmd     後から送られたコマンド
+	 * @return まとめた場合は true、まとめられない場合は false
+	 */
+	virtual bool coalesce_command(OMX_MF_CMD *pending, const OMX_MF_CMD& cmd);
+
+	/**
+	 * コマンドにまとめられた後続のコマンドの完了を通知します。
+	 *
+	 * まとめずに処理した場合と同じイベントを発生させます。
+	 *
+	 * @param cmd 処理したコマンド
+	 * @param err コマンドの処理結果
+	 */
+	virtual void notify_absorbed_commands(const OMX_MF_CMD& cmd, OMX_ERRORTYPE err);
+
 	/**
 	 * OMX_SendCommand にて送られたコマンドを処理します。
 	 *
@@ -579,6 +922,17 @@ protected:
 	 */
 	virtual OMX_ERRORTYPE command_state_set_to_idle_from_executing();
 
+	/**
+	 * OMX_SendCommand にて送られたコマンドを処理します。
+	 *
+	 * OMX_SendCommand(OMX_CommandStateSet, OMX_StateIdle...) かつ
+	 * 現在の状態が OMX_StatePause のとき
+	 * に対応します。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE command_state_set_to_idle_from_pause();
+
 	/**
 	 * OMX_SendCommand にて送られたコマンドを処理します。
 	 *
@@ -600,6 +954,17 @@ protected:
 	 */
 	virtual OMX_ERRORTYPE command_state_set_to_executing_from_idle();
 
+	/**
+	 * OMX_SendCommand にて送られたコマンドを処理します。
+	 *
+	 * OMX_SendCommand(OMX_CommandStateSet, OMX_StateExecuting...) かつ
+	 * 現在の状態が OMX_StatePause のとき
+	 * に対応します。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE command_state_set_to_executing_from_pause();
+
 	/**
 	 * OMX_SendCommand にて送られたコマンドを処理します。
 	 *
@@ -610,6 +975,28 @@ protected:
 	 */
 	virtual OMX_ERRORTYPE command_state_set_to_pause();
 
+	/**
+	 * OMX_SendCommand にて送られたコマンドを処理します。
+	 *
+	 * OMX_SendCommand(OMX_CommandStateSet, OMX_StatePause...) かつ
+	 * 現在の状態が OMX_StateIdle のとき
+	 * に対応します。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE command_state_set_to_pause_from_idle();
+
+	/**
+	 * OMX_SendCommand にて送られたコマンドを処理します。
+	 *
+	 * OMX_SendCommand(OMX_CommandStateSet, OMX_StatePause...) かつ
+	 * 現在の状態が OMX_StateExecuting のとき
+	 * に対応します。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE command_state_set_to_pause_from_executing();
+
 	/**
 	 * OMX_SendCommand にて送られたコマンドを処理します。
 	 *
@@ -631,6 +1018,16 @@ protected:
 	 */
 	virtual OMX_ERRORTYPE command_flush(OMX_U32 port_index);
 
+	/**
+	 * OMX_CommandFlush の完了を通知します。
+	 *
+	 * 指定されたポートのうち、有効なポートごとにイベントを発生させます。
+	 *
+	 * @param port_index ポートのインデックス、
+	 * 	OMX_ALL は全てのポートを表す
+	 */
+	virtual void notify_flush_done(OMX_U32 port_index);
+
 	/**
 	 * OMX_SendCommand にて送られたコマンドを処理します。
 	 *
@@ -696,6 +1093,23 @@ protected:
 	virtual OMX_ERRORTYPE execute_flush(OMX_U32 port_index,
 		std::function<OMX_ERRORTYPE(OMX_U32)> func_request_flush, std::function<OMX_ERRORTYPE(OMX_U32)> func_wait_flush_done);
 
+	/**
+	 * execute_flush と同じ順にコンポーネントを停止し、
+	 * ポートに受付済みで、コンポーネントがまだ取り出していないバッファだけを
+	 * 返却します。
+	 *
+	 * コンポーネントが取り出したまま返却していないバッファは返却しないため、
+	 * 必要なら wait_port_buffer_returned_for で期限まで待ってください。
+	 *
+	 * @param port_index             フラッシュするポートのインデックス
+	 * @param func_request_flush     フラッシュ要求処理
+	 * @param func_wait_flush_done   フラッシュ終了待ち処理
+	 * @return OpenMAX エラー値
+	 * @see port::return_queued_buffers
+	 */
+	virtual OMX_ERRORTYPE execute_flush_queued(OMX_U32 port_index,
+		std::function<OMX_ERRORTYPE(OMX_U32)> func_request_flush, std::function<OMX_ERRORTYPE(OMX_U32)> func_wait_flush_done);
+
 	/**
 	 * フラッシュ処理で停止したコンポーネントを再開します。
 	 *
@@ -721,6 +1135,75 @@ protected:
 	virtual OMX_ERRORTYPE execute_restart(OMX_U32 port_index,
 		std::function<OMX_ERRORTYPE(OMX_U32)> func_request_restart, std::function<OMX_ERRORTYPE(OMX_U32)> func_wait_restart_done);
 
+	/**
+	 * 全てのワーカースレッドが軽量フラッシュに対応しているかを取得します。
+	 *
+	 * @return 全て対応していれば true、
+	 * 対応していないワーカースレッドがあれば false
+	 * @see component_worker::is_light_flush_supported()
+	 */
+	virtual bool is_light_flush_supported() const;
+
+	/**
+	 * 全てのワーカースレッドが一時停止に対応しているかを取得します。
+	 *
+	 * @return 全て対応していれば true、
+	 * 対応していないワーカースレッドがあれば false
+	 * @see component_worker::is_pause_supported()
+	 */
+	virtual bool is_pause_supported() const;
+
+	/**
+	 * 全ての有効なポートで、コンポーネントからのバッファ取り出しを
+	 * 禁止、あるいは許可します。
+	 *
+	 * 禁止すると port::pop_buffer の待機が解除され、
+	 * ワーカースレッドは安全な位置（component_worker::accept_flush）へ進みます。
+	 *
+	 * @param f 禁止するならば true、許可するならば false
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE plug_component_all_ports(bool f);
+
+	/**
+	 * トンネル接続のサプライヤーである全ての有効なポートで、
+	 * 相手ポートに全バッファの処理を要求します。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE start_tunneling_all_ports();
+
+	/**
+	 * ワーカースレッドのメイン処理を止めずに、
+	 * ポートに受付済みで、コンポーネントが未処理のバッファを全て返却します。
+	 *
+	 * 下記の順に実行されます。
+	 *
+	 * <pre>
+	 * - クライアントからポートへのバッファ処理要求の受付を禁止します。
+	 *   参照: port::plug_client_request
+	 * - ワーカースレッドにフラッシュを通知します。
+	 *   参照: component_worker::begin_light_flush
+	 * - 全ての有効なポートで port::pop_buffer の待機を解除し、
+	 *   ワーカースレッドを安全な位置（component_worker::accept_flush）へ進めます。
+	 *   参照: port::plug_component_request
+	 * - コンポーネントがまだ取り出していないバッファを返却します。
+	 *   参照: port::return_queued_buffers
+	 * - ワーカースレッドが保持していたバッファの返却を待ちます。
+	 * - ポートへのバッファ処理要求の受付を許可し、
+	 *   ワーカースレッドにフラッシュの終了を通知します。
+	 *   参照: component_worker::end_light_flush
+	 * </pre>
+	 *
+	 * execute_flush, execute_restart と異なり、
+	 * ワーカースレッドのメイン処理を抜けさせないため、
+	 * ワーカースレッドの内部状態は保持されます。
+	 *
+	 * @param port_index フラッシュするポートのインデックス
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE execute_light_flush(OMX_U32 port_index);
+
 	/**
 	 * ポート一覧表にポートを追加します。
 	 *
@@ -742,17 +1225,24 @@ protected:
 	 *
 	 * @return ポート一覧表
 	 */
-	virtual const portmap_t& get_map_ports() const;
+	virtual const portlist_t& get_port_list() const;
 
 	/**
-	 * ポート一覧表を取得します。
+	 * ポート一覧表から、ポート番号で引く表を作り直します。
 	 *
-	 * ポート一覧表に対して、検索、追加、削除、
-	 * 以外の操作を行う場合に使います。
+	 * ポートを追加、削除したときに呼び出します。
+	 */
+	virtual void update_port_table();
+
+	/**
+	 * ポート番号で引く表を使わずに、ポートを検索します。
 	 *
-	 * @return ポート一覧表
+	 * ポート番号が離れすぎていて、表を作らなかったときに使います。
+	 *
+	 * @param index ポート番号
+	 * @return ポートへのポインタ、存在しない場合は nullptr
 	 */
-	virtual portmap_t& get_map_ports();
+	virtual port *find_port_slow(OMX_U32 index) const;
 
 	virtual OMX_ERRORTYPE check_omx_header(const void *p, size_t size) const;
 
@@ -784,25 +1274,60 @@ private:
 	//待機の強制解除フラグ
 	bool f_broken;
 
-	//OpenMAX コンポーネントの状態
-	OMX_STATETYPE state;
+	//OpenMAX コンポーネントの状態（読み出し時はロック不要）
+	std::atomic<OMX_STATETYPE> state;
 	//OpenMAX コールバック関数
 	OMX_CALLBACKTYPE omx_cbs;
 	//OpenMAX コールバック関数に渡すアプリケーション定義のデータ
 	void *omx_cbs_priv;
 
-	//コマンド受理スレッド
+	//コマンド受理スレッド、共有のスレッドで処理する場合は nullptr
 	std::thread *th_accept;
 	//コマンド受け渡し用リングバッファ
 	std::vector<OMX_MF_CMD> vec_accept;
 	command_ring_t *ring_accept;
 	command_bound_t *bound_accept;
+	//以下はコマンド受け渡し用リングバッファのロックで保護する
+	//コマンドを専用のスレッドで処理するか
+	OMX_BOOL f_cmd_dedicated;
+	//最初のコマンドを受け付けたか
+	bool f_cmd_started;
+	//strand を共有のスレッドに投入済みか
+	bool f_cmd_queued;
+	//コンポーネントの破棄中か
+	bool f_cmd_closed;
+	//strand の終了を通知する条件変数
+	std::condition_variable_any cond_cmd;
 
 	//ワーカースレッド一覧表
 	workerlist_t list_workers;
-
-	//ポート一覧表
-	portmap_t map_ports;
+	//ワーカーをワーカープールで実行するか
+	OMX_BOOL f_worker_pooled;
+	//ワーカープールで優先するレーン
+	OMX_S32 worker_lane;
+
+	//ポート一覧表（ポート番号順）
+	portlist_t list_ports;
+	//ポート番号から port_base を引いた値を添字とするポートの表、
+	//存在しない番号は nullptr
+	std::vector<port *> table_ports;
+	OMX_U32 port_base;
+
+	//複数のポートのバッファ返却を待つときに使用するロック
+	std::mutex mut_returned;
+	std::condition_variable cond_returned;
+	//フラッシュでバッファの返却を待つ時間（ミリ秒）
+	std::atomic<OMX_U32> flush_timeout;
+
+	//save_defaults() で保存した設定を持っているか
+	bool f_saved_defaults;
+	//save_defaults() で保存したポートの definition data（ポート番号順）
+	std::vector<OMX_PARAM_PORTDEFINITIONTYPE> saved_defs;
+	//save_defaults() で保存したコマンド、ワーカーの実行方法
+	OMX_BOOL saved_cmd_dedicated;
+	OMX_BOOL saved_worker_pooled;
+	OMX_S32 saved_worker_lane;
+	OMX_U32 saved_flush_timeout;
 
 };
 
@@ -1,10 +1,13 @@
 ﻿#ifndef OMX_MF_COMPONENT_WORKER_HPP__
 #define OMX_MF_COMPONENT_WORKER_HPP__
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
 
+#include <OMX_Core.h>
+
 #include <omxil_mf/base.h>
 
 namespace mf {
@@ -28,6 +31,8 @@ public:
 	 * NOTE:
 	 * std::thread とは異なり、
 	 * start() を呼び出さない限りスレッドは開始されません。
+	 * 一度開始したスレッドは join() を呼ぶまで破棄されず、
+	 * stop() から start() までの間は待機状態となります。
 	 *
 	 * @param c ワーカースレッドを保持するコンポーネント
 	 */
@@ -94,6 +99,24 @@ public:
 	 */
 	void set_running(bool f);
 
+	/**
+	 * ワーカースレッドがメイン処理を停止し、
+	 * 再開を待っている状態かどうかを取得します。
+	 *
+	 * @return 待機状態ならば true、
+	 * メイン処理を実行中ならば false
+	 */
+	virtual bool is_parked() const;
+
+	/**
+	 * ワーカースレッドがメイン処理を停止し、
+	 * 再開を待っている状態かどうかを設定します。
+	 *
+	 * @param f 待機状態ならば true、
+	 * メイン処理を実行中ならば false
+	 */
+	virtual void set_parked(bool f);
+
 	/**
 	 * このワーカースレッドの資源を待っているスレッドの待機状態を
 	 * 強制的に解除すべきかを取得します。
@@ -204,13 +227,242 @@ public:
 	 */
 	virtual void wait_restart_done();
 
+	/**
+	 * メイン処理を抜けずにフラッシュ処理（軽量フラッシュ）を
+	 * 行えるかどうかを取得します。
+	 *
+	 * 軽量フラッシュに対応するワーカースレッドは、
+	 * メイン処理のバッファ処理の合間に accept_flush() を呼び出し、
+	 * handle_flush() で保持しているバッファを返却してください。
+	 *
+	 * 必要に応じて派生クラスにてオーバライドしてください。
+	 *
+	 * @return 軽量フラッシュに対応していれば true、
+	 * 対応していなければ false
+	 */
+	virtual bool is_light_flush_supported() const;
+
+	/**
+	 * 軽量フラッシュの開始をワーカースレッドに通知します。
+	 *
+	 * コンポーネントから呼び出します。
+	 *
+	 * @param port_index フラッシュするポート番号、
+	 * 全てのポートの場合は OMX_ALL
+	 */
+	virtual void begin_light_flush(OMX_U32 port_index);
+
+	/**
+	 * 軽量フラッシュの終了をワーカースレッドに通知します。
+	 *
+	 * コンポーネントから呼び出します。
+	 * accept_flush() で待機しているワーカースレッドは処理を再開します。
+	 */
+	virtual void end_light_flush();
+
+	/**
+	 * 一時停止（OMX_StatePause）に対応しているかどうかを取得します。
+	 *
+	 * 一時停止中のワーカースレッドは accept_flush() で待機します。
+	 * 軽量フラッシュに対応していないワーカースレッドも、
+	 * 待機を解除された pop_buffer() の中で待機するため、
+	 * デフォルトでは対応します。
+	 *
+	 * @return 一時停止に対応していれば true、
+	 * 対応していなければ false
+	 */
+	virtual bool is_pause_supported() const;
+
+	/**
+	 * ワーカースレッドが一時停止を要求されているかどうかを取得します。
+	 *
+	 * @return 一時停止を要求されていれば true、
+	 * 要求されていなければ false
+	 */
+	virtual bool is_paused() const;
+
+	/**
+	 * ワーカースレッドに一時停止、あるいは再開を要求します。
+	 *
+	 * コンポーネントから呼び出します。
+	 * accept_flush() で待機しているワーカースレッドは、
+	 * 再開を要求されると処理を再開します。
+	 *
+	 * @param f 一時停止するならば true、
+	 * 再開するならば false
+	 */
+	virtual void set_paused(bool f);
+
+	/**
+	 * 一時停止を要求したワーカースレッドが、
+	 * accept_flush() で待機するまで待ちます。
+	 *
+	 * コンポーネントから呼び出します。
+	 */
+	virtual void wait_paused();
+
+	/**
+	 * accept_flush() で処理すべき要求があるかどうかを取得します。
+	 *
+	 * 軽量フラッシュや一時停止の要求により pop_buffer() の待機が
+	 * 解除された場合は、エラーとして扱わずに accept_flush() を
+	 * 呼び出してください。
+	 *
+	 * @return 軽量フラッシュか一時停止を要求されていれば true、
+	 * 要求されていなければ false
+	 */
+	virtual bool is_request_accept_flush() const;
+
+	/**
+	 * 軽量フラッシュが要求されていれば handle_flush() を呼び出し、
+	 * フラッシュが終わるまで待ちます。
+	 * 一時停止が要求されていれば、再開されるまで待ちます。
+	 * 一時停止中に要求された軽量フラッシュも処理します。
+	 *
+	 * メイン処理のバッファを処理していない、
+	 * 安全な位置から呼び出してください。
+	 * 要求されていなければすぐに返ります。
+	 *
+	 * @return フラッシュ処理か一時停止を行った場合は true、
+	 * 要求されていなかった場合は false
+	 */
+	virtual bool accept_flush();
+
+	/**
+	 * 呼び出したスレッドでメイン処理を実行しているワーカーを取得します。
+	 *
+	 * @return ワーカースレッドから呼び出した場合はワーカーへのポインタ、
+	 * それ以外のスレッドから呼び出した場合は nullptr
+	 */
+	static component_worker *get_current();
+
+	/**
+	 * 軽量フラッシュの際にワーカースレッドから呼び出されます。
+	 *
+	 * フラッシュするポートのバッファを保持していれば返却し、
+	 * 必要ならワーカースレッドの内部状態を初期化してください。
+	 *
+	 * 必要に応じて派生クラスにてオーバライドしてください。
+	 *
+	 * @param port_index フラッシュするポート番号、
+	 * 全てのポートの場合は OMX_ALL
+	 */
+	virtual void handle_flush(OMX_U32 port_index);
+
+	/**
+	 * ブロックしない単位処理（run_step()）に対応しているかどうかを取得します。
+	 *
+	 * 対応しているワーカーは、スレッドを持たずに
+	 * 全てのコンポーネントが共有するワーカープールで実行できます。
+	 *
+	 * 必要に応じて派生クラスにてオーバライドしてください。
+	 *
+	 * @return 単位処理に対応していれば true、
+	 * 対応していなければ false
+	 */
+	virtual bool is_step_supported() const;
+
+	/**
+	 * ワーカープールで実行するかどうかを取得します。
+	 *
+	 * @return ワーカープールで実行するならば true、
+	 * 専用のスレッドで実行するならば false
+	 */
+	virtual bool is_pooled() const;
+
+	/**
+	 * ワーカープールで実行するかどうかを設定します。
+	 *
+	 * start() を呼び出す前に設定してください。
+	 * ワーカープールで実行するには is_step_supported() が
+	 * true を返す必要があります。
+	 *
+	 * @param f ワーカープールで実行するならば true、
+	 * 専用のスレッドで実行するならば false
+	 */
+	virtual void set_pooled(bool f);
+
+	/**
+	 * ワーカープールで実行する際に優先するレーンを取得します。
+	 *
+	 * @return レーン番号
+	 */
+	virtual int get_lane() const;
+
+	/**
+	 * ワーカープールで実行する際に優先するレーンを設定します。
+	 *
+	 * 同じレーンに投入された処理は、
+	 * 他のスレッドに盗まれない限り同じスレッドで実行されます。
+	 *
+	 * @param l レーン番号
+	 */
+	virtual void set_lane(int l);
+
+	/**
+	 * ワーカープールで実行するワーカーの処理をプールに投入します。
+	 *
+	 * 入力バッファや出力バッファが届いたとき、
+	 * ワーカーへの要求が変わったときに呼び出します。
+	 * 既に投入済みならば何もせず、
+	 * 実行中ならば処理を終えた後にもう一度実行します。
+	 * 専用のスレッドで実行するワーカーでは何もしません。
+	 */
+	virtual void schedule();
+
+	/**
+	 * ワーカープールで実行する際、メイン処理の開始時に呼び出されます。
+	 *
+	 * run() の先頭で行う初期化を行ってください。
+	 *
+	 * 必要に応じて派生クラスにてオーバライドしてください。
+	 */
+	virtual void begin_step();
+
+	/**
+	 * ワーカープールで実行する際のメイン処理の単位処理を行います。
+	 *
+	 * 入力バッファや出力バッファが揃っていなければ、
+	 * 待たずに false を返してください。
+	 * バッファは port::try_pop_buffer() で取り出します。
+	 * フラッシュや一時停止の要求はワーカープール側で処理するため、
+	 * accept_flush() を呼ぶ必要はありません。
+	 *
+	 * 単位処理に対応するワーカーは派生クラスにてオーバライドしてください。
+	 *
+	 * @return 処理が進んだならば true、
+	 * バッファが揃わず処理が進まなかったならば false
+	 */
+	virtual bool run_step();
+
+	/**
+	 * メイン処理の実行が指示されるまで待ちます。
+	 *
+	 * 待機状態のフラグは自動的にクリアされます。
+	 */
+	virtual void wait_running();
+
 	/**
 	 * ワーカースレッドを開始します。
+	 *
+	 * スレッドが既に存在する場合は新たに生成せず、
+	 * 待機しているスレッドにメイン処理の再開を通知するだけです。
+	 * 事前に set_running(true) を呼び出してください。
 	 */
 	virtual void start();
 
+	/**
+	 * ワーカースレッドのメイン処理を停止し、
+	 * スレッドが待機状態になるまで待ちます。
+	 *
+	 * スレッドは終了せず、次の start() で再開します。
+	 */
+	virtual void stop();
+
 	/**
 	 * ワーカースレッドが終了するまで待ちます。
+	 *
+	 * 事前に set_broken(true) を呼び出してください。
 	 */
 	virtual void join();
 
@@ -231,6 +483,25 @@ protected:
 	 */
 	virtual void error_if_broken(std::unique_lock<std::mutex>& lock) const;
 
+	/**
+	 * ワーカープールのスレッドから呼び出され、
+	 * 処理が進まなくなるまで drive_step() を繰り返します。
+	 */
+	virtual void run_task();
+
+	/**
+	 * ワーカープールで実行する際に、
+	 * ワーカースレッドのメイン関数に相当する処理を一段階進めます。
+	 *
+	 * メイン処理の開始、フラッシュ、一時停止の要求を処理し、
+	 * 要求がなければ run_step() を呼び出します。
+	 * ブロックしません。
+	 *
+	 * @return 処理が進んだならば true、
+	 * 進まなかったならば false
+	 */
+	virtual bool drive_step();
+
 protected:
 	/**
 	 * ワーカースレッドのメイン関数です。
@@ -253,8 +524,10 @@ private:
 
 	//処理を続けるかどうかのフラグ
 	bool f_running;
-	//待機の強制解除フラグ
-	bool f_broken;
+	//メイン処理を停止し、再開を待っているかどうかのフラグ
+	bool f_parked;
+	//待機の強制解除フラグ、schedule() はロックせずに読む
+	std::atomic<bool> f_broken;
 	//フラッシュ要求フラグ
 	bool f_request_flush;
 	//フラッシュ完了フラグ
@@ -263,6 +536,40 @@ private:
 	bool f_request_restart;
 	//リスタート完了フラグ
 	bool f_restart_done;
+	//軽量フラッシュ中フラグ
+	bool f_light_flush;
+	//軽量フラッシュするポート番号
+	OMX_U32 light_flush_port;
+	//軽量フラッシュの要求回数、ワーカースレッドが処理した回数
+	std::atomic<uint32_t> cnt_light_flush;
+	uint32_t cnt_light_flush_accepted;
+	//一時停止要求フラグ
+	std::atomic<bool> f_paused;
+	//一時停止の要求を受けて待機しているかどうかのフラグ
+	bool f_pause_parked;
+
+	//ワーカープールの処理の状態
+	enum {
+		//未投入
+		TASK_IDLE,
+		//投入済み
+		TASK_QUEUED,
+		//実行中
+		TASK_RUNNING,
+		//実行中に再度投入を要求された
+		TASK_RESCHEDULED,
+	};
+
+	//ワーカープールで実行するかどうかのフラグ、schedule() はロックせずに読む
+	std::atomic<bool> f_pooled;
+	//ワーカープールで優先するレーン
+	int lane;
+	//ワーカープールの処理の状態
+	std::atomic<int> task_state;
+	//ワーカープールでメイン処理を実行中かどうかのフラグ
+	bool f_in_step;
+	//ワーカースレッドでメイン処理（run()）を実行中かどうかのフラグ
+	bool f_in_run;
 
 };
 
@@ -25,6 +25,20 @@ extern "C" {
 #define DPRINT_LEVEL_DEBUG     5
 #define DPRINT_LEVEL_TRACE     6
 
+/**
+ * Maximum debug print level compiled in.
+ *
+ * Debug prints over this level are removed at compile time,
+ * they cost nothing even if the runtime level is higher.
+ * scoped_log_begin is also removed if this is lower than
+ * DPRINT_LEVEL_TRACE.
+ *
+ * configure sets this by --with-log-max-level.
+ */
+#ifndef OMX_MF_LOG_MAX_LEVEL
+#define OMX_MF_LOG_MAX_LEVEL   DPRINT_LEVEL_TRACE
+#endif
+
 #if defined(__linux__)
 /* Linux */
 #define thread_id()    ((pid_t)syscall(SYS_gettid))
@@ -50,9 +64,72 @@ OMX_MF_API int OMX_MF_set_debug_level(int level);
 OMX_MF_API int OMX_MF_print_cont(int level, const char *fmt, ...);
 #endif
 
+/**
+ * Destination of debug prints.
+ *
+ * STDERR : Standard error (default)
+ * FILE   : File, see OMX_MF_set_log_sink()
+ * ANDROID: Android log (only on Android)
+ */
+#define OMX_MF_LOG_SINK_STDERR     0
+#define OMX_MF_LOG_SINK_FILE       1
+#define OMX_MF_LOG_SINK_ANDROID    2
+
+/**
+ * Write debug prints on the background thread.
+ *
+ * Threads format the messages into their own ring buffers without locks
+ * and return. The background thread writes them to the sink.
+ * If a ring buffer is full, the message is dropped and counted.
+ *
+ * @param enable Non-zero to start, 0 to stop and write out all messages
+ * @return 0 if success, -1 if failed
+ */
+OMX_MF_API int OMX_MF_set_log_async(int enable);
+
+/**
+ * Change the destination of debug prints.
+ *
+ * @param sink OMX_MF_LOG_SINK_XXXX
+ * @param path Path of the file if sink is OMX_MF_LOG_SINK_FILE,
+ *             messages are appended to the file
+ * @return 0 if success, -1 if failed
+ */
+OMX_MF_API int OMX_MF_set_log_sink(int sink, const char *path);
+
+/**
+ * Write out all messages waiting for the background thread.
+ */
+OMX_MF_API void OMX_MF_flush_log(void);
+
+/**
+ * Get the number of messages dropped because the ring buffer was full.
+ *
+ * @return Number of dropped messages since the process started
+ */
+OMX_MF_API unsigned long long OMX_MF_get_log_dropped(void);
+
+/**
+ * Runtime debug print level.
+ *
+ * Use OMX_MF_set_debug_level() to change,
+ * OMX_MF_debug_level_load() to read without calling a function.
+ */
+OMX_MF_API_DATA int OMX_MF_debug_level;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define OMX_MF_debug_level_load()     __atomic_load_n(&OMX_MF_debug_level, __ATOMIC_RELAXED)
+#else
+#define OMX_MF_debug_level_load()     (*(volatile int *)&OMX_MF_debug_level)
+#endif
+
+#define OMX_MF_debug_level_enabled(level)                             \
+	((level) <= OMX_MF_LOG_MAX_LEVEL &&                           \
+		(level) <= OMX_MF_debug_level_load())
+
 #define OMX_MF_print_cont_chk(level, fmt, ...)                        \
 	do {                                                          \
-		if (level <= OMX_MF_get_debug_level()) {              \
+		if (OMX_MF_debug_level_enabled(level)) {              \
 			OMX_MF_print_cont(level, fmt, ##__VA_ARGS__); \
 		}                                                     \
 	} while (0)
@@ -121,6 +121,18 @@ public:
 	virtual OMX_ERRORTYPE ComponentRoleEnum(OMX_HANDLETYPE hComponent, OMX_U8 *cRole, OMX_U32 nIndex) = 0;
 
 
+public:
+	/**
+	 * OpenMAX コンポーネントのハンドルが、
+	 * omx_reflector クラスのインスタンスに接続されているかどうかを取得します。
+	 *
+	 * 同じプロセスで動作する OpenMAX MF のコンポーネントであれば true を返します。
+	 *
+	 * @param hComponent OpenMAX コンポーネント
+	 * @return omx_reflector に接続されていれば true、そうでなければ false
+	 */
+	static bool is_reflector(OMX_HANDLETYPE hComponent);
+
 protected:
 	/**
 	 * OpenMAX コンポーネントのハンドルから、
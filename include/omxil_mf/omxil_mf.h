@@ -14,6 +14,16 @@ extern "C" {
 #define OMX_MF_ENTRY_FUNCNAME    "OMX_MF_LibEntry"
 typedef OMX_ERRORTYPE OMX_APIENTRY (*OMX_MF_ENTRY_FUNC)(void);
 
+#if defined(OMX_MF_BUILTIN_ENTRY)
+/*
+ * Components library linked into OpenMAX MF lib
+ * (configure --enable-builtin-components) is built with
+ * -DOMX_MF_BUILTIN_ENTRY=<unique name>, so that entry functions of
+ * several libraries do not conflict.
+ */
+#define OMX_MF_LibEntry    OMX_MF_BUILTIN_ENTRY
+#endif
+
 /**
  * The entry function of addtional components library.
  *
@@ -55,6 +65,353 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_RegisterComponent(const char *name, co
 OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_RegisterComponentAlias(const char *name, const char *alias);
 OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_RegisterComponentRole(const char *name, const char *role);
 
+
+/**
+ * API for IL client.
+ */
+
+/**
+ * Change the state of tunneled components together.
+ *
+ * Sends OMX_CommandStateSet to all components and waits until
+ * all of them reach eState. If the transition needs an intermediate
+ * state (ex. Loaded -> Idle -> Executing), components go through it.
+ * A component moves on to the next state as soon as it and its
+ * tunneled peers in the list have finished the previous one,
+ * so the transitions of the pipeline run concurrently.
+ *
+ * The client still receives OMX_EventCmdComplete or OMX_EventError
+ * of each command by the callbacks of the component.
+ *
+ * @param hComponents: Array of components, all must be in the same state.
+ * @param nComponents: Number of components.
+ * @param eState     : New state. Loaded, Idle, Executing or Pause.
+ * @param nTimeout   : Timeout of the whole transition in milliseconds.
+ * @return OMX_ErrorNone if success,
+ * OMX_ErrorTimeout if some components did not reach the state in time,
+ * OMX error value if failed.
+ */
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_SetPipelineState(OMX_HANDLETYPE *hComponents, OMX_U32 nComponents, OMX_STATETYPE eState, OMX_U32 nTimeout);
+
+/**
+ * Keep constructed instances of the component for reuse.
+ *
+ * Constructs nInstances instances of the component in advance.
+ * OMX_GetHandle hands out one of them instead of constructing
+ * a new instance, its callbacks, port definitions and tunnels
+ * are reset to the defaults of the component. OMX_FreeHandle
+ * returns the instance back to the pool instead of destructing it,
+ * while the pool has less than nInstances idle instances.
+ *
+ * The pool is kept for each name, so aliases of the component
+ * have their own pools. Pools are destroyed by OMX_Deinit.
+ *
+ * @param cComponentName: Name of the component.
+ * @param nInstances    : Maximum number of idle instances,
+ * 0 destroys the pool.
+ * @return OMX_ErrorNone if success,
+ * OMX_ErrorInvalidComponentName if the component is not found,
+ * OMX error value if failed.
+ */
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_SetComponentPool(OMX_STRING cComponentName, OMX_U32 nInstances);
+
+/**
+ * Free the handles of components together.
+ *
+ * Same as calling OMX_FreeHandle for each component, but signals
+ * all threads of all components to stop first, and then destructs
+ * the components in parallel.
+ *
+ * If some components are not in Loaded state, no components
+ * are freed.
+ *
+ * @param hComponents: Array of components, must not contain
+ * the same component twice.
+ * @param nComponents: Number of components.
+ * @return OMX_ErrorNone if success,
+ * OMX_ErrorInvalidState if some components are not in Loaded state,
+ * OMX error value if failed.
+ */
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_FreeHandles(OMX_HANDLETYPE *hComponents, OMX_U32 nComponents);
+
+/**
+ * Start recording trace events of the framework.
+ *
+ * Each thread records timestamped events (buffers pushed and popped,
+ * callbacks, commands, state changes and flush stages) into its own
+ * ring buffer. If the ring buffer is full, the oldest events are
+ * overwritten. Events recorded before are discarded.
+ *
+ * Setting the environment variable OMX_MF_TRACE=<path> starts
+ * recording at OMX_Init and writes the trace to the path at OMX_Deinit.
+ *
+ * @return OMX_ErrorNone
+ */
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_StartTrace(void);
+
+/**
+ * Stop recording trace events, and write them as Chrome trace JSON.
+ *
+ * Open the file with Perfetto (https://ui.perfetto.dev) or
+ * chrome://tracing.
+ *
+ * @param cFileName: Path of the file, nullptr only stops recording.
+ * @return OMX_ErrorNone if success,
+ * OMX_ErrorInsufficientResources if failed to write the file.
+ */
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_StopTrace(OMX_STRING cFileName);
+
+
+/**
+ * Vendor extensions for IL client.
+ *
+ * Get the index by OMX_GetExtensionIndex() with following names,
+ * and use it with OMX_GetParameter() or OMX_SetParameter().
+ */
+
+/**
+ * Enable or disable direct buffer handoff between tunneled ports.
+ *
+ * If both ends of the tunnel are OpenMAX MF components
+ * in the same process, the port pushes used buffers into
+ * the tunneled port directly without returning thread.
+ * This mode is enabled by default.
+ *
+ * Structure: OMX_MF_PARAM_TUNNELDIRECTTYPE
+ */
+#define OMX_MF_INDEX_PARAM_TUNNEL_DIRECT    "OMX.MF.index.param.tunnelDirect"
+
+typedef enum OMX_MF_INDEXTYPE {
+	OMX_MF_IndexVendorStart = OMX_IndexVendorStartUnused + 0x00004d46,
+	OMX_MF_IndexParamTunnelDirect = OMX_MF_IndexVendorStart,
+	OMX_MF_IndexParamBatchDone,
+	OMX_MF_IndexConfigSubmitBuffers,
+	OMX_MF_IndexParamFlushTimeout,
+	OMX_MF_IndexParamCommandThread,
+	OMX_MF_IndexParamWorkerPool,
+	OMX_MF_IndexConfigPortLatency,
+	OMX_MF_IndexMax = 0x7fffffff
+} OMX_MF_INDEXTYPE;
+
+typedef struct OMX_MF_PARAM_TUNNELDIRECTTYPE {
+	OMX_U32 nSize;
+	OMX_VERSIONTYPE nVersion;
+	OMX_U32 nPortIndex;
+	OMX_BOOL bEnabled;
+} OMX_MF_PARAM_TUNNELDIRECTTYPE;
+
+/**
+ * Enable or disable batched buffer done callback.
+ *
+ * If enabled, the port returns used buffers to the IL client by
+ * pBuffersDone callback instead of EmptyBufferDone or FillBufferDone.
+ * The callback carries the array of buffers that are returned
+ * in one wakeup of the returning thread.
+ *
+ * nMaxBatch   : Maximum number of buffers in one callback.
+ * nMaxDelayUs : Maximum time (in microseconds) to wait for
+ *               more buffers before calling pBuffersDone.
+ *               0 means that the port does not wait.
+ *
+ * This mode is disabled by default.
+ * It cannot be used for tunneled ports.
+ *
+ * Structure: OMX_MF_PARAM_BATCHDONETYPE
+ */
+#define OMX_MF_INDEX_PARAM_BATCH_DONE    "OMX.MF.index.param.batchDone"
+
+/**
+ * Batched buffer done callback.
+ *
+ * @param hComponent: Handle of the component.
+ * @param pAppData  : Application data which is specified at OMX_GetHandle().
+ * @param nPortIndex: Index of the port which returns buffers.
+ * @param ppBuffers : Array of returned buffers.
+ * @param nBuffers  : Number of returned buffers.
+ * @return OMX_ErrorNone if success, OMX error value if failed.
+ */
+typedef OMX_ERRORTYPE (*OMX_MF_BUFFERSDONE_FUNC)(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE **ppBuffers, OMX_U32 nBuffers);
+
+typedef struct OMX_MF_PARAM_BATCHDONETYPE {
+	OMX_U32 nSize;
+	OMX_VERSIONTYPE nVersion;
+	OMX_U32 nPortIndex;
+	OMX_BOOL bEnabled;
+	OMX_U32 nMaxBatch;
+	OMX_U32 nMaxDelayUs;
+	OMX_MF_BUFFERSDONE_FUNC pBuffersDone;
+} OMX_MF_PARAM_BATCHDONETYPE;
+
+/**
+ * Submit many buffers to one port in a single call.
+ *
+ * Use with OMX_SetConfig(). If the port is input, this works as
+ * OMX_EmptyThisBuffer() for each buffer, if the port is output,
+ * this works as OMX_FillThisBuffer() for each buffer.
+ * The port validates all buffers before accepting any of them.
+ * The port accepts all buffers or none of them, nBuffers must not
+ * exceed the number of buffers which the port can hold at once.
+ *
+ * ppBuffers: Array of buffers to submit.
+ * nBuffers : Number of buffers in ppBuffers.
+ *
+ * Structure: OMX_MF_CONFIG_SUBMITBUFFERSTYPE
+ */
+#define OMX_MF_INDEX_CONFIG_SUBMIT_BUFFERS    "OMX.MF.index.config.submitBuffers"
+
+typedef struct OMX_MF_CONFIG_SUBMITBUFFERSTYPE {
+	OMX_U32 nSize;
+	OMX_VERSIONTYPE nVersion;
+	OMX_U32 nPortIndex;
+	OMX_U32 nBuffers;
+	OMX_BUFFERHEADERTYPE **ppBuffers;
+} OMX_MF_CONFIG_SUBMITBUFFERSTYPE;
+
+/**
+ * Time limit of OMX_CommandFlush.
+ *
+ * The component flushes all requested ports at the same time,
+ * and sends OMX_EventCmdComplete for each port as soon as
+ * the port gets back all buffers.
+ * If some buffers are not returned within nTimeoutMs, the port
+ * returns held buffers forcibly and the component sends
+ * OMX_EventError before OMX_EventCmdComplete of the port:
+ *
+ *   nData1    : OMX_ErrorTimeout
+ *   nData2    : Index of the port.
+ *   pEventData: Number of buffers which were not returned
+ *               (cast to OMX_PTR).
+ *
+ * nTimeoutMs: Time limit in milliseconds, the default is 1000.
+ *
+ * Structure: OMX_MF_PARAM_FLUSHTIMEOUTTYPE
+ */
+#define OMX_MF_INDEX_PARAM_FLUSH_TIMEOUT    "OMX.MF.index.param.flushTimeout"
+
+typedef struct OMX_MF_PARAM_FLUSHTIMEOUTTYPE {
+	OMX_U32 nSize;
+	OMX_VERSIONTYPE nVersion;
+	OMX_U32 nTimeoutMs;
+} OMX_MF_PARAM_FLUSHTIMEOUTTYPE;
+
+/**
+ * Thread which processes commands sent by OMX_SendCommand().
+ *
+ * By default, commands of all components are processed by
+ * a thread pool shared in the process. Commands of one component
+ * are still processed one by one in the order they were sent.
+ * If bDedicated is OMX_TRUE, the component creates its own thread
+ * for commands instead of the shared pool.
+ *
+ * This parameter can be changed only before the first
+ * OMX_SendCommand() to the component.
+ *
+ * Structure: OMX_MF_PARAM_COMMANDTHREADTYPE
+ */
+#define OMX_MF_INDEX_PARAM_COMMAND_THREAD    "OMX.MF.index.param.commandThread"
+
+typedef struct OMX_MF_PARAM_COMMANDTHREADTYPE {
+	OMX_U32 nSize;
+	OMX_VERSIONTYPE nVersion;
+	OMX_BOOL bDedicated;
+} OMX_MF_PARAM_COMMANDTHREADTYPE;
+
+/**
+ * Threads which run workers of the component.
+ *
+ * By default, each worker of the component has its own thread
+ * which blocks until buffers arrive. If bEnabled is OMX_TRUE,
+ * workers run as non-blocking tasks on a work-stealing thread pool
+ * shared in the process. A task is scheduled when buffers arrive
+ * at the ports of the component. The pool has one thread per CPU.
+ *
+ * nLane is a hint of the pool thread which runs the workers.
+ * Tasks of the same lane usually run on the same thread unless
+ * other threads are idle and steal them. If nLane is negative,
+ * the lane is assigned automatically.
+ *
+ * The pool can be enabled only if all workers of the component
+ * support non-blocking steps, otherwise OMX_SetParameter() fails
+ * with OMX_ErrorUnsupportedSetting. This parameter can be changed
+ * only in OMX_StateLoaded.
+ *
+ * Structure: OMX_MF_PARAM_WORKERPOOLTYPE
+ */
+#define OMX_MF_INDEX_PARAM_WORKER_POOL    "OMX.MF.index.param.workerPool"
+
+typedef struct OMX_MF_PARAM_WORKERPOOLTYPE {
+	OMX_U32 nSize;
+	OMX_VERSIONTYPE nVersion;
+	OMX_BOOL bEnabled;
+	OMX_S32 nLane;
+} OMX_MF_PARAM_WORKERPOOLTYPE;
+
+/**
+ * Latency and throughput statistics of a port.
+ *
+ * The port records monotonic timestamps of each buffer at
+ * the following points, and keeps a latency histogram per stage:
+ *
+ *   OMX_MF_LatencyStageQueued   : From OMX_EmptyThisBuffer() or
+ *                                 OMX_FillThisBuffer() until the worker
+ *                                 of the component takes the buffer.
+ *   OMX_MF_LatencyStageHeld     : While the worker holds the buffer.
+ *   OMX_MF_LatencyStageReturning: From the worker returns the buffer
+ *                                 until the callback is called.
+ *   OMX_MF_LatencyStageCallback : Inside the callback (EmptyBufferDone,
+ *                                 FillBufferDone, pBuffersDone or
+ *                                 the tunneled port).
+ *   OMX_MF_LatencyStageTotal    : From OMX_EmptyThisBuffer() or
+ *                                 OMX_FillThisBuffer() until
+ *                                 the callback returns.
+ *
+ * Use with OMX_GetConfig() to read the statistics, and OMX_SetConfig()
+ * to reset them. OMX_SetConfig() uses only nPortIndex.
+ *
+ * Percentiles are upper bounds of histogram buckets,
+ * they are at most 1/32 (about 3%) larger than the actual value.
+ * Latencies over 2^36 ns (about 68 seconds) are counted
+ * in the last bucket.
+ *
+ * nBuffers  : Number of buffers returned by the worker.
+ * nBytes    : Number of bytes submitted to the input port,
+ *             or returned from the output port (nFilledLen).
+ * nElapsedUs: Time since the statistics are reset (microseconds).
+ * sStage    : Statistics of each stage.
+ *
+ * Structure: OMX_MF_CONFIG_PORTLATENCYTYPE
+ */
+#define OMX_MF_INDEX_CONFIG_PORT_LATENCY    "OMX.MF.index.config.portLatency"
+
+typedef enum OMX_MF_LATENCYSTAGETYPE {
+	OMX_MF_LatencyStageQueued,
+	OMX_MF_LatencyStageHeld,
+	OMX_MF_LatencyStageReturning,
+	OMX_MF_LatencyStageCallback,
+	OMX_MF_LatencyStageTotal,
+	OMX_MF_LatencyStageMax
+} OMX_MF_LATENCYSTAGETYPE;
+
+typedef struct OMX_MF_LATENCYSTATSTYPE {
+	OMX_U64 nCount;
+	OMX_U64 nMinNs;
+	OMX_U64 nMaxNs;
+	OMX_U64 nMeanNs;
+	OMX_U64 nP50Ns;
+	OMX_U64 nP99Ns;
+	OMX_U64 nP999Ns;
+} OMX_MF_LATENCYSTATSTYPE;
+
+typedef struct OMX_MF_CONFIG_PORTLATENCYTYPE {
+	OMX_U32 nSize;
+	OMX_VERSIONTYPE nVersion;
+	OMX_U32 nPortIndex;
+	OMX_U64 nBuffers;
+	OMX_U64 nBytes;
+	OMX_U64 nElapsedUs;
+	OMX_MF_LATENCYSTATSTYPE sStage[OMX_MF_LatencyStageMax];
+} OMX_MF_CONFIG_PORTLATENCYTYPE;
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
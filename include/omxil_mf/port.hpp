@@ -2,6 +2,7 @@
 #define OMX_MF_PORT_HPP__
 
 #include <vector>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
@@ -10,18 +11,22 @@
 #include <OMX_Core.h>
 
 #include <omxil_mf/base.h>
+#include <omxil_mf/omxil_mf.h>
 #include <omxil_mf/ring/ring_buffer.hpp>
 #include <omxil_mf/ring/bounded_buffer.hpp>
 #include <omxil_mf/port_buffer.hpp>
 #include <omxil_mf/port_format.hpp>
 
 
-//OpenMAX バッファを受け渡すバッファの深さ
+//OpenMAX バッファを受け渡すバッファの深さの初期値
+//ポートにバッファが揃った時点で、バッファ数に合わせて変更します。
 #define OMX_MF_BUFS_DEPTH    10
 
 
 namespace mf {
 
+class port_latency;
+
 class OMX_MF_API_CLASS port {
 public:
 	//親クラス
@@ -336,6 +341,21 @@ public:
 	 */
 	virtual bool is_shutting_write() const;
 
+	/**
+	 * ポートのスレッドに終了を指示します。
+	 *
+	 * 終了を待たずに戻ります、終了を待つには join_threads() を呼び出します。
+	 * 複数のポートを破棄する場合は、先に全てのポートに終了を指示すると、
+	 * 各スレッドの終了を並行して待つことができます。
+	 * 呼び出した後は、バッファの受け渡しはできません。
+	 */
+	virtual void shutdown_threads();
+
+	/**
+	 * shutdown_threads() で終了を指示したスレッドの終了を待ちます。
+	 */
+	virtual void join_threads();
+
 	/**
 	 * ポートのバッファが全て解放されているかどうか取得します。
 	 *
@@ -421,7 +441,14 @@ public:
 	 * Get OpenMAX IL definition data of this port.
 	 *
 	 * OMX_PARAM_PORTDEFINITIONTYPE の各メンバに設定値がセットされます。
-	 * ただし format メンバは 0 で埋められます。
+	 * format メンバは継承先のクラスが設定し、
+	 * このクラスでは 0 で埋められます。
+	 *
+	 * 内部の一時領域を使わず、ロックも取らないため、
+	 * 複数のスレッドから同時に呼び出すことができます。
+	 * definition data の更新中に呼び出された場合は、
+	 * 更新前の値を返します。
+	 * 更新前と更新後が混ざった値を返すことはありません。
 	 *
 	 * <pre>
 	 * struct OMX_PARAM_PORTDEFINITIONTYPE {
@@ -446,6 +473,20 @@ public:
 	 * }
 	 * </pre>
 	 *
+	 * @param def port definition data を受け取るポインタ
+	 */
+	virtual void get_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const;
+
+	/**
+	 * Get OpenMAX IL definition data of this port.
+	 *
+	 * 以前の版との互換性のために残しています。
+	 * 新たに使う場合は get_definition(OMX_PARAM_PORTDEFINITIONTYPE *)
+	 * を使ってください。
+	 *
+	 * 呼び出したスレッドごとの一時領域にコピーして返します。
+	 * 返した値は、同じスレッドが次に呼び出すまで有効です。
+	 *
 	 * @return port definition data of OpenMAX IL
 	 */
 	virtual const OMX_PARAM_PORTDEFINITIONTYPE *get_definition() const;
@@ -536,6 +577,126 @@ public:
 	virtual OMX_BOOL get_tunneled_supplier() const;
 	virtual void set_tunneled_supplier(OMX_BOOL v);
 
+	/**
+	 * トンネル接続先のポートを取得します。
+	 *
+	 * トンネル接続先が同じプロセスで動作する
+	 * OpenMAX MF のコンポーネントの場合のみ取得できます。
+	 *
+	 * @return トンネル接続先のポート、
+	 * 接続先が OpenMAX MF のコンポーネントでなければ nullptr
+	 */
+	virtual port *get_tunneled_peer() const;
+
+	/**
+	 * トンネル接続先のポートを設定します。
+	 *
+	 * @param v トンネル接続先のポート、解除する場合は nullptr
+	 */
+	virtual void set_tunneled_peer(port *v);
+
+	/**
+	 * トンネル接続先のポートへ、
+	 * バッファ返却スレッドを経由せず直接バッファを渡すかどうかを取得します。
+	 *
+	 * @return 直接渡すならば OMX_TRUE、そうでなければ OMX_FALSE
+	 */
+	virtual OMX_BOOL get_tunneled_direct() const;
+
+	/**
+	 * トンネル接続先のポートへ、
+	 * バッファ返却スレッドを経由せず直接バッファを渡すかどうかを設定します。
+	 *
+	 * @param v 直接渡すならば OMX_TRUE、そうでなければ OMX_FALSE
+	 */
+	virtual void set_tunneled_direct(OMX_BOOL v);
+
+	/**
+	 * 使用後のバッファをまとめて返却するかどうかを取得します。
+	 *
+	 * @return まとめて返却するならば OMX_TRUE、そうでなければ OMX_FALSE
+	 */
+	virtual OMX_BOOL get_batch_done() const;
+
+	/**
+	 * 使用後のバッファをまとめて返却するかどうかを設定します。
+	 *
+	 * まとめて返却する場合、EmptyBufferDone, FillBufferDone の代わりに
+	 * set_batch_done_func() で設定したコールバックを呼び出します。
+	 *
+	 * @param v まとめて返却するならば OMX_TRUE、そうでなければ OMX_FALSE
+	 */
+	virtual void set_batch_done(OMX_BOOL v);
+
+	/**
+	 * 一度のコールバックで返却するバッファの最大数を取得します。
+	 *
+	 * @return バッファの最大数
+	 */
+	virtual OMX_U32 get_batch_done_max() const;
+
+	/**
+	 * 一度のコールバックで返却するバッファの最大数を設定します。
+	 *
+	 * @param v バッファの最大数
+	 */
+	virtual void set_batch_done_max(OMX_U32 v);
+
+	/**
+	 * 後続のバッファを待つ最大の時間を取得します。
+	 *
+	 * @return 待つ時間（マイクロ秒）
+	 */
+	virtual OMX_U32 get_batch_done_delay() const;
+
+	/**
+	 * 後続のバッファを待つ最大の時間を設定します。
+	 *
+	 * @param v 待つ時間（マイクロ秒）、0 ならば待たない
+	 */
+	virtual void set_batch_done_delay(OMX_U32 v);
+
+	/**
+	 * まとめて返却する際に呼び出すコールバックを取得します。
+	 *
+	 * @return コールバック関数
+	 */
+	virtual OMX_MF_BUFFERSDONE_FUNC get_batch_done_func() const;
+
+	/**
+	 * まとめて返却する際に呼び出すコールバックを設定します。
+	 *
+	 * @param v コールバック関数
+	 */
+	virtual void set_batch_done_func(OMX_MF_BUFFERSDONE_FUNC v);
+
+	/**
+	 * バッファの遅延とスループットの統計を取得します。
+	 *
+	 * conf の nPortIndex 以外のメンバを設定します。
+	 *
+	 * @param conf 統計を格納する構造体
+	 */
+	virtual void get_latency(OMX_MF_CONFIG_PORTLATENCYTYPE *conf) const;
+
+	/**
+	 * バッファの遅延とスループットの統計を消去します。
+	 */
+	virtual void reset_latency();
+
+	/**
+	 * ポートを生成直後の設定に戻します。
+	 *
+	 * definition data を def に戻し、
+	 * トンネル接続とまとめて返却する設定を解除し、
+	 * 遅延とスループットの統計を消去します。
+	 * バッファが 1つも割り当てられていないときのみ戻せます。
+	 *
+	 * @param def 戻す definition data
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE reset(const OMX_PARAM_PORTDEFINITIONTYPE& def);
+
 	/**
 	 * ポートがサポートするデータ形式を追加します。
 	 *
@@ -761,6 +922,17 @@ public:
 	 */
 	virtual OMX_ERRORTYPE unplug_client_request();
 
+	/**
+	 * IL クライアントからポートへのバッファ処理要求を
+	 * 禁止しているかどうかを取得します。
+	 *
+	 * フラッシュ中のポートは、ポートのシャットダウンフラグを立てずに
+	 * バッファ処理要求だけを禁止するため、そちらも調べます。
+	 *
+	 * @return 禁止していれば true、していなければ false
+	 */
+	virtual bool is_plugged_client_request() const;
+
 	/**
 	 * コンポーネントからポートへのバッファ処理要求を禁止します。
 	 *
@@ -793,12 +965,47 @@ public:
 	 */
 	virtual OMX_ERRORTYPE return_buffers_force();
 
+	/**
+	 * コンポーネントがまだ取り出していないバッファを全て返却します。
+	 *
+	 * empty_buffer または fill_buffer によって渡され、
+	 * pop_buffer で取り出される前のバッファだけを返却します。
+	 * コンポーネントが取り出したバッファには触れないため、
+	 * コンポーネントの動作中に呼び出すことができます。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE return_queued_buffers();
+
 	/**
 	 * 全てのバッファを EmptyBufferDone あるいは FillBufferDone にて、
 	 * 返却するまで待ちます。
 	 */
 	virtual void wait_buffer_returned() const;
 
+	/**
+	 * 送出したが、まだ返却していない OpenMAX バッファの数を取得します。
+	 *
+	 * @return 返却していないバッファの数
+	 */
+	virtual uint64_t get_unreturned_buffer_count() const;
+
+	/**
+	 * 全てのバッファが返却されたときに、
+	 * ポートを保持するコンポーネントへの通知を要求します。
+	 *
+	 * 複数のポートをまとめて待つ場合に使います。
+	 * 通知は component::notify_port_buffer_returned() にて行われます。
+	 * 不要になったら remove_returned_waiter() を呼び出してください。
+	 */
+	virtual void add_returned_waiter() const;
+
+	/**
+	 * 全てのバッファが返却されたときの、
+	 * コンポーネントへの通知の要求を取り消します。
+	 */
+	virtual void remove_returned_waiter() const;
+
 	/**
 	 * 指定されたコンポーネントのポートと、トンネル接続します。
 	 *
@@ -931,6 +1138,21 @@ public:
 	 */
 	virtual bool find_buffer(const port_buffer *pb) const;
 
+	/**
+	 * バッファに割り当てた番号（スロット）を取得します。
+	 *
+	 * 番号はバッファの登録時に割り当て、
+	 * バッファヘッダが指すポートバッファに保持しているため、
+	 * バッファ登録リストを検索しません。
+	 *
+	 * トンネル接続のサプライヤ側は pAppPrivate、
+	 * それ以外は pPlatformPrivate がこのポートのポートバッファを指します。
+	 *
+	 * @param bufhead OpenMAX バッファヘッダ
+	 * @return スロット番号、このポートに登録されていなければ -1
+	 */
+	virtual OMX_S32 get_buffer_slot(const OMX_BUFFERHEADERTYPE *bufhead) const;
+
 	/**
 	 * クライアントから受け取ったが、
 	 * クライアントに返していないバッファをリストに追加します。
@@ -949,6 +1171,27 @@ public:
 	 */
 	OMX_ERRORTYPE remove_held_buffer(const port_buffer *pb);
 
+	/**
+	 * 受け付けられなかったバッファを、リストと送出数から取り消します。
+	 *
+	 * 既にフラッシュが返却したバッファは取り消さず、受け付けたものとします。
+	 *
+	 * @param pb ポートバッファ
+	 * @return 取り消した場合は OMX_ErrorInsufficientResources、
+	 * 受け付けたものとした場合は OMX_ErrorNone
+	 */
+	OMX_ERRORTYPE cancel_held_buffer(const port_buffer *pb);
+
+	/**
+	 * クライアントから受け取ったが、
+	 * クライアントに返していないバッファをまとめてリストに追加します。
+	 *
+	 * @param pbs ポートバッファの配列
+	 * @param n   ポートバッファの数
+	 * @return OpenMAX エラー値
+	 */
+	OMX_ERRORTYPE add_held_buffers(const port_buffer *pbs, size_t n);
+
 	//----------------------------------------
 	// コンポーネント利用者 → コンポーネントへのバッファ送付
 	//----------------------------------------
@@ -979,17 +1222,70 @@ public:
 	 */
 	virtual OMX_ERRORTYPE push_buffer(OMX_BUFFERHEADERTYPE *bufhead);
 
+	/**
+	 * ポートとポートが所属しているコンポーネントに対し、
+	 * 指定した複数の OpenMAX バッファからデータを読み出すことを要求します。
+	 *
+	 * @param bufheads OpenMAX バッファヘッダの配列
+	 * @param n        OpenMAX バッファヘッダの数
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE empty_buffers(OMX_BUFFERHEADERTYPE **bufheads, OMX_U32 n);
+
+	/**
+	 * ポートとポートが所属しているコンポーネントに対し、
+	 * 指定した複数の OpenMAX バッファにデータを書き込むことを要求します。
+	 *
+	 * @param bufheads OpenMAX バッファヘッダの配列
+	 * @param n        OpenMAX バッファヘッダの数
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE fill_buffers(OMX_BUFFERHEADERTYPE **bufheads, OMX_U32 n);
+
+	/**
+	 * 複数の OpenMAX バッファをまとめて受け付け、
+	 * バッファ処理スレッドに送出します。
+	 *
+	 * 全てのバッファを検査してから受け付けます。
+	 * 一つでも不正なバッファがあれば、何も受け付けずにエラーを返します。
+	 *
+	 * 全てのバッファが入る空きを待ってから一度に送出するため、
+	 * 途中で中断されても一部だけを受け付けることはありません。
+	 *
+	 * @param bufheads OpenMAX バッファヘッダの配列
+	 * @param n        OpenMAX バッファヘッダの数
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE push_buffers(OMX_BUFFERHEADERTYPE **bufheads, OMX_U32 n);
+
 
 	/**
 	 * 受け付けた OpenMAX バッファを持つポートバッファを引き出します。
 	 *
 	 * バッファ処理スレッドにて使用します。
 	 *
+	 * 軽量フラッシュに対応していないワーカースレッドから呼び出した場合、
+	 * 一時停止の間は待機し、再開されたらバッファを引き出します。
+	 *
 	 * @param pb ポートバッファ
 	 * @return OpenMAX エラー値
 	 */
 	virtual OMX_ERRORTYPE pop_buffer(port_buffer *pb);
 
+	/**
+	 * 受け付けた OpenMAX バッファを持つポートバッファを、
+	 * 待たずに引き出します。
+	 *
+	 * ワーカープールで実行するワーカーの単位処理にて使用します。
+	 *
+	 * @param pb ポートバッファ
+	 * @return バッファを引き出せたら OMX_ErrorNone、
+	 * バッファがなければ OMX_ErrorNotReady、
+	 * コンポーネントからの要求が禁止されていれば
+	 * OMX_ErrorIncorrectStateOperation
+	 */
+	virtual OMX_ERRORTYPE try_pop_buffer(port_buffer *pb);
+
 
 	//----------------------------------------
 	// コンポーネント → コンポーネント利用者へのバッファ返却
@@ -1034,6 +1330,9 @@ public:
 	/**
 	 * 使用後の OpenMAX バッファを、バッファ返却スレッドに送出します。
 	 *
+	 * フラッシュの期限切れにより強制的に返却済みのバッファは送出せず、
+	 * エラーを返します。
+	 *
 	 * @param bufhead OpenMAX バッファヘッダ
 	 * @return OpenMAX エラー値
 	 */
@@ -1048,6 +1347,68 @@ public:
 
 
 protected:
+	/**
+	 * definition data の更新区間を表すクラスです。
+	 *
+	 * 入れ子にすることができ、一番外側の区間が終わったときに
+	 * 更新が完了したとみなされ、
+	 * fill_definition() で作った definition data の写しを公開します。
+	 * get_definition() は公開された写しだけを読みます。
+	 *
+	 * 構築後に definition data を変更するメンバ関数は、
+	 * 変更の間このクラスのオブジェクトを保持してください。
+	 *
+	 * NOTE:
+	 * 写しはワード単位のアトミック変数に置き、
+	 * 書き込み側も読み出し側も relaxed でアクセスします。
+	 * 読み出し側は読んだ後に更新回数が変わっていれば読み直すため、
+	 * 途中の値が呼び出し元に返ることはありません（seqlock）。
+	 * 各メンバそのものは更新同士を排他するロックの下でのみ読み書きされ、
+	 * データ競合にはなりません。
+	 */
+	class definition_writer {
+	public:
+		explicit definition_writer(port *p) : pt(p) {
+			pt->begin_write_definition();
+		}
+
+		~definition_writer() {
+			pt->end_write_definition();
+		}
+
+		definition_writer(const definition_writer& obj) = delete;
+		definition_writer& operator=(const definition_writer& obj) = delete;
+
+	private:
+		port *pt;
+	};
+
+	/**
+	 * definition data の更新を開始します。
+	 *
+	 * 通常は definition_writer を用いてください。
+	 */
+	virtual void begin_write_definition();
+
+	/**
+	 * definition data の更新を終了します。
+	 *
+	 * 通常は definition_writer を用いてください。
+	 */
+	virtual void end_write_definition();
+
+	/**
+	 * OMX_PARAM_PORTDEFINITIONTYPE の各メンバに、
+	 * このポートの設定値を書き込みます。
+	 *
+	 * definition data の更新区間の終わりに、
+	 * 更新同士を排他するロックを確保した状態で呼び出されます。
+	 * 継承先のクラスでは format メンバを設定してください。
+	 *
+	 * @param def port definition data を受け取るポインタ
+	 */
+	virtual void fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const;
+
 	/**
 	 * ポートが対応しているフォーマットのリストを取得します。
 	 *
@@ -1077,10 +1438,57 @@ protected:
 	virtual bool is_broken() const;
 
 	/**
-	 * 送出、返却した OpenMAX バッファ数を更新し、通知します。
+	 * 送出した OpenMAX バッファが全て返却されたかどうかを取得します。
+	 *
+	 * @return 全て返却されていれば true、そうでなければ false
+	 */
+	virtual bool is_buffer_returned() const;
+
+	/**
+	 * 送出、返却した OpenMAX バッファ数の変化を通知します。
+	 *
+	 * 全てのバッファが返却された時点で wait_buffer_returned の
+	 * 待機中のスレッドがいる場合のみ、ポートのロックを取って起こします。
+	 * add_returned_waiter による要求があれば、コンポーネントにも通知します。
+	 * それ以外の場合はロックを取らずに戻ります。
 	 */
 	virtual void notify_buffer_count();
 
+	/**
+	 * OpenMAX バッファの送出用、返却用のリングバッファの深さを変更します。
+	 *
+	 * クライアントが全てのバッファを一度に送出しても
+	 * ブロックしないよう、ポートのバッファ数に合わせて呼び出します。
+	 *
+	 * リングバッファが空でない場合は何もせずにエラーを返します。
+	 *
+	 * @param depth リングバッファの深さ
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE resize_buffer_rings(size_t depth);
+
+	/**
+	 * 登録するバッファに、空いている番号（スロット）を割り当てます。
+	 *
+	 * バッファ登録リストのロックを確保してから呼び出します。
+	 *
+	 * @return スロット番号
+	 */
+	virtual OMX_S32 assign_buffer_slot();
+
+	/**
+	 * 使用後の OpenMAX バッファを、
+	 * トンネル接続先のポートに直接送出します。
+	 *
+	 * 接続先のポートが受け付けられない状態の場合は、
+	 * 何もせずにエラーを返します。
+	 * その場合、呼び出し元はバッファ返却スレッドに送出してください。
+	 *
+	 * @param bufhead OpenMAX バッファヘッダ
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE push_buffer_tunneled_peer(OMX_BUFFERHEADERTYPE *bufhead);
+
 	/**
 	 * 指定されたコンポーネントのポートと、トンネル接続します。
 	 * （入力ポート用）
@@ -1125,6 +1533,20 @@ protected:
 	 */
 	virtual void *buffer_done();
 
+	/**
+	 * 使用後の OpenMAX バッファをまとめて返却します。
+	 *
+	 * 返却用のリングバッファに溜まっているバッファを最大
+	 * get_batch_done_max() 個まで取り出し、
+	 * get_batch_done_func() のコールバックにて一度に返却します。
+	 *
+	 * バッファが足りなければ、最大
+	 * get_batch_done_delay() マイクロ秒まで後続のバッファを待ちます。
+	 *
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE buffer_done_batch();
+
 	/**
 	 * 使用後の OpenMAX バッファを返却するスレッドの main 関数です。
 	 *
@@ -1134,17 +1556,33 @@ protected:
 	static void *buffer_done_thread_main(port *p);
 
 
-protected:
-	//temporary buffer for get_definition() member function.
-	mutable OMX_PARAM_PORTDEFINITIONTYPE definition;
-
-
 private:
 	//ポートのロック
 	mutable std::recursive_mutex mut;
 	//ポートの状態変数
 	mutable std::condition_variable_any cond;
 
+	/**
+	 * definition data の写しを作り、読み出し側に公開します。
+	 *
+	 * 更新同士を排他するロックを確保してから呼び出します。
+	 */
+	void publish_definition() const;
+
+	//definition data の写しのワード数
+	static const size_t N_DEF_WORDS =
+		(sizeof(OMX_PARAM_PORTDEFINITIONTYPE) + sizeof(uint32_t) - 1) /
+		sizeof(uint32_t);
+
+	//definition data の写しの公開回数（奇数なら公開中、0 なら未公開）
+	mutable std::atomic<uint32_t> seq_def;
+	//definition data の写し
+	mutable std::atomic<uint32_t> snap_def[N_DEF_WORDS];
+	//definition data の更新同士を排他するロック
+	mutable std::recursive_mutex mut_def;
+	//definition data の更新区間の深さ
+	int depth_def;
+
 	//以下 OMX_PARAM_PORTDEFINITIONTYPE に基づくメンバ
 
 	OMX_U32 port_index;
@@ -1165,7 +1603,7 @@ private:
 	component *comp;
 
 	//待機の強制解除フラグ
-	bool shutting_read, shutting_write;
+	std::atomic<bool> shutting_read, shutting_write;
 
 	//ポートに使用可能なバッファが一つもないことを示すフラグ
 	OMX_BOOL f_no_buffer;
@@ -1178,6 +1616,19 @@ private:
 	OMX_U32 tunneled_port;
 	//バッファ供給側（Supplier）か、使用側（User）か
 	OMX_BOOL f_tunneled_supplier;
+	//トンネル接続先のポート（OpenMAX MF のコンポーネントの場合のみ）
+	port *tunneled_peer;
+	//トンネル接続先のポートに直接バッファを渡すかどうか
+	OMX_BOOL f_tunneled_direct;
+
+	//使用後のバッファをまとめて返却するかどうか
+	OMX_BOOL f_batch_done;
+	//一度に返却するバッファの最大数
+	OMX_U32 batch_done_max;
+	//後続のバッファを待つ最大の時間（マイクロ秒）
+	OMX_U32 batch_done_delay;
+	//まとめて返却する際のコールバック
+	OMX_MF_BUFFERSDONE_FUNC batch_done_func;
 
 	//ポートがサポートするフォーマットのリスト
 	//OMX_GetParameter(OMX_IndexParamXxxxxPortFormat) にて使用します。
@@ -1204,8 +1655,18 @@ private:
 	//使用後のバッファ返却スレッド
 	std::thread *th_ret;
 
-	//バッファ送出数、返却数のメモ
-	uint64_t cnt_send_wr, cnt_recv_rd;
+	//バッファ送出数、返却数
+	//バッファの受け渡しごとに更新するため、ポートのロックは取らずに
+	//アトミック変数で数えます。
+	std::atomic<uint64_t> cnt_send_wr, cnt_recv_rd;
+	//トンネル接続先のポートに直接渡したバッファ数
+	std::atomic<uint64_t> cnt_direct;
+	//wait_buffer_returned にて待機しているスレッド数
+	mutable std::atomic<int> cnt_wait_returned;
+	//コンポーネントへの返却通知を要求している数
+	mutable std::atomic<int> cnt_wait_returned_comp;
+	//バッファごとの遅延とスループットの統計
+	port_latency *latency;
 };
 
 } //namespace mf
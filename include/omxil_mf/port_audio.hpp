@@ -41,25 +41,6 @@ public:
 
 	virtual OMX_AUDIO_CODINGTYPE get_encoding() const;
 
-	/**
-	 * Get OpenMAX IL definition data of this port.
-	 *
-	 * OMX_PARAM_PORTDEFINITIONTYPE の各メンバに加え、
-	 * format.audio メンバにも設定値がセットされます。
-	 *
-	 * <pre>
-	 * struct OMX_AUDIO_PORTDEFINITIONTYPE {
-	 *     OMX_STRING cMIMEType;
-	 *     OMX_NATIVE_DEVICETYPE pNativeRender;
-	 *     OMX_BOOL bFlagErrorConcealment;
-	 *     OMX_AUDIO_CODINGTYPE eEncoding;
-	 * }
-	 * </pre>
-	 *
-	 * @return Port definition data
-	 */
-	virtual const OMX_PARAM_PORTDEFINITIONTYPE *get_definition() const override;
-
 	/**
 	 * Set OpenMAX IL definition data of this port.
 	 *
@@ -127,6 +108,27 @@ public:
 	 */
 	virtual const OMX_AUDIO_PARAM_PORTFORMATTYPE *get_default_format_audio() const;
 
+protected:
+	/**
+	 * Fill OpenMAX IL definition data of this port.
+	 *
+	 * OMX_PARAM_PORTDEFINITIONTYPE の各メンバに加え、
+	 * format.audio メンバにも設定値がセットされます。
+	 *
+	 * <pre>
+	 * struct OMX_AUDIO_PORTDEFINITIONTYPE {
+	 *     OMX_STRING cMIMEType;
+	 *     OMX_NATIVE_DEVICETYPE pNativeRender;
+	 *     OMX_BOOL bFlagErrorConcealment;
+	 *     OMX_AUDIO_CODINGTYPE eEncoding;
+	 * }
+	 * </pre>
+	 *
+	 * @param def Port definition data を受け取るポインタ
+	 */
+	virtual void fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const override;
+
+
 private:
 	OMX_STRING mime_type;
 	OMX_NATIVE_DEVICETYPE native_render;
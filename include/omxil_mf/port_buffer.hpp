@@ -59,6 +59,9 @@ struct OMX_MF_API_CLASS port_buffer {
 	//nOffset と nFilledLen を更新して返す、とあるが、
 	//gst-omx など実際に変更して返すと変な動作をする奴らが多い？
 	OMX_U32 index;
+	//ポートがバッファに割り当てた番号、未登録のバッファは -1
+	//バッファごとの遅延の記録に使います。
+	OMX_S32 slot;
 
 public:
 	/**
@@ -32,22 +32,6 @@ public:
 
 	virtual OMX_OTHER_FORMATTYPE get_format() const;
 
-	/**
-	 * Get OpenMAX IL definition data of this port.
-	 *
-	 * OMX_PARAM_PORTDEFINITIONTYPE の各メンバに加え、
-	 * format.other メンバにも設定値がセットされます。
-	 *
-	 * <pre>
-	 * struct OMX_OTHER_PORTDEFINITIONTYPE {
-	 *     OMX_OTHER_FORMATTYPE eFormat;
-	 * }
-	 * </pre>
-	 *
-	 * @return Port definition data
-	 */
-	virtual const OMX_PARAM_PORTDEFINITIONTYPE *get_definition() const override;
-
 	/**
 	 * Set OpenMAX IL definition data of this port.
 	 *
@@ -109,6 +93,24 @@ public:
 	 */
 	virtual const OMX_OTHER_PARAM_PORTFORMATTYPE *get_default_format_other() const;
 
+protected:
+	/**
+	 * Fill OpenMAX IL definition data of this port.
+	 *
+	 * OMX_PARAM_PORTDEFINITIONTYPE の各メンバに加え、
+	 * format.other メンバにも設定値がセットされます。
+	 *
+	 * <pre>
+	 * struct OMX_OTHER_PORTDEFINITIONTYPE {
+	 *     OMX_OTHER_FORMATTYPE eFormat;
+	 * }
+	 * </pre>
+	 *
+	 * @param def Port definition data を受け取るポインタ
+	 */
+	virtual void fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const override;
+
+
 private:
 	//下記メンバについては、直接設定できません
 	//OMX_XXXXX_PARAM_PORTFORMATTYPE のリスト
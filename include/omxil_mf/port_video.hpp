@@ -63,33 +63,6 @@ public:
 	virtual OMX_NATIVE_WINDOWTYPE get_native_window() const;
 	virtual void set_native_window(OMX_NATIVE_WINDOWTYPE v);
 
-	/**
-	 * Get OpenMAX IL definition data of this port.
-	 *
-	 * OMX_PARAM_PORTDEFINITIONTYPE の各メンバに加え、
-	 * format.video メンバにも設定値がセットされます。
-	 *
-	 * <pre>
-	 * struct OMX_VIDEO_PORTDEFINITIONTYPE {
-	 *     OMX_STRING cMIMEType;
-	 *     OMX_NATIVE_DEVICETYPE pNativeRender;
-	 *     OMX_U32 nFrameWidth;
-	 *     OMX_U32 nFrameHeight;
-	 *     OMX_S32 nStride;
-	 *     OMX_U32 nSliceHeight;
-	 *     OMX_U32 nBitrate;
-	 *     OMX_U32 xFramerate;
-	 *     OMX_BOOL bFlagErrorConcealment;
-	 *     OMX_VIDEO_CODINGTYPE eCompressionFormat;
-	 *     OMX_COLOR_FORMATTYPE eColorFormat;
-	 *     OMX_NATIVE_WINDOWTYPE pNativeWindow;
-	 * }
-	 * </pre>
-	 *
-	 * @return Port definition data
-	 */
-	virtual const OMX_PARAM_PORTDEFINITIONTYPE *get_definition() const override;
-
 	/**
 	 * Set OpenMAX IL definition data of this port.
 	 *
@@ -173,6 +146,35 @@ public:
 	 */
 	virtual const OMX_VIDEO_PARAM_PORTFORMATTYPE *get_default_format_video() const;
 
+protected:
+	/**
+	 * Fill OpenMAX IL definition data of this port.
+	 *
+	 * OMX_PARAM_PORTDEFINITIONTYPE の各メンバに加え、
+	 * format.video メンバにも設定値がセットされます。
+	 *
+	 * <pre>
+	 * struct OMX_VIDEO_PORTDEFINITIONTYPE {
+	 *     OMX_STRING cMIMEType;
+	 *     OMX_NATIVE_DEVICETYPE pNativeRender;
+	 *     OMX_U32 nFrameWidth;
+	 *     OMX_U32 nFrameHeight;
+	 *     OMX_S32 nStride;
+	 *     OMX_U32 nSliceHeight;
+	 *     OMX_U32 nBitrate;
+	 *     OMX_U32 xFramerate;
+	 *     OMX_BOOL bFlagErrorConcealment;
+	 *     OMX_VIDEO_CODINGTYPE eCompressionFormat;
+	 *     OMX_COLOR_FORMATTYPE eColorFormat;
+	 *     OMX_NATIVE_WINDOWTYPE pNativeWindow;
+	 * }
+	 * </pre>
+	 *
+	 * @param def Port definition data を受け取るポインタ
+	 */
+	virtual void fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const override;
+
+
 private:
 	OMX_STRING mime_type;
 	OMX_NATIVE_DEVICETYPE native_render;
@@ -6,6 +6,7 @@
 #include <string>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 #include <cstdio>
 //#include <cstdint>
 #include <cstddef>
@@ -578,6 +579,33 @@ public:
 		}
 	}
 
+	/**
+	 * リングバッファに指定された要素数が書き込まれるか、
+	 * 指定された時間が経過するまでブロックします。
+	 * リングバッファに要素が既に存在していればすぐに返ります。
+	 *
+	 * シャットダウンされた場合は interrupted_error をスローします。
+	 *
+	 * @param n        要素数
+	 * @param rel_time 待機する最大の時間
+	 * @return 指定された要素数が存在すれば true、
+	 * 時間が経過しても要素数が足りなければ false
+	 */
+	template <class Rep, class Period>
+	bool wait_element_for(size_type n, const std::chrono::duration<Rep, Period>& rel_time) {
+		std::unique_lock<std::recursive_mutex> lock(mut);
+		bool result;
+
+		result = cond_not_empty.wait_for(lock, rel_time, [&] { return shutting_read || bound.size() >= n; });
+		if (shutting_read) {
+			std::string msg(__func__);
+			msg += ": interrupted.";
+			throw mf::interrupted_error(msg);
+		}
+
+		return result;
+	}
+
 	/**
 	 * リングバッファに指定された要素数の空きができるまでブロックします。
 	 * リングバッファに空きが既に存在していればすぐに返ります。
@@ -636,6 +664,28 @@ public:
 		notify_with_lock();
 	}
 
+	/**
+	 * 読み出しを禁止（シャットダウン）しているかどうかを取得します。
+	 *
+	 * ロックを確保してから呼び出します。
+	 *
+	 * @return 禁止していれば true、していなければ false
+	 */
+	bool is_shutting_read_with_lock() const {
+		return shutting_read;
+	}
+
+	/**
+	 * 書き込みを禁止（シャットダウン）しているかどうかを取得します。
+	 *
+	 * ロックを確保してから呼び出します。
+	 *
+	 * @return 禁止していれば true、していなければ false
+	 */
+	bool is_shutting_write_with_lock() const {
+		return shutting_write;
+	}
+
 	/**
 	 * シャットダウン処理を中止し、
 	 * ポートからの読み出し、または書き込みを許可します。
@@ -794,6 +844,26 @@ public:
 		}
 	}
 
+	/**
+	 * リングバッファに指定された要素数の空きができるまでブロックします。
+	 *
+	 * ロックを確保してから呼び出します。
+	 *
+	 * 書き込み側をシャットダウンされた場合は、
+	 * interrupted_error をスローします。
+	 *
+	 * @param lock リングバッファのロックへの参照
+	 * @param n    要素数
+	 */
+	void wait_space_with_lock(std::unique_lock<std::recursive_mutex>& lock, size_type n) {
+		cond_not_full.wait(lock, [&] { return shutting_write || bound.reserve() >= n; });
+		if (shutting_write) {
+			std::string msg(__func__);
+			msg += ": interrupted.";
+			throw mf::interrupted_error(msg);
+		}
+	}
+
 	/**
 	 * バッファに変更を加えたことを他のスレッドに通知します。
 	 *
@@ -45,6 +45,19 @@ protected:
 		return nelements;
 	}
 
+	/**
+	 * バッファのベースとなる配列を変更します。
+	 *
+	 * 以前の配列に格納されていた要素は引き継ぎません。
+	 *
+	 * @param buf 新たなベース配列の先頭
+	 * @param l   新たなベース配列の要素数
+	 */
+	void set_base(RandomIterator buf, size_type l) {
+		start = buf;
+		nelements = l;
+	}
+
 	/**
 	 * リングバッファの範囲内に丸めたインデックスを取得する。
 	 *
@@ -25,6 +25,7 @@ public:
 	typedef typename buffer_base<RandomIterator, T>::size_type size_type;
 
 	using buffer_base<RandomIterator, T>::elems;
+	using buffer_base<RandomIterator, T>::set_base;
 	using buffer_base<RandomIterator, T>::get_elem;
 	using buffer_base<RandomIterator, T>::read_array;
 	using buffer_base<RandomIterator, T>::write_array;
@@ -512,6 +513,19 @@ public:
 	// vendor specific
 	//----------------------------------------
 
+	/**
+	 * Change the base array of this buffer.
+	 *
+	 * All elements in this buffer are removed.
+	 *
+	 * @param buf The first element of new base array
+	 * @param l   The number of elements of new base array
+	 */
+	void assign(RandomIterator buf, size_type l) {
+		set_base(buf, l);
+		rd = wr = 0;
+	}
+
 	size_type get_read_position() const {
 		return rd;
 	}
@@ -4,7 +4,11 @@
 #include <omxil_mf/base.h>
 #include <omxil_mf/dprint.h>
 
+#if OMX_MF_LOG_MAX_LEVEL >= DPRINT_LEVEL_TRACE
 #define scoped_log_begin    mf::scoped_log __tmp_scoped_log__(DPRINT_FUNC, __LINE__)
+#else
+#define scoped_log_begin    do { } while (0)
+#endif
 
 namespace mf {
 
@@ -13,17 +17,24 @@ namespace mf {
  */
 class OMX_MF_API_CLASS scoped_log {
 public:
-	scoped_log(const char *f, int n) : func(f), num(n) {
-		traceprint_cont("[% 5d] %-5s: %s:%d\n", (int)thread_id(), "in", func, num);
+	scoped_log(const char *f, int n) : func(f), num(n),
+		f_enabled(OMX_MF_debug_level_enabled(DPRINT_LEVEL_TRACE)) {
+		if (f_enabled) {
+			OMX_MF_print_cont(DPRINT_LEVEL_TRACE, "[% 5d] %-5s: %s:%d\n", (int)thread_id(), "in", func, num);
+		}
 	}
 
 	~scoped_log() {
-		traceprint_cont("[% 5d] %-5s: %s\n", (int)thread_id(), "out", func);
+		if (f_enabled) {
+			OMX_MF_print_cont(DPRINT_LEVEL_TRACE, "[% 5d] %-5s: %s\n", (int)thread_id(), "out", func);
+		}
 	}
 
 private:
 	const char *func;
 	int num;
+	//入口でレベルを調べた結果、出口でも同じ結果を使う
+	bool f_enabled;
 };
 
 } //namespace mf
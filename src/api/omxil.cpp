@@ -2,6 +2,7 @@
 #define __OMX_EXPORTS
 #define __OMX_MF_EXPORTS
 
+#include <cstdlib>
 #include <fstream>
 
 #include <OMX_Core.h>
@@ -10,6 +11,8 @@
 #include <omxil_mf/component.hpp>
 #include <omxil_mf/scoped_log.hpp>
 
+#include "debug/trace.hpp"
+#include "regist/component_pool.hpp"
 #include "regist/register_component.hpp"
 #include "util/omx_enum_name.hpp"
 
@@ -29,6 +32,11 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Init(void)
 	}
 	rc->init();
 
+	//OMX_Deinit までトレースを記録する
+	if (getenv("OMX_MF_TRACE") != nullptr) {
+		mf::trace::get_instance()->start();
+	}
+
 	return OMX_ErrorNone;
 }
 
@@ -36,13 +44,26 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Deinit(void)
 {
 	scoped_log_begin;
 	mf::register_component *rc = mf::register_component::get_instance();
+	const char *trace_path;
 
 	if (!rc->is_init()) {
 		errprint("Already deinited.\n");
 		return OMX_ErrorNone;
 	}
+	//Pooled instances need destructors in the libraries
+	mf::component_pool::get_instance()->clear();
 	rc->deinit();
 
+	trace_path = getenv("OMX_MF_TRACE");
+	if (trace_path != nullptr && mf::trace::is_enabled()) {
+		mf::trace *tr = mf::trace::get_instance();
+
+		tr->stop();
+		if (!tr->write_json(trace_path)) {
+			errprint("Failed to write trace '%s'.\n", trace_path);
+		}
+	}
+
 	return OMX_ErrorNone;
 }
 
@@ -50,7 +71,7 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_ComponentNameEnum(OMX_OUT OMX_STRING cCom
 {
 	scoped_log_begin;
 	mf::register_component *rc = mf::register_component::get_instance();
-	mf::register_info *rinfo = nullptr;
+	const mf::register_info *rinfo = nullptr;
 
 	if (nIndex >= rc->size()) {
 		return OMX_ErrorNoMore;
@@ -71,38 +92,24 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_ComponentNameEnum(OMX_OUT OMX_STRING cCom
 OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_GetHandle(OMX_OUT OMX_HANDLETYPE* pHandle, OMX_IN OMX_STRING cComponentName, OMX_IN OMX_PTR pAppData, OMX_IN OMX_CALLBACKTYPE* pCallBacks)
 {
 	scoped_log_begin;
-	mf::register_component *rc = mf::register_component::get_instance();
-	mf::register_info *rinfo = nullptr;
-	void *ptr = nullptr;
+	mf::component_pool *pool = mf::component_pool::get_instance();
 	OMX_COMPONENTTYPE *omx_comp = nullptr;
 	OMX_ERRORTYPE result = OMX_ErrorUndefined;
 
 	if (pHandle == nullptr) {
 		errprint("Invalid handle %p.\n", pHandle);
-		result = OMX_ErrorBadParameter;
-		goto err_out;
-	}
-
-	rinfo = rc->find(cComponentName);
-	if (rinfo == nullptr) {
-		errprint("Not found component '%s'.\n", cComponentName);
-		result = OMX_ErrorInvalidComponentName;
-		goto err_out;
+		return OMX_ErrorBadParameter;
 	}
 
-	//Create base component
-	omx_comp = new OMX_COMPONENTTYPE;
-
-	//Create derived component.
-	//Call original constructor of extend libraries
-	//instead of 'new comp'.
-	//It is because we need not know the class type of
-	//derived component.
-	ptr = rinfo->comp_info->constructor(omx_comp, cComponentName);
-	if (ptr == nullptr) {
-		errprint("Failed to create component '%s'.\n", cComponentName);
-		result = OMX_ErrorInsufficientResources;
-		goto err_out;
+	//Reuse the instance reset to defaults if the pool has,
+	//otherwise create new one
+	omx_comp = pool->acquire(cComponentName);
+	if (omx_comp == nullptr) {
+		result = mf::component_pool::create_component(cComponentName, &omx_comp, false);
+		if (result != OMX_ErrorNone) {
+			*pHandle = nullptr;
+			return result;
+		}
 	}
 
 	//Set callbacks.
@@ -112,19 +119,12 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_GetHandle(OMX_OUT OMX_HANDLETYPE* pHandle
 	*pHandle = omx_comp;
 
 	return OMX_ErrorNone;
-
-err_out:
-	*pHandle = nullptr;
-	delete omx_comp;
-
-	return result;
 }
 
 OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_FreeHandle(OMX_IN OMX_HANDLETYPE hComponent)
 {
 	scoped_log_begin;
-	mf::register_component *rc = mf::register_component::get_instance();
-	mf::register_info *rinfo = nullptr;
+	mf::component_pool *pool = mf::component_pool::get_instance();
 	OMX_COMPONENTTYPE *omx_comp = nullptr;
 	OMX_STATETYPE st;
 	OMX_ERRORTYPE err;
@@ -153,26 +153,12 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_FreeHandle(OMX_IN OMX_HANDLETYPE hCompone
 		return OMX_ErrorInvalidState;
 	}
 
-	omx_comp->ComponentDeInit(hComponent);
-
-	//Delete derived component
-	if (omx_comp->pComponentPrivate != nullptr) {
-		mf::component *comp = mf::component::get_instance(hComponent);
-
-		//Call original destructor of extend libraries
-		//instead of 'delete comp'.
-		rinfo = rc->find(comp->get_component_name().c_str());
-		if (rinfo == nullptr) {
-			//not found
-			errprint("Not found component '%p'.\n", comp->get_component_name().c_str());
-			goto err_out;
-		}
-		rinfo->comp_info->destructor(omx_comp);
+	//Return the instance to the pool if the pool has a room
+	if (pool->release(omx_comp)) {
+		return OMX_ErrorNone;
 	}
 
-err_out:
-	//Delete base component
-	delete(omx_comp);
+	mf::component_pool::destroy_component(omx_comp);
 
 	return OMX_ErrorNone;
 }
@@ -323,7 +309,7 @@ OMX_API OMX_ERRORTYPE OMX_RoleOfComponentEnum(OMX_OUT OMX_STRING role, OMX_IN OM
 {
 	scoped_log_begin;
 	mf::register_component *rc = mf::register_component::get_instance();
-	mf::register_info *rinfo = nullptr;
+	const mf::register_info *rinfo = nullptr;
 
 	if (compName == nullptr) {
 		return OMX_ErrorBadParameter;
@@ -2,11 +2,92 @@
 #define __OMX_EXPORTS
 #define __OMX_MF_EXPORTS
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
 #include <OMX_Core.h>
 
+#include <omxil_mf/component.hpp>
+#include <omxil_mf/port.hpp>
 #include <omxil_mf/scoped_log.hpp>
 
+#include "debug/trace.hpp"
+#include "regist/component_pool.hpp"
 #include "regist/register_component.hpp"
+#include "util/omx_enum_name.hpp"
+
+//----------------------------------------
+//internal functions
+//----------------------------------------
+
+/**
+ * 目的の状態に向かうとき、次に遷移する状態を取得します。
+ *
+ * Loaded からの遷移と Loaded への遷移は Idle を経由します。
+ *
+ * @param cur    現在の状態
+ * @param target 目的の状態
+ * @return 次に遷移する状態
+ */
+static OMX_STATETYPE get_next_pipeline_state(OMX_STATETYPE cur, OMX_STATETYPE target)
+{
+	if (cur == OMX_StateLoaded) {
+		return OMX_StateIdle;
+	}
+	if (target == OMX_StateLoaded && cur != OMX_StateIdle) {
+		return OMX_StateIdle;
+	}
+
+	return target;
+}
+
+/**
+ * 期限までの残り時間を取得します。
+ *
+ * @param deadline 期限
+ * @return 残り時間（ミリ秒）、期限を過ぎていれば 0
+ */
+static OMX_U32 get_remain_msec(std::chrono::steady_clock::time_point deadline)
+{
+	std::chrono::milliseconds remain;
+
+	remain = std::chrono::duration_cast<std::chrono::milliseconds>(
+		deadline - std::chrono::steady_clock::now());
+
+	return (OMX_U32)std::max<int64_t>(remain.count(), 0);
+}
+
+/**
+ * コンポーネントの状態遷移が終わるまで、期限まで待ちます。
+ *
+ * @param comps    コンポーネントの配列
+ * @param index    待つコンポーネントの番号
+ * @param s        待ちたいコンポーネントの状態
+ * @param deadline 期限
+ * @return OpenMAX エラー値
+ */
+static OMX_ERRORTYPE wait_pipeline_state(const std::vector<mf::component *>& comps, size_t index, OMX_STATETYPE s, std::chrono::steady_clock::time_point deadline)
+{
+	scoped_log_begin;
+
+	try {
+		if (!comps[index]->wait_state_for(s, get_remain_msec(deadline))) {
+			errprint("Component %d did not reach %s in time.\n",
+				(int)index, mf::omx_enum_name::get_OMX_STATETYPE_name(s));
+			return OMX_ErrorTimeout;
+		}
+	} catch (const mf::interrupted_error& e) {
+		infoprint("interrupted: %s\n", e.what());
+		return OMX_ErrorInsufficientResources;
+	} catch (const std::runtime_error& e) {
+		errprint("runtime_error: %s\n", e.what());
+		return OMX_ErrorInsufficientResources;
+	}
+
+	return OMX_ErrorNone;
+}
 
 //----------------------------------------
 //external APIs
@@ -27,9 +108,6 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_RegisterComponent(const char *name, co
 		return OMX_ErrorInvalidComponentName;
 	}
 
-	//dump all registered components
-	rc->dump();
-
 	return OMX_ErrorNone;
 }
 
@@ -37,31 +115,14 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_RegisterComponentAlias(const char *nam
 {
 	scoped_log_begin;
 	mf::register_component *rc = mf::register_component::get_instance();
-	mf::register_info *rinfo = nullptr;
-	const OMX_MF_COMPONENT_INFO *comp_info = nullptr;
 	bool res;
 
-	rinfo = rc->find(name);
-	if (rinfo == nullptr) {
-		//not found
-		return OMX_ErrorInvalidComponentName;
-	}
-
-	//Copy component info.
-	//Reason: OMX_FreeHandle() call 'delete' for all key.
-	//        If we use shallow copy of component_info,
-	//        OMX_FreeHandle() faces double-free and SEGV.
-	comp_info = new OMX_MF_COMPONENT_INFO(*rinfo->comp_info);
-	res = rc->insert(alias, rinfo->cano_name.c_str(), comp_info);
+	res = rc->insert_alias(name, alias);
 	if (!res) {
-		//Alias has already existed
-		delete comp_info;
+		//Not found component, or alias has already existed
 		return OMX_ErrorInvalidComponentName;
 	}
 
-	//dump all registered components
-	rc->dump();
-
 	return OMX_ErrorNone;
 }
 
@@ -80,5 +141,270 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_RegisterComponentRole(const char *name
 	return OMX_ErrorNone;
 }
 
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_SetPipelineState(OMX_HANDLETYPE *hComponents, OMX_U32 nComponents, OMX_STATETYPE eState, OMX_U32 nTimeout)
+{
+	scoped_log_begin;
+	std::vector<mf::component *> comps;
+	std::vector<std::vector<size_t> > peers, users;
+	std::vector<size_t> n_suppliers, order;
+	std::vector<mf::port *> ports;
+	std::vector<bool> sent;
+	std::chrono::steady_clock::time_point deadline;
+	OMX_STATETYPE cur, next;
+	size_t i, j;
+	OMX_ERRORTYPE err;
+
+	if (hComponents == nullptr || nComponents == 0) {
+		errprint("No components.\n");
+		return OMX_ErrorBadParameter;
+	}
+
+	switch (eState) {
+	case OMX_StateLoaded:
+	case OMX_StateIdle:
+	case OMX_StateExecuting:
+	case OMX_StatePause:
+		//OK
+		break;
+	default:
+		errprint("Unsupported state %s.\n",
+			mf::omx_enum_name::get_OMX_STATETYPE_name(eState));
+		return OMX_ErrorBadParameter;
+	}
+
+	deadline = std::chrono::steady_clock::now() +
+		std::chrono::milliseconds(nTimeout);
+
+	comps.resize(nComponents);
+	for (i = 0; i < nComponents; i++) {
+		if (hComponents[i] == nullptr) {
+			errprint("Invalid component %d.\n", (int)i);
+			return OMX_ErrorInvalidComponent;
+		}
+
+		comps[i] = mf::component::get_instance(hComponents[i]);
+		if (comps[i] == nullptr) {
+			errprint("Invalid component %d.\n", (int)i);
+			return OMX_ErrorInvalidComponent;
+		}
+	}
+
+	cur = comps[0]->get_state();
+	for (i = 0; i < nComponents; i++) {
+		if (comps[i]->get_state() != cur) {
+			errprint("Component %d is %s, not %s.\n", (int)i,
+				mf::omx_enum_name::get_OMX_STATETYPE_name(comps[i]->get_state()),
+				mf::omx_enum_name::get_OMX_STATETYPE_name(cur));
+			return OMX_ErrorIncorrectStateOperation;
+		}
+	}
+	if (cur == eState) {
+		return OMX_ErrorSameState;
+	}
+
+	//リストに含まれるトンネル接続先と、
+	//利用側のポートにバッファを供給するコンポーネントの数を調べておく
+	peers.resize(nComponents);
+	users.resize(nComponents);
+	n_suppliers.assign(nComponents, 0);
+	for (i = 0; i < nComponents; i++) {
+		err = comps[i]->filter_ports(OMX_ALL, &ports);
+		if (err != OMX_ErrorNone) {
+			//No ports, skip
+			continue;
+		}
+
+		for (mf::port *p : ports) {
+			if (!p->get_enabled() || !p->get_tunneled()) {
+				continue;
+			}
+
+			for (j = 0; j < nComponents; j++) {
+				if (hComponents[j] != p->get_tunneled_component()) {
+					continue;
+				}
+
+				peers[i].push_back(j);
+				if (!p->get_tunneled_supplier()) {
+					users[j].push_back(i);
+					n_suppliers[i]++;
+				}
+			}
+		}
+	}
+
+	//供給側のコンポーネントから順に指示する、
+	//利用側を先に指示すると供給側を待つ間にコマンドを処理するスレッドを塞ぐ
+	for (i = 0; i < nComponents; i++) {
+		if (n_suppliers[i] == 0) {
+			order.push_back(i);
+		}
+	}
+	for (i = 0; i < order.size(); i++) {
+		for (size_t user : users[order[i]]) {
+			if (--n_suppliers[user] == 0) {
+				order.push_back(user);
+			}
+		}
+	}
+	//循環している接続は元の順に指示する
+	for (i = 0; i < nComponents; i++) {
+		if (n_suppliers[i] > 0) {
+			order.push_back(i);
+		}
+	}
+
+	while (cur != eState) {
+		next = get_next_pipeline_state(cur, eState);
+
+		//全てのコンポーネントが前の状態に揃うのは待たず、
+		//自身とトンネル接続先が前の状態に遷移したものから次の状態に進める
+		sent.assign(nComponents, false);
+		for (size_t k = 0; k < order.size(); k++) {
+			i = order[k];
+
+			err = wait_pipeline_state(comps, i, cur, deadline);
+			if (err != OMX_ErrorNone) {
+				return err;
+			}
+
+			//既に次の状態を指示した接続先は、前の状態に遷移済み
+			for (size_t peer : peers[i]) {
+				if (sent[peer]) {
+					continue;
+				}
+
+				err = wait_pipeline_state(comps, peer, cur, deadline);
+				if (err != OMX_ErrorNone) {
+					return err;
+				}
+			}
+
+			err = OMX_SendCommand(hComponents[i], OMX_CommandStateSet,
+				next, nullptr);
+			if (err != OMX_ErrorNone) {
+				errprint("Failed to OMX_SendCommand(%d, StateSet, %s).\n",
+					(int)i, mf::omx_enum_name::get_OMX_STATETYPE_name(next));
+				return err;
+			}
+			sent[i] = true;
+		}
+
+		cur = next;
+	}
+
+	for (i = 0; i < nComponents; i++) {
+		err = wait_pipeline_state(comps, i, eState, deadline);
+		if (err != OMX_ErrorNone) {
+			return err;
+		}
+	}
+
+	return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_SetComponentPool(OMX_STRING cComponentName, OMX_U32 nInstances)
+{
+	scoped_log_begin;
+	mf::register_component *rc = mf::register_component::get_instance();
+	mf::component_pool *pool = mf::component_pool::get_instance();
+
+	if (cComponentName == nullptr) {
+		errprint("Invalid component name.\n");
+		return OMX_ErrorBadParameter;
+	}
+	if (rc->find(cComponentName) == nullptr) {
+		errprint("Not found component '%s'.\n", cComponentName);
+		return OMX_ErrorInvalidComponentName;
+	}
+
+	return pool->set_capacity(cComponentName, nInstances);
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_FreeHandles(OMX_HANDLETYPE *hComponents, OMX_U32 nComponents)
+{
+	scoped_log_begin;
+	mf::component_pool *pool = mf::component_pool::get_instance();
+	std::vector<OMX_COMPONENTTYPE *> destroyed;
+	std::vector<OMX_HANDLETYPE> sorted;
+	OMX_STATETYPE st;
+	OMX_U32 i;
+	OMX_ERRORTYPE err;
+
+	if (hComponents == nullptr || nComponents == 0) {
+		errprint("No components.\n");
+		return OMX_ErrorBadParameter;
+	}
+
+	//OpenMAX IL 1.2.0: Table 3-17: Valid Component Calls
+	//1つでも解放できなければ、どれも解放しない
+	for (i = 0; i < nComponents; i++) {
+		if (hComponents[i] == nullptr) {
+			errprint("Invalid component %d.\n", (int)i);
+			return OMX_ErrorBadParameter;
+		}
+
+		err = OMX_GetState(hComponents[i], &st);
+		if (err != OMX_ErrorNone) {
+			errprint("Cannot get state of component %d.\n", (int)i);
+			return err;
+		}
+		if (st != OMX_StateLoaded) {
+			errprint("Component %d is %s, not Loaded.\n", (int)i,
+				mf::omx_enum_name::get_OMX_STATETYPE_name(st));
+			return OMX_ErrorInvalidState;
+		}
+	}
+
+	//同じハンドルを 2度解放しない
+	sorted.assign(hComponents, hComponents + nComponents);
+	std::sort(sorted.begin(), sorted.end());
+	if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+		errprint("Duplicated components.\n");
+		return OMX_ErrorBadParameter;
+	}
+
+	for (i = 0; i < nComponents; i++) {
+		OMX_COMPONENTTYPE *omx_comp = (OMX_COMPONENTTYPE *)hComponents[i];
+
+		//Return the instance to the pool if the pool has a room
+		if (pool->release(omx_comp)) {
+			continue;
+		}
+		destroyed.push_back(omx_comp);
+	}
+
+	mf::component_pool::destroy_components(destroyed);
+
+	return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_StartTrace(void)
+{
+	scoped_log_begin;
+
+	mf::trace::get_instance()->start();
+
+	return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_MF_StopTrace(OMX_STRING cFileName)
+{
+	scoped_log_begin;
+	mf::trace *tr = mf::trace::get_instance();
+
+	tr->stop();
+
+	if (cFileName == nullptr) {
+		return OMX_ErrorNone;
+	}
+	if (!tr->write_json(cFileName)) {
+		errprint("Failed to write trace '%s'.\n", cFileName);
+		return OMX_ErrorInsufficientResources;
+	}
+
+	return OMX_ErrorNone;
+}
+
 } //extern "C"
 
@@ -0,0 +1,44 @@
+﻿
+#define __OMX_MF_EXPORTS
+
+#include <OMX_Core.h>
+
+#include <omxil_mf/omxil_mf.h>
+
+#if defined(__linux__)
+//For autoconf
+#include "config.h"
+#endif
+
+#include "builtin/builtin_components.hpp"
+
+extern "C" {
+
+#ifdef BUILTIN_EMPTY
+OMX_ERRORTYPE OMX_APIENTRY OMX_MF_LibEntry_empty(void);
+#endif
+#ifdef BUILTIN_SIMPLE
+OMX_ERRORTYPE OMX_APIENTRY OMX_MF_LibEntry_simple(void);
+#endif
+#ifdef BUILTIN_READER_TS
+OMX_ERRORTYPE OMX_APIENTRY OMX_MF_LibEntry_reader_ts(void);
+#endif
+
+} //extern "C"
+
+namespace mf {
+
+const builtin_entry builtin_entries[] = {
+#ifdef BUILTIN_EMPTY
+	{ "empty", OMX_MF_LibEntry_empty },
+#endif
+#ifdef BUILTIN_SIMPLE
+	{ "simple", OMX_MF_LibEntry_simple },
+#endif
+#ifdef BUILTIN_READER_TS
+	{ "reader_ts", OMX_MF_LibEntry_reader_ts },
+#endif
+	{ nullptr, nullptr },
+};
+
+} //namespace mf
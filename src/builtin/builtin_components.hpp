@@ -0,0 +1,28 @@
+﻿
+#ifndef OMX_MF_BUILTIN_COMPONENTS_HPP__
+#define OMX_MF_BUILTIN_COMPONENTS_HPP__
+
+#include <OMX_Core.h>
+
+#include <omxil_mf/omxil_mf.h>
+
+namespace mf {
+
+struct builtin_entry {
+	const char *name;
+	OMX_MF_ENTRY_FUNC entry_func;
+};
+
+/**
+ * Entry functions of the components libraries
+ * linked into this OMX IL library.
+ *
+ * The table is fixed at compile time
+ * (configure --enable-builtin-components),
+ * the last element has nullptr as name.
+ */
+extern const builtin_entry builtin_entries[];
+
+} //namespace mf
+
+#endif //OMX_MF_BUILTIN_COMPONENTS_HPP__
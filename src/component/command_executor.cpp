@@ -0,0 +1,276 @@
+﻿
+#define __OMX_MF_EXPORTS
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <system_error>
+#include <thread>
+
+#include <omxil_mf/scoped_log.hpp>
+
+#include "component/command_executor.hpp"
+#include "util/util.hpp"
+
+namespace mf {
+
+//処理を実行しているスレッドであれば、そのスレッドを持つ command_executor
+static thread_local command_executor *tls_executor = nullptr;
+
+/*
+ * public functions
+ */
+
+bool command_executor::post(std::function<void()> task)
+{
+	scoped_log_begin;
+	std::lock_guard<std::mutex> lock(mut);
+
+	//最初の投入時に監視スレッドを開始する
+	if (!f_watching) {
+		try {
+			std::thread th(watch_thread_main, this);
+
+			th.detach();
+		} catch (const std::system_error& e) {
+			errprint("failed to create thread '%s'.\n", e.what());
+			return false;
+		}
+		f_watching = true;
+	}
+
+	//ブロックしていないスレッドが常に残すスレッド数に満たなければ増やす
+	if (n_idle == 0 && n_threads - n_blocked < n_base) {
+		add_thread_with_lock();
+	}
+	if (n_threads == 0) {
+		return false;
+	}
+
+	tasks.push_back(std::move(task));
+	cond.notify_one();
+	//すぐに実行できるスレッドがなければ監視を始める
+	if (tasks.size() > n_idle) {
+		wake_watcher_with_lock();
+	}
+
+	return true;
+}
+
+size_t command_executor::get_thread_count() const
+{
+	std::lock_guard<std::mutex> lock(mut);
+
+	return n_threads;
+}
+
+
+/*
+ * static public functions
+ */
+
+void command_executor::begin_blocking()
+{
+	if (tls_executor != nullptr) {
+		tls_executor->enter_blocking();
+	}
+}
+
+void command_executor::end_blocking()
+{
+	if (tls_executor != nullptr) {
+		tls_executor->leave_blocking();
+	}
+}
+
+static std::once_flag once_instance;
+static command_executor *g_executor = nullptr;
+
+command_executor *command_executor::get_instance()
+{
+	//1回目の呼び出し時にシングルトンを生成してポインタを返す。
+	//2回目以降の呼び出しでは 1回目で生成したポインタを返す。
+	std::call_once(once_instance, create_instance_once);
+
+	return g_executor;
+}
+
+
+/*
+ * protected functions
+ */
+
+command_executor::command_executor()
+	: n_base(OMX_MF_EXECUTOR_MIN_THREADS), n_threads(0), n_idle(0), n_blocked(0),
+	cnt_started(0), f_watching(false), f_watch_sleeping(false)
+{
+	scoped_log_begin;
+
+	n_base = std::max<size_t>(n_base, std::thread::hardware_concurrency());
+}
+
+command_executor::~command_executor()
+{
+	scoped_log_begin;
+	//do nothing
+}
+
+bool command_executor::add_thread_with_lock()
+{
+	scoped_log_begin;
+
+	try {
+		std::thread th(executor_thread_main, this);
+
+		//スレッドは不要になると自ら終了する
+		th.detach();
+	} catch (const std::system_error& e) {
+		errprint("failed to create thread '%s'.\n", e.what());
+		return false;
+	}
+	n_threads++;
+
+	return true;
+}
+
+void command_executor::wake_watcher_with_lock()
+{
+	if (f_watch_sleeping) {
+		f_watch_sleeping = false;
+		cond_watch.notify_one();
+	}
+}
+
+void command_executor::enter_blocking()
+{
+	scoped_log_begin;
+	std::lock_guard<std::mutex> lock(mut);
+
+	n_blocked++;
+
+	//監視を待たずに、ブロックするスレッドの代わりを追加する
+	if (tasks.size() > n_idle && n_threads - n_blocked < n_base) {
+		add_thread_with_lock();
+	}
+}
+
+void command_executor::leave_blocking()
+{
+	std::lock_guard<std::mutex> lock(mut);
+
+	n_blocked--;
+}
+
+void command_executor::run()
+{
+	scoped_log_begin;
+	std::unique_lock<std::mutex> lock(mut);
+	std::function<void()> task;
+
+	while (true) {
+		n_idle++;
+		while (tasks.empty()) {
+			std::cv_status st = cond.wait_for(lock,
+				std::chrono::milliseconds(OMX_MF_EXECUTOR_IDLE_TIMEOUT));
+
+			//しばらく処理待ちがなければ、追加したスレッドは終了する
+			if (st == std::cv_status::timeout && tasks.empty() &&
+				n_threads - n_blocked > n_base) {
+				n_idle--;
+				n_threads--;
+				return;
+			}
+		}
+		n_idle--;
+
+		task.swap(tasks.front());
+		tasks.pop_front();
+		cnt_started++;
+		if (!tasks.empty()) {
+			wake_watcher_with_lock();
+		}
+
+		lock.unlock();
+		task();
+		task = nullptr;
+		lock.lock();
+	}
+}
+
+void command_executor::watch()
+{
+	scoped_log_begin;
+	std::unique_lock<std::mutex> lock(mut);
+	uint64_t cnt_last;
+
+	while (true) {
+		//処理待ちがなければ、起こされるまで休む
+		if (tasks.empty()) {
+			f_watch_sleeping = true;
+			cond_watch.wait(lock, [&] { return !f_watch_sleeping; });
+		}
+
+		//処理待ちがある間は、処理が開始されているかを定期的に確かめる
+		cnt_last = cnt_started;
+		cond_watch.wait_for(lock,
+			std::chrono::milliseconds(OMX_MF_EXECUTOR_STALL_TIMEOUT));
+		if (!tasks.empty() && n_idle == 0 && cnt_started == cnt_last) {
+			//全てのスレッドがブロックしているため、
+			//処理待ちの数だけスレッドを追加する
+			dprint("executor stalled, add %d threads (threads:%d).\n",
+				(int)tasks.size(), (int)n_threads);
+			for (size_t i = 0; i < tasks.size(); i++) {
+				if (!add_thread_with_lock()) {
+					break;
+				}
+			}
+		}
+	}
+}
+
+
+/*
+ * static protected functions
+ */
+
+void *command_executor::executor_thread_main(command_executor *ex)
+{
+	scoped_log_begin;
+
+	//スレッド名をつける
+	set_thread_name("omx:cmdexec");
+
+	tls_executor = ex;
+	ex->run();
+
+	return nullptr;
+}
+
+void *command_executor::watch_thread_main(command_executor *ex)
+{
+	scoped_log_begin;
+
+	//スレッド名をつける
+	set_thread_name("omx:cmdwatch");
+
+	ex->watch();
+
+	return nullptr;
+}
+
+
+/*
+ * static private functions
+ */
+
+void command_executor::create_instance_once()
+{
+	scoped_log_begin;
+
+	g_executor = new command_executor();
+}
+
+} //namespace mf
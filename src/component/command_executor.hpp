@@ -0,0 +1,196 @@
+﻿
+#ifndef OMX_MF_COMMAND_EXECUTOR_HPP__
+#define OMX_MF_COMMAND_EXECUTOR_HPP__
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+//常に残すスレッド数の下限（CPU 数の方が多ければ CPU 数）
+#define OMX_MF_EXECUTOR_MIN_THREADS     2
+//処理が進まないとみなしてスレッドを追加するまでの時間（ミリ秒）
+#define OMX_MF_EXECUTOR_STALL_TIMEOUT   10
+//追加したスレッドが、処理待ちがないときに終了するまでの時間（ミリ秒）
+#define OMX_MF_EXECUTOR_IDLE_TIMEOUT    3000
+
+namespace mf {
+
+/**
+ * 全てのコンポーネントが共有する、コマンド処理用のスレッドプールです。
+ *
+ * コンポーネントは自身のコマンドを処理する関数（strand）を投入します。
+ * 同じコンポーネントの strand を同時に複数投入しないことで、
+ * コンポーネント毎にコマンドを一つずつ処理する順序を保ちます。
+ *
+ * コマンドの処理はバッファの割り当てなどを待ってブロックすることがあります。
+ * ブロックすることが分かっている処理は begin_blocking() で知らせると、
+ * 処理待ちがあればすぐにスレッドを追加し、
+ * ブロックしていないスレッドの数を常に残すスレッド数に保ちます。
+ * 知らせずにブロックした処理のため、処理待ちがあるにも関わらず、
+ * OMX_MF_EXECUTOR_STALL_TIMEOUT ミリ秒の間どの処理も開始されなければ、
+ * 監視スレッドが処理待ちの数だけスレッドを追加します。
+ * 監視スレッドは処理待ちがある間だけ動作します。
+ * 追加したスレッドは、処理待ちがない状態が
+ * OMX_MF_EXECUTOR_IDLE_TIMEOUT ミリ秒続くと終了します。
+ */
+class command_executor {
+public:
+	//親クラス
+	//typedef xxxx super;
+
+	//disable copy constructor
+	command_executor(const command_executor& obj) = delete;
+	//disable operator=
+	command_executor& operator=(const command_executor& obj) = delete;
+
+	/**
+	 * 処理を投入します。
+	 *
+	 * 投入した処理は、いずれかのスレッドで一度だけ実行されます。
+	 *
+	 * @param task 処理
+	 * @return 投入できた場合は true、できなかった場合は false
+	 */
+	virtual bool post(std::function<void()> task);
+
+	/**
+	 * 処理を実行するスレッドの数を取得します。
+	 *
+	 * @return スレッド数
+	 */
+	virtual size_t get_thread_count() const;
+
+	/**
+	 * 呼び出したスレッドが、これからブロックすることを知らせます。
+	 *
+	 * 共有スレッド以外から呼び出した場合は何もしません。
+	 */
+	static void begin_blocking();
+
+	/**
+	 * 呼び出したスレッドが、ブロックを終えたことを知らせます。
+	 *
+	 * 共有スレッド以外から呼び出した場合は何もしません。
+	 */
+	static void end_blocking();
+
+	/**
+	 * シングルトンのインスタンスを取得します。
+	 *
+	 * @return command_executor のインスタンス
+	 */
+	static command_executor *get_instance();
+
+protected:
+	command_executor();
+	virtual ~command_executor();
+
+	/**
+	 * 処理を実行するスレッドを一つ追加します。
+	 *
+	 * ロックを確保してから呼び出します。
+	 *
+	 * @return 追加できた場合は true、できなかった場合は false
+	 */
+	virtual bool add_thread_with_lock();
+
+	/**
+	 * 休んでいる監視スレッドを起こします。
+	 *
+	 * ロックを確保してから呼び出します。
+	 */
+	virtual void wake_watcher_with_lock();
+
+	/**
+	 * ブロックしているスレッドの数を増やし、
+	 * 処理待ちがあればスレッドを追加します。
+	 */
+	virtual void enter_blocking();
+
+	/**
+	 * ブロックしているスレッドの数を減らします。
+	 */
+	virtual void leave_blocking();
+
+	/**
+	 * 投入された処理を順に実行します。
+	 *
+	 * 追加されたスレッドは、処理待ちがない状態が続くと戻ります。
+	 */
+	virtual void run();
+
+	/**
+	 * 処理が進んでいるかを監視し、必要ならスレッドを追加します。
+	 */
+	virtual void watch();
+
+	/**
+	 * 処理を実行するスレッドの main 関数です。
+	 *
+	 * @param ex command_executor へのポインタ
+	 * @return 常に nullptr
+	 */
+	static void *executor_thread_main(command_executor *ex);
+
+	/**
+	 * 監視スレッドの main 関数です。
+	 *
+	 * @param ex command_executor へのポインタ
+	 * @return 常に nullptr
+	 */
+	static void *watch_thread_main(command_executor *ex);
+
+private:
+	static void create_instance_once();
+
+private:
+	mutable std::mutex mut;
+	std::condition_variable cond;
+	std::condition_variable cond_watch;
+	//処理待ちの処理
+	std::deque<std::function<void()> > tasks;
+	//常に残すスレッド数
+	size_t n_base;
+	//処理を実行するスレッド数
+	size_t n_threads;
+	//処理待ちで待機しているスレッド数
+	size_t n_idle;
+	//処理の途中でブロックしているスレッド数
+	size_t n_blocked;
+	//開始した処理の数
+	uint64_t cnt_started;
+	//監視スレッドを開始したか
+	bool f_watching;
+	//監視スレッドが次の投入まで休んでいるか
+	bool f_watch_sleeping;
+
+};
+
+/**
+ * 生存期間の間、コマンドを処理するスレッドが
+ * ブロックすることを command_executor に知らせます。
+ */
+class scoped_blocking {
+public:
+	scoped_blocking()
+	{
+		command_executor::begin_blocking();
+	}
+
+	~scoped_blocking()
+	{
+		command_executor::end_blocking();
+	}
+
+	//disable copy constructor
+	scoped_blocking(const scoped_blocking& obj) = delete;
+	//disable operator=
+	scoped_blocking& operator=(const scoped_blocking& obj) = delete;
+
+};
+
+} //namespace mf
+
+#endif //OMX_MF_COMMAND_EXECUTOR_HPP__
@@ -3,14 +3,17 @@
 
 #include <cstdarg>
 #include <cstdint>
-#include <deque>
+#include <cstring>
 #include <map>
+#include <algorithm>
 #include <mutex>
 #include <condition_variable>
+#include <system_error>
 
 #include <OMX_Component.h>
 #include <OMX_Core.h>
 
+#include <omxil_mf/omxil_mf.h>
 #include <omxil_mf/component.hpp>
 #include <omxil_mf/port_audio.hpp>
 #include <omxil_mf/port_video.hpp>
@@ -20,6 +23,10 @@
 #include <omxil_mf/scoped_log.hpp>
 
 #include "api/consts.hpp"
+#include "component/command_executor.hpp"
+#include "component/worker_pool.hpp"
+#include "debug/probe.hpp"
+#include "debug/trace.hpp"
 #include "util/util.hpp"
 #include "util/omx_enum_name.hpp"
 
@@ -44,7 +51,14 @@ component::component(OMX_COMPONENTTYPE *c, const char *cname)
 	: omx_reflector(c, cname),
 	f_broken(false),
 	state(OMX_StateInvalid), omx_cbs(), omx_cbs_priv(nullptr),
-	th_accept(nullptr), ring_accept(nullptr), bound_accept(nullptr)
+	th_accept(nullptr), ring_accept(nullptr), bound_accept(nullptr),
+	f_cmd_dedicated(OMX_FALSE), f_cmd_started(false),
+	f_cmd_queued(false), f_cmd_closed(false),
+	f_worker_pooled(OMX_FALSE), worker_lane(0),
+	port_base(0), flush_timeout(OMX_MF_FLUSH_TIMEOUT_DEFAULT),
+	f_saved_defaults(false), saved_defs(),
+	saved_cmd_dedicated(OMX_FALSE), saved_worker_pooled(OMX_FALSE),
+	saved_worker_lane(0), saved_flush_timeout(OMX_MF_FLUSH_TIMEOUT_DEFAULT)
 {
 	scoped_log_begin;
 
@@ -54,14 +68,11 @@ component::component(OMX_COMPONENTTYPE *c, const char *cname)
 		ring_accept = new command_ring_t(vec_accept.begin(), vec_accept.capacity());
 		bound_accept = new command_bound_t(*ring_accept);
 
-		//start command accept thread
-		th_accept = new std::thread(accept_command_thread_main, get_omx_component());
+		//コマンドを処理するスレッドは、
+		//最初のコマンドを受け付けたときに決める
 	} catch (const std::bad_alloc& e) {
 		errprint("failed to construct '%s'.\n", e.what());
 
-		delete th_accept;
-		th_accept = nullptr;
-
 		delete ring_accept;
 		ring_accept = nullptr;
 		delete bound_accept;
@@ -90,6 +101,13 @@ component::~component()
 	if (th_accept) {
 		th_accept->join();
 	}
+	//共有スレッドで処理中、または処理待ちのコマンドがあれば終わるまで待つ
+	if (bound_accept) {
+		std::unique_lock<std::recursive_mutex> lk(bound_accept->mutex());
+
+		f_cmd_closed = true;
+		cond_cmd.wait(lk, [&] { return !f_cmd_queued; });
+	}
 	delete th_accept;
 	delete bound_accept;
 	delete ring_accept;
@@ -109,30 +127,77 @@ void component::shutdown()
 	}
 }
 
+void component::shutdown_threads()
+{
+	scoped_log_begin;
+
+	shutdown();
+
+	for (port *p : list_ports) {
+		p->shutdown_threads();
+	}
+
+	if (bound_accept) {
+		bound_accept->shutdown();
+	}
+}
+
 OMX_STATETYPE component::get_state() const
 {
-	return state;
+	//GetState() のポーリングと競合しないようロックは取らない
+	return state.load(std::memory_order_acquire);
 }
 
 void component::set_state(OMX_STATETYPE s)
 {
+	static const trace_point tp = {
+		"state", "command", "state", "component", true,
+	};
 	std::lock_guard<std::mutex> lock(mut);
 
-	state = s;
+	trace_instant(&tp, s, (uintptr_t)get_omx_component());
+	OMX_MF_PROBE3(state_change, get_name(),
+		(int)state.load(std::memory_order_relaxed), (int)s);
+
+	state.store(s, std::memory_order_release);
 	cond.notify_all();
 }
 
 void component::wait_state(OMX_STATETYPE s) const
 {
+	//既に目的の状態であれば、ロックを取らずに戻る
+	if (get_state() == s) {
+		return;
+	}
+
 	std::unique_lock<std::mutex> lock(mut);
 
-	cond.wait(lock, [&] { return is_broken() || state == s; });
+	cond.wait(lock, [&] { return is_broken() || get_state() == s; });
 	error_if_broken(lock);
 }
 
-void component::wait_state_multiple(int cnt, ...) const
+bool component::wait_state_for(OMX_STATETYPE s, OMX_U32 msec) const
 {
+	bool res;
+
+	//既に目的の状態であれば、ロックを取らずに戻る
+	if (get_state() == s) {
+		return true;
+	}
+
 	std::unique_lock<std::mutex> lock(mut);
+
+	res = cond.wait_for(lock, std::chrono::milliseconds(msec),
+		[&] { return is_broken() || get_state() == s; });
+	error_if_broken(lock);
+
+	return res;
+}
+
+void component::wait_state_multiple(int cnt, ...) const
+{
+	std::unique_lock<std::mutex> lock(mut, std::defer_lock);
+	OMX_STATETYPE cur;
 	va_list ap;
 	OMX_STATETYPE states[16];
 
@@ -154,9 +219,18 @@ void component::wait_state_multiple(int cnt, ...) const
 	}
 	va_end(ap);
 
+	//既に目的の状態であれば、ロックを取らずに戻る
+	cur = get_state();
+	for (int i = 0; i < cnt; i++) {
+		if (cur == states[i]) {
+			return;
+		}
+	}
+
+	lock.lock();
 	cond.wait(lock, [&] {
 		for (int i = 0; i < cnt; i++) {
-			if (is_broken() || state == states[i]) {
+			if (is_broken() || get_state() == states[i]) {
 				return true;
 			}
 		}
@@ -176,61 +250,100 @@ const void *component::get_callbacks_data() const
 
 const port *component::find_port(OMX_U32 index) const
 {
-	auto ret = map_ports.find(index);
-	if (ret == map_ports.end()) {
+	OMX_U32 off = index - port_base;
+
+	if (off < table_ports.size()) {
+		return table_ports[off];
+	}
+	if (!table_ports.empty() || list_ports.empty()) {
 		//not found
 		return nullptr;
 	}
 
-	return &ret->second;
+	return find_port_slow(index);
 }
 
 port *component::find_port(OMX_U32 index)
 {
-	auto ret = map_ports.find(index);
-	if (ret == map_ports.end()) {
+	OMX_U32 off = index - port_base;
+
+	if (off < table_ports.size()) {
+		return table_ports[off];
+	}
+	if (!table_ports.empty() || list_ports.empty()) {
 		//not found
 		return nullptr;
 	}
 
-	return &ret->second;
+	return find_port_slow(index);
 }
 
-OMX_ERRORTYPE component::filter_ports(OMX_U32 port_index, std::vector<const port *> *filtered_ports) const
+OMX_ERRORTYPE component::filter_ports(OMX_U32 port_index, port_range *range) const
 {
-	if (filtered_ports == nullptr) {
-		errprint("filtered_ports is null.\n");
+	if (range == nullptr) {
+		errprint("range is null.\n");
 		return OMX_ErrorBadParameter;
 	}
 
-	filtered_ports->clear();
-
 	if (port_index == OMX_ALL) {
 		//All ports
-		for (auto it = map_ports.begin(); it != map_ports.end(); it++) {
-			filtered_ports->push_back(&it->second);
+		if (list_ports.empty()) {
+			errprint("Invalid all ports.\n");
+			return OMX_ErrorBadPortIndex;
 		}
+		range->first = &list_ports[0];
+		range->last = range->first + list_ports.size();
 	} else {
 		//Single port
-		const port *port_found = find_port(port_index);
-		if (port_found == nullptr) {
-			errprint("Invalid port:%d\n",
-				(int)port_index);
-			return OMX_ErrorBadPortIndex;
+		OMX_U32 off = port_index - port_base;
+
+		if (off < table_ports.size() && table_ports[off] != nullptr) {
+			range->first = &table_ports[off];
 		} else {
-			filtered_ports->push_back(port_found);
+			auto it = std::lower_bound(list_ports.begin(), list_ports.end(),
+				port_index, [](const port *p, OMX_U32 ind) {
+					return p->get_port_index() < ind;
+				});
+			if (!table_ports.empty() || it == list_ports.end() ||
+				(*it)->get_port_index() != port_index) {
+				errprint("Invalid port:%d\n",
+					(int)port_index);
+				return OMX_ErrorBadPortIndex;
+			}
+			range->first = &*it;
 		}
+		range->last = range->first + 1;
 	}
-	if (filtered_ports->empty()) {
-		errprint("Invalid all ports.\n");
-		return OMX_ErrorBadPortIndex;
+
+	return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE component::filter_ports(OMX_U32 port_index, std::vector<const port *> *filtered_ports) const
+{
+	port_range range;
+	OMX_ERRORTYPE err;
+
+	if (filtered_ports == nullptr) {
+		errprint("filtered_ports is null.\n");
+		return OMX_ErrorBadParameter;
+	}
+
+	filtered_ports->clear();
+
+	err = filter_ports(port_index, &range);
+	if (err != OMX_ErrorNone) {
+		return err;
 	}
+	filtered_ports->assign(range.begin(), range.end());
 
 	return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE component::filter_ports(OMX_U32 port_index, std::vector<port *> *filtered_ports)
 {
+	port_range range;
+	OMX_ERRORTYPE err;
+
 	if (filtered_ports == nullptr) {
 		errprint("filtered_ports is null.\n");
 		return OMX_ErrorBadParameter;
@@ -238,26 +351,11 @@ OMX_ERRORTYPE component::filter_ports(OMX_U32 port_index, std::vector<port *> *f
 
 	filtered_ports->clear();
 
-	if (port_index == OMX_ALL) {
-		//All ports
-		for (auto it = map_ports.begin(); it != map_ports.end(); it++) {
-			filtered_ports->push_back(&it->second);
-		}
-	} else {
-		//Single port
-		port *port_found = find_port(port_index);
-		if (port_found == nullptr) {
-			errprint("Invalid port:%d\n",
-				(int)port_index);
-			return OMX_ErrorBadPortIndex;
-		} else {
-			filtered_ports->push_back(port_found);
-		}
-	}
-	if (filtered_ports->empty()) {
-		errprint("Invalid all ports.\n");
-		return OMX_ErrorBadPortIndex;
+	err = filter_ports(port_index, &range);
+	if (err != OMX_ErrorNone) {
+		return err;
 	}
+	filtered_ports->assign(range.begin(), range.end());
 
 	return OMX_ErrorNone;
 }
@@ -265,7 +363,7 @@ OMX_ERRORTYPE component::filter_ports(OMX_U32 port_index, std::vector<port *> *f
 void component::wait_port_buffer_returned(OMX_U32 port_index) const
 {
 	scoped_log_begin;
-	std::vector<const port *> filtered_ports;
+	port_range filtered_ports;
 	OMX_ERRORTYPE err;
 
 	//Filter
@@ -275,6 +373,9 @@ void component::wait_port_buffer_returned(OMX_U32 port_index) const
 		return;
 	}
 
+	//トンネル接続先などを待つ間、共有スレッドの代わりを用意させる
+	scoped_blocking blocking;
+
 	for (const port *p : filtered_ports) {
 		if (!p->get_enabled()) {
 			continue;
@@ -283,6 +384,274 @@ void component::wait_port_buffer_returned(OMX_U32 port_index) const
 	}
 }
 
+OMX_ERRORTYPE component::wait_port_buffer_returned_for(OMX_U32 port_index, std::function<void(port *)> func_port_done)
+{
+	scoped_log_begin;
+	port_range filtered_ports;
+	std::vector<port *> pending_ports, done_ports;
+	std::chrono::steady_clock::time_point deadline;
+	OMX_ERRORTYPE err, err_handler;
+
+	//Filter
+	err = filter_ports(port_index, &filtered_ports);
+	if (err != OMX_ErrorNone) {
+		errprint("Invalid or disabled all ports.\n");
+		return err;
+	}
+
+	for (port *p : filtered_ports) {
+		if (!p->get_enabled()) {
+			continue;
+		}
+		p->add_returned_waiter();
+		pending_ports.push_back(p);
+	}
+
+	deadline = std::chrono::steady_clock::now() +
+		std::chrono::milliseconds(get_flush_timeout());
+
+	//返却が済んだポートから順に処理する
+	scoped_blocking blocking;
+	std::unique_lock<std::mutex> lock(mut_returned);
+
+	while (!pending_ports.empty()) {
+		done_ports.clear();
+		for (auto it = pending_ports.begin(); it != pending_ports.end(); ) {
+			if ((*it)->get_unreturned_buffer_count() == 0) {
+				done_ports.push_back(*it);
+				it = pending_ports.erase(it);
+			} else {
+				it++;
+			}
+		}
+
+		if (!done_ports.empty()) {
+			lock.unlock();
+			for (port *p : done_ports) {
+				p->remove_returned_waiter();
+				func_port_done(p);
+			}
+			lock.lock();
+			continue;
+		}
+
+		if (cond_returned.wait_until(lock, deadline) == std::cv_status::timeout) {
+			break;
+		}
+	}
+
+	lock.unlock();
+
+	//期限を過ぎても返却されないバッファを強制的に返却する
+	for (port *p : pending_ports) {
+		uint64_t cnt = p->get_unreturned_buffer_count();
+
+		p->remove_returned_waiter();
+		if (cnt != 0) {
+			errprint("Port %d has %d buffers not returned in %dms, "
+				"return forcibly.\n",
+				(int)p->get_port_index(), (int)cnt,
+				(int)get_flush_timeout());
+
+			err = p->return_buffers_force();
+			if (err != OMX_ErrorNone) {
+				errprint("Failed to port return_buffers_force(%d), "
+					"err:0x%08x(%s).\n",
+					(int)p->get_port_index(), (int)err,
+					omx_enum_name::get_OMX_ERRORTYPE_name(err));
+			}
+
+			err_handler = EventHandler(OMX_EventError,
+				OMX_ErrorTimeout, p->get_port_index(),
+				(OMX_PTR)(uintptr_t)cnt);
+			if (err_handler != OMX_ErrorNone) {
+				errprint("event handler(port:%d, timeout) returns err:%d(%s)\n",
+					(int)p->get_port_index(), (int)err_handler,
+					omx_enum_name::get_OMX_ERRORTYPE_name(err_handler));
+			}
+		}
+
+		func_port_done(p);
+	}
+
+	return OMX_ErrorNone;
+}
+
+void component::notify_port_buffer_returned()
+{
+	std::lock_guard<std::mutex> lock(mut_returned);
+
+	cond_returned.notify_all();
+}
+
+OMX_U32 component::get_flush_timeout() const
+{
+	return flush_timeout;
+}
+
+void component::set_flush_timeout(OMX_U32 msec)
+{
+	flush_timeout = msec;
+}
+
+OMX_BOOL component::get_command_thread_dedicated() const
+{
+	std::lock_guard<std::recursive_mutex> lk(bound_accept->mutex());
+
+	return f_cmd_dedicated;
+}
+
+OMX_ERRORTYPE component::set_command_thread_dedicated(OMX_BOOL v)
+{
+	std::lock_guard<std::recursive_mutex> lk(bound_accept->mutex());
+
+	//コマンドを処理するスレッドは途中で変えられない
+	if (f_cmd_started) {
+		errprint("Commands have already been accepted.\n");
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	f_cmd_dedicated = v;
+
+	return OMX_ErrorNone;
+}
+
+OMX_BOOL component::get_worker_pooled() const
+{
+	return f_worker_pooled;
+}
+
+OMX_S32 component::get_worker_lane() const
+{
+	return worker_lane;
+}
+
+OMX_ERRORTYPE component::set_worker_pooled(OMX_BOOL v, OMX_S32 lane)
+{
+	scoped_log_begin;
+
+	//ワーカーが動き出した後は実行方法を変えられない
+	if (get_state() != OMX_StateLoaded) {
+		errprint("Invalid state:%s.\n",
+			omx_enum_name::get_OMX_STATETYPE_name(get_state()));
+		return OMX_ErrorIncorrectStateOperation;
+	}
+	if (v) {
+		for (auto wr : list_workers) {
+			if (!wr->is_step_supported()) {
+				errprint("Worker %s does not support step.\n",
+					wr->get_name());
+				return OMX_ErrorUnsupportedSetting;
+			}
+		}
+		if (lane < 0) {
+			lane = worker_pool::get_instance()->assign_lane();
+		}
+	}
+
+	//同じコンポーネントのワーカーは同じレーンに投入する
+	for (auto wr : list_workers) {
+		wr->set_lane(lane);
+		wr->set_pooled(v == OMX_TRUE);
+	}
+	f_worker_pooled = v;
+	worker_lane = lane;
+
+	return OMX_ErrorNone;
+}
+
+void component::schedule_pooled_workers()
+{
+	if (!f_worker_pooled) {
+		return;
+	}
+
+	for (auto wr : list_workers) {
+		wr->schedule();
+	}
+}
+
+void component::save_defaults()
+{
+	scoped_log_begin;
+
+	saved_defs.resize(list_ports.size());
+	for (size_t i = 0; i < list_ports.size(); i++) {
+		list_ports[i]->get_definition(&saved_defs[i]);
+	}
+
+	{
+		std::lock_guard<std::recursive_mutex> lk(bound_accept->mutex());
+
+		saved_cmd_dedicated = f_cmd_dedicated;
+	}
+	saved_worker_pooled = f_worker_pooled;
+	saved_worker_lane = worker_lane;
+	saved_flush_timeout = get_flush_timeout();
+
+	f_saved_defaults = true;
+}
+
+bool component::has_saved_defaults() const
+{
+	return f_saved_defaults;
+}
+
+OMX_ERRORTYPE component::reset_to_defaults()
+{
+	scoped_log_begin;
+	OMX_ERRORTYPE err;
+
+	if (!f_saved_defaults || saved_defs.size() != list_ports.size()) {
+		errprint("Defaults of '%s' are not saved.\n", get_name());
+		return OMX_ErrorNotReady;
+	}
+	if (get_state() != OMX_StateLoaded) {
+		errprint("Invalid state:%s.\n",
+			omx_enum_name::get_OMX_STATETYPE_name(get_state()));
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	{
+		std::unique_lock<std::recursive_mutex> lk(bound_accept->mutex());
+
+		//未処理のコマンドが残っていると、戻した後に状態が変わってしまう、
+		//完了を通知した直後の strand は終わるまで少し待つ
+		if (!bound_accept->empty() ||
+			!cond_cmd.wait_for(lk, std::chrono::milliseconds(get_flush_timeout()),
+				[&] { return !f_cmd_queued; })) {
+			errprint("Commands of '%s' are pending.\n", get_name());
+			return OMX_ErrorIncorrectStateOperation;
+		}
+		//コマンドを処理するスレッドは最初のコマンドの後は変えられない
+		if (f_cmd_dedicated != saved_cmd_dedicated) {
+			if (f_cmd_started) {
+				errprint("Command thread of '%s' cannot be reset.\n", get_name());
+				return OMX_ErrorUnsupportedSetting;
+			}
+			f_cmd_dedicated = saved_cmd_dedicated;
+		}
+	}
+
+	for (size_t i = 0; i < list_ports.size(); i++) {
+		err = list_ports[i]->reset(saved_defs[i]);
+		if (err != OMX_ErrorNone) {
+			return err;
+		}
+	}
+
+	err = set_worker_pooled(saved_worker_pooled, saved_worker_lane);
+	if (err != OMX_ErrorNone) {
+		return err;
+	}
+	set_flush_timeout(saved_flush_timeout);
+
+	omx_cbs = OMX_CALLBACKTYPE();
+	omx_cbs_priv = nullptr;
+
+	return OMX_ErrorNone;
+}
+
 
 /*
  * OpenMAX member functions
@@ -325,7 +694,7 @@ OMX_ERRORTYPE component::SendCommand(OMX_HANDLETYPE hComponent, OMX_COMMANDTYPE
 {
 	port *port_found;
 	OMX_MF_CMD cmd;
-	//OMX_ERRORTYPE err;
+	OMX_ERRORTYPE err;
 
 	dprint("cmd:%s\n", omx_enum_name::get_OMX_COMMANDTYPE_name(Cmd));
 
@@ -360,16 +729,50 @@ OMX_ERRORTYPE component::SendCommand(OMX_HANDLETYPE hComponent, OMX_COMMANDTYPE
 		return OMX_ErrorUnsupportedIndex;
 	}
 
-	try {
-		cmd.cmd = Cmd;
-		cmd.param = nParam;
-		cmd.data = pCmdData;
+	OMX_MF_PROBE3(command_send, get_name(), (int)Cmd, nParam);
 
-		bound_accept->write_fully(&cmd, 1);
-	} catch (const mf::interrupted_error& e) {
-		infoprint("interrupted: %s\n", e.what());
-	} catch (const std::runtime_error& e) {
-		errprint("runtime_error: %s\n", e.what());
+	cmd.cmd = Cmd;
+	cmd.param = nParam;
+	cmd.data = pCmdData;
+	cmd.n_absorbed = 0;
+
+	{
+		std::unique_lock<std::recursive_mutex> lk(bound_accept->mutex());
+
+		//最初のコマンドで、コマンドを処理するスレッドを確定する
+		if (!f_cmd_started) {
+			err = start_command_thread();
+			if (err != OMX_ErrorNone) {
+				return err;
+			}
+		}
+
+		//未処理のコマンドにまとめられれば、新たに積まない
+		if (!bound_accept->empty() &&
+			coalesce_command(&bound_accept->container().back(), cmd)) {
+			dprint("cmd:%s, param1:0x%08x is coalesced.\n",
+				omx_enum_name::get_OMX_COMMANDTYPE_name(Cmd),
+				(int)nParam);
+			return OMX_ErrorNone;
+		}
+
+		//OMX_SendCommand はノンブロッキングのため、空きを待たない
+		if (bound_accept->full()) {
+			errprint("Command queue is full.\n");
+			return OMX_ErrorInsufficientResources;
+		}
+
+		//共有スレッドで処理する場合、
+		//このコンポーネントの strand が処理中でなければ投入する
+		if (th_accept == nullptr && !f_cmd_queued) {
+			if (!command_executor::get_instance()->post([this] { run_command_strand(); })) {
+				errprint("Cannot post command strand.\n");
+				return OMX_ErrorInsufficientResources;
+			}
+			f_cmd_queued = true;
+		}
+
+		bound_accept->write_array_with_lock(&cmd, 1);
 	}
 
 	return OMX_ErrorNone;
@@ -387,6 +790,10 @@ OMX_ERRORTYPE component::GetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE n
 
 	ptr = pComponentParameterStructure;
 
+	if (nParamIndex >= OMX_IndexVendorStartUnused) {
+		return get_vendor_parameter(nParamIndex, ptr);
+	}
+
 	//OpenMAX IL 1.2.0: 8.2 Mandatory Port Parameters
 	switch (nParamIndex) {
 	case OMX_IndexParamPortDefinition: {
@@ -405,7 +812,7 @@ OMX_ERRORTYPE component::GetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE n
 			break;
 		}
 
-		*def = *(port_found->get_definition());
+		port_found->get_definition(def);
 
 		break;
 	}
@@ -689,6 +1096,10 @@ OMX_ERRORTYPE component::SetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE n
 
 	ptr = pComponentParameterStructure;
 
+	if (nParamIndex >= OMX_IndexVendorStartUnused) {
+		return set_vendor_parameter(nParamIndex, ptr);
+	}
+
 	//OpenMAX IL 1.2.0: 8.2 Mandatory Port Parameters
 	switch (nParamIndex) {
 	case OMX_IndexParamPortDefinition: {
@@ -919,6 +1330,10 @@ OMX_ERRORTYPE component::GetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nInd
 {
 	scoped_log_begin;
 
+	if (nIndex >= OMX_IndexVendorStartUnused) {
+		return get_vendor_config(nIndex, pComponentConfigStructure);
+	}
+
 	//do nothing
 
 	return OMX_ErrorNone;
@@ -928,6 +1343,10 @@ OMX_ERRORTYPE component::SetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nInd
 {
 	scoped_log_begin;
 
+	if (nIndex >= OMX_IndexVendorStartUnused) {
+		return set_vendor_config(nIndex, pComponentConfigStructure);
+	}
+
 	//do nothing
 
 	return OMX_ErrorNone;
@@ -936,10 +1355,36 @@ OMX_ERRORTYPE component::SetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nInd
 OMX_ERRORTYPE component::GetExtensionIndex(OMX_HANDLETYPE hComponent, OMX_STRING cParameterName, OMX_INDEXTYPE *pIndexType)
 {
 	scoped_log_begin;
+	//ベンダー拡張の名前とインデックスの対応表
+	static const struct {
+		const char *name;
+		OMX_U32 index;
+	} ext_indices[] = {
+		{ OMX_MF_INDEX_PARAM_TUNNEL_DIRECT, OMX_MF_IndexParamTunnelDirect },
+		{ OMX_MF_INDEX_PARAM_BATCH_DONE, OMX_MF_IndexParamBatchDone },
+		{ OMX_MF_INDEX_CONFIG_SUBMIT_BUFFERS, OMX_MF_IndexConfigSubmitBuffers },
+		{ OMX_MF_INDEX_PARAM_FLUSH_TIMEOUT, OMX_MF_IndexParamFlushTimeout },
+		{ OMX_MF_INDEX_PARAM_COMMAND_THREAD, OMX_MF_IndexParamCommandThread },
+		{ OMX_MF_INDEX_PARAM_WORKER_POOL, OMX_MF_IndexParamWorkerPool },
+		{ OMX_MF_INDEX_CONFIG_PORT_LATENCY, OMX_MF_IndexConfigPortLatency },
+	};
+
+	if (cParameterName == nullptr || pIndexType == nullptr) {
+		errprint("Invalid name:%p or index:%p.\n",
+			cParameterName, pIndexType);
+		return OMX_ErrorBadParameter;
+	}
 
-	//do nothing
+	for (auto& ext : ext_indices) {
+		if (strcmp(cParameterName, ext.name) == 0) {
+			*pIndexType = (OMX_INDEXTYPE)ext.index;
+			return OMX_ErrorNone;
+		}
+	}
 
-	return OMX_ErrorNone;
+	errprint("Unsupported extension:'%s'.\n", cParameterName);
+
+	return OMX_ErrorUnsupportedIndex;
 }
 
 OMX_ERRORTYPE component::GetState(OMX_HANDLETYPE hComponent, OMX_STATETYPE *pState)
@@ -1144,6 +1589,10 @@ OMX_ERRORTYPE component::ComponentRoleEnum(OMX_HANDLETYPE hComponent, OMX_U8 *cR
 OMX_ERRORTYPE component::EventHandler(OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
 {
 	scoped_log_begin;
+	static const trace_point tp = {
+		"EventHandler", "callback", "event", "data1", false,
+	};
+	scoped_trace tr(&tp, eEvent, nData1);
 	bool dump_all = false;
 	OMX_ERRORTYPE err;
 
@@ -1240,6 +1689,10 @@ OMX_ERRORTYPE component::EventHandler(OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_
 
 OMX_ERRORTYPE component::EmptyBufferDone(OMX_BUFFERHEADERTYPE *pBuffer)
 {
+	static const trace_point tp = {
+		"EmptyBufferDone", "callback", "port", "buffer", true,
+	};
+	scoped_trace tr(&tp, pBuffer->nInputPortIndex, (uintptr_t)pBuffer);
 	OMX_ERRORTYPE err;
 
 	err = omx_cbs.EmptyBufferDone(get_omx_component(),
@@ -1261,6 +1714,10 @@ OMX_ERRORTYPE component::EmptyBufferDone(port_buffer *pb)
 
 OMX_ERRORTYPE component::FillBufferDone(OMX_BUFFERHEADERTYPE *pBuffer)
 {
+	static const trace_point tp = {
+		"FillBufferDone", "callback", "port", "buffer", true,
+	};
+	scoped_trace tr(&tp, pBuffer->nOutputPortIndex, (uintptr_t)pBuffer);
 	OMX_ERRORTYPE err;
 
 	err = omx_cbs.FillBufferDone(get_omx_component(),
@@ -1280,6 +1737,20 @@ OMX_ERRORTYPE component::FillBufferDone(port_buffer *pb)
 	return FillBufferDone(pb->header);
 }
 
+OMX_ERRORTYPE component::BuffersDone(OMX_MF_BUFFERSDONE_FUNC func, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE **ppBuffers, OMX_U32 nBuffers)
+{
+	static const trace_point tp = {
+		"BuffersDone", "callback", "port", "count", false,
+	};
+	scoped_trace tr(&tp, nPortIndex, nBuffers);
+	OMX_ERRORTYPE err;
+
+	err = func(get_omx_component(), omx_cbs_priv,
+		nPortIndex, ppBuffers, nBuffers);
+
+	return err;
+}
+
 
 /*
  * protected functions (Maybe override by derived classes)
@@ -1299,6 +1770,348 @@ OMX_ERRORTYPE component::free_static_resouces()
 	return OMX_ErrorNone;
 }
 
+OMX_ERRORTYPE component::get_vendor_parameter(OMX_INDEXTYPE nParamIndex, OMX_PTR pComponentParameterStructure)
+{
+	scoped_log_begin;
+	void *ptr = pComponentParameterStructure;
+	port *port_found = nullptr;
+	OMX_ERRORTYPE err;
+
+	switch ((OMX_U32)nParamIndex) {
+	case OMX_MF_IndexParamTunnelDirect: {
+		OMX_MF_PARAM_TUNNELDIRECTTYPE *direct = static_cast<OMX_MF_PARAM_TUNNELDIRECTTYPE *>(ptr);
+
+		err = check_omx_header(direct, sizeof(OMX_MF_PARAM_TUNNELDIRECTTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		port_found = find_port(direct->nPortIndex);
+		if (port_found == nullptr) {
+			errprint("Invalid port:%d\n", (int)direct->nPortIndex);
+			err = OMX_ErrorBadPortIndex;
+			break;
+		}
+
+		direct->bEnabled = port_found->get_tunneled_direct();
+
+		break;
+	}
+	case OMX_MF_IndexParamBatchDone: {
+		OMX_MF_PARAM_BATCHDONETYPE *batch = static_cast<OMX_MF_PARAM_BATCHDONETYPE *>(ptr);
+
+		err = check_omx_header(batch, sizeof(OMX_MF_PARAM_BATCHDONETYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		port_found = find_port(batch->nPortIndex);
+		if (port_found == nullptr) {
+			errprint("Invalid port:%d\n", (int)batch->nPortIndex);
+			err = OMX_ErrorBadPortIndex;
+			break;
+		}
+
+		batch->bEnabled = port_found->get_batch_done();
+		batch->nMaxBatch = port_found->get_batch_done_max();
+		batch->nMaxDelayUs = port_found->get_batch_done_delay();
+		batch->pBuffersDone = port_found->get_batch_done_func();
+
+		break;
+	}
+	case OMX_MF_IndexParamFlushTimeout: {
+		OMX_MF_PARAM_FLUSHTIMEOUTTYPE *timeout = static_cast<OMX_MF_PARAM_FLUSHTIMEOUTTYPE *>(ptr);
+
+		err = check_omx_header(timeout, sizeof(OMX_MF_PARAM_FLUSHTIMEOUTTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		timeout->nTimeoutMs = get_flush_timeout();
+
+		break;
+	}
+	case OMX_MF_IndexParamCommandThread: {
+		OMX_MF_PARAM_COMMANDTHREADTYPE *cmdth = static_cast<OMX_MF_PARAM_COMMANDTHREADTYPE *>(ptr);
+
+		err = check_omx_header(cmdth, sizeof(OMX_MF_PARAM_COMMANDTHREADTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		cmdth->bDedicated = get_command_thread_dedicated();
+
+		break;
+	}
+	case OMX_MF_IndexParamWorkerPool: {
+		OMX_MF_PARAM_WORKERPOOLTYPE *pool = static_cast<OMX_MF_PARAM_WORKERPOOLTYPE *>(ptr);
+
+		err = check_omx_header(pool, sizeof(OMX_MF_PARAM_WORKERPOOLTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		pool->bEnabled = get_worker_pooled();
+		pool->nLane = get_worker_lane();
+
+		break;
+	}
+	default:
+		errprint("unsupported index:%d.\n", (int)nParamIndex);
+		err = OMX_ErrorUnsupportedIndex;
+		break;
+	}
+
+	return err;
+}
+
+OMX_ERRORTYPE component::set_vendor_parameter(OMX_INDEXTYPE nParamIndex, OMX_PTR pComponentParameterStructure)
+{
+	scoped_log_begin;
+	void *ptr = pComponentParameterStructure;
+	port *port_found = nullptr;
+	OMX_ERRORTYPE err;
+
+	switch ((OMX_U32)nParamIndex) {
+	case OMX_MF_IndexParamTunnelDirect: {
+		OMX_MF_PARAM_TUNNELDIRECTTYPE *direct = static_cast<OMX_MF_PARAM_TUNNELDIRECTTYPE *>(ptr);
+
+		err = check_omx_header(direct, sizeof(OMX_MF_PARAM_TUNNELDIRECTTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		port_found = find_port(direct->nPortIndex);
+		if (port_found == nullptr) {
+			errprint("Invalid port:%d\n", (int)direct->nPortIndex);
+			err = OMX_ErrorBadPortIndex;
+			break;
+		}
+
+		port_found->set_tunneled_direct(direct->bEnabled);
+
+		break;
+	}
+	case OMX_MF_IndexParamBatchDone: {
+		OMX_MF_PARAM_BATCHDONETYPE *batch = static_cast<OMX_MF_PARAM_BATCHDONETYPE *>(ptr);
+
+		err = check_omx_header(batch, sizeof(OMX_MF_PARAM_BATCHDONETYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		port_found = find_port(batch->nPortIndex);
+		if (port_found == nullptr) {
+			errprint("Invalid port:%d\n", (int)batch->nPortIndex);
+			err = OMX_ErrorBadPortIndex;
+			break;
+		}
+
+		//返却スレッドが動作中に変更しないよう、
+		//バッファが割り当てられていない時だけ変更可能とする
+		if (port_found->get_enabled() && get_state() != OMX_StateLoaded) {
+			errprint("Port %d is enabled and state is not Loaded.\n",
+				(int)batch->nPortIndex);
+			err = OMX_ErrorIncorrectStateOperation;
+			break;
+		}
+
+		if (batch->bEnabled) {
+			if (batch->nMaxBatch == 0 || batch->pBuffersDone == nullptr) {
+				errprint("Invalid max batch:%d or callback:%p.\n",
+					(int)batch->nMaxBatch, batch->pBuffersDone);
+				err = OMX_ErrorBadParameter;
+				break;
+			}
+			if (port_found->get_tunneled()) {
+				errprint("Port %d is tunneled.\n",
+					(int)batch->nPortIndex);
+				err = OMX_ErrorIncorrectStateOperation;
+				break;
+			}
+		}
+
+		port_found->set_batch_done_max(batch->nMaxBatch);
+		port_found->set_batch_done_delay(batch->nMaxDelayUs);
+		port_found->set_batch_done_func(batch->pBuffersDone);
+		port_found->set_batch_done(batch->bEnabled);
+
+		break;
+	}
+	case OMX_MF_IndexParamFlushTimeout: {
+		OMX_MF_PARAM_FLUSHTIMEOUTTYPE *timeout = static_cast<OMX_MF_PARAM_FLUSHTIMEOUTTYPE *>(ptr);
+
+		err = check_omx_header(timeout, sizeof(OMX_MF_PARAM_FLUSHTIMEOUTTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		set_flush_timeout(timeout->nTimeoutMs);
+
+		break;
+	}
+	case OMX_MF_IndexParamCommandThread: {
+		OMX_MF_PARAM_COMMANDTHREADTYPE *cmdth = static_cast<OMX_MF_PARAM_COMMANDTHREADTYPE *>(ptr);
+
+		err = check_omx_header(cmdth, sizeof(OMX_MF_PARAM_COMMANDTHREADTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		err = set_command_thread_dedicated(cmdth->bDedicated);
+
+		break;
+	}
+	case OMX_MF_IndexParamWorkerPool: {
+		OMX_MF_PARAM_WORKERPOOLTYPE *pool = static_cast<OMX_MF_PARAM_WORKERPOOLTYPE *>(ptr);
+
+		err = check_omx_header(pool, sizeof(OMX_MF_PARAM_WORKERPOOLTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		err = set_worker_pooled(pool->bEnabled, pool->nLane);
+
+		break;
+	}
+	default:
+		errprint("unsupported index:%d.\n", (int)nParamIndex);
+		err = OMX_ErrorUnsupportedIndex;
+		break;
+	}
+
+	return err;
+}
+
+OMX_ERRORTYPE component::get_vendor_config(OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure)
+{
+	scoped_log_begin;
+	void *ptr = pComponentConfigStructure;
+	port *port_found = nullptr;
+	OMX_ERRORTYPE err;
+
+	switch ((OMX_U32)nIndex) {
+	case OMX_MF_IndexConfigPortLatency: {
+		OMX_MF_CONFIG_PORTLATENCYTYPE *lat = static_cast<OMX_MF_CONFIG_PORTLATENCYTYPE *>(ptr);
+
+		err = check_omx_header(lat, sizeof(OMX_MF_CONFIG_PORTLATENCYTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		port_found = find_port(lat->nPortIndex);
+		if (port_found == nullptr) {
+			errprint("Invalid port:%d\n", (int)lat->nPortIndex);
+			err = OMX_ErrorBadPortIndex;
+			break;
+		}
+
+		port_found->get_latency(lat);
+
+		break;
+	}
+	default:
+		errprint("unsupported index:%d.\n", (int)nIndex);
+		err = OMX_ErrorUnsupportedIndex;
+		break;
+	}
+
+	return err;
+}
+
+OMX_ERRORTYPE component::set_vendor_config(OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure)
+{
+	scoped_log_begin;
+	void *ptr = pComponentConfigStructure;
+	port *port_found = nullptr;
+	OMX_ERRORTYPE err;
+
+	switch ((OMX_U32)nIndex) {
+	case OMX_MF_IndexConfigSubmitBuffers: {
+		OMX_MF_CONFIG_SUBMITBUFFERSTYPE *submit = static_cast<OMX_MF_CONFIG_SUBMITBUFFERSTYPE *>(ptr);
+
+		err = check_omx_header(submit, sizeof(OMX_MF_CONFIG_SUBMITBUFFERSTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		switch (get_state()) {
+		case OMX_StateIdle:
+		case OMX_StateExecuting:
+		case OMX_StatePause:
+			//OK
+			break;
+		default:
+			//NG
+			errprint("Invalid state:%s.\n",
+				omx_enum_name::get_OMX_STATETYPE_name(get_state()));
+			return OMX_ErrorInvalidState;
+		}
+
+		port_found = find_port(submit->nPortIndex);
+		if (port_found == nullptr) {
+			errprint("Invalid port:%d\n", (int)submit->nPortIndex);
+			err = OMX_ErrorBadPortIndex;
+			break;
+		}
+
+		switch (port_found->get_dir()) {
+		case OMX_DirInput:
+			err = port_found->empty_buffers(submit->ppBuffers, submit->nBuffers);
+			break;
+		case OMX_DirOutput:
+			err = port_found->fill_buffers(submit->ppBuffers, submit->nBuffers);
+			break;
+		default:
+			errprint("Unknown direction.\n");
+			err = OMX_ErrorBadPortIndex;
+			break;
+		}
+
+		break;
+	}
+	case OMX_MF_IndexConfigPortLatency: {
+		OMX_MF_CONFIG_PORTLATENCYTYPE *lat = static_cast<OMX_MF_CONFIG_PORTLATENCYTYPE *>(ptr);
+
+		err = check_omx_header(lat, sizeof(OMX_MF_CONFIG_PORTLATENCYTYPE));
+		if (err != OMX_ErrorNone) {
+			errprint("Invalid header.\n");
+			break;
+		}
+
+		port_found = find_port(lat->nPortIndex);
+		if (port_found == nullptr) {
+			errprint("Invalid port:%d\n", (int)lat->nPortIndex);
+			err = OMX_ErrorBadPortIndex;
+			break;
+		}
+
+		//統計を消去する、他のメンバは使わない
+		port_found->reset_latency();
+
+		break;
+	}
+	default:
+		errprint("unsupported index:%d.\n", (int)nIndex);
+		err = OMX_ErrorUnsupportedIndex;
+		break;
+	}
+
+	return err;
+}
+
 OMX_ERRORTYPE component::begin_flush(OMX_U32 port_index)
 {
 	scoped_log_begin;
@@ -1436,6 +2249,10 @@ bool component::unregister_worker_thread(component_worker *wr)
 
 	for (auto it = list_workers.begin(); it != list_workers.end(); it++) {
 		if (*it == wr) {
+			//待機しているスレッドを終了させる
+			wr->set_broken(true);
+			wr->join();
+
 			list_workers.erase(it);
 
 			return true;
@@ -1475,8 +2292,28 @@ void component::stop_all_worker_threads()
 	scoped_log_begin;
 
 	for (auto wr : list_workers) {
-		wr->set_running(false);
-		wr->join();
+		wr->stop();
+	}
+}
+
+void component::pause_all_worker_threads()
+{
+	scoped_log_begin;
+
+	for (auto wr : list_workers) {
+		wr->set_paused(true);
+	}
+	for (auto wr : list_workers) {
+		wr->wait_paused();
+	}
+}
+
+void component::resume_all_worker_threads()
+{
+	scoped_log_begin;
+
+	for (auto wr : list_workers) {
+		wr->set_paused(false);
 	}
 }
 
@@ -1494,8 +2331,26 @@ void *component::accept_command()
 {
 	scoped_log_begin;
 	OMX_MF_CMD cmd;
-	OMX_STATETYPE new_state;
-	OMX_U32 port_index;
+
+	while (1) {
+		//blocked read
+		bound_accept->read_fully(&cmd, 1);
+
+		process_command(cmd);
+	}
+
+	return nullptr;
+}
+
+void component::process_command(const OMX_MF_CMD& cmd)
+{
+	scoped_log_begin;
+	static const trace_point tp = {
+		"command", "command", "cmd", "param", false,
+	};
+	scoped_trace tr(&tp, cmd.cmd, cmd.param);
+	OMX_STATETYPE new_state;
+	OMX_U32 port_index;
 	//callback するかしないか
 	bool f_callback;
 	//EventHandler の引数
@@ -1503,100 +2358,245 @@ void *component::accept_command()
 	OMX_PTR event_data;
 	OMX_ERRORTYPE err, err_handler;
 
+	dprint("cmd:%s, param1:0x%08x, data:%p\n",
+		omx_enum_name::get_OMX_COMMANDTYPE_name(cmd.cmd),
+		(int)cmd.param, cmd.data);
+
+	OMX_MF_PROBE3(command_start, get_name(), (int)cmd.cmd, cmd.param);
+
+	//process command
+	err = OMX_ErrorNone;
+	err_handler = OMX_ErrorNone;
+	f_callback = true;
+
+	switch (cmd.cmd) {
+	case OMX_CommandStateSet:
+		new_state = (OMX_STATETYPE) cmd.param;
+		err = command_state_set(new_state);
+
+		data1 = OMX_CommandStateSet;
+		data2 = new_state;
+		event_data = nullptr;
+
+		break;
+	case OMX_CommandFlush:
+		port_index = cmd.param;
+		err = command_flush(port_index);
+
+		data1 = OMX_CommandFlush;
+		data2 = port_index;
+		event_data = nullptr;
+
+		//command_flush() had already called
+		//EventHandler() callback function.
+		f_callback = false;
+
+		break;
+	case OMX_CommandPortDisable:
+		port_index = cmd.param;
+		err = command_port_disable(port_index);
+
+		data1 = OMX_CommandPortDisable;
+		data2 = port_index;
+		event_data = nullptr;
+
+		break;
+	case OMX_CommandPortEnable:
+		port_index = cmd.param;
+		err = command_port_enable(port_index);
+
+		data1 = OMX_CommandPortEnable;
+		data2 = port_index;
+		event_data = nullptr;
+
+		break;
+	case OMX_CommandMarkBuffer:
+		port_index = cmd.param;
+		err = command_mark_buffer(port_index);
+
+		data1 = OMX_CommandMarkBuffer;
+		data2 = port_index;
+		event_data = nullptr;
+
+		break;
+	default:
+		errprint("unsupported index:%d.\n",
+			(int)cmd.cmd);
+		f_callback = false;
+		event_data = nullptr;
+
+		break;
+	}
+
+	//done/error event callback
+	if (f_callback && err == OMX_ErrorNone) {
+		//done
+		err_handler = EventHandler(OMX_EventCmdComplete,
+			data1, data2, event_data);
+	} else if (f_callback) {
+		//error
+		err_handler = EventHandler(OMX_EventError,
+			err, 0, nullptr);
+	}
+	if (err_handler != OMX_ErrorNone) {
+		errprint("event handler returns error: %s\n",
+			omx_enum_name::get_OMX_ERRORTYPE_name(err_handler));
+	}
+
+	OMX_MF_PROBE4(command_done, get_name(), (int)cmd.cmd, cmd.param, (int)err);
+
+	//まとめられたコマンドの完了を通知する
+	notify_absorbed_commands(cmd, err);
+}
+
+OMX_ERRORTYPE component::start_command_thread()
+{
+	scoped_log_begin;
+
+	if (f_cmd_dedicated) {
+		try {
+			th_accept = new std::thread(accept_command_thread_main, get_omx_component());
+		} catch (const std::bad_alloc& e) {
+			errprint("failed to create thread '%s'.\n", e.what());
+			return OMX_ErrorInsufficientResources;
+		} catch (const std::system_error& e) {
+			errprint("failed to create thread '%s'.\n", e.what());
+			return OMX_ErrorInsufficientResources;
+		}
+	}
+	f_cmd_started = true;
+
+	return OMX_ErrorNone;
+}
+
+void component::run_command_strand()
+{
+	scoped_log_begin;
+	OMX_MF_CMD cmd;
+
 	while (1) {
-		//blocked read
-		bound_accept->read_fully(&cmd, 1);
+		{
+			std::lock_guard<std::recursive_mutex> lk(bound_accept->mutex());
 
-		dprint("cmd:%s, param1:0x%08x, data:%p\n",
-			omx_enum_name::get_OMX_COMMANDTYPE_name(cmd.cmd),
-			(int)cmd.param, cmd.data);
+			//積まれたコマンドがなくなったら、スレッドを返す
+			if (f_cmd_closed || bound_accept->empty()) {
+				f_cmd_queued = false;
+				cond_cmd.notify_all();
+				return;
+			}
 
-		//process command
-		err = OMX_ErrorNone;
-		err_handler = OMX_ErrorNone;
-		f_callback = true;
+			bound_accept->read_array_with_lock(&cmd, 1);
+		}
 
-		switch (cmd.cmd) {
-		case OMX_CommandStateSet:
-			new_state = (OMX_STATETYPE) cmd.param;
-			err = command_state_set(new_state);
+		try {
+			process_command(cmd);
+		} catch (const mf::interrupted_error& e) {
+			infoprint("interrupted: %s\n", e.what());
+		} catch (const std::runtime_error& e) {
+			errprint("runtime_error: %s\n", e.what());
+		}
+	}
+}
+
+bool component::coalesce_command(OMX_MF_CMD *pending, const OMX_MF_CMD& cmd)
+{
+	if (pending->cmd != cmd.cmd ||
+		pending->n_absorbed >= OMX_MF_CMD_ABSORB_MAX) {
+		return false;
+	}
 
-			data1 = OMX_CommandStateSet;
-			data2 = new_state;
-			event_data = nullptr;
+	switch (cmd.cmd) {
+	case OMX_CommandStateSet:
+		//同じ状態への遷移は 1度だけ行う
+		if (pending->param != cmd.param) {
+			return false;
+		}
 
+		break;
+	case OMX_CommandFlush:
+		if (pending->param == OMX_ALL) {
+			//全ポートのフラッシュは後続のフラッシュを含む
 			break;
-		case OMX_CommandFlush:
-			port_index = cmd.param;
-			err = command_flush(port_index);
+		}
+		if (cmd.param == OMX_ALL) {
+			//全ポートのフラッシュに広げ、元のポートの完了通知を残す
+			pending->absorbed[pending->n_absorbed] = pending->param;
+			pending->n_absorbed++;
+			pending->param = OMX_ALL;
+
+			return true;
+		}
+		if (pending->param != cmd.param) {
+			return false;
+		}
 
-			data1 = OMX_CommandFlush;
-			data2 = port_index;
-			event_data = nullptr;
+		break;
+	default:
+		//まとめない
+		return false;
+	}
 
-			//command_flush() had already called
-			//EventHandler() callback function.
-			f_callback = false;
+	pending->absorbed[pending->n_absorbed] = cmd.param;
+	pending->n_absorbed++;
 
-			break;
-		case OMX_CommandPortDisable:
-			port_index = cmd.param;
-			err = command_port_disable(port_index);
+	return true;
+}
 
-			data1 = OMX_CommandPortDisable;
-			data2 = port_index;
-			event_data = nullptr;
+void component::notify_absorbed_commands(const OMX_MF_CMD& cmd, OMX_ERRORTYPE err)
+{
+	scoped_log_begin;
+	OMX_ERRORTYPE err_absorbed, err_handler;
+	OMX_U32 i;
 
-			break;
-		case OMX_CommandPortEnable:
-			port_index = cmd.param;
-			err = command_port_enable(port_index);
+	for (i = 0; i < cmd.n_absorbed; i++) {
+		err_handler = OMX_ErrorNone;
 
-			data1 = OMX_CommandPortEnable;
-			data2 = port_index;
-			event_data = nullptr;
+		switch (cmd.cmd) {
+		case OMX_CommandStateSet:
+			//遷移後に同じ状態を要求されたことになる
+			if (err == OMX_ErrorNone) {
+				err_absorbed = OMX_ErrorSameState;
+			} else {
+				err_absorbed = err;
+			}
+			err_handler = EventHandler(OMX_EventError,
+				err_absorbed, 0, nullptr);
+			OMX_MF_PROBE4(command_done, get_name(), (int)cmd.cmd,
+				cmd.param, (int)err_absorbed);
 
 			break;
-		case OMX_CommandMarkBuffer:
-			port_index = cmd.param;
-			err = command_mark_buffer(port_index);
-
-			data1 = OMX_CommandMarkBuffer;
-			data2 = port_index;
-			event_data = nullptr;
+		case OMX_CommandFlush:
+			//まとめたフラッシュが失敗すれば、同じエラーを通知する
+			if (err == OMX_ErrorNone) {
+				notify_flush_done(cmd.absorbed[i]);
+			} else {
+				err_handler = EventHandler(OMX_EventError,
+					err, 0, nullptr);
+			}
+			OMX_MF_PROBE4(command_done, get_name(), (int)cmd.cmd,
+				cmd.absorbed[i], (int)err);
 
 			break;
 		default:
 			errprint("unsupported index:%d.\n",
 				(int)cmd.cmd);
-			f_callback = false;
-			event_data = nullptr;
 
 			break;
 		}
-
-		//done/error event callback
-		if (f_callback && err == OMX_ErrorNone) {
-			//done
-			err_handler = EventHandler(OMX_EventCmdComplete,
-				data1, data2, event_data);
-		} else if (f_callback) {
-			//error
-			err_handler = EventHandler(OMX_EventError,
-				err_handler, 0, nullptr);
-		}
 		if (err_handler != OMX_ErrorNone) {
 			errprint("event handler returns error: %s\n",
 				omx_enum_name::get_OMX_ERRORTYPE_name(err_handler));
 		}
 	}
-
-	return nullptr;
 }
 
 OMX_ERRORTYPE component::command_state_set(OMX_STATETYPE new_state)
 {
 	scoped_log_begin;
+	static const trace_point tp = {
+		"state_set", "command", "from", "to", false,
+	};
+	scoped_trace tr(&tp, get_state(), new_state);
 	OMX_ERRORTYPE err;
 
 	dprint("state:%s -> %s\n",
@@ -1689,27 +2689,42 @@ OMX_ERRORTYPE component::command_state_set_to_loaded_from_idle()
 	}
 
 	//Free buffers on all ports
-	for (auto it = map_ports.begin(); it != map_ports.end(); it++) {
-		if (!it->second.get_enabled()) {
+	//供給側のポートが先にバッファを解放してから、他のポートを待つ
+	for (port *p : list_ports) {
+		if (!p->get_enabled()) {
 			//Disabled port, skip
 			continue;
 		}
 
-		if (it->second.get_tunneled() && it->second.get_tunneled_supplier()) {
+		if (p->get_tunneled() && p->get_tunneled_supplier()) {
 			//Tunneled and Supplier port
 			//Free buffers for tunneled port
-			errtmp = it->second.free_tunnel_buffers();
+			errtmp = p->free_tunnel_buffers();
 			if (errtmp != OMX_ErrorNone) {
 				errprint("Failed to free_tunnel_buffers().\n");
 				err = errtmp;
 			}
-		} else {
-			//Other
-			//Wait for all enabled port to be "no buffer"
-			it->second.wait_no_buffer(OMX_TRUE);
 		}
 	}
 
+	scoped_blocking blocking;
+
+	for (port *p : list_ports) {
+		if (!p->get_enabled()) {
+			//Disabled port, skip
+			continue;
+		}
+
+		if (p->get_tunneled() && p->get_tunneled_supplier()) {
+			//Tunneled and Supplier port, already freed
+			continue;
+		}
+
+		//Other
+		//Wait for all enabled port to be "no buffer"
+		p->wait_no_buffer(OMX_TRUE);
+	}
+
 	return err;
 }
 
@@ -1744,6 +2759,17 @@ OMX_ERRORTYPE component::command_state_set_to_idle()
 			err = OMX_ErrorInsufficientResources;
 		}
 		break;
+	case OMX_StatePause:
+		try {
+			err = command_state_set_to_idle_from_pause();
+		} catch (const mf::interrupted_error& e) {
+			infoprint("interrupted: %s\n", e.what());
+			err = OMX_ErrorInsufficientResources;
+		} catch (const std::runtime_error& e) {
+			errprint("runtime_error: %s\n", e.what());
+			err = OMX_ErrorInsufficientResources;
+		}
+		break;
 	default:
 		errprint("Invalid state:%s.\n",
 			omx_enum_name::get_OMX_STATETYPE_name(get_state()));
@@ -1763,36 +2789,49 @@ OMX_ERRORTYPE component::command_state_set_to_idle_from_loaded()
 	scoped_log_begin;
 	OMX_ERRORTYPE err, errtmp;
 
+	//供給側のポートが先にバッファを確保する、
+	//利用側のポートを先に待つと、このコンポーネントが供給する
+	//トンネル接続先も待ち続けるため、パイプライン全体が止まる
 	err = OMX_ErrorNone;
-	for (auto it = map_ports.begin(); it != map_ports.end(); it++) {
-		if (!it->second.get_enabled()) {
+	for (port *p : list_ports) {
+		if (!p->get_enabled()) {
 			//Disabled port, skip
 			continue;
 		}
 
-		if (it->second.get_tunneled() && it->second.get_tunneled_supplier()) {
+		if (p->get_tunneled() && p->get_tunneled_supplier()) {
 			//Tunneled and Supplier port
 			//Allocate buffers for tunneled port
-			errtmp = it->second.allocate_tunnel_buffers();
+			errtmp = p->allocate_tunnel_buffers();
 			if (errtmp != OMX_ErrorNone) {
 				errprint("Failed to allocate_tunnel_buffer().\n");
 				err = errtmp;
 			}
-		} else if (it->second.get_tunneled() && !it->second.get_tunneled_supplier()) {
-			//Tunneled and User port
-			//Notify to accept OMX_UseBuffer() calls
-			//FIXME: not implemented
-			err = OMX_ErrorNone;//OMX_ErrorNotImplemented;
-		} else {
-			//Other
-			//Wait for all enabled port to be populated
-			it->second.wait_populated(OMX_TRUE);
 		}
 	}
 	if (err != OMX_ErrorNone) {
 		return err;
 	}
 
+	scoped_blocking blocking;
+
+	for (port *p : list_ports) {
+		if (!p->get_enabled()) {
+			//Disabled port, skip
+			continue;
+		}
+
+		if (p->get_tunneled() && p->get_tunneled_supplier()) {
+			//Tunneled and Supplier port, already populated
+			continue;
+		}
+
+		//Tunneled and User port, or Other
+		//Wait for all enabled port to be populated by
+		//OMX_UseBuffer() calls from supplier or client
+		p->wait_populated(OMX_TRUE);
+	}
+
 	//Allocate static resources of component
 	err = allocate_static_resouces();
 	if (err != OMX_ErrorNone) {
@@ -1845,6 +2884,19 @@ OMX_ERRORTYPE component::command_state_set_to_idle_from_executing()
 	return err;
 }
 
+OMX_ERRORTYPE component::command_state_set_to_idle_from_pause()
+{
+	scoped_log_begin;
+	OMX_ERRORTYPE err;
+
+	//一時停止中のワーカースレッドはフラッシュ要求で待機を解除する
+	err = command_state_set_to_idle_from_executing();
+
+	resume_all_worker_threads();
+
+	return err;
+}
+
 OMX_ERRORTYPE component::command_state_set_to_executing()
 {
 	scoped_log_begin;
@@ -1857,6 +2909,17 @@ OMX_ERRORTYPE component::command_state_set_to_executing()
 	case OMX_StateExecuting:
 		err = OMX_ErrorSameState;
 		break;
+	case OMX_StatePause:
+		try {
+			err = command_state_set_to_executing_from_pause();
+		} catch (const mf::interrupted_error& e) {
+			infoprint("interrupted: %s\n", e.what());
+			err = OMX_ErrorInsufficientResources;
+		} catch (const std::runtime_error& e) {
+			errprint("runtime_error: %s\n", e.what());
+			err = OMX_ErrorInsufficientResources;
+		}
+		break;
 	default:
 		errprint("Invalid state:%s.\n",
 			omx_enum_name::get_OMX_STATETYPE_name(get_state()));
@@ -1899,22 +2962,27 @@ OMX_ERRORTYPE component::command_state_set_to_executing_from_idle()
 		err = errtmp;
 	}
 
-	//トンネル接続している相手ポートに、全バッファの処理を要求する
-	for (auto it = map_ports.begin(); it != map_ports.end(); it++) {
-		if (!it->second.get_enabled() ||
-			!it->second.get_tunneled() ||
-			!it->second.get_tunneled_supplier()) {
-			continue;
-		}
+	errtmp = start_tunneling_all_ports();
+	if (errtmp != OMX_ErrorNone) {
+		err = errtmp;
+	}
 
-		errtmp = it->second.start_tunneling();
-		if (errtmp != OMX_ErrorNone) {
-			errprint("Failed to start_tunneling() in port:%d.\n",
-				(int)it->second.get_port_index());
-			err = errtmp;
-		}
+	return err;
+}
+
+OMX_ERRORTYPE component::command_state_set_to_executing_from_pause()
+{
+	scoped_log_begin;
+	OMX_ERRORTYPE err;
+
+	//ポートを先に開けておき、ワーカースレッドは 1度の通知で再開させる
+	err = plug_component_all_ports(false);
+	if (err != OMX_ErrorNone) {
+		errprint("Failed to plug_component_all_ports(false).\n");
 	}
 
+	resume_all_worker_threads();
+
 	return err;
 }
 
@@ -1925,11 +2993,27 @@ OMX_ERRORTYPE component::command_state_set_to_pause()
 
 	switch (get_state()) {
 	case OMX_StateIdle:
-		//err = command_state_set_to_pause_from_idle();
-		//break;
+		try {
+			err = command_state_set_to_pause_from_idle();
+		} catch (const mf::interrupted_error& e) {
+			infoprint("interrupted: %s\n", e.what());
+			err = OMX_ErrorInsufficientResources;
+		} catch (const std::runtime_error& e) {
+			errprint("runtime_error: %s\n", e.what());
+			err = OMX_ErrorInsufficientResources;
+		}
+		break;
 	case OMX_StateExecuting:
-		//err = command_state_set_to_pause_from_executing();
-		//break;
+		try {
+			err = command_state_set_to_pause_from_executing();
+		} catch (const mf::interrupted_error& e) {
+			infoprint("interrupted: %s\n", e.what());
+			err = OMX_ErrorInsufficientResources;
+		} catch (const std::runtime_error& e) {
+			errprint("runtime_error: %s\n", e.what());
+			err = OMX_ErrorInsufficientResources;
+		}
+		break;
 	case OMX_StatePause:
 		err = OMX_ErrorSameState;
 		break;
@@ -1948,74 +3032,221 @@ OMX_ERRORTYPE component::command_state_set_to_pause()
 	return err;
 }
 
-OMX_ERRORTYPE component::command_state_set_to_wait_for_resources()
+OMX_ERRORTYPE component::command_state_set_to_pause_from_idle()
 {
 	scoped_log_begin;
+	OMX_ERRORTYPE err, errtmp;
 
-	set_state(OMX_StateWaitForResources);
-
-	return OMX_ErrorNone;
-}
+	if (!is_pause_supported()) {
+		errprint("Workers do not support pause.\n");
+		return OMX_ErrorIncorrectStateTransition;
+	}
 
-OMX_ERRORTYPE component::command_flush(OMX_U32 port_index)
-{
-	scoped_log_begin;
-	std::deque<OMX_U32> ev_results;
-	bool success = true;
-	OMX_ERRORTYPE err = OMX_ErrorNone, err_handler = OMX_ErrorNone;
+	//ワーカースレッドは開始直後に accept_flush で待機する
+	for (auto wr : list_workers) {
+		wr->set_paused(true);
+	}
 
 	try {
-		//Flush all ports
-		err = execute_flush(port_index,
-			[&](OMX_U32 ind) -> OMX_ERRORTYPE {
-				return begin_flush(ind);
-			},
-			[&](OMX_U32 ind) -> OMX_ERRORTYPE {
-				return end_flush(ind);
-			});
-		if (err != OMX_ErrorNone) {
-			errprint("Failed to execute_flush(port:%d)\n",
-				(int)port_index);
-			success = false;
-		}
-
-		//Wait for all buffer returned to supplier
-		wait_port_buffer_returned(port_index);
-
-		//Restart all ports and component
-		err = execute_restart(port_index,
-			[&](OMX_U32 ind) -> OMX_ERRORTYPE {
-				return begin_restart(ind);
-			},
-			[&](OMX_U32 ind) -> OMX_ERRORTYPE {
-				return end_restart(ind);
-			});
-		if (err != OMX_ErrorNone) {
-			errprint("Failed to execute_restart(component, port:%d)\n",
-				(int)port_index);
-			success = false;
-		}
+		//Start all workers
+		start_all_worker_threads();
+	} catch (const std::bad_alloc& e) {
+		errprint("Failed to create main thread '%s'.\n", e.what());
+		return OMX_ErrorInsufficientResources;
+	}
+
+	//ワーカースレッドがバッファを取り出せないよう、ポートを塞いでから開始する
+	err = OMX_ErrorNone;
+	errtmp = execute_restart(OMX_ALL,
+		[&](OMX_U32 ind) -> OMX_ERRORTYPE {
+			OMX_ERRORTYPE e;
 
-		for (auto it = map_ports.begin(); it != map_ports.end(); it++) {
-			if (!it->second.get_enabled()) {
-				continue;
+			e = plug_component_all_ports(true);
+			if (e != OMX_ErrorNone) {
+				errprint("Failed to plug_component_all_ports(true).\n");
+				return e;
 			}
-			ev_results.push_back(it->first);
-		}
-	} catch (const mf::interrupted_error& e) {
-		infoprint("interrupted: %s\n", e.what());
-		err = OMX_ErrorInsufficientResources;
-		success = false;
-	} catch (const std::runtime_error& e) {
-		errprint("runtime_error: %s\n", e.what());
-		err = OMX_ErrorInsufficientResources;
-		success = false;
+
+			return begin_restart(ind);
+		},
+		[&](OMX_U32 ind) -> OMX_ERRORTYPE {
+			return end_restart(ind);
+		});
+	if (errtmp != OMX_ErrorNone) {
+		errprint("Failed to execute_restart(idle->pause, port:all)\n");
+		err = errtmp;
+	}
+
+	//相手ポートからバッファが届く前に、ワーカースレッドを待機させる
+	pause_all_worker_threads();
+
+	errtmp = start_tunneling_all_ports();
+	if (errtmp != OMX_ErrorNone) {
+		err = errtmp;
+	}
+
+	return err;
+}
+
+OMX_ERRORTYPE component::command_state_set_to_pause_from_executing()
+{
+	scoped_log_begin;
+	OMX_ERRORTYPE err;
+
+	if (!is_pause_supported()) {
+		errprint("Workers do not support pause.\n");
+		return OMX_ErrorIncorrectStateTransition;
+	}
+
+	//pop_buffer の待機を解除して、ワーカースレッドを安全な位置で止める
+	//保持しているバッファは返却しない
+	//NOTE: 待機を解除されたワーカースレッドが一時停止の要求を見つけられるよう、
+	//      ポートを塞ぐ前に要求する
+	for (auto wr : list_workers) {
+		wr->set_paused(true);
+	}
+
+	err = plug_component_all_ports(true);
+	if (err != OMX_ErrorNone) {
+		errprint("Failed to plug_component_all_ports(true).\n");
+	}
+
+	pause_all_worker_threads();
+
+	return err;
+}
+
+OMX_ERRORTYPE component::command_state_set_to_wait_for_resources()
+{
+	scoped_log_begin;
+
+	set_state(OMX_StateWaitForResources);
+
+	return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE component::command_flush(OMX_U32 port_index)
+{
+	scoped_log_begin;
+	static const trace_point tp_light = {
+		"flush:light", "flush", "port", nullptr, false,
+	};
+	static const trace_point tp_flush = {
+		"flush:flush", "flush", "port", nullptr, false,
+	};
+	static const trace_point tp_wait = {
+		"flush:wait_returned", "flush", "port", nullptr, false,
+	};
+	static const trace_point tp_restart = {
+		"flush:restart", "flush", "port", nullptr, false,
+	};
+	bool success = true, f_light;
+	OMX_ERRORTYPE err = OMX_ErrorNone, err_handler = OMX_ErrorNone;
+	OMX_ERRORTYPE err_flush = OMX_ErrorNone;
+
+	f_light = is_light_flush_supported();
+
+	try {
+		if (f_light) {
+			scoped_trace tr(&tp_light, (OMX_S32)port_index, 0);
+
+			//Flush ports without leaving worker's main loop
+			err = execute_light_flush(port_index);
+			if (err != OMX_ErrorNone) {
+				errprint("Failed to execute_light_flush(port:%d)\n",
+					(int)port_index);
+				if (success) {
+					err_flush = err;
+				}
+				success = false;
+			}
+		} else {
+			//Flush all ports
+			//NOTE: 期限を過ぎるまでは、保持されているバッファを強制的に返却しない
+			{
+				scoped_trace tr(&tp_flush, (OMX_S32)port_index, 0);
+
+				err = execute_flush_queued(port_index,
+					[&](OMX_U32 ind) -> OMX_ERRORTYPE {
+						return begin_flush(ind);
+					},
+					[&](OMX_U32 ind) -> OMX_ERRORTYPE {
+						return end_flush(ind);
+					});
+			}
+			if (err != OMX_ErrorNone) {
+				errprint("Failed to execute_flush_queued(port:%d)\n",
+					(int)port_index);
+				if (success) {
+					err_flush = err;
+				}
+				success = false;
+			}
+
+			//Wait for all buffer returned to supplier
+			//返却が済んだポートから順にクライアントへ戻し、完了を通知する
+			{
+				scoped_trace tr(&tp_wait, (OMX_S32)port_index, 0);
+
+				err = wait_port_buffer_returned_for(port_index,
+					[&](port *p) {
+						OMX_ERRORTYPE errport;
+
+						errport = p->unplug_client_request();
+						if (errport != OMX_ErrorNone) {
+							errprint("Failed to port unplug_client_request(%d), "
+								"err:0x%08x(%s).\n",
+								(int)p->get_port_index(), (int)errport,
+								omx_enum_name::get_OMX_ERRORTYPE_name(errport));
+						}
+
+						notify_flush_done(p->get_port_index());
+					});
+			}
+			if (err != OMX_ErrorNone) {
+				errprint("Failed to wait_port_buffer_returned_for(port:%d)\n",
+					(int)port_index);
+				if (success) {
+					err_flush = err;
+				}
+				success = false;
+			}
+
+			//Restart all ports and component
+			{
+				scoped_trace tr(&tp_restart, (OMX_S32)port_index, 0);
+
+				err = execute_restart(port_index,
+					[&](OMX_U32 ind) -> OMX_ERRORTYPE {
+						return begin_restart(ind);
+					},
+					[&](OMX_U32 ind) -> OMX_ERRORTYPE {
+						return end_restart(ind);
+					});
+			}
+			if (err != OMX_ErrorNone) {
+				errprint("Failed to execute_restart(component, port:%d)\n",
+					(int)port_index);
+				if (success) {
+					err_flush = err;
+				}
+				success = false;
+			}
+		}
+	} catch (const mf::interrupted_error& e) {
+		infoprint("interrupted: %s\n", e.what());
+		err_flush = OMX_ErrorInsufficientResources;
+		success = false;
+	} catch (const std::runtime_error& e) {
+		errprint("runtime_error: %s\n", e.what());
+		err_flush = OMX_ErrorInsufficientResources;
+		success = false;
 	}
 
 	if (!success) {
 		//Callback EventHandler(EventError)
 		err_handler = EventHandler(OMX_EventError,
-			err, 0, nullptr);
+			err_flush, 0, nullptr);
 		if (err_handler != OMX_ErrorNone) {
 			errprint("event handler(error) returns err:%d(%s)\n",
 				(int)err_handler,
@@ -2023,18 +3254,34 @@ OMX_ERRORTYPE component::command_flush(OMX_U32 port_index)
 		}
 	}
 
-	//Callback EventHandler(CmdComplete)
-	for (OMX_U32 ind : ev_results) {
+	//エラーは通知済みだが、まとめたフラッシュにも通知するため返す
+	return err_flush;
+}
+
+void component::notify_flush_done(OMX_U32 port_index)
+{
+	scoped_log_begin;
+	port_range filtered_ports;
+	OMX_ERRORTYPE err, err_handler;
+
+	err = filter_ports(port_index, &filtered_ports);
+	if (err != OMX_ErrorNone) {
+		return;
+	}
+
+	for (port *p : filtered_ports) {
+		if (!p->get_enabled()) {
+			continue;
+		}
+
 		err_handler = EventHandler(OMX_EventCmdComplete,
-			OMX_CommandFlush, ind, nullptr);
+			OMX_CommandFlush, p->get_port_index(), nullptr);
 		if (err_handler != OMX_ErrorNone) {
 			errprint("event handler(port:%d, complete) returns err:%d(%s)\n",
-				(int)ind, (int)err_handler,
+				(int)p->get_port_index(), (int)err_handler,
 				omx_enum_name::get_OMX_ERRORTYPE_name(err_handler));
 		}
 	}
-
-	return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE component::command_port_disable(OMX_U32 port_index)
@@ -2062,7 +3309,44 @@ OMX_ERRORTYPE component::execute_flush(OMX_U32 port_index,
 	std::function<OMX_ERRORTYPE(OMX_U32)> func_request_flush, std::function<OMX_ERRORTYPE(OMX_U32)> func_wait_flush_done)
 {
 	scoped_log_begin;
-	std::vector<port *> filtered_ports;
+	port_range filtered_ports;
+	OMX_ERRORTYPE err, errtmp;
+
+	//Filter
+	errtmp = filter_ports(port_index, &filtered_ports);
+	if (errtmp != OMX_ErrorNone) {
+		errprint("Invalid or disabled all ports.\n");
+		return errtmp;
+	}
+
+	//Execute flush sequence
+	err = execute_flush_queued(port_index,
+		func_request_flush, func_wait_flush_done);
+
+	//Return all unprocessed buffers by component
+	for (port *p : filtered_ports) {
+		if (!p->get_enabled()) {
+			continue;
+		}
+
+		errtmp = p->return_buffers_force();
+		if (errtmp != OMX_ErrorNone) {
+			errprint("Failed to port return_buffers_force(%d), "
+				"err:0x%08x(%s).\n",
+				(int)port_index, (int)errtmp,
+				omx_enum_name::get_OMX_ERRORTYPE_name(errtmp));
+			err = errtmp;
+		}
+	}
+
+	return err;
+}
+
+OMX_ERRORTYPE component::execute_flush_queued(OMX_U32 port_index,
+	std::function<OMX_ERRORTYPE(OMX_U32)> func_request_flush, std::function<OMX_ERRORTYPE(OMX_U32)> func_wait_flush_done)
+{
+	scoped_log_begin;
+	port_range filtered_ports;
 	OMX_ERRORTYPE err, errtmp;
 
 	//Filter
@@ -2124,15 +3408,16 @@ OMX_ERRORTYPE component::execute_flush(OMX_U32 port_index,
 		err = errtmp;
 	}
 
-	//Return all unprocessed buffers by component
+	//Return buffers not popped by component
+	//NOTE: ワーカースレッドが保持していたバッファは強制的に返却しない
 	for (port *p : filtered_ports) {
 		if (!p->get_enabled()) {
 			continue;
 		}
 
-		errtmp = p->return_buffers_force();
+		errtmp = p->return_queued_buffers();
 		if (errtmp != OMX_ErrorNone) {
-			errprint("Failed to port return_buffers_force(%d), "
+			errprint("Failed to port return_queued_buffers(%d), "
 				"err:0x%08x(%s).\n",
 				(int)port_index, (int)errtmp,
 				omx_enum_name::get_OMX_ERRORTYPE_name(errtmp));
@@ -2147,7 +3432,7 @@ OMX_ERRORTYPE component::execute_restart(OMX_U32 port_index,
 	std::function<OMX_ERRORTYPE(OMX_U32)> func_request_restart, std::function<OMX_ERRORTYPE(OMX_U32)> func_wait_restart_done)
 {
 	scoped_log_begin;
-	std::vector<port *> filtered_ports;
+	port_range filtered_ports;
 	OMX_ERRORTYPE err, errtmp;
 
 	//Filter
@@ -2211,32 +3496,280 @@ OMX_ERRORTYPE component::execute_restart(OMX_U32 port_index,
 	return err;
 }
 
-bool component::insert_port(port& p)
+bool component::is_light_flush_supported() const
 {
-	std::pair<component::portmap_t::iterator, bool> ret;
+	for (auto wr : list_workers) {
+		if (!wr->is_light_flush_supported()) {
+			return false;
+		}
+	}
 
-	ret = map_ports.insert(component::portmap_t::value_type(p.get_port_index(), p));
+	return true;
+}
+
+bool component::is_pause_supported() const
+{
+	for (auto wr : list_workers) {
+		if (!wr->is_pause_supported()) {
+			return false;
+		}
+	}
 
-	return ret.second;
+	return true;
 }
 
-bool component::erase_port(OMX_U32 index)
+OMX_ERRORTYPE component::start_tunneling_all_ports()
 {
-	size_t ret;
+	scoped_log_begin;
+	OMX_ERRORTYPE err, errtmp;
+
+	//トンネル接続している相手ポートに、全バッファの処理を要求する
+	err = OMX_ErrorNone;
+	for (port *p : list_ports) {
+		if (!p->get_enabled() ||
+			!p->get_tunneled() ||
+			!p->get_tunneled_supplier()) {
+			continue;
+		}
 
-	ret = map_ports.erase(index);
+		errtmp = p->start_tunneling();
+		if (errtmp != OMX_ErrorNone) {
+			errprint("Failed to start_tunneling() in port:%d.\n",
+				(int)p->get_port_index());
+			err = errtmp;
+		}
+	}
 
-	return (ret != 0);
+	return err;
 }
 
-const component::portmap_t& component::get_map_ports() const
+OMX_ERRORTYPE component::plug_component_all_ports(bool f)
 {
-	return map_ports;
+	scoped_log_begin;
+	OMX_ERRORTYPE err, errtmp;
+
+	err = OMX_ErrorNone;
+	for (port *p : list_ports) {
+		if (!p->get_enabled()) {
+			continue;
+		}
+
+		if (f) {
+			errtmp = p->plug_component_request();
+		} else {
+			errtmp = p->unplug_component_request();
+		}
+		if (errtmp != OMX_ErrorNone) {
+			errprint("Failed to port (un)plug_component_request(%d), "
+				"err:0x%08x(%s).\n",
+				(int)p->get_port_index(), (int)errtmp,
+				omx_enum_name::get_OMX_ERRORTYPE_name(errtmp));
+			err = errtmp;
+		}
+	}
+
+	return err;
+}
+
+OMX_ERRORTYPE component::execute_light_flush(OMX_U32 port_index)
+{
+	scoped_log_begin;
+	port_range filtered_ports, all_ports;
+	OMX_ERRORTYPE err, errtmp;
+
+	//Filter
+	errtmp = filter_ports(port_index, &filtered_ports);
+	if (errtmp != OMX_ErrorNone) {
+		errprint("Invalid or disabled all ports.\n");
+		return errtmp;
+	}
+	errtmp = filter_ports(OMX_ALL, &all_ports);
+	if (errtmp != OMX_ErrorNone) {
+		errprint("Invalid or disabled all ports.\n");
+		return errtmp;
+	}
+
+	//Execute flush sequence
+	err = OMX_ErrorNone;
+
+	for (port *p : filtered_ports) {
+		if (!p->get_enabled()) {
+			continue;
+		}
+
+		errtmp = p->plug_client_request();
+		if (errtmp != OMX_ErrorNone) {
+			errprint("Failed to port plug_client_request(%d), "
+				"err:0x%08x(%s).\n",
+				(int)port_index, (int)errtmp,
+				omx_enum_name::get_OMX_ERRORTYPE_name(errtmp));
+			err = errtmp;
+		}
+	}
+
+	for (auto wr : list_workers) {
+		wr->begin_light_flush(port_index);
+	}
+
+	//ワーカースレッドはフラッシュしないポートで待っている可能性があるため、
+	//全てのポートの待機を解除する
+	for (port *p : all_ports) {
+		if (!p->get_enabled()) {
+			continue;
+		}
+
+		errtmp = p->plug_component_request();
+		if (errtmp != OMX_ErrorNone) {
+			errprint("Failed to port plug_component_request(%d), "
+				"err:0x%08x(%s).\n",
+				(int)p->get_port_index(), (int)errtmp,
+				omx_enum_name::get_OMX_ERRORTYPE_name(errtmp));
+			err = errtmp;
+		}
+	}
+
+	for (port *p : filtered_ports) {
+		if (!p->get_enabled()) {
+			continue;
+		}
+
+		errtmp = p->return_queued_buffers();
+		if (errtmp != OMX_ErrorNone) {
+			errprint("Failed to port return_queued_buffers(%d), "
+				"err:0x%08x(%s).\n",
+				(int)port_index, (int)errtmp,
+				omx_enum_name::get_OMX_ERRORTYPE_name(errtmp));
+			err = errtmp;
+		}
+	}
+
+	//Wait for buffers held by workers
+	//返却が済んだポートから順にクライアントへ戻し、完了を通知する
+	errtmp = wait_port_buffer_returned_for(port_index,
+		[&](port *p) {
+			OMX_ERRORTYPE errport;
+
+			errport = p->unplug_client_request();
+			if (errport != OMX_ErrorNone) {
+				errprint("Failed to port unplug_client_request(%d), "
+					"err:0x%08x(%s).\n",
+					(int)p->get_port_index(), (int)errport,
+					omx_enum_name::get_OMX_ERRORTYPE_name(errport));
+				err = errport;
+			}
+
+			notify_flush_done(p->get_port_index());
+		});
+	if (errtmp != OMX_ErrorNone) {
+		errprint("Failed to wait_port_buffer_returned_for(%d), "
+			"err:0x%08x(%s).\n",
+			(int)port_index, (int)errtmp,
+			omx_enum_name::get_OMX_ERRORTYPE_name(errtmp));
+		err = errtmp;
+	}
+
+	//Restart
+	//NOTE: 一時停止中はワーカースレッドを待機させたままにするため、
+	//      ポートのバッファ取り出しは禁止したままにする
+	for (port *p : all_ports) {
+		if (!p->get_enabled() || get_state() == OMX_StatePause) {
+			continue;
+		}
+
+		errtmp = p->unplug_component_request();
+		if (errtmp != OMX_ErrorNone) {
+			errprint("Failed to port unplug_component_request(%d), "
+				"err:0x%08x(%s).\n",
+				(int)p->get_port_index(), (int)errtmp,
+				omx_enum_name::get_OMX_ERRORTYPE_name(errtmp));
+			err = errtmp;
+		}
+	}
+
+	for (auto wr : list_workers) {
+		wr->end_light_flush();
+	}
+
+	return err;
+}
+
+void component::update_port_table()
+{
+	OMX_U32 span;
+
+	table_ports.clear();
+	port_base = 0;
+	if (list_ports.empty()) {
+		return;
+	}
+
+	//ポート番号は通常連続しているため、番号をそのまま添字に使う
+	//極端に離れた番号を持つ場合は表を作らず、二分探索する
+	port_base = list_ports.front()->get_port_index();
+	span = list_ports.back()->get_port_index() - port_base + 1;
+	if (span > list_ports.size() * 4 + OMX_MF_PORT_TABLE_SLACK) {
+		return;
+	}
+
+	table_ports.assign(span, nullptr);
+	for (port *p : list_ports) {
+		table_ports[p->get_port_index() - port_base] = p;
+	}
+}
+
+port *component::find_port_slow(OMX_U32 index) const
+{
+	auto it = std::lower_bound(list_ports.begin(), list_ports.end(),
+		index, [](const port *p, OMX_U32 ind) {
+			return p->get_port_index() < ind;
+		});
+	if (it == list_ports.end() || (*it)->get_port_index() != index) {
+		//not found
+		return nullptr;
+	}
+
+	return *it;
+}
+
+bool component::insert_port(port& p)
+{
+	OMX_U32 index = p.get_port_index();
+
+	auto it = std::lower_bound(list_ports.begin(), list_ports.end(),
+		index, [](const port *q, OMX_U32 ind) {
+			return q->get_port_index() < ind;
+		});
+	if (it != list_ports.end() && (*it)->get_port_index() == index) {
+		//already exists
+		return false;
+	}
+
+	list_ports.insert(it, &p);
+	update_port_table();
+
+	return true;
+}
+
+bool component::erase_port(OMX_U32 index)
+{
+	auto it = std::find_if(list_ports.begin(), list_ports.end(),
+		[&](const port *q) {
+			return q->get_port_index() == index;
+		});
+	if (it == list_ports.end()) {
+		//not found
+		return false;
+	}
+
+	list_ports.erase(it);
+	update_port_table();
+
+	return true;
 }
 
-component::portmap_t& component::get_map_ports()
+const component::portlist_t& component::get_port_list() const
 {
-	return map_ports;
+	return list_ports;
 }
 
 OMX_ERRORTYPE component::check_omx_header(const void *p, size_t size) const
@@ -16,16 +16,25 @@
 #include <omxil_mf/scoped_log.hpp>
 
 #include "api/consts.hpp"
+#include "component/worker_pool.hpp"
 #include "util/util.hpp"
 #include "util/omx_enum_name.hpp"
 
 namespace mf {
 
+//ワーカースレッドで実行しているワーカー
+static thread_local component_worker *current_worker = nullptr;
+
 component_worker::component_worker(component *c)
 	: comp(c), th_work(nullptr),
-	f_running(false), f_broken(false),
+	f_running(false), f_parked(true), f_broken(false),
 	f_request_flush(false), f_flush_done(false),
-	f_request_restart(false), f_restart_done(false)
+	f_request_restart(false), f_restart_done(false),
+	f_light_flush(false), light_flush_port(OMX_ALL),
+	cnt_light_flush(0), cnt_light_flush_accepted(0),
+	f_paused(false), f_pause_parked(false),
+	f_pooled(false), lane(0), task_state(TASK_IDLE), f_in_step(false),
+	f_in_run(false)
 {
 	scoped_log_begin;
 	//Do nothing
@@ -76,6 +85,21 @@ void component_worker::set_running(bool f)
 
 	f_running = f;
 	cond.notify_all();
+	schedule();
+}
+
+bool component_worker::is_parked() const
+{
+	return f_parked;
+}
+
+void component_worker::set_parked(bool f)
+{
+	scoped_log_begin;
+	std::lock_guard<std::mutex> lock(mut);
+
+	f_parked = f;
+	cond.notify_all();
 }
 
 bool component_worker::is_broken() const
@@ -104,6 +128,7 @@ void component_worker::set_request_flush(bool f)
 
 	f_request_flush = f;
 	cond.notify_all();
+	schedule();
 }
 
 bool component_worker::is_flush_done() const
@@ -132,6 +157,7 @@ void component_worker::set_request_restart(bool f)
 
 	f_request_restart = f;
 	cond.notify_all();
+	schedule();
 }
 
 bool component_worker::is_restart_done() const
@@ -196,13 +222,269 @@ void component_worker::wait_restart_done()
 	error_if_broken(lock);
 }
 
+bool component_worker::is_light_flush_supported() const
+{
+	return false;
+}
+
+void component_worker::begin_light_flush(OMX_U32 port_index)
+{
+	scoped_log_begin;
+	std::lock_guard<std::mutex> lock(mut);
+
+	f_light_flush = true;
+	light_flush_port = port_index;
+	cnt_light_flush++;
+	cond.notify_all();
+	schedule();
+}
+
+void component_worker::end_light_flush()
+{
+	scoped_log_begin;
+	std::lock_guard<std::mutex> lock(mut);
+
+	f_light_flush = false;
+	cond.notify_all();
+	schedule();
+}
+
+bool component_worker::is_pause_supported() const
+{
+	return true;
+}
+
+bool component_worker::is_paused() const
+{
+	return f_paused;
+}
+
+void component_worker::set_paused(bool f)
+{
+	scoped_log_begin;
+	std::lock_guard<std::mutex> lock(mut);
+
+	f_paused = f;
+	cond.notify_all();
+	schedule();
+}
+
+void component_worker::wait_paused()
+{
+	scoped_log_begin;
+	std::unique_lock<std::mutex> lock(mut);
+
+	//メイン処理を実行していなければ、バッファを処理しないため待たない
+	cond.wait(lock, [&]() {
+			return is_broken() || !is_running() || !is_paused() ||
+				f_pause_parked || (!f_in_run && !f_in_step);
+		});
+	error_if_broken(lock);
+}
+
+bool component_worker::is_request_accept_flush() const
+{
+	return cnt_light_flush != cnt_light_flush_accepted || f_paused;
+}
+
+bool component_worker::accept_flush()
+{
+	OMX_U32 port_index;
+
+	//要求がなければロックを取らずに返る
+	if (!is_request_accept_flush()) {
+		return false;
+	}
+
+	scoped_log_begin;
+	std::unique_lock<std::mutex> lock(mut);
+
+	//フラッシュ中、一時停止中はここで待ち、
+	//待っている間に次のフラッシュが要求されたら、続けて処理する
+	while (is_running() && !is_request_flush()) {
+		if (cnt_light_flush != cnt_light_flush_accepted) {
+			cnt_light_flush_accepted = cnt_light_flush;
+			port_index = light_flush_port;
+
+			//バッファの返却はロックを外して行う
+			lock.unlock();
+			handle_flush(port_index);
+			lock.lock();
+			continue;
+		}
+		if (!f_light_flush && !is_paused()) {
+			break;
+		}
+
+		if (is_paused() && !f_pause_parked) {
+			f_pause_parked = true;
+			cond.notify_all();
+		}
+
+		cond.wait(lock, [&]() {
+				return is_broken() || !is_running() ||
+					is_request_flush() ||
+					(!f_light_flush && !is_paused()) ||
+					cnt_light_flush != cnt_light_flush_accepted;
+			});
+		error_if_broken(lock);
+	}
+	f_pause_parked = false;
+
+	return true;
+}
+
+component_worker *component_worker::get_current()
+{
+	return current_worker;
+}
+
+void component_worker::handle_flush(OMX_U32 port_index)
+{
+	scoped_log_begin;
+	//Do nothing
+}
+
+bool component_worker::is_step_supported() const
+{
+	return false;
+}
+
+bool component_worker::is_pooled() const
+{
+	return f_pooled;
+}
+
+void component_worker::set_pooled(bool f)
+{
+	scoped_log_begin;
+
+	//待機しているスレッドがあれば終了させる
+	if (f && th_work != nullptr) {
+		set_broken(true);
+		join();
+		set_broken(false);
+	}
+
+	std::lock_guard<std::mutex> lock(mut);
+
+	f_pooled = f;
+}
+
+int component_worker::get_lane() const
+{
+	return lane;
+}
+
+void component_worker::set_lane(int l)
+{
+	scoped_log_begin;
+	std::lock_guard<std::mutex> lock(mut);
+
+	lane = l;
+}
+
+void component_worker::schedule()
+{
+	int st;
+
+	if (!f_pooled || f_broken) {
+		return;
+	}
+
+	st = task_state.load();
+	while (1) {
+		switch (st) {
+		case TASK_IDLE:
+			if (!task_state.compare_exchange_weak(st, TASK_QUEUED)) {
+				continue;
+			}
+			if (!worker_pool::get_instance()->post([this] { run_task(); }, lane)) {
+				errprint("failed to post worker %s.\n", get_name());
+
+				std::lock_guard<std::mutex> lock(mut);
+
+				task_state = TASK_IDLE;
+				cond.notify_all();
+			}
+			return;
+		case TASK_RUNNING:
+			if (!task_state.compare_exchange_weak(st, TASK_RESCHEDULED)) {
+				continue;
+			}
+			return;
+		default:
+			//投入済み、または実行後に再度実行する予定
+			return;
+		}
+	}
+}
+
+void component_worker::begin_step()
+{
+	scoped_log_begin;
+	//Do nothing
+}
+
+bool component_worker::run_step()
+{
+	scoped_log_begin;
+
+	return false;
+}
+
+void component_worker::wait_running()
+{
+	scoped_log_begin;
+	std::unique_lock<std::mutex> lock(mut);
+
+	cond.wait(lock, [&]() {
+			return is_broken() || is_running();
+		});
+	error_if_broken(lock);
+	f_parked = false;
+}
+
 void component_worker::start()
 {
-	th_work = new std::thread(component_worker_thread_main, this);
+	//ワーカープールで実行する場合はスレッドを持たない
+	if (f_pooled) {
+		schedule();
+		return;
+	}
+
+	//待機しているスレッドは set_running(true) で再開する
+	if (th_work == nullptr) {
+		th_work = new std::thread(component_worker_thread_main, this);
+	}
+}
+
+void component_worker::stop()
+{
+	scoped_log_begin;
+
+	set_running(false);
+
+	std::unique_lock<std::mutex> lock(mut);
+
+	cond.wait(lock, [&]() {
+			return is_broken() || is_parked() ||
+				(th_work == nullptr && !f_pooled);
+		});
 }
 
 void component_worker::join()
 {
+	//ワーカープールで実行中、あるいは投入済みの処理が終わるまで待つ
+	//NOTE: set_broken(true) の後は新たに投入されない
+	{
+		std::unique_lock<std::mutex> lock(mut);
+
+		cond.wait(lock, [&]() {
+				return task_state == TASK_IDLE;
+			});
+	}
+
 	if (th_work) {
 		th_work->join();
 	}
@@ -233,6 +515,131 @@ void component_worker::error_if_broken(std::unique_lock<std::mutex>& lock) const
 }
 
 
+void component_worker::run_task()
+{
+	int st, n;
+
+	task_state = TASK_RUNNING;
+
+	while (1) {
+		for (n = 0; n < OMX_MF_WORKER_POOL_BUDGET; n++) {
+			if (!drive_step()) {
+				break;
+			}
+		}
+
+		if (n == OMX_MF_WORKER_POOL_BUDGET) {
+			//処理が続いていても、同じレーンの他のワーカーに譲る
+			task_state = TASK_QUEUED;
+			if (worker_pool::get_instance()->post([this] { run_task(); }, lane)) {
+				return;
+			}
+			task_state = TASK_RUNNING;
+			continue;
+		}
+
+		//join() が待っているため、ロックを取ってから未投入に戻す
+		//NOTE: 戻った後は this に触れない、join() の後に破棄されうる
+		{
+			std::lock_guard<std::mutex> lock(mut);
+
+			st = TASK_RUNNING;
+			if (task_state.compare_exchange_strong(st, TASK_IDLE)) {
+				cond.notify_all();
+				return;
+			}
+		}
+
+		//実行中にバッファが届いたか、要求が変わったため、もう一度処理する
+		task_state = TASK_RUNNING;
+	}
+}
+
+bool component_worker::drive_step()
+{
+	std::unique_lock<std::mutex> lock(mut);
+	OMX_U32 port_index;
+
+	if (is_broken()) {
+		return false;
+	}
+
+	//component_worker_thread_main() の wait_running() に相当する
+	if (!is_running()) {
+		f_in_step = false;
+		if (!f_parked) {
+			f_parked = true;
+			cond.notify_all();
+		}
+		return false;
+	}
+	f_parked = false;
+
+	//wait_request_restart() に相当する
+	if (!f_in_step) {
+		if (!is_request_restart()) {
+			return false;
+		}
+		f_request_restart = false;
+		f_restart_done = true;
+		f_in_step = true;
+		cond.notify_all();
+
+		lock.unlock();
+		begin_step();
+
+		return true;
+	}
+
+	//run() から戻ったときに相当する
+	if (is_request_flush()) {
+		f_in_step = false;
+		f_request_flush = false;
+		f_flush_done = true;
+		cond.notify_all();
+
+		return true;
+	}
+
+	//accept_flush() に相当するが、待たずに戻る
+	if (cnt_light_flush != cnt_light_flush_accepted) {
+		cnt_light_flush_accepted = cnt_light_flush;
+		port_index = light_flush_port;
+
+		//バッファの返却はロックを外して行う
+		lock.unlock();
+		handle_flush(port_index);
+
+		return true;
+	}
+	if (f_light_flush) {
+		return false;
+	}
+	if (is_paused()) {
+		if (!f_pause_parked) {
+			f_pause_parked = true;
+			cond.notify_all();
+		}
+		return false;
+	}
+	f_pause_parked = false;
+
+	lock.unlock();
+
+	try {
+		return run_step();
+	} catch (const mf::interrupted_error& e) {
+		infoprint("interrupted: worker %s: %s\n",
+			get_name(), e.what());
+	} catch (const std::runtime_error& e) {
+		errprint("runtime_error: worker %s: %s\n",
+			get_name(), e.what());
+	}
+
+	return false;
+}
+
+
 /*
  * static protected functions
  */
@@ -245,26 +652,48 @@ void *component_worker::component_worker_thread_main(component_worker *arg)
 	thname = "omx:wrk:";
 	thname += arg->get_name();
 	set_thread_name(thname.c_str());
+	current_worker = arg;
 
 	try {
-		while (arg->is_running()) {
-			arg->wait_request_restart();
-			if (!arg->is_running()) {
-				break;
-			}
-			arg->set_restart_done(true);
-
-			try {
-				arg->run();
-			} catch (const mf::interrupted_error& e) {
-				infoprint("interrupted: worker %s: %s\n",
-					arg->get_name(), e.what());
-			} catch (const std::runtime_error& e) {
-				errprint("runtime_error: worker %s: %s\n",
-					arg->get_name(), e.what());
+		//コンポーネントが破棄されるまでスレッドを保持し、
+		//実行中でなければ待機させる
+		while (1) {
+			arg->wait_running();
+
+			while (arg->is_running()) {
+				arg->wait_request_restart();
+				if (!arg->is_running()) {
+					break;
+				}
+				//wait_paused() が待機を見逃さないよう、
+				//リスタートの完了より先に設定する
+				{
+					std::lock_guard<std::mutex> lock(arg->mut);
+
+					arg->f_in_run = true;
+				}
+				arg->set_restart_done(true);
+
+				try {
+					arg->run();
+				} catch (const mf::interrupted_error& e) {
+					infoprint("interrupted: worker %s: %s\n",
+						arg->get_name(), e.what());
+				} catch (const std::runtime_error& e) {
+					errprint("runtime_error: worker %s: %s\n",
+						arg->get_name(), e.what());
+				}
+				{
+					std::lock_guard<std::mutex> lock(arg->mut);
+
+					arg->f_in_run = false;
+					arg->cond.notify_all();
+				}
+				arg->set_request_flush(false);
+				arg->set_flush_done(true);
 			}
-			arg->set_request_flush(false);
-			arg->set_flush_done(true);
+
+			arg->set_parked(true);
 		}
 	} catch (const mf::interrupted_error& e) {
 		infoprint("interrupted: worker %s: %s\n",
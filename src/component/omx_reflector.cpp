@@ -85,6 +85,21 @@ const std::string& omx_reflector::get_component_name() const
 }
 
 
+/*
+ * static public functions
+ */
+bool omx_reflector::is_reflector(OMX_HANDLETYPE hComponent)
+{
+	OMX_COMPONENTTYPE *omx_comp = (OMX_COMPONENTTYPE *) hComponent;
+
+	if (omx_comp == nullptr || omx_comp->pComponentPrivate == nullptr) {
+		return false;
+	}
+
+	return omx_comp->EmptyThisBuffer == comp_EmptyThisBuffer;
+}
+
+
 /* 
  * static protected functions
  */
@@ -3,12 +3,17 @@
 
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <chrono>
 
 #include <omxil_mf/component.hpp>
 #include <omxil_mf/port.hpp>
 #include <omxil_mf/scoped_log.hpp>
 
 #include "api/consts.hpp"
+#include "component/port_latency.hpp"
+#include "debug/probe.hpp"
+#include "debug/trace.hpp"
 #include "util/util.hpp"
 #include "util/omx_enum_name.hpp"
 
@@ -17,7 +22,8 @@
 namespace mf {
 
 port::port(int ind, component *c)
-	: definition(), port_index(ind), dir(OMX_DirMax),
+	: seq_def(0), mut_def(), depth_def(0),
+	port_index(ind), dir(OMX_DirMax),
 	buffer_count_actual(0), buffer_count_min(0), buffer_size(0),
 	f_enabled(OMX_TRUE), f_populated(OMX_FALSE),
 	domain(OMX_PortDomainMax),
@@ -26,10 +32,14 @@ port::port(int ind, component *c)
 	f_no_buffer(OMX_TRUE),
 	f_tunneled(OMX_FALSE), tunneled_comp(nullptr),
 	tunneled_port(0), f_tunneled_supplier(OMX_FALSE),
+	tunneled_peer(nullptr), f_tunneled_direct(OMX_TRUE),
+	f_batch_done(OMX_FALSE), batch_done_max(1),
+	batch_done_delay(0), batch_done_func(nullptr),
 	default_format(-1),
 	ring_send(nullptr), bound_send(nullptr),
 	ring_ret(nullptr), bound_ret(nullptr), th_ret(nullptr),
-	cnt_send_wr(0), cnt_recv_rd(0)
+	cnt_send_wr(0), cnt_recv_rd(0), cnt_direct(0), cnt_wait_returned(0),
+	cnt_wait_returned_comp(0), latency(nullptr)
 {
 	scoped_log_begin;
 
@@ -44,6 +54,9 @@ port::port(int ind, component *c)
 		ring_ret  = new portbuf_ring_t(vec_ret.begin(), vec_ret.capacity());
 		bound_ret = new portbuf_bound_t(*ring_ret);
 
+		//statistics of latency
+		latency = new port_latency();
+
 		//start returning OpenMAX buffers thread
 		th_ret = new std::thread(buffer_done_thread_main, this);
 	} catch (const std::bad_alloc& e) {
@@ -52,6 +65,9 @@ port::port(int ind, component *c)
 		delete th_ret;
 		th_ret = nullptr;
 
+		delete latency;
+		latency = nullptr;
+
 		delete bound_ret;
 		bound_ret = nullptr;
 		delete ring_ret;
@@ -70,24 +86,11 @@ port::~port()
 {
 	scoped_log_begin;
 
-	shutdown(true, true);
-
-	//shutdown returning OpenMAX buffers thread
-	if (bound_ret) {
-		bound_ret->shutdown();
-		notify_buffer_count();
-	}
-	if (th_ret) {
-		th_ret->join();
-	}
-
-	//shutdown sending OpenMAX buffers thread
-	if (bound_send) {
-		bound_send->shutdown();
-		notify_buffer_count();
-	}
+	shutdown_threads();
+	join_threads();
 
 	delete th_ret;
+	delete latency;
 	delete bound_ret;
 	delete ring_ret;
 	delete bound_send;
@@ -110,6 +113,8 @@ OMX_U32 port::get_port_index() const
 
 void port::set_port_index(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	port_index = v;
 }
 
@@ -120,6 +125,8 @@ OMX_DIRTYPE port::get_dir() const
 
 void port::set_dir(OMX_DIRTYPE v)
 {
+	definition_writer wr(this);
+
 	dir = v;
 }
 
@@ -130,6 +137,8 @@ OMX_U32 port::get_buffer_count_actual() const
 
 void port::set_buffer_count_actual(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	buffer_count_actual = v;
 }
 
@@ -140,6 +149,8 @@ OMX_U32 port::get_buffer_count_min() const
 
 void port::set_buffer_count_min(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	buffer_count_min = v;
 }
 
@@ -150,6 +161,8 @@ OMX_U32 port::get_buffer_size() const
 
 void port::set_buffer_size(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	buffer_size = v;
 }
 
@@ -161,6 +174,7 @@ OMX_BOOL port::get_enabled() const
 void port::set_enabled(OMX_BOOL v)
 {
 	std::lock_guard<std::recursive_mutex> lk_port(mut);
+	definition_writer wr(this);
 
 	f_enabled = v;
 	cond.notify_all();
@@ -176,7 +190,14 @@ void port::set_populated(OMX_BOOL v)
 	scoped_log_begin;
 	std::lock_guard<std::recursive_mutex> lk_port(mut);
 
-	f_populated = v;
+	if (f_populated == v) {
+		return;
+	}
+	{
+		definition_writer wr(this);
+
+		f_populated = v;
+	}
 	cond.notify_all();
 }
 
@@ -196,6 +217,8 @@ OMX_PORTDOMAINTYPE port::get_domain() const
 
 void port::set_domain(OMX_PORTDOMAINTYPE v)
 {
+	definition_writer wr(this);
+
 	domain = v;
 }
 
@@ -206,6 +229,8 @@ OMX_BOOL port::get_buffers_contiguous() const
 
 void port::set_buffers_contiguous(OMX_BOOL v)
 {
+	definition_writer wr(this);
+
 	buffers_contiguous = v;
 }
 
@@ -216,6 +241,8 @@ OMX_U32 port::get_buffer_alignment() const
 
 void port::set_buffer_alignment(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	buffer_alignment = v;
 }
 
@@ -248,6 +275,32 @@ void port::shutdown(bool rd, bool wr)
 	cond.notify_all();
 }
 
+void port::shutdown_threads()
+{
+	scoped_log_begin;
+
+	shutdown(true, true);
+
+	//shutdown returning OpenMAX buffers thread
+	if (bound_ret) {
+		bound_ret->shutdown();
+	}
+
+	//shutdown sending OpenMAX buffers thread
+	if (bound_send) {
+		bound_send->shutdown();
+	}
+}
+
+void port::join_threads()
+{
+	scoped_log_begin;
+
+	if (th_ret && th_ret->joinable()) {
+		th_ret->join();
+	}
+}
+
 void port::abort_shutdown(bool rd, bool wr)
 {
 	scoped_log_begin;
@@ -282,6 +335,9 @@ void port::set_no_buffer(OMX_BOOL v)
 	scoped_log_begin;
 	std::lock_guard<std::recursive_mutex> lk_port(mut);
 
+	if (f_no_buffer == v) {
+		return;
+	}
 	f_no_buffer = v;
 	cond.notify_all();
 }
@@ -298,6 +354,9 @@ void port::wait_no_buffer(OMX_BOOL v) const
 void port::update_buffer_status()
 {
 	if (list_bufs.size() >= buffer_count_actual) {
+		//トンネル接続時は nBufferCountActual より多くのバッファが
+		//登録されることがあるため、登録された数に合わせる
+		resize_buffer_rings(list_bufs.size());
 		set_populated(OMX_TRUE);
 	} else {
 		set_populated(OMX_FALSE);
@@ -310,28 +369,47 @@ void port::update_buffer_status()
 	}
 }
 
+void port::get_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const
+{
+	uint32_t words[N_DEF_WORDS];
+	uint32_t seq;
+	size_t i;
+
+	while (true) {
+		seq = seq_def.load(std::memory_order_acquire);
+		if (seq == 0) {
+			//まだ一度も公開されていない
+			std::lock_guard<std::recursive_mutex> lk_def(mut_def);
+
+			if (seq_def.load(std::memory_order_relaxed) == 0) {
+				publish_definition();
+			}
+			continue;
+		}
+		if (seq & 1) {
+			//公開中
+			std::this_thread::yield();
+			continue;
+		}
+
+		for (i = 0; i < N_DEF_WORDS; i++) {
+			words[i] = snap_def[i].load(std::memory_order_relaxed);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq_def.load(std::memory_order_relaxed) == seq) {
+			break;
+		}
+	}
+
+	memcpy(def, words, sizeof(*def));
+}
+
 const OMX_PARAM_PORTDEFINITIONTYPE *port::get_definition() const
 {
-	scoped_log_begin;
+	static thread_local OMX_PARAM_PORTDEFINITIONTYPE definition;
 
-	memset(&definition, 0, sizeof(definition));
-
-	definition.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
-	definition.nVersion.s.nVersionMajor = OMX_MF_IL_MAJOR;
-	definition.nVersion.s.nVersionMinor = OMX_MF_IL_MINOR;
-	definition.nVersion.s.nRevision     = OMX_MF_IL_REVISION;
-	definition.nVersion.s.nStep         = OMX_MF_IL_STEP;
-	definition.nPortIndex         = port_index;
-	definition.eDir               = dir;
-	definition.nBufferCountActual = buffer_count_actual;
-	definition.nBufferCountMin    = buffer_count_min;
-	definition.nBufferSize        = buffer_size;
-	definition.bEnabled           = f_enabled;
-	definition.bPopulated         = f_populated;
-	definition.eDomain            = domain;
-	//definition.format is not set
-	definition.bBuffersContiguous = buffers_contiguous;
-	definition.nBufferAlignment   = buffer_alignment;
+	get_definition(&definition);
 
 	return &definition;
 }
@@ -339,6 +417,7 @@ const OMX_PARAM_PORTDEFINITIONTYPE *port::get_definition() const
 OMX_ERRORTYPE port::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 
 	dir                 = v.eDir;
 	buffer_count_actual = v.nBufferCountActual;
@@ -358,6 +437,15 @@ OMX_ERRORTYPE port::set_definition_from_client(const OMX_PARAM_PORTDEFINITIONTYP
 {
 	scoped_log_begin;
 
+	definition_writer wr(this);
+	OMX_ERRORTYPE err;
+
+	//バッファの受け渡し中に深さを変えることはできない
+	err = resize_buffer_rings(v.nBufferCountActual);
+	if (err != OMX_ErrorNone) {
+		return err;
+	}
+
 	//nBufferCountActual 以外は全て read-only
 	buffer_count_actual = v.nBufferCountActual;
 	//definition.format is ignored
@@ -405,8 +493,118 @@ void port::set_tunneled_supplier(OMX_BOOL v)
 	f_tunneled_supplier = v;
 }
 
+port *port::get_tunneled_peer() const
+{
+	return tunneled_peer;
+}
+
+void port::set_tunneled_peer(port *v)
+{
+	tunneled_peer = v;
+}
+
+OMX_BOOL port::get_tunneled_direct() const
+{
+	return f_tunneled_direct;
+}
+
+void port::set_tunneled_direct(OMX_BOOL v)
+{
+	f_tunneled_direct = v;
+}
+
+OMX_BOOL port::get_batch_done() const
+{
+	return f_batch_done;
+}
+
+void port::set_batch_done(OMX_BOOL v)
+{
+	f_batch_done = v;
+}
+
+OMX_U32 port::get_batch_done_max() const
+{
+	return batch_done_max;
+}
+
+void port::set_batch_done_max(OMX_U32 v)
+{
+	batch_done_max = v;
+}
+
+OMX_U32 port::get_batch_done_delay() const
+{
+	return batch_done_delay;
+}
+
+void port::set_batch_done_delay(OMX_U32 v)
+{
+	batch_done_delay = v;
+}
+
+OMX_MF_BUFFERSDONE_FUNC port::get_batch_done_func() const
+{
+	return batch_done_func;
+}
+
+void port::set_batch_done_func(OMX_MF_BUFFERSDONE_FUNC v)
+{
+	batch_done_func = v;
+}
+
+void port::get_latency(OMX_MF_CONFIG_PORTLATENCYTYPE *conf) const
+{
+	latency->get_stats(conf);
+}
+
+void port::reset_latency()
+{
+	latency->reset();
+}
+
+OMX_ERRORTYPE port::reset(const OMX_PARAM_PORTDEFINITIONTYPE& def)
+{
+	scoped_log_begin;
+	OMX_ERRORTYPE err;
+
+	if (!get_no_buffer()) {
+		errprint("Port %d still has buffers.\n", (int)get_port_index());
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	//format とバッファ数はクライアントからの設定と同じ経路で戻す
+	err = set_definition_from_client(def);
+	if (err != OMX_ErrorNone) {
+		return err;
+	}
+	err = set_definition(def);
+	if (err != OMX_ErrorNone) {
+		return err;
+	}
+
+	set_tunneled(OMX_FALSE);
+	set_tunneled_component(nullptr);
+	set_tunneled_port(0);
+	set_tunneled_supplier(OMX_FALSE);
+	set_tunneled_peer(nullptr);
+	set_tunneled_direct(OMX_TRUE);
+
+	set_batch_done(OMX_FALSE);
+	set_batch_done_max(1);
+	set_batch_done_delay(0);
+	set_batch_done_func(nullptr);
+
+	//前のクライアントの統計を残さない
+	reset_latency();
+
+	return OMX_ErrorNone;
+}
+
 OMX_ERRORTYPE port::add_port_format(const port_format& f)
 {
+	definition_writer wr(this);
+
 	formats.push_back(f);
 
 	return OMX_ErrorNone;
@@ -485,7 +683,11 @@ OMX_ERRORTYPE port::set_default_format(size_t index)
 		return OMX_ErrorBadParameter;
 	}
 
-	default_format = index;
+	{
+		definition_writer wr(this);
+
+		default_format = index;
+	}
 
 	return OMX_ErrorNone;
 }
@@ -573,6 +775,13 @@ OMX_ERRORTYPE port::unplug_client_request()
 	return OMX_ErrorNone;
 }
 
+bool port::is_plugged_client_request() const
+{
+	std::lock_guard<std::recursive_mutex> lk_send(bound_send->mutex());
+
+	return is_shutting_write() || bound_send->is_shutting_write_with_lock();
+}
+
 OMX_ERRORTYPE port::plug_component_request()
 {
 	scoped_log_begin;
@@ -606,14 +815,16 @@ OMX_ERRORTYPE port::unplug_component_request()
 	bound_send->abort_shutdown(true, false);
 	cond.notify_all();
 
+	//ワーカープールで実行するワーカーは、許可されたら取り出しを再開する
+	get_component()->schedule_pooled_workers();
+
 	return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE port::return_buffers_force()
 {
 	scoped_log_begin;
-	std::lock_guard<std::recursive_mutex> lk_port(mut);
-	std::vector<port_buffer> list_held_copy = list_held_bufs;
+	std::vector<port_buffer> list_held_copy;
 
 	if (!get_enabled()) {
 		errprint("Port %d is disabled.\n",
@@ -625,14 +836,48 @@ OMX_ERRORTYPE port::return_buffers_force()
 	//NOTE: flush メソッドとコンポーネントが同時に動作すると、
 	//      同一のバッファが 2回返却される可能性があるため、
 	//      返却前にコンポーネント側の動作を確実に止める必要があります。
+	{
+		std::lock_guard<std::recursive_mutex> lk_buf(mut_list_bufs);
+
+		list_held_copy.swap(list_held_bufs);
+	}
 	for (port_buffer pb_held : list_held_copy) {
-		remove_held_buffer(&pb_held);
 		pb_held.header->nFilledLen = 0;
 		bound_ret->write_fully(&pb_held, 1);
 	}
 
 	bound_send->clear();
-	notify_buffer_count();
+
+	return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE port::return_queued_buffers()
+{
+	scoped_log_begin;
+	std::vector<port_buffer> list_queued;
+
+	if (!get_enabled()) {
+		errprint("Port %d is disabled.\n",
+			(int)get_port_index());
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	//取り出しと同じロックの下で読み出すため、
+	//コンポーネントが取り出したバッファと重複することはない
+	{
+		std::lock_guard<std::recursive_mutex> lk_send(bound_send->mutex());
+
+		list_queued.resize(bound_send->size());
+		if (!list_queued.empty()) {
+			bound_send->read_array_with_lock(&list_queued[0],
+				list_queued.size());
+		}
+	}
+	for (port_buffer pb_queued : list_queued) {
+		remove_held_buffer(&pb_queued);
+		pb_queued.header->nFilledLen = 0;
+		bound_ret->write_fully(&pb_queued, 1);
+	}
 
 	return OMX_ErrorNone;
 }
@@ -642,11 +887,35 @@ void port::wait_buffer_returned() const
 	scoped_log_begin;
 	std::unique_lock<std::recursive_mutex> lk_port(mut);
 
-	cond.wait(lk_port, [&] { return is_broken() ||
-		cnt_send_wr == cnt_recv_rd; });
+	//待機中であることを示してから条件を調べる、
+	//notify_buffer_count はこの数が 0 ならばロックを取らない
+	cnt_wait_returned++;
+	cond.wait(lk_port, [&] { return is_broken() || is_buffer_returned(); });
+	cnt_wait_returned--;
 	error_if_broken(lk_port);
 }
 
+uint64_t port::get_unreturned_buffer_count() const
+{
+	uint64_t done;
+
+	//送出数は返却数より先に増えるため、返却数から先に読む
+	done = cnt_recv_rd.load(std::memory_order_acquire) +
+		cnt_direct.load(std::memory_order_acquire);
+
+	return cnt_send_wr.load(std::memory_order_acquire) - done;
+}
+
+void port::add_returned_waiter() const
+{
+	cnt_wait_returned_comp++;
+}
+
+void port::remove_returned_waiter() const
+{
+	cnt_wait_returned_comp--;
+}
+
 OMX_ERRORTYPE port::component_tunnel_request(OMX_HANDLETYPE omx_comp, OMX_U32 index, OMX_TUNNELSETUPTYPE *setup)
 {
 	scoped_log_begin;
@@ -659,6 +928,7 @@ OMX_ERRORTYPE port::component_tunnel_request(OMX_HANDLETYPE omx_comp, OMX_U32 in
 		set_tunneled_component(nullptr);
 		set_tunneled_port(0);
 		set_tunneled_supplier(OMX_FALSE);
+		set_tunneled_peer(nullptr);
 
 		return OMX_ErrorNone;
 	}
@@ -717,6 +987,14 @@ OMX_ERRORTYPE port::component_tunnel_request(OMX_HANDLETYPE omx_comp, OMX_U32 in
 		return OMX_ErrorPortsNotCompatible;
 	}
 
+	//同じプロセスの OpenMAX MF コンポーネントならば、
+	//バッファを直接受け渡せるように接続先のポートを覚えておく
+	if (omx_reflector::is_reflector(omx_comp)) {
+		set_tunneled_peer(component::get_instance(omx_comp)->find_port(index));
+	} else {
+		set_tunneled_peer(nullptr);
+	}
+
 	return OMX_ErrorNone;
 }
 
@@ -870,6 +1148,7 @@ OMX_ERRORTYPE port::allocate_tunnel_buffers()
 			pb->f_allocate  = true;
 			pb->header      = header;
 			pb->index       = 0;
+			pb->slot        = assign_buffer_slot();
 
 			//Set information for myself
 			switch (get_dir()) {
@@ -916,6 +1195,7 @@ OMX_ERRORTYPE port::free_tunnel_buffers()
 {
 	scoped_log_begin;
 	OMX_BUFFERHEADERTYPE *header;
+	OMX_U8 *backbuf;
 	OMX_ERRORTYPE err;
 
 	if (!get_enabled()) {
@@ -932,6 +1212,8 @@ OMX_ERRORTYPE port::free_tunnel_buffers()
 
 	for (port_buffer *pb : list_bufs) {
 		header = pb->header;
+		//バッファヘッダは OMX_FreeBuffer で解放されるので先に覚えておく
+		backbuf = header->pBuffer;
 
 		err = OMX_FreeBuffer(get_tunneled_component(), get_tunneled_port(), header);
 		if (err != OMX_ErrorNone) {
@@ -941,7 +1223,7 @@ OMX_ERRORTYPE port::free_tunnel_buffers()
 		}
 
 		delete pb;
-		delete[] header->pBuffer;
+		delete[] backbuf;
 	}
 
 	list_bufs.clear();
@@ -995,6 +1277,7 @@ OMX_ERRORTYPE port::use_buffer(OMX_BUFFERHEADERTYPE **bufhead, OMX_PTR priv, OMX
 		pb->f_allocate  = false;
 		pb->header      = header;
 		pb->index       = 0;
+		pb->slot        = assign_buffer_slot();
 
 		//init OpenMAX BUFFERHEADER
 		header->nSize = sizeof(OMX_BUFFERHEADERTYPE);
@@ -1096,6 +1379,7 @@ OMX_ERRORTYPE port::allocate_buffer(OMX_BUFFERHEADERTYPE **bufhead, OMX_PTR priv
 		pb->f_allocate  = true;
 		pb->header      = header;
 		pb->index       = 0;
+		pb->slot        = assign_buffer_slot();
 
 		//init OpenMAX BUFFERHEADER
 		header->nSize = sizeof(OMX_BUFFERHEADERTYPE);
@@ -1218,6 +1502,23 @@ bool port::find_buffer(const port_buffer *pb) const
 	return find_buffer(pb->header);
 }
 
+OMX_S32 port::get_buffer_slot(const OMX_BUFFERHEADERTYPE *bufhead) const
+{
+	const port_buffer *pb;
+
+	if (get_tunneled() && get_tunneled_supplier()) {
+		//接続先の OMX_UseBuffer に渡したポートバッファ
+		pb = static_cast<const port_buffer *>(bufhead->pAppPrivate);
+	} else {
+		pb = static_cast<const port_buffer *>(bufhead->pPlatformPrivate);
+	}
+	if (pb == nullptr || pb->p != this) {
+		return -1;
+	}
+
+	return pb->slot;
+}
+
 OMX_ERRORTYPE port::add_held_buffer(const port_buffer *pb)
 {
 	scoped_log_begin;
@@ -1249,6 +1550,40 @@ OMX_ERRORTYPE port::remove_held_buffer(const port_buffer *pb)
 }
 
 
+OMX_ERRORTYPE port::cancel_held_buffer(const port_buffer *pb)
+{
+	scoped_log_begin;
+	std::lock_guard<std::recursive_mutex> lk_buf(mut_list_bufs);
+
+	for (auto it = list_held_bufs.begin(); it != list_held_bufs.end(); it++) {
+		if (it->header->pBuffer == pb->header->pBuffer) {
+			//found
+			list_held_bufs.erase(it);
+			cnt_send_wr--;
+			notify_buffer_count();
+			return OMX_ErrorInsufficientResources;
+		}
+	}
+
+	//書き込みを待つ間にフラッシュが保持リストごと返却したバッファは、
+	//受け付けたものとして扱う（取り消すと 2回返却される）
+	dprint("port_buffer:%p (buffer:%p) was returned by flush.\n",
+		pb, pb->header->pBuffer);
+
+	return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE port::add_held_buffers(const port_buffer *pbs, size_t n)
+{
+	scoped_log_begin;
+	std::lock_guard<std::recursive_mutex> lk_buf(mut_list_bufs);
+
+	list_held_bufs.insert(list_held_bufs.end(), pbs, pbs + n);
+
+	return OMX_ErrorNone;
+}
+
+
 //----------------------------------------
 //コンポーネント利用者 → コンポーネントへのバッファ送付
 //----------------------------------------
@@ -1286,6 +1621,10 @@ OMX_ERRORTYPE port::fill_buffer(OMX_BUFFERHEADERTYPE *bufhead)
 OMX_ERRORTYPE port::push_buffer(OMX_BUFFERHEADERTYPE *bufhead)
 {
 	scoped_log_begin;
+	static const trace_point tp = {
+		"push_buffer", "buffer", "port", "buffer", true,
+	};
+	scoped_trace tr(&tp, get_port_index(), (uintptr_t)bufhead);
 	port_buffer pb;
 	OMX_ERRORTYPE err;
 
@@ -1299,45 +1638,224 @@ OMX_ERRORTYPE port::push_buffer(OMX_BUFFERHEADERTYPE *bufhead)
 			(int)get_port_index());
 		return OMX_ErrorIncorrectStateOperation;
 	}
-	if (!find_buffer(bufhead)) {
+	pb.slot = get_buffer_slot(bufhead);
+	if (pb.slot < 0) {
 		dprint("Buffer header:%p is not registered.\n", bufhead);
 	}
 
+	OMX_MF_PROBE3(push_buffer, get_component()->get_name(),
+		get_port_index(), bufhead);
+
 	pb.p          = this;
 	pb.f_allocate = false;
 	pb.header     = bufhead;
 	pb.index      = bufhead->nOffset;
 
+	//入力ポートは受け取ったデータ量を数える
+	latency->on_push(pb.slot,
+		(get_dir() == OMX_DirInput) ? bufhead->nFilledLen : 0);
+
 	add_held_buffer(&pb);
 
+	//返却が先に数えられないよう、書き込む前に数える
+	cnt_send_wr++;
+
 	try {
 		bound_send->write_fully(&pb, 1);
-		notify_buffer_count();
+
+		//ワーカープールで実行するワーカーにバッファが届いたことを知らせる
+		get_component()->schedule_pooled_workers();
+
+		err = OMX_ErrorNone;
+	} catch (const mf::interrupted_error& e) {
+		infoprint("interrupted: %s\n", e.what());
+
+		err = cancel_held_buffer(&pb);
+	} catch (const std::runtime_error& e) {
+		errprint("runtime_error: %s\n", e.what());
+
+		err = cancel_held_buffer(&pb);
+	}
+
+	return err;
+}
+
+OMX_ERRORTYPE port::empty_buffers(OMX_BUFFERHEADERTYPE **bufheads, OMX_U32 n)
+{
+	OMX_ERRORTYPE err;
+
+	if (get_dir() != OMX_DirInput) {
+		errprint("port:%d is not input.\n",
+			(int)get_port_index());
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	err = push_buffers(bufheads, n);
+
+	return err;
+}
+
+OMX_ERRORTYPE port::fill_buffers(OMX_BUFFERHEADERTYPE **bufheads, OMX_U32 n)
+{
+	OMX_ERRORTYPE err;
+
+	if (get_dir() != OMX_DirOutput) {
+		errprint("port:%d is not output.\n",
+			(int)get_port_index());
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	err = push_buffers(bufheads, n);
+
+	return err;
+}
+
+OMX_ERRORTYPE port::push_buffers(OMX_BUFFERHEADERTYPE **bufheads, OMX_U32 n)
+{
+	scoped_log_begin;
+	static const trace_point tp = {
+		"push_buffers", "buffer", "port", "count", false,
+	};
+	scoped_trace tr(&tp, get_port_index(), n);
+	std::vector<port_buffer> pbs;
+	OMX_U32 i, ind;
+	bool f_cancel;
+	OMX_ERRORTYPE err;
+
+	if (n == 0) {
+		return OMX_ErrorNone;
+	}
+	if (bufheads == nullptr) {
+		errprint("Buffer headers are nullptr.\n");
+		return OMX_ErrorBadParameter;
+	}
+	if (!get_enabled()) {
+		errprint("Port %d is disabled.\n",
+			(int)get_port_index());
+		return OMX_ErrorIncorrectStateOperation;
+	}
+	if (is_shutting_write()) {
+		errprint("Port %d is flushing.\n",
+			(int)get_port_index());
+		return OMX_ErrorIncorrectStateOperation;
+	}
+	if (n > bound_send->capacity()) {
+		errprint("Port %d cannot hold %d buffers at once.\n",
+			(int)get_port_index(), (int)n);
+		return OMX_ErrorBadParameter;
+	}
+
+	//全てのバッファを検査してから受け付ける
+	pbs.resize(n);
+	for (i = 0; i < n; i++) {
+		if (bufheads[i] == nullptr) {
+			errprint("Buffer header[%d] is nullptr.\n", (int)i);
+			return OMX_ErrorBadParameter;
+		}
+
+		if (get_dir() == OMX_DirInput) {
+			ind = bufheads[i]->nInputPortIndex;
+		} else {
+			ind = bufheads[i]->nOutputPortIndex;
+		}
+		if (ind != get_port_index()) {
+			errprint("Buffer header[%d] is for port %d, not %d.\n",
+				(int)i, (int)ind, (int)get_port_index());
+			return OMX_ErrorBadPortIndex;
+		}
+
+		pbs[i].p          = this;
+		pbs[i].f_allocate = false;
+		pbs[i].header     = bufheads[i];
+		pbs[i].index      = bufheads[i]->nOffset;
+		pbs[i].slot       = get_buffer_slot(bufheads[i]);
+	}
+
+	for (i = 0; i < n; i++) {
+		OMX_MF_PROBE3(push_buffer, get_component()->get_name(),
+			get_port_index(), bufheads[i]);
+		latency->on_push(pbs[i].slot,
+			(get_dir() == OMX_DirInput) ? bufheads[i]->nFilledLen : 0);
+	}
+
+	add_held_buffers(&pbs[0], n);
+	cnt_send_wr += n;
+
+	//一部だけ受け付けることがないよう、
+	//全てのバッファが入る空きを待ってから一度に書き込む
+	try {
+		std::unique_lock<std::recursive_mutex> lk(bound_send->mutex());
+
+		bound_send->wait_space_with_lock(lk, n);
+		bound_send->write_array_with_lock(&pbs[0], n);
+		lk.unlock();
+
+		//ワーカープールで実行するワーカーにバッファが届いたことを知らせる
+		get_component()->schedule_pooled_workers();
 
 		err = OMX_ErrorNone;
 	} catch (const mf::interrupted_error& e) {
 		infoprint("interrupted: %s\n", e.what());
 
-		remove_held_buffer(&pb);
 		err = OMX_ErrorInsufficientResources;
 	} catch (const std::runtime_error& e) {
 		errprint("runtime_error: %s\n", e.what());
 
-		remove_held_buffer(&pb);
 		err = OMX_ErrorInsufficientResources;
 	}
 
+	//受け付けられなければ全て保持リストから外す
+	//待つ間にフラッシュが保持リストごと返却していれば、
+	//受け付けたものとして扱う（取り消すと 2回返却される）
+	if (err != OMX_ErrorNone) {
+		f_cancel = false;
+		for (i = 0; i < n; i++) {
+			if (cancel_held_buffer(&pbs[i]) != OMX_ErrorNone) {
+				f_cancel = true;
+			}
+		}
+		if (!f_cancel) {
+			err = OMX_ErrorNone;
+		}
+	}
+
 	return err;
 }
 
 OMX_ERRORTYPE port::pop_buffer(port_buffer *pb)
 {
 	scoped_log_begin;
+	static const trace_point tp = {
+		"pop_buffer", "buffer", "port", "buffer", true,
+	};
+	scoped_trace tr(&tp, get_port_index(), 0);
+	component_worker *wr;
 	OMX_ERRORTYPE err;
 
 	try {
-		bound_send->read_fully(pb, 1);
-		notify_buffer_count();
+		while (1) {
+			try {
+				bound_send->read_fully(pb, 1);
+				break;
+			} catch (const mf::interrupted_error& e) {
+				//軽量フラッシュに対応していないワーカースレッドは、
+				//一時停止の間ここで待ち、再開されたら取り出し直す
+				wr = component_worker::get_current();
+				if (wr == nullptr || wr->is_light_flush_supported() ||
+					!wr->is_paused()) {
+					throw;
+				}
+
+				wr->accept_flush();
+				if (!wr->is_running() || wr->is_request_flush()) {
+					throw;
+				}
+			}
+		}
+		tr.set_arg1((uintptr_t)pb->header);
+		OMX_MF_PROBE3(pop_buffer, get_component()->get_name(),
+			get_port_index(), pb->header);
+		latency->on_pop(pb->slot);
 
 		err = OMX_ErrorNone;
 	} catch (const mf::interrupted_error& e) {
@@ -1353,6 +1871,24 @@ OMX_ERRORTYPE port::pop_buffer(port_buffer *pb)
 	return err;
 }
 
+OMX_ERRORTYPE port::try_pop_buffer(port_buffer *pb)
+{
+	std::lock_guard<std::recursive_mutex> lk(bound_send->mutex());
+
+	if (bound_send->is_shutting_read_with_lock()) {
+		return OMX_ErrorIncorrectStateOperation;
+	}
+	if (bound_send->read_array_with_lock(pb, 1) == 0) {
+		return OMX_ErrorNotReady;
+	}
+
+	OMX_MF_PROBE3(pop_buffer, get_component()->get_name(),
+		get_port_index(), pb->header);
+	latency->on_pop(pb->slot);
+
+	return OMX_ErrorNone;
+}
+
 //----------------------------------------
 //コンポーネント → コンポーネント利用者へのバッファ返却
 //----------------------------------------
@@ -1408,8 +1944,12 @@ OMX_ERRORTYPE port::fill_buffer_done(port_buffer *pb)
 OMX_ERRORTYPE port::push_buffer_done(OMX_BUFFERHEADERTYPE *bufhead)
 {
 	scoped_log_begin;
-	std::unique_lock<std::recursive_mutex> lk_port(mut);
+	static const trace_point tp = {
+		"push_buffer_done", "buffer", "port", "buffer", true,
+	};
+	scoped_trace tr(&tp, get_port_index(), (uintptr_t)bufhead);
 	port_buffer pb;
+	port_latency::callback_stamp cs;
 	OMX_ERRORTYPE err;
 
 	if (!get_enabled()) {
@@ -1418,15 +1958,48 @@ OMX_ERRORTYPE port::push_buffer_done(OMX_BUFFERHEADERTYPE *bufhead)
 		return OMX_ErrorIncorrectStateOperation;
 	}
 
+	OMX_MF_PROBE3(push_buffer_done, get_component()->get_name(),
+		get_port_index(), bufhead);
+
 	pb.p = this;
 	pb.f_allocate = false;
 	pb.header = bufhead;
 
-	remove_held_buffer(&pb);
+	//フラッシュの期限切れで強制的に返却済みのバッファは、
+	//2回返却しないように破棄する
+	err = remove_held_buffer(&pb);
+	if (err != OMX_ErrorNone) {
+		errprint("Port %d buffer:%p was already returned, drop it.\n",
+			(int)get_port_index(), bufhead->pBuffer);
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	//出力ポートは返却するデータ量を数える
+	pb.slot = get_buffer_slot(bufhead);
+	latency->on_done(pb.slot,
+		(get_dir() == OMX_DirOutput) ? bufhead->nFilledLen : 0);
+
+	//トンネル接続先のポートに直接渡す
+	if (get_tunneled_direct() && get_tunneled_peer() != nullptr) {
+		//接続先に渡す処理をコールバックとみなして記録する
+		latency->on_callback_begin(pb.slot, port_latency::now(), &cs);
+		err = push_buffer_tunneled_peer(bufhead);
+		if (err == OMX_ErrorNone) {
+			latency->on_callback_end(cs, port_latency::now());
+			OMX_MF_PROBE3(buffer_done, get_component()->get_name(),
+				get_port_index(), bufhead);
+
+			cnt_direct++;
+			notify_buffer_count();
+
+			return OMX_ErrorNone;
+		}
+
+		//受け付けられなければ、通常通り返却スレッドから渡す
+	}
 
 	try {
 		bound_ret->write_fully(&pb, 1);
-		notify_buffer_count();
 
 		err = OMX_ErrorNone;
 	} catch (const mf::interrupted_error& e) {
@@ -1496,6 +2069,66 @@ OMX_ERRORTYPE port::start_tunneling()
  * protected functions
  */
 
+void port::begin_write_definition()
+{
+	mut_def.lock();
+
+	depth_def++;
+}
+
+void port::end_write_definition()
+{
+	if (--depth_def == 0) {
+		publish_definition();
+	}
+
+	mut_def.unlock();
+}
+
+void port::publish_definition() const
+{
+	OMX_PARAM_PORTDEFINITIONTYPE def;
+	uint32_t words[N_DEF_WORDS] = {0, };
+	uint32_t seq;
+	size_t i;
+
+	fill_definition(&def);
+	memcpy(words, &def, sizeof(def));
+
+	//奇数にしてから写しを書き換え、偶数に戻す
+	seq = seq_def.load(std::memory_order_relaxed);
+	seq_def.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (i = 0; i < N_DEF_WORDS; i++) {
+		snap_def[i].store(words[i], std::memory_order_relaxed);
+	}
+
+	seq_def.store(seq + 2, std::memory_order_release);
+}
+
+void port::fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const
+{
+	memset(def, 0, sizeof(*def));
+
+	def->nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+	def->nVersion.s.nVersionMajor = OMX_MF_IL_MAJOR;
+	def->nVersion.s.nVersionMinor = OMX_MF_IL_MINOR;
+	def->nVersion.s.nRevision     = OMX_MF_IL_REVISION;
+	def->nVersion.s.nStep         = OMX_MF_IL_STEP;
+	def->nPortIndex         = port_index;
+	def->eDir               = dir;
+	def->nBufferCountActual = buffer_count_actual;
+	def->nBufferCountMin    = buffer_count_min;
+	def->nBufferSize        = buffer_size;
+	def->bEnabled           = f_enabled;
+	def->bPopulated         = f_populated;
+	def->eDomain            = domain;
+	//def->format is not set
+	def->bBuffersContiguous = buffers_contiguous;
+	def->nBufferAlignment   = buffer_alignment;
+}
+
 const std::vector<port_format>& port::get_port_format_list() const
 {
 	return formats;
@@ -1515,15 +2148,129 @@ bool port::is_broken() const
 	return is_shutting_read() && is_shutting_write();
 }
 
+bool port::is_buffer_returned() const
+{
+	uint64_t done;
+
+	//送出数を先に読むと、その後に送出、返却されたバッファの返却数だけを
+	//数えてしまい、全て返却済みと誤るため、返却数から先に読む
+	done = cnt_recv_rd.load(std::memory_order_acquire) +
+		cnt_direct.load(std::memory_order_acquire);
+
+	return cnt_send_wr.load(std::memory_order_acquire) == done;
+}
+
 void port::notify_buffer_count()
+{
+	//待機しているスレッドがいない、あるいはまだ返却途中のバッファが
+	//あれば、ポートのロックを取る必要はない
+	if ((cnt_wait_returned == 0 && cnt_wait_returned_comp == 0) ||
+		!is_buffer_returned()) {
+		return;
+	}
+
+	if (cnt_wait_returned != 0) {
+		std::lock_guard<std::recursive_mutex> lk_port(mut);
+
+		cond.notify_all();
+	}
+	if (cnt_wait_returned_comp != 0) {
+		get_component()->notify_port_buffer_returned();
+	}
+}
+
+OMX_ERRORTYPE port::resize_buffer_rings(size_t depth)
 {
 	scoped_log_begin;
-	std::lock_guard<std::recursive_mutex> lk_port(mut);
+	std::lock_guard<std::recursive_mutex> lk_send(bound_send->mutex());
+	std::lock_guard<std::recursive_mutex> lk_ret(bound_ret->mutex());
+	std::vector<port_buffer> vec_send_new, vec_ret_new;
 
-	cnt_send_wr = bound_send->get_write_count();
-	cnt_recv_rd = bound_ret->get_read_count();
+	depth = std::max<size_t>(depth, 1);
+	if (ring_send->capacity() == depth && ring_ret->capacity() == depth) {
+		return OMX_ErrorNone;
+	}
 
-	cond.notify_all();
+	if (!bound_send->empty() || !bound_ret->empty()) {
+		errprint("Port %d is passing buffers, cannot resize.\n",
+			(int)get_port_index());
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	//待機中のスレッドがリングバッファを参照しているため、
+	//リングバッファは作り直さずにベースの配列だけを差し替える
+	vec_send_new.reserve(depth + 1);
+	ring_send->assign(vec_send_new.begin(), vec_send_new.capacity());
+	vec_send.swap(vec_send_new);
+	bound_send->notify_with_lock();
+
+	vec_ret_new.reserve(depth + 1);
+	ring_ret->assign(vec_ret_new.begin(), vec_ret_new.capacity());
+	vec_ret.swap(vec_ret_new);
+	bound_ret->notify_with_lock();
+
+	dprint("Port %d resized rings to %d.\n",
+		(int)get_port_index(), (int)depth);
+
+	return OMX_ErrorNone;
+}
+
+OMX_S32 port::assign_buffer_slot()
+{
+	OMX_S32 slot;
+	bool used;
+
+	//解放されたバッファの番号を再利用する
+	for (slot = 0; ; slot++) {
+		used = false;
+		for (port_buffer *pb : list_bufs) {
+			if (pb->slot == slot) {
+				used = true;
+				break;
+			}
+		}
+		if (!used) {
+			break;
+		}
+	}
+
+	latency->reserve_slot(slot);
+
+	return slot;
+}
+
+OMX_ERRORTYPE port::push_buffer_tunneled_peer(OMX_BUFFERHEADERTYPE *bufhead)
+{
+	scoped_log_begin;
+	port *peer = get_tunneled_peer();
+
+	//接続先が OMX_EmptyThisBuffer, OMX_FillThisBuffer を
+	//受け付けない状態ならば、何もせずにエラーとする
+	switch (peer->get_component()->get_state()) {
+	case OMX_StateIdle:
+	case OMX_StateExecuting:
+	case OMX_StatePause:
+		//OK
+		break;
+	default:
+		//NG
+		return OMX_ErrorIncorrectStateOperation;
+	}
+	//フラッシュ中の接続先に渡すと中断されるため、
+	//渡さずに返却スレッドから返す
+	if (!peer->get_enabled() || peer->is_plugged_client_request()) {
+		return OMX_ErrorIncorrectStateOperation;
+	}
+
+	switch (get_dir()) {
+	case OMX_DirInput:
+		return peer->fill_buffer(bufhead);
+	case OMX_DirOutput:
+		return peer->empty_buffer(bufhead);
+	default:
+		errprint("unknown direction.\n");
+		return OMX_ErrorBadPortIndex;
+	}
 }
 
 //----------------------------------------
@@ -1533,9 +2280,13 @@ void port::notify_buffer_count()
 void *port::buffer_done()
 {
 	scoped_log_begin;
+	static const trace_point tp = {
+		"buffer_done", "buffer", "port", "buffer", true,
+	};
 	port_buffer pb;
 	component *comp;
 	bool f_callback;
+	port_latency::callback_stamp cs;
 	OMX_ERRORTYPE err, err_handler;
 
 	while (1) {
@@ -1544,10 +2295,31 @@ void *port::buffer_done()
 
 		comp = pb.p->get_component();
 
+		scoped_trace tr(&tp, get_port_index(), (uintptr_t)pb.header);
+
+		//まとめて返却する
+		if (get_batch_done() && !get_tunneled()) {
+			err = buffer_done_batch();
+			if (err != OMX_ErrorNone) {
+				err_handler = comp->EventHandler(OMX_EventError,
+					err, 0, nullptr);
+				if (err_handler != OMX_ErrorNone) {
+					errprint("error handler returns error: %s\n",
+						omx_enum_name::get_OMX_ERRORTYPE_name(err_handler));
+				}
+			}
+			continue;
+		}
+
+		OMX_MF_PROBE3(buffer_done, comp->get_name(),
+			get_port_index(), pb.header);
+
 		err = OMX_ErrorNone;
 		err_handler = OMX_ErrorNone;
 		f_callback = true;
 
+		latency->on_callback_begin(pb.slot, port_latency::now(), &cs);
+
 		switch (pb.p->get_dir()) {
 		case OMX_DirInput:
 			if (pb.p->get_tunneled()) {
@@ -1568,6 +2340,8 @@ void *port::buffer_done()
 			err = OMX_ErrorBadPortIndex;
 		}
 
+		latency->on_callback_end(cs, port_latency::now());
+
 		//error event callback
 		if (f_callback && err != OMX_ErrorNone) {
 			err_handler = comp->EventHandler(OMX_EventError,
@@ -1580,12 +2354,85 @@ void *port::buffer_done()
 
 		//erase request
 		bound_ret->read_fully(&pb, 1);
+		cnt_recv_rd++;
 		notify_buffer_count();
 	}
 
 	return nullptr;
 }
 
+OMX_ERRORTYPE port::buffer_done_batch()
+{
+	scoped_log_begin;
+	static const trace_point tp = {
+		"buffer_done_batch", "buffer", "port", "count", false,
+	};
+	std::vector<port_buffer> pbs;
+	std::vector<OMX_BUFFERHEADERTYPE *> headers;
+	std::vector<port_latency::callback_stamp> css;
+	component *comp = get_component();
+	OMX_MF_BUFFERSDONE_FUNC func = get_batch_done_func();
+	size_t n, i;
+	uint64_t t_begin, t_end;
+	OMX_ERRORTYPE err;
+
+	n = std::min<size_t>(std::max<OMX_U32>(get_batch_done_max(), 1),
+		bound_ret->capacity());
+
+	//後続のバッファを待つ
+	if (get_batch_done_delay() > 0) {
+		bound_ret->wait_element_for(n,
+			std::chrono::microseconds(get_batch_done_delay()));
+	}
+
+	pbs.resize(n);
+	{
+		std::unique_lock<std::recursive_mutex> lk(bound_ret->mutex());
+
+		n = bound_ret->peek_array_with_lock(&pbs[0], n);
+	}
+
+	scoped_trace tr(&tp, get_port_index(), n);
+
+	t_begin = port_latency::now();
+
+	headers.resize(n);
+	css.resize(n);
+	for (i = 0; i < n; i++) {
+		headers[i] = pbs[i].header;
+		OMX_MF_PROBE3(buffer_done, comp->get_name(),
+			get_port_index(), headers[i]);
+		latency->on_callback_begin(pbs[i].slot, t_begin, &css[i]);
+
+		//EOS detected
+		if (headers[i]->nFlags & OMX_BUFFERFLAG_EOS) {
+			comp->EventHandler(OMX_EventBufferFlag,
+				get_port_index(), headers[i]->nFlags, nullptr);
+		}
+	}
+
+	if (func != nullptr) {
+		err = comp->BuffersDone(func, get_port_index(),
+			&headers[0], (OMX_U32)n);
+	} else {
+		errprint("Port %d has no callback.\n",
+			(int)get_port_index());
+		err = OMX_ErrorUndefined;
+	}
+
+	t_end = port_latency::now();
+	for (i = 0; i < n; i++) {
+		latency->on_callback_end(css[i], t_end);
+	}
+
+	//erase request
+	bound_ret->read_fully(&pbs[0], n);
+	cnt_recv_rd += n;
+	notify_buffer_count();
+
+	return err;
+}
+
 void *port::buffer_done_thread_main(port *p)
 {
 	scoped_log_begin;
@@ -38,6 +38,8 @@ OMX_STRING port_audio::get_mime_type() const
 
 void port_audio::set_mime_type(OMX_STRING v)
 {
+	definition_writer wr(this);
+
 	mime_type = v;
 }
 
@@ -48,6 +50,8 @@ OMX_NATIVE_DEVICETYPE port_audio::get_native_render() const
 
 void port_audio::set_native_render(OMX_NATIVE_DEVICETYPE v)
 {
+	definition_writer wr(this);
+
 	native_render = v;
 }
 
@@ -58,6 +62,8 @@ OMX_BOOL port_audio::get_flag_error_concealment() const
 
 void port_audio::set_flag_error_concealment(OMX_BOOL v)
 {
+	definition_writer wr(this);
+
 	flag_error_concealment = v;
 }
 
@@ -72,23 +78,20 @@ OMX_AUDIO_CODINGTYPE port_audio::get_encoding() const
 	}
 }
 
-const OMX_PARAM_PORTDEFINITIONTYPE *port_audio::get_definition() const
+void port_audio::fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const
 {
-	scoped_log_begin;
-
-	super::get_definition();
-
-	definition.format.audio.cMIMEType     = mime_type;
-	definition.format.audio.pNativeRender = native_render;
-	definition.format.audio.bFlagErrorConcealment = flag_error_concealment;
-	definition.format.audio.eEncoding     = get_encoding();
+	super::fill_definition(def);
 
-	return &definition;
+	def->format.audio.cMIMEType     = mime_type;
+	def->format.audio.pNativeRender = native_render;
+	def->format.audio.bFlagErrorConcealment = flag_error_concealment;
+	def->format.audio.eEncoding     = get_encoding();
 }
 
 OMX_ERRORTYPE port_audio::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 	OMX_AUDIO_PARAM_PORTFORMATTYPE t = {0, };
 	OMX_ERRORTYPE err;
 
@@ -115,6 +118,7 @@ OMX_ERRORTYPE port_audio::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 OMX_ERRORTYPE port_audio::set_definition_from_client(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 	OMX_AUDIO_PARAM_PORTFORMATTYPE t = {0, };
 	OMX_ERRORTYPE err;
 
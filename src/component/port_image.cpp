@@ -40,6 +40,8 @@ OMX_STRING port_image::get_mime_type() const
 
 void port_image::set_mime_type(OMX_STRING v)
 {
+	definition_writer wr(this);
+
 	mime_type = v;
 }
 
@@ -50,6 +52,8 @@ OMX_NATIVE_DEVICETYPE port_image::get_native_render() const
 
 void port_image::set_native_render(OMX_NATIVE_DEVICETYPE v)
 {
+	definition_writer wr(this);
+
 	native_render = v;
 }
 
@@ -60,6 +64,8 @@ OMX_U32 port_image::get_frame_width() const
 
 void port_image::set_frame_width(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	frame_width = v;
 }
 
@@ -70,6 +76,8 @@ OMX_U32 port_image::get_frame_height() const
 
 void port_image::set_frame_height(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	frame_height = v;
 }
 
@@ -80,6 +88,8 @@ OMX_S32 port_image::get_stride() const
 
 void port_image::set_stride(OMX_S32 v)
 {
+	definition_writer wr(this);
+
 	stride = v;
 }
 
@@ -90,6 +100,8 @@ OMX_U32 port_image::get_slice_height() const
 
 void port_image::set_slice_height(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	slice_height = v;
 }
 
@@ -100,6 +112,8 @@ OMX_BOOL port_image::get_flag_error_concealment() const
 
 void port_image::set_flag_error_concealment(OMX_BOOL v)
 {
+	definition_writer wr(this);
+
 	flag_error_concealment = v;
 }
 
@@ -132,32 +146,31 @@ OMX_NATIVE_WINDOWTYPE port_image::get_native_window() const
 
 void port_image::set_native_window(OMX_NATIVE_WINDOWTYPE v)
 {
+	definition_writer wr(this);
+
 	native_window = v;
 }
 
-const OMX_PARAM_PORTDEFINITIONTYPE *port_image::get_definition() const
+void port_image::fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const
 {
-	scoped_log_begin;
-
-	super::get_definition();
-
-	definition.format.image.cMIMEType     = mime_type;
-	definition.format.image.pNativeRender = native_render;
-	definition.format.image.nFrameWidth   = frame_width;
-	definition.format.image.nFrameHeight  = frame_height;
-	definition.format.image.nStride       = stride;
-	definition.format.image.nSliceHeight  = slice_height;
-	definition.format.image.bFlagErrorConcealment = flag_error_concealment;
-	definition.format.image.eCompressionFormat = get_compression_format();
-	definition.format.image.eColorFormat  = get_color_format();
-	definition.format.image.pNativeWindow = native_window;
-
-	return &definition;
+	super::fill_definition(def);
+
+	def->format.image.cMIMEType     = mime_type;
+	def->format.image.pNativeRender = native_render;
+	def->format.image.nFrameWidth   = frame_width;
+	def->format.image.nFrameHeight  = frame_height;
+	def->format.image.nStride       = stride;
+	def->format.image.nSliceHeight  = slice_height;
+	def->format.image.bFlagErrorConcealment = flag_error_concealment;
+	def->format.image.eCompressionFormat = get_compression_format();
+	def->format.image.eColorFormat  = get_color_format();
+	def->format.image.pNativeWindow = native_window;
 }
 
 OMX_ERRORTYPE port_image::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 	OMX_IMAGE_PARAM_PORTFORMATTYPE t = {0, };
 	OMX_ERRORTYPE err;
 
@@ -191,6 +204,7 @@ OMX_ERRORTYPE port_image::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 OMX_ERRORTYPE port_image::set_definition_from_client(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 	OMX_IMAGE_PARAM_PORTFORMATTYPE t = {0, };
 	OMX_ERRORTYPE err;
 
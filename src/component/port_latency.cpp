@@ -0,0 +1,272 @@
+﻿
+#define __OMX_MF_EXPORTS
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "component/port_latency.hpp"
+
+namespace mf {
+
+/*
+ * latency_histogram
+ */
+
+latency_histogram::latency_histogram()
+	: cnt(0), sum(0), min(std::numeric_limits<uint64_t>::max()), max(0)
+{
+	for (auto& b : buckets) {
+		b.store(0, std::memory_order_relaxed);
+	}
+}
+
+void latency_histogram::record(uint64_t ns)
+{
+	uint64_t v;
+
+	buckets[get_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+	cnt.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(ns, std::memory_order_relaxed);
+
+	v = min.load(std::memory_order_relaxed);
+	while (ns < v && !min.compare_exchange_weak(v, ns,
+		std::memory_order_relaxed)) {
+		//retry
+	}
+
+	v = max.load(std::memory_order_relaxed);
+	while (ns > v && !max.compare_exchange_weak(v, ns,
+		std::memory_order_relaxed)) {
+		//retry
+	}
+}
+
+void latency_histogram::reset()
+{
+	for (auto& b : buckets) {
+		b.store(0, std::memory_order_relaxed);
+	}
+	cnt.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+void latency_histogram::get_stats(OMX_MF_LATENCYSTATSTYPE *st) const
+{
+	//パーセンタイル（1/1000 単位）と格納先
+	const struct {
+		uint64_t permille;
+		OMX_U64 *dest;
+	} ranks[] = {
+		{ 500, &st->nP50Ns },
+		{ 990, &st->nP99Ns },
+		{ 999, &st->nP999Ns },
+	};
+	uint64_t copy[OMX_MF_LATENCY_BUCKETS];
+	uint64_t total = 0, acc, target;
+	int b;
+
+	//記録中でも矛盾しないよう、バケツを写してから数える
+	for (b = 0; b < OMX_MF_LATENCY_BUCKETS; b++) {
+		copy[b] = buckets[b].load(std::memory_order_relaxed);
+		total += copy[b];
+	}
+
+	st->nCount = total;
+	if (total == 0) {
+		st->nMinNs  = 0;
+		st->nMaxNs  = 0;
+		st->nMeanNs = 0;
+		st->nP50Ns  = 0;
+		st->nP99Ns  = 0;
+		st->nP999Ns = 0;
+		return;
+	}
+
+	st->nMinNs  = min.load(std::memory_order_relaxed);
+	st->nMaxNs  = max.load(std::memory_order_relaxed);
+	st->nMeanNs = sum.load(std::memory_order_relaxed) /
+		std::max<uint64_t>(cnt.load(std::memory_order_relaxed), 1);
+
+	for (auto& r : ranks) {
+		target = std::max<uint64_t>((total * r.permille + 999) / 1000, 1);
+
+		acc = 0;
+		for (b = 0; b < OMX_MF_LATENCY_BUCKETS - 1; b++) {
+			acc += copy[b];
+			if (acc >= target) {
+				break;
+			}
+		}
+
+		//バケツの上限は実際の最大値を超えることがある
+		*r.dest = std::min<uint64_t>(get_bucket_value(b), st->nMaxNs);
+	}
+}
+
+int latency_histogram::get_bucket(uint64_t ns)
+{
+	int e;
+
+	if (ns < (1ULL << OMX_MF_LATENCY_SUB_BITS)) {
+		return (int)ns;
+	}
+	if (ns >= (1ULL << OMX_MF_LATENCY_MAX_EXP)) {
+		return OMX_MF_LATENCY_BUCKETS - 1;
+	}
+
+	//最上位ビットの位置で区間を決め、続く SUB_BITS ビットで等分する
+	e = 63 - __builtin_clzll(ns);
+
+	return ((e - OMX_MF_LATENCY_SUB_BITS + 1) << OMX_MF_LATENCY_SUB_BITS) +
+		(int)((ns >> (e - OMX_MF_LATENCY_SUB_BITS)) &
+		((1ULL << OMX_MF_LATENCY_SUB_BITS) - 1));
+}
+
+uint64_t latency_histogram::get_bucket_value(int b)
+{
+	int g, shift;
+	uint64_t sub;
+
+	if (b < (1 << OMX_MF_LATENCY_SUB_BITS)) {
+		return b;
+	}
+
+	g = b >> OMX_MF_LATENCY_SUB_BITS;
+	sub = b & ((1 << OMX_MF_LATENCY_SUB_BITS) - 1);
+	shift = g - 1;
+
+	return (((1ULL << OMX_MF_LATENCY_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+
+/*
+ * port_latency
+ */
+
+port_latency::port_latency()
+	: stamps(), cnt_buffers(0), cnt_bytes(0), t_reset(now())
+{
+	//do nothing
+}
+
+void port_latency::reserve_slot(OMX_S32 slot)
+{
+	while (slot >= 0 && stamps.size() <= (size_t)slot) {
+		stamps.emplace_back();
+	}
+}
+
+void port_latency::on_push(OMX_S32 slot, OMX_U32 bytes)
+{
+	if (slot < 0 || (size_t)slot >= stamps.size()) {
+		return;
+	}
+
+	buffer_stamp& st = stamps[slot];
+
+	st.t_push.store(now(), std::memory_order_relaxed);
+	st.t_pop.store(0, std::memory_order_relaxed);
+	st.t_done.store(0, std::memory_order_relaxed);
+	cnt_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void port_latency::on_pop(OMX_S32 slot)
+{
+	uint64_t t = now();
+
+	if (slot < 0 || (size_t)slot >= stamps.size()) {
+		return;
+	}
+
+	buffer_stamp& st = stamps[slot];
+
+	st.t_pop.store(t, std::memory_order_relaxed);
+	record(OMX_MF_LatencyStageQueued,
+		st.t_push.load(std::memory_order_relaxed), t);
+}
+
+void port_latency::on_done(OMX_S32 slot, OMX_U32 bytes)
+{
+	uint64_t t = now();
+
+	if (slot < 0 || (size_t)slot >= stamps.size()) {
+		return;
+	}
+
+	buffer_stamp& st = stamps[slot];
+
+	st.t_done.store(t, std::memory_order_relaxed);
+	record(OMX_MF_LatencyStageHeld,
+		st.t_pop.load(std::memory_order_relaxed), t);
+	cnt_buffers.fetch_add(1, std::memory_order_relaxed);
+	cnt_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void port_latency::on_callback_begin(OMX_S32 slot, uint64_t t, callback_stamp *cs) const
+{
+	cs->t_begin = t;
+
+	if (slot < 0 || (size_t)slot >= stamps.size()) {
+		cs->t_push = 0;
+		cs->t_done = 0;
+		return;
+	}
+
+	cs->t_push = stamps[slot].t_push.load(std::memory_order_relaxed);
+	cs->t_done = stamps[slot].t_done.load(std::memory_order_relaxed);
+}
+
+void port_latency::on_callback_end(const callback_stamp& cs, uint64_t t)
+{
+	if (cs.t_push == 0) {
+		return;
+	}
+
+	//フラッシュで返却されたバッファはコンポーネントを通らないため、
+	//返した時刻がなく記録されない
+	record(OMX_MF_LatencyStageReturning, cs.t_done, cs.t_begin);
+	record(OMX_MF_LatencyStageCallback, cs.t_begin, t);
+	record(OMX_MF_LatencyStageTotal, cs.t_push, t);
+}
+
+void port_latency::get_stats(OMX_MF_CONFIG_PORTLATENCYTYPE *conf) const
+{
+	int i;
+
+	conf->nBuffers   = cnt_buffers.load(std::memory_order_relaxed);
+	conf->nBytes     = cnt_bytes.load(std::memory_order_relaxed);
+	conf->nElapsedUs = (now() - t_reset.load(std::memory_order_relaxed)) / 1000;
+	for (i = 0; i < OMX_MF_LatencyStageMax; i++) {
+		hists[i].get_stats(&conf->sStage[i]);
+	}
+}
+
+void port_latency::reset()
+{
+	for (auto& h : hists) {
+		h.reset();
+	}
+	cnt_buffers.store(0, std::memory_order_relaxed);
+	cnt_bytes.store(0, std::memory_order_relaxed);
+	t_reset.store(now(), std::memory_order_relaxed);
+}
+
+uint64_t port_latency::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void port_latency::record(OMX_MF_LATENCYSTAGETYPE stage, uint64_t t_from, uint64_t t_to)
+{
+	if (t_from == 0 || t_to < t_from) {
+		return;
+	}
+
+	hists[stage].record(t_to - t_from);
+}
+
+} //namespace mf
@@ -0,0 +1,224 @@
+﻿
+#ifndef OMX_MF_PORT_LATENCY_HPP__
+#define OMX_MF_PORT_LATENCY_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+
+#include <OMX_Core.h>
+
+#include <omxil_mf/omxil_mf.h>
+
+//1桁（2 倍）ごとのバケツの分割数（2^N）、誤差は 1/2^N 以下
+#define OMX_MF_LATENCY_SUB_BITS    5
+//記録できる最大の遅延（2^N ナノ秒）、超えた値は最後のバケツに数える
+#define OMX_MF_LATENCY_MAX_EXP     36
+//バケツの数
+#define OMX_MF_LATENCY_BUCKETS     \
+	((OMX_MF_LATENCY_MAX_EXP - OMX_MF_LATENCY_SUB_BITS + 1) << OMX_MF_LATENCY_SUB_BITS)
+
+namespace mf {
+
+/**
+ * 遅延のヒストグラムです。
+ *
+ * HdrHistogram と同様に、2 のべき乗ごとの区間を
+ * さらに等分したバケツに数えるため、
+ * 値の大きさによらず相対誤差が一定（1/32 以下）に収まります。
+ *
+ * 記録はロックを取らずに行うため、
+ * 複数のスレッドから同時に記録、読み出しできます。
+ * ただしリセットと同時に記録された値は、一部だけ残ることがあります。
+ */
+class latency_histogram {
+public:
+	//親クラス
+	//typedef xxxx super;
+
+	latency_histogram();
+
+	//disable copy constructor
+	latency_histogram(const latency_histogram& obj) = delete;
+	//disable operator=
+	latency_histogram& operator=(const latency_histogram& obj) = delete;
+
+	/**
+	 * 遅延を記録します。
+	 *
+	 * @param ns 遅延（ナノ秒）
+	 */
+	void record(uint64_t ns);
+
+	/**
+	 * 記録した値を全て消去します。
+	 */
+	void reset();
+
+	/**
+	 * 記録した値の統計を取得します。
+	 *
+	 * @param st 統計を格納する構造体
+	 */
+	void get_stats(OMX_MF_LATENCYSTATSTYPE *st) const;
+
+	/**
+	 * 値を数えるバケツの番号を取得します。
+	 *
+	 * @param ns 値（ナノ秒）
+	 * @return バケツの番号
+	 */
+	static int get_bucket(uint64_t ns);
+
+	/**
+	 * バケツに数える値の上限を取得します。
+	 *
+	 * @param b バケツの番号
+	 * @return バケツに数える値の上限（ナノ秒）
+	 */
+	static uint64_t get_bucket_value(int b);
+
+private:
+	std::atomic<uint64_t> buckets[OMX_MF_LATENCY_BUCKETS];
+	std::atomic<uint64_t> cnt;
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> min;
+	std::atomic<uint64_t> max;
+
+};
+
+/**
+ * ポートを通過するバッファの遅延を測定します。
+ *
+ * バッファが各段階を通過した時刻を、
+ * ポートがバッファに割り当てた番号（スロット）ごとの配列に記録し、
+ * 段階ごとの遅延をヒストグラムに数えます。
+ * OpenMAX バッファヘッダには何も書き込みません。
+ *
+ * 各スロットの時刻は、そのバッファを扱っているスレッドだけが更新します。
+ */
+class port_latency {
+public:
+	//親クラス
+	//typedef xxxx super;
+
+	//返却のコールバックを呼び出す時点の時刻
+	struct callback_stamp {
+		uint64_t t_push;
+		uint64_t t_done;
+		uint64_t t_begin;
+	};
+
+	port_latency();
+
+	//disable copy constructor
+	port_latency(const port_latency& obj) = delete;
+	//disable operator=
+	port_latency& operator=(const port_latency& obj) = delete;
+
+	/**
+	 * 指定されたスロットの時刻を記録する領域を確保します。
+	 *
+	 * 配列を伸ばすため、ポートがバッファを受け渡していない時
+	 * （バッファの登録時）にだけ呼び出してください。
+	 *
+	 * @param slot スロット番号
+	 */
+	void reserve_slot(OMX_S32 slot);
+
+	/**
+	 * バッファを受け取った時刻を記録します。
+	 *
+	 * @param slot  スロット番号、負の値ならば何もしない
+	 * @param bytes 数えるバイト数
+	 */
+	void on_push(OMX_S32 slot, OMX_U32 bytes);
+
+	/**
+	 * コンポーネントがバッファを取り出した時刻を記録します。
+	 *
+	 * @param slot スロット番号、負の値ならば何もしない
+	 */
+	void on_pop(OMX_S32 slot);
+
+	/**
+	 * コンポーネントがバッファを返した時刻を記録します。
+	 *
+	 * @param slot  スロット番号、負の値ならば何もしない
+	 * @param bytes 数えるバイト数
+	 */
+	void on_done(OMX_S32 slot, OMX_U32 bytes);
+
+	/**
+	 * 返却のコールバックを呼び出す前に、バッファの時刻を取得します。
+	 *
+	 * コールバックから戻る前に、バッファが再びポートに渡されて
+	 * スロットの時刻が書き換わることがあるため、先に取得しておきます。
+	 *
+	 * @param slot スロット番号、負の値ならば何も記録しない
+	 * @param t    コールバックを呼び出す時刻
+	 * @param cs   時刻を格納する構造体
+	 */
+	void on_callback_begin(OMX_S32 slot, uint64_t t, callback_stamp *cs) const;
+
+	/**
+	 * 返却のコールバックから戻った時刻を記録します。
+	 *
+	 * @param cs on_callback_begin で取得した時刻
+	 * @param t  コールバックから戻った時刻
+	 */
+	void on_callback_end(const callback_stamp& cs, uint64_t t);
+
+	/**
+	 * 統計を取得します。
+	 *
+	 * nPortIndex 以外のメンバを設定します。
+	 *
+	 * @param conf 統計を格納する構造体
+	 */
+	void get_stats(OMX_MF_CONFIG_PORTLATENCYTYPE *conf) const;
+
+	/**
+	 * 統計を消去します。
+	 */
+	void reset();
+
+	/**
+	 * 単調増加する現在時刻を取得します。
+	 *
+	 * @return 現在時刻（ナノ秒）
+	 */
+	static uint64_t now();
+
+private:
+	//バッファが各段階を通過した時刻、0 ならば未通過
+	struct buffer_stamp {
+		std::atomic<uint64_t> t_push;
+		std::atomic<uint64_t> t_pop;
+		std::atomic<uint64_t> t_done;
+
+		buffer_stamp() : t_push(0), t_pop(0), t_done(0) {}
+	};
+
+	/**
+	 * 2つの時刻の間隔を記録します。
+	 *
+	 * 開始時刻が未通過（0）ならば何もしません。
+	 */
+	void record(OMX_MF_LATENCYSTAGETYPE stage, uint64_t t_from, uint64_t t_to);
+
+private:
+	//スロットごとの時刻
+	//要素を追加しても既存の要素は移動しないため deque を使う
+	std::deque<buffer_stamp> stamps;
+	latency_histogram hists[OMX_MF_LatencyStageMax];
+	//スループット
+	std::atomic<uint64_t> cnt_buffers;
+	std::atomic<uint64_t> cnt_bytes;
+	std::atomic<uint64_t> t_reset;
+
+};
+
+} //namespace mf
+
+#endif //OMX_MF_PORT_LATENCY_HPP__
@@ -40,20 +40,17 @@ OMX_OTHER_FORMATTYPE port_other::get_format() const
 	}
 }
 
-const OMX_PARAM_PORTDEFINITIONTYPE *port_other::get_definition() const
+void port_other::fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const
 {
-	scoped_log_begin;
-
-	super::get_definition();
-
-	definition.format.other.eFormat = get_format();
+	super::fill_definition(def);
 
-	return &definition;
+	def->format.other.eFormat = get_format();
 }
 
 OMX_ERRORTYPE port_other::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 	OMX_OTHER_PARAM_PORTFORMATTYPE t = {0, };
 	OMX_ERRORTYPE err;
 
@@ -77,6 +74,7 @@ OMX_ERRORTYPE port_other::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 OMX_ERRORTYPE port_other::set_definition_from_client(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 	OMX_OTHER_PARAM_PORTFORMATTYPE t = {0, };
 	OMX_ERRORTYPE err;
 
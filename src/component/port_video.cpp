@@ -40,6 +40,8 @@ OMX_STRING port_video::get_mime_type() const
 
 void port_video::set_mime_type(OMX_STRING v)
 {
+	definition_writer wr(this);
+
 	mime_type = v;
 }
 
@@ -50,6 +52,8 @@ OMX_NATIVE_DEVICETYPE port_video::get_native_render() const
 
 void port_video::set_native_render(OMX_NATIVE_DEVICETYPE v)
 {
+	definition_writer wr(this);
+
 	native_render = v;
 }
 
@@ -60,6 +64,8 @@ OMX_U32 port_video::get_frame_width() const
 
 void port_video::set_frame_width(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	frame_width = v;
 }
 
@@ -70,6 +76,8 @@ OMX_U32 port_video::get_frame_height() const
 
 void port_video::set_frame_height(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	frame_height = v;
 }
 
@@ -80,6 +88,8 @@ OMX_S32 port_video::get_stride() const
 
 void port_video::set_stride(OMX_S32 v)
 {
+	definition_writer wr(this);
+
 	stride = v;
 }
 
@@ -90,6 +100,8 @@ OMX_U32 port_video::get_slice_height() const
 
 void port_video::set_slice_height(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	slice_height = v;
 }
 
@@ -100,6 +112,8 @@ OMX_U32 port_video::get_bitrate() const
 
 void port_video::set_bitrate(OMX_U32 v)
 {
+	definition_writer wr(this);
+
 	bitrate = v;
 }
 
@@ -121,6 +135,8 @@ OMX_BOOL port_video::get_flag_error_concealment() const
 
 void port_video::set_flag_error_concealment(OMX_BOOL v)
 {
+	definition_writer wr(this);
+
 	flag_error_concealment = v;
 }
 
@@ -153,34 +169,33 @@ OMX_NATIVE_WINDOWTYPE port_video::get_native_window() const
 
 void port_video::set_native_window(OMX_NATIVE_WINDOWTYPE v)
 {
+	definition_writer wr(this);
+
 	native_window = v;
 }
 
-const OMX_PARAM_PORTDEFINITIONTYPE *port_video::get_definition() const
+void port_video::fill_definition(OMX_PARAM_PORTDEFINITIONTYPE *def) const
 {
-	scoped_log_begin;
-
-	super::get_definition();
-
-	definition.format.video.cMIMEType     = mime_type;
-	definition.format.video.pNativeRender = native_render;
-	definition.format.video.nFrameWidth   = frame_width;
-	definition.format.video.nFrameHeight  = frame_height;
-	definition.format.video.nStride       = stride;
-	definition.format.video.nSliceHeight  = slice_height;
-	definition.format.video.nBitrate      = bitrate;
-	definition.format.video.xFramerate    = get_framerate();
-	definition.format.video.bFlagErrorConcealment = flag_error_concealment;
-	definition.format.video.eCompressionFormat    = get_compression_format();
-	definition.format.video.eColorFormat  = get_color_format();
-	definition.format.video.pNativeWindow = native_window;
-
-	return &definition;
+	super::fill_definition(def);
+
+	def->format.video.cMIMEType     = mime_type;
+	def->format.video.pNativeRender = native_render;
+	def->format.video.nFrameWidth   = frame_width;
+	def->format.video.nFrameHeight  = frame_height;
+	def->format.video.nStride       = stride;
+	def->format.video.nSliceHeight  = slice_height;
+	def->format.video.nBitrate      = bitrate;
+	def->format.video.xFramerate    = get_framerate();
+	def->format.video.bFlagErrorConcealment = flag_error_concealment;
+	def->format.video.eCompressionFormat    = get_compression_format();
+	def->format.video.eColorFormat  = get_color_format();
+	def->format.video.pNativeWindow = native_window;
 }
 
 OMX_ERRORTYPE port_video::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 	OMX_VIDEO_PARAM_PORTFORMATTYPE t = {0, };
 	OMX_ERRORTYPE err;
 
@@ -217,6 +232,7 @@ OMX_ERRORTYPE port_video::set_definition(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 OMX_ERRORTYPE port_video::set_definition_from_client(const OMX_PARAM_PORTDEFINITIONTYPE& v)
 {
 	scoped_log_begin;
+	definition_writer wr(this);
 	OMX_VIDEO_PARAM_PORTFORMATTYPE t = {0, };
 	OMX_ERRORTYPE err;
 
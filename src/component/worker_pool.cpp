@@ -0,0 +1,235 @@
+﻿
+#define __OMX_MF_EXPORTS
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <omxil_mf/scoped_log.hpp>
+
+#include "component/worker_pool.hpp"
+#include "util/util.hpp"
+
+namespace mf {
+
+//プールのスレッドが実行しているレーン番号、プール外のスレッドは -1
+static thread_local int tls_lane = -1;
+
+/*
+ * public functions
+ */
+
+bool worker_pool::post(std::function<void()> task, int lane)
+{
+	size_t n = lanes.size();
+	size_t ind;
+
+	//最初の投入時にスレッドを開始する
+	if (!f_started) {
+		std::lock_guard<std::mutex> lock(mut);
+
+		if (!f_started && !start_threads_with_lock()) {
+			return false;
+		}
+	}
+
+	if (lane < 0) {
+		lane = std::max(tls_lane, 0);
+	}
+	ind = (size_t)lane % n;
+
+	{
+		std::lock_guard<std::mutex> lk_lane(lanes[ind]->mut);
+
+		lanes[ind]->tasks.push_back(std::move(task));
+	}
+
+	//休んでいるスレッドがいれば起こす
+	//NOTE: n_pending を増やしてから n_sleeping を読み、
+	//      休むスレッドは n_sleeping を増やしてから n_pending を読むため、
+	//      どちらかが必ず相手に気づく
+	n_pending++;
+	if (n_sleeping > 0) {
+		std::lock_guard<std::mutex> lock(mut);
+
+		cond.notify_one();
+	}
+
+	return true;
+}
+
+int worker_pool::assign_lane()
+{
+	return (int)(cnt_assign++ % lanes.size());
+}
+
+size_t worker_pool::get_thread_count() const
+{
+	std::lock_guard<std::mutex> lock(mut);
+
+	return f_started ? lanes.size() : 0;
+}
+
+
+/*
+ * static public functions
+ */
+
+static std::once_flag once_instance;
+static worker_pool *g_pool = nullptr;
+
+worker_pool *worker_pool::get_instance()
+{
+	//1回目の呼び出し時にシングルトンを生成してポインタを返す。
+	//2回目以降の呼び出しでは 1回目で生成したポインタを返す。
+	std::call_once(once_instance, create_instance_once);
+
+	return g_pool;
+}
+
+
+/*
+ * protected functions
+ */
+
+worker_pool::worker_pool()
+	: f_started(false), n_pending(0), n_sleeping(0), cnt_assign(0)
+{
+	scoped_log_begin;
+	size_t n;
+
+	n = std::max<size_t>(OMX_MF_WORKER_POOL_MIN_THREADS,
+		std::thread::hardware_concurrency());
+	for (size_t i = 0; i < n; i++) {
+		lanes.emplace_back(new lane());
+	}
+}
+
+worker_pool::~worker_pool()
+{
+	scoped_log_begin;
+	//do nothing
+}
+
+bool worker_pool::start_threads_with_lock()
+{
+	scoped_log_begin;
+
+	for (size_t i = 0; i < lanes.size(); i++) {
+		try {
+			std::thread th(pool_thread_main, this, i);
+
+			//スレッドはプロセスの終了まで残す
+			th.detach();
+		} catch (const std::system_error& e) {
+			errprint("failed to create thread '%s'.\n", e.what());
+
+			//開始できたスレッドが全てのレーンから盗むため、
+			//1つでも開始できていれば処理は進む
+			if (i == 0) {
+				return false;
+			}
+			break;
+		}
+	}
+	f_started = true;
+
+	return true;
+}
+
+bool worker_pool::take(size_t self, std::function<void()> *task)
+{
+	size_t n = lanes.size();
+
+	//自分のレーンは投入された順に取り出す
+	{
+		lane *l = lanes[self].get();
+		std::lock_guard<std::mutex> lk_lane(l->mut);
+
+		if (!l->tasks.empty()) {
+			task->swap(l->tasks.front());
+			l->tasks.pop_front();
+			n_pending--;
+			return true;
+		}
+	}
+
+	//他のレーンからは、持ち主と競合しにくい末尾から盗む
+	for (size_t i = 1; i < n; i++) {
+		lane *l = lanes[(self + i) % n].get();
+		std::lock_guard<std::mutex> lk_lane(l->mut);
+
+		if (!l->tasks.empty()) {
+			task->swap(l->tasks.back());
+			l->tasks.pop_back();
+			n_pending--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void worker_pool::run(size_t self)
+{
+	scoped_log_begin;
+	std::function<void()> task;
+
+	tls_lane = (int)self;
+
+	while (true) {
+		if (take(self, &task)) {
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		//処理待ちがなければ、投入されるまで休む
+		std::unique_lock<std::mutex> lock(mut);
+
+		n_sleeping++;
+		cond.wait(lock, [&] { return n_pending > 0; });
+		n_sleeping--;
+	}
+}
+
+
+/*
+ * static protected functions
+ */
+
+void *worker_pool::pool_thread_main(worker_pool *pool, size_t self)
+{
+	scoped_log_begin;
+	std::string thname;
+
+	//スレッド名をつける
+	thname = "omx:pool:";
+	thname += std::to_string(self);
+	set_thread_name(thname.c_str());
+
+	pool->run(self);
+
+	return nullptr;
+}
+
+
+/*
+ * static private functions
+ */
+
+void worker_pool::create_instance_once()
+{
+	scoped_log_begin;
+
+	g_pool = new worker_pool();
+}
+
+} //namespace mf
@@ -0,0 +1,140 @@
+﻿
+#ifndef OMX_MF_WORKER_POOL_HPP__
+#define OMX_MF_WORKER_POOL_HPP__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+//スレッド数の下限（CPU 数の方が多ければ CPU 数）
+#define OMX_MF_WORKER_POOL_MIN_THREADS    1
+//ワーカーが他のワーカーに譲るまでに続けて処理する回数
+#define OMX_MF_WORKER_POOL_BUDGET         16
+
+namespace mf {
+
+/**
+ * 全てのコンポーネントが共有する、ワーカー実行用のスレッドプールです。
+ *
+ * スレッドは CPU の数だけ生成し、それぞれが自分の処理待ちキュー（レーン）を持ちます。
+ * 処理は投入時に指定したレーンに入り、
+ * 自分のレーンが空になったスレッドは他のレーンから処理を盗んで実行します。
+ * 同じコンポーネントの処理を同じレーンに投入すると、
+ * 通常は同じスレッドで実行されるため、キャッシュの局所性が保たれます。
+ *
+ * 投入する処理はブロックしてはいけません。
+ * ブロックする処理はワーカースレッド（component_worker）で実行してください。
+ */
+class worker_pool {
+public:
+	//親クラス
+	//typedef xxxx super;
+
+	//disable copy constructor
+	worker_pool(const worker_pool& obj) = delete;
+	//disable operator=
+	worker_pool& operator=(const worker_pool& obj) = delete;
+
+	/**
+	 * 処理を投入します。
+	 *
+	 * 投入した処理は、いずれかのスレッドで一度だけ実行されます。
+	 *
+	 * @param task 処理
+	 * @param lane 処理を投入するレーン、
+	 * 	負の値ならば呼び出したスレッドのレーン（プール外からは 0 番）
+	 * @return 投入できた場合は true、できなかった場合は false
+	 */
+	virtual bool post(std::function<void()> task, int lane);
+
+	/**
+	 * 処理を投入するレーンを順に割り当てます。
+	 *
+	 * @return レーン番号
+	 */
+	virtual int assign_lane();
+
+	/**
+	 * 処理を実行するスレッドの数を取得します。
+	 *
+	 * @return スレッド数
+	 */
+	virtual size_t get_thread_count() const;
+
+	/**
+	 * シングルトンのインスタンスを取得します。
+	 *
+	 * @return worker_pool のインスタンス
+	 */
+	static worker_pool *get_instance();
+
+protected:
+	worker_pool();
+	virtual ~worker_pool();
+
+	/**
+	 * 全てのスレッドを開始します。
+	 *
+	 * ロックを確保してから呼び出します。
+	 *
+	 * @return 開始できた場合は true、できなかった場合は false
+	 */
+	virtual bool start_threads_with_lock();
+
+	/**
+	 * 自分のレーン、または他のレーンから処理を取り出します。
+	 *
+	 * @param self 自分のレーン番号
+	 * @param task 取り出した処理
+	 * @return 取り出せた場合は true、処理待ちがなければ false
+	 */
+	virtual bool take(size_t self, std::function<void()> *task);
+
+	/**
+	 * 投入された処理を実行します。
+	 *
+	 * @param self 自分のレーン番号
+	 */
+	virtual void run(size_t self);
+
+	/**
+	 * 処理を実行するスレッドの main 関数です。
+	 *
+	 * @param pool worker_pool へのポインタ
+	 * @param self 自分のレーン番号
+	 * @return 常に nullptr
+	 */
+	static void *pool_thread_main(worker_pool *pool, size_t self);
+
+private:
+	static void create_instance_once();
+
+private:
+	//スレッド毎の処理待ちキュー
+	struct lane {
+		std::mutex mut;
+		std::deque<std::function<void()> > tasks;
+	};
+
+	//スレッドの開始、休止に使用するロック
+	mutable std::mutex mut;
+	std::condition_variable cond;
+	std::vector<std::unique_ptr<lane> > lanes;
+	//スレッドを開始したか
+	std::atomic<bool> f_started;
+	//全てのレーンの処理待ちの数
+	std::atomic<size_t> n_pending;
+	//処理待ちがなく休んでいるスレッド数
+	std::atomic<size_t> n_sleeping;
+	//次に割り当てるレーン
+	std::atomic<unsigned int> cnt_assign;
+
+};
+
+} //namespace mf
+
+#endif //OMX_MF_WORKER_POOL_HPP__
@@ -0,0 +1,518 @@
+﻿
+#define __OMX_MF_EXPORTS
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <system_error>
+
+#include <omxil_mf/dprint.h>
+
+#if defined(__ANDROID__)
+#include <android/log.h>
+#endif
+
+#include "debug/async_log.hpp"
+#include "debug/tls_ring.hpp"
+#include "util/util.hpp"
+
+//Maximum length of a message passed to the log thread
+#define LOG_MSG_MAX         1024
+//Interval of the log thread to write out the messages (msec)
+#define LOG_INTERVAL_MS     10
+//Alignment of records in the ring buffer
+#define LOG_ALIGN           16
+//Length of the padding record, skip to the top of the ring buffer
+#define LOG_LEN_PAD         0xffffffffU
+
+namespace mf {
+
+/**
+ * Header of a record in the ring buffer, the message follows.
+ */
+struct log_record {
+	uint32_t len;
+	int32_t level;
+	int64_t time;
+};
+
+/**
+ * Reading position of the log thread in a ring buffer.
+ */
+struct log_cursor {
+	log_ring *ring;
+	size_t head;
+	size_t tail;
+	//Header of the next record
+	log_record rec;
+};
+
+static size_t log_record_size(size_t len)
+{
+	return (sizeof(log_record) + len + LOG_ALIGN - 1) & ~(size_t)(LOG_ALIGN - 1);
+}
+
+/**
+ * Read the header of the next record, skip the padding.
+ *
+ * @param c Reading position
+ * @return true if the record exists, false if the ring buffer is empty
+ */
+static bool log_peek(log_cursor *c)
+{
+	size_t pos;
+
+	while (c->head != c->tail) {
+		pos = c->head & (log_ring::SIZE - 1);
+		memcpy(&c->rec, &c->ring->buf[pos], sizeof(c->rec));
+		if (c->rec.len != LOG_LEN_PAD) {
+			return true;
+		}
+
+		c->head += log_ring::SIZE - pos;
+		c->ring->head.store(c->head, std::memory_order_release);
+	}
+
+	return false;
+}
+
+async_log::async_log()
+	: f_running(false), n_dropped(0), n_reported(0),
+	sink(OMX_MF_LOG_SINK_STDERR), file_sink(nullptr),
+	f_stop(false), th_log(nullptr)
+{
+	//NOTE: Do not use debug prints in this class, it calls itself.
+}
+
+async_log::~async_log()
+{
+	set_async(false);
+
+	for (log_ring *r : rings) {
+		delete r;
+	}
+	if (file_sink != nullptr) {
+		fclose(file_sink);
+	}
+}
+
+int async_log::print(int level, const char *fmt, va_list ap)
+{
+	char msg[LOG_MSG_MAX];
+	size_t len;
+	int result;
+
+	if (!f_running.load(std::memory_order_acquire) ||
+		tls_ring<log_ring>::is_exiting()) {
+		std::lock_guard<std::mutex> lk(mut_sink);
+
+		//ログスレッドがなければ、呼び出したスレッドで書き出す
+		//終了中のスレッドはリングバッファを手放しているので、同様に書き出す
+		if (sink == OMX_MF_LOG_SINK_FILE && file_sink != nullptr) {
+			result = vfprintf(file_sink, fmt, ap);
+			fflush(file_sink);
+		} else if (sink != OMX_MF_LOG_SINK_ANDROID) {
+			result = vfprintf(stderr, fmt, ap);
+			fflush(stderr);
+		} else {
+			result = vsnprintf(msg, sizeof(msg), fmt, ap);
+			if (result > 0) {
+				write_sink(level, msg, std::min((size_t)result, sizeof(msg) - 1));
+			}
+		}
+
+		return result;
+	}
+
+	result = vsnprintf(msg, sizeof(msg), fmt, ap);
+	if (result <= 0) {
+		return result;
+	}
+	len = (size_t)result;
+	if (len >= sizeof(msg)) {
+		//長すぎるメッセージは切り詰める
+		len = sizeof(msg) - 1;
+		msg[len - 1] = '\n';
+	}
+
+	push(level, msg, len);
+
+	//直後にプロセスが終了しても失われないよう、すぐに書き出す
+	if (level <= DPRINT_LEVEL_FATAL) {
+		flush();
+	}
+
+	return result;
+}
+
+bool async_log::set_async(bool enable)
+{
+	static std::once_flag once_atexit;
+	std::unique_lock<std::mutex> lock(mut_thread);
+	std::thread *th;
+
+	if (enable) {
+		if (th_log != nullptr) {
+			return true;
+		}
+
+		f_stop = false;
+		try {
+			th_log = new std::thread(log_thread_main, this);
+		} catch (const std::system_error& e) {
+			return false;
+		} catch (const std::bad_alloc& e) {
+			return false;
+		}
+		f_running.store(true, std::memory_order_release);
+
+		//終了時にバッファに残ったメッセージを書き出す
+		std::call_once(once_atexit, []() {
+				atexit(stop_at_exit);
+			});
+
+		return true;
+	}
+
+	if (th_log == nullptr) {
+		return true;
+	}
+
+	f_running.store(false, std::memory_order_release);
+	f_stop = true;
+	cond_thread.notify_all();
+
+	th = th_log;
+	th_log = nullptr;
+	lock.unlock();
+
+	th->join();
+	delete th;
+
+	//ログスレッドが最後に書き出した後に追加されたメッセージ
+	flush();
+
+	return true;
+}
+
+bool async_log::set_sink(int s, const char *path)
+{
+	FILE *f = nullptr;
+
+	switch (s) {
+	case OMX_MF_LOG_SINK_STDERR:
+		break;
+	case OMX_MF_LOG_SINK_FILE:
+		if (path == nullptr) {
+			return false;
+		}
+		f = fopen(path, "a");
+		if (f == nullptr) {
+			return false;
+		}
+		break;
+#if defined(__ANDROID__)
+	case OMX_MF_LOG_SINK_ANDROID:
+		break;
+#endif
+	default:
+		return false;
+	}
+
+	//古い宛先に渡すはずのメッセージを先に書き出す
+	flush();
+
+	std::lock_guard<std::mutex> lk(mut_sink);
+
+	if (file_sink != nullptr) {
+		fclose(file_sink);
+	}
+	sink = s;
+	file_sink = f;
+
+	return true;
+}
+
+void async_log::flush()
+{
+	std::lock_guard<std::mutex> lk(mut_drain);
+
+	drain();
+}
+
+uint64_t async_log::get_dropped() const
+{
+	return n_dropped.load(std::memory_order_relaxed);
+}
+
+//----------------------------------------
+//protected methods
+//----------------------------------------
+
+log_ring *async_log::get_ring()
+{
+	log_ring *r = tls_ring<log_ring>::get();
+
+	if (r != nullptr) {
+		return r;
+	}
+	if (tls_ring<log_ring>::is_exiting()) {
+		//終了中のスレッドには新たに割り当てない
+		return nullptr;
+	}
+
+	//スレッドが初めてメッセージを出すときだけロックする
+	r = new(std::nothrow) log_ring();
+	if (r == nullptr) {
+		return nullptr;
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(mut_rings);
+
+		rings.push_back(r);
+	}
+	tls_ring<log_ring>::set(r);
+
+	return r;
+}
+
+bool async_log::push(int level, const char *msg, size_t len)
+{
+	log_ring *r = get_ring();
+	log_record rec;
+	size_t t, h, pos, room, need, total;
+
+	if (r == nullptr) {
+		n_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	need = log_record_size(len);
+	t = r->tail.load(std::memory_order_relaxed);
+	h = r->head.load(std::memory_order_acquire);
+	pos = t & (log_ring::SIZE - 1);
+	room = log_ring::SIZE - pos;
+
+	//バッファの末尾に収まらなければ、先頭から書く
+	total = need;
+	if (room < need) {
+		total += room;
+	}
+
+	//空きがなければ待たずに捨てる
+	if (total > log_ring::SIZE - (t - h)) {
+		n_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	if (room < need) {
+		rec.len = LOG_LEN_PAD;
+		memcpy(&r->buf[pos], &rec, sizeof(rec));
+		pos = 0;
+	}
+
+	rec.len = (uint32_t)len;
+	rec.level = level;
+	rec.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	memcpy(&r->buf[pos], &rec, sizeof(rec));
+	memcpy(&r->buf[pos + sizeof(rec)], msg, len);
+
+	r->tail.store(t + total, std::memory_order_release);
+
+	return true;
+}
+
+void async_log::drain()
+{
+	std::vector<log_cursor> curs;
+	size_t i, best, pos;
+	uint64_t dropped;
+	char note[64];
+	int len;
+
+	{
+		std::lock_guard<std::mutex> lk(mut_rings);
+
+		for (log_ring *r : rings) {
+			log_cursor c;
+
+			c.ring = r;
+			c.head = r->head.load(std::memory_order_relaxed);
+			c.tail = r->tail.load(std::memory_order_acquire);
+			if (log_peek(&c)) {
+				curs.push_back(c);
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(mut_sink);
+
+		//スレッドをまたいで時刻順に書き出す
+		while (!curs.empty()) {
+			best = 0;
+			for (i = 1; i < curs.size(); i++) {
+				if (curs[i].rec.time < curs[best].rec.time) {
+					best = i;
+				}
+			}
+
+			log_cursor &c = curs[best];
+
+			pos = c.head & (log_ring::SIZE - 1);
+			write_sink(c.rec.level, &c.ring->buf[pos + sizeof(log_record)],
+				c.rec.len);
+			c.head += log_record_size(c.rec.len);
+			c.ring->head.store(c.head, std::memory_order_release);
+
+			if (!log_peek(&c)) {
+				curs[best] = curs.back();
+				curs.pop_back();
+			}
+		}
+
+		dropped = n_dropped.load(std::memory_order_relaxed);
+		if (dropped != n_reported) {
+			len = snprintf(note, sizeof(note),
+				"omxil-mf: %llu log messages dropped\n",
+				(unsigned long long)(dropped - n_reported));
+			write_sink(DPRINT_LEVEL_WARN, note, (size_t)len);
+			n_reported = dropped;
+		}
+
+		if (sink == OMX_MF_LOG_SINK_FILE && file_sink != nullptr) {
+			fflush(file_sink);
+		} else if (sink != OMX_MF_LOG_SINK_ANDROID) {
+			fflush(stderr);
+		}
+	}
+
+	//終了したスレッドのリングバッファは、読み終えたら解放する
+	{
+		std::lock_guard<std::mutex> lk(mut_rings);
+
+		for (auto it = rings.begin(); it != rings.end(); ) {
+			log_ring *r = *it;
+
+			if (r->orphaned.load(std::memory_order_acquire) &&
+				r->head.load(std::memory_order_relaxed) ==
+				r->tail.load(std::memory_order_acquire)) {
+				delete r;
+				it = rings.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+}
+
+void async_log::write_sink(int level, const char *msg, size_t len)
+{
+#if defined(__ANDROID__)
+	char buf[LOG_MSG_MAX];
+	int prio;
+#endif
+
+	switch (sink) {
+#if defined(__ANDROID__)
+	case OMX_MF_LOG_SINK_ANDROID:
+		switch (level) {
+		case DPRINT_LEVEL_FATAL:
+			prio = ANDROID_LOG_FATAL;
+			break;
+		case DPRINT_LEVEL_ERROR:
+			prio = ANDROID_LOG_ERROR;
+			break;
+		case DPRINT_LEVEL_WARN:
+			prio = ANDROID_LOG_WARN;
+			break;
+		case DPRINT_LEVEL_INFO:
+			prio = ANDROID_LOG_INFO;
+			break;
+		case DPRINT_LEVEL_DEBUG:
+			prio = ANDROID_LOG_DEBUG;
+			break;
+		default:
+			prio = ANDROID_LOG_VERBOSE;
+			break;
+		}
+
+		len = std::min(len, sizeof(buf) - 1);
+		memcpy(buf, msg, len);
+		buf[len] = '\0';
+		__android_log_write(prio, "omxil-mf", buf);
+		break;
+#endif
+	case OMX_MF_LOG_SINK_FILE:
+		if (file_sink != nullptr) {
+			fwrite(msg, 1, len, file_sink);
+			break;
+		}
+		//fall through
+	default:
+		fwrite(msg, 1, len, stderr);
+		break;
+	}
+
+	(void)level;
+}
+
+void async_log::run()
+{
+	std::unique_lock<std::mutex> lock(mut_thread);
+
+	while (!f_stop) {
+		lock.unlock();
+		flush();
+		lock.lock();
+
+		cond_thread.wait_for(lock, std::chrono::milliseconds(LOG_INTERVAL_MS),
+			[&]() {
+				return f_stop;
+			});
+	}
+}
+
+//----------------------------------------
+//static public methods
+//----------------------------------------
+
+static std::once_flag once_instance;
+static async_log *g_async_log = nullptr;
+
+async_log *async_log::get_instance(void)
+{
+	std::call_once(once_instance, create_instance_once);
+
+	return g_async_log;
+}
+
+//----------------------------------------
+//static private methods
+//----------------------------------------
+
+void async_log::create_instance_once(void)
+{
+	//NOTE: Never destruct, other threads may print until exit.
+	g_async_log = new async_log();
+}
+
+void async_log::stop_at_exit(void)
+{
+	get_instance()->set_async(false);
+}
+
+void *async_log::log_thread_main(async_log *arg)
+{
+	set_thread_name("omx:log");
+
+	arg->run();
+
+	return nullptr;
+}
+
+} //namespace mf
@@ -0,0 +1,179 @@
+﻿
+#ifndef OMX_MF_ASYNC_LOG_HPP__
+#define OMX_MF_ASYNC_LOG_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mf {
+
+/**
+ * Ring buffer of log records written by one thread.
+ *
+ * Only the owner thread writes records and only the log thread
+ * reads them, so we need no locks.
+ */
+struct log_ring {
+	//Size of the buffer, must be a power of 2
+	static const size_t SIZE = 64 * 1024;
+
+	//Total bytes read by the log thread
+	std::atomic<size_t> head;
+	//Total bytes written by the owner thread
+	std::atomic<size_t> tail;
+	//The owner thread has exited
+	std::atomic<bool> orphaned;
+	char buf[SIZE];
+
+	log_ring() : head(0), tail(0), orphaned(false)
+	{
+	}
+};
+
+/**
+ * Write debug prints on the background thread.
+ *
+ * Threads format the messages into their own ring buffers and
+ * the log thread writes them to the sink. If the ring buffer is full,
+ * the message is dropped and counted, the thread never waits.
+ *
+ * If the log thread is not running, debug prints are written to
+ * the sink on the calling thread.
+ */
+class async_log {
+public:
+	//親クラス
+	//typedef xxxx super;
+
+	/**
+	 * Format the message and write it to the sink,
+	 * or pass it to the log thread if it is running.
+	 *
+	 * @param level Debug print level
+	 * @param fmt   Format string
+	 * @param ap    Arguments
+	 * @return Number of characters of the message
+	 */
+	virtual int print(int level, const char *fmt, va_list ap);
+
+	/**
+	 * Start or stop the log thread.
+	 *
+	 * When stopping, the messages in the buffers are written
+	 * before this method returns.
+	 *
+	 * @param enable true to start, false to stop
+	 * @return true if success, false if failed to create the thread
+	 */
+	virtual bool set_async(bool enable);
+
+	/**
+	 * Change the destination of debug prints.
+	 *
+	 * @param sink Type of the sink, OMX_MF_LOG_SINK_XXXX
+	 * @param path Path of the file if the sink is OMX_MF_LOG_SINK_FILE
+	 * @return true if success, false if failed to open the file or
+	 * the sink is not supported
+	 */
+	virtual bool set_sink(int sink, const char *path);
+
+	/**
+	 * Write all messages in the buffers to the sink.
+	 */
+	virtual void flush();
+
+	/**
+	 * Get the number of messages dropped because the buffer was full.
+	 *
+	 * @return Number of dropped messages
+	 */
+	virtual uint64_t get_dropped() const;
+
+protected:
+	/**
+	 * Get the ring buffer of the calling thread.
+	 *
+	 * @return Ring buffer, nullptr if failed to allocate
+	 */
+	virtual log_ring *get_ring();
+
+	/**
+	 * Put the message to the ring buffer of the calling thread.
+	 *
+	 * @param level Debug print level
+	 * @param msg   Message
+	 * @param len   Length of the message
+	 * @return true if success, false if dropped
+	 */
+	virtual bool push(int level, const char *msg, size_t len);
+
+	/**
+	 * Write all messages in the ring buffers to the sink
+	 * in order of time. Caller must hold mut_drain.
+	 */
+	virtual void drain();
+
+	/**
+	 * Write a message to the sink. Caller must hold mut_sink.
+	 *
+	 * @param level Debug print level
+	 * @param msg   Message, need not be terminated by NUL
+	 * @param len   Length of the message
+	 */
+	virtual void write_sink(int level, const char *msg, size_t len);
+
+	/**
+	 * Main loop of the log thread.
+	 */
+	virtual void run();
+
+private:
+	async_log();
+	virtual ~async_log();
+
+private:
+	std::atomic<bool> f_running;
+	std::atomic<uint64_t> n_dropped;
+	uint64_t n_reported;
+
+	//Protect rings
+	std::mutex mut_rings;
+	std::vector<log_ring *> rings;
+
+	//Only one thread reads the ring buffers at once
+	std::mutex mut_drain;
+
+	//Protect the sink
+	std::mutex mut_sink;
+	int sink;
+	FILE *file_sink;
+
+	//Start/stop the log thread
+	std::mutex mut_thread;
+	std::condition_variable cond_thread;
+	bool f_stop;
+	std::thread *th_log;
+
+public:
+	/**
+	 * Get the singleton instance of this class.
+	 *
+	 * @return Pointer of singleton instance of this class.
+	 */
+	static async_log *get_instance(void);
+
+private:
+	static void create_instance_once(void);
+	static void stop_at_exit(void);
+	static void *log_thread_main(async_log *arg);
+};
+
+} //namespace mf
+
+#endif //OMX_MF_ASYNC_LOG_HPP__
@@ -6,6 +6,8 @@
 
 #include <omxil_mf/dprint.h>
 
+#include "debug/async_log.hpp"
+
 #if defined(__linux__) && defined(__ANDROID__)
 //For Android
 #include <utils/Log.h>
@@ -27,18 +29,22 @@
 #endif
 
 //Debug print level
-static int debug_level = DPRINT_LEVEL_DEFAULT;
+int OMX_MF_debug_level = DPRINT_LEVEL_DEFAULT;
 
 OMX_MF_API int OMX_MF_get_debug_level()
 {
-	return debug_level;
+	return OMX_MF_debug_level_load();
 }
 
 OMX_MF_API int OMX_MF_set_debug_level(int level)
 {
-	debug_level = level;
+#if defined(__GNUC__) || defined(__clang__)
+	__atomic_store_n(&OMX_MF_debug_level, level, __ATOMIC_RELAXED);
+#else
+	OMX_MF_debug_level = level;
+#endif
 
-	return debug_level;
+	return level;
 }
 
 OMX_MF_API int OMX_MF_print_cont(int level, const char *fmt, ...)
@@ -46,14 +52,41 @@ OMX_MF_API int OMX_MF_print_cont(int level, const char *fmt, ...)
 	va_list ap;
 	int result;
 
-	if (level > debug_level) {
+	if (level > OMX_MF_debug_level_load()) {
 		return 0;
 	}
 
 	va_start(ap, fmt);
-	result = vfprintf(stderr, fmt, ap);
-	fflush(stderr);
+	result = mf::async_log::get_instance()->print(level, fmt, ap);
 	va_end(ap);
 
 	return result;
 }
+
+OMX_MF_API int OMX_MF_set_log_async(int enable)
+{
+	if (!mf::async_log::get_instance()->set_async(enable != 0)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+OMX_MF_API int OMX_MF_set_log_sink(int sink, const char *path)
+{
+	if (!mf::async_log::get_instance()->set_sink(sink, path)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+OMX_MF_API void OMX_MF_flush_log(void)
+{
+	mf::async_log::get_instance()->flush();
+}
+
+OMX_MF_API unsigned long long OMX_MF_get_log_dropped(void)
+{
+	return mf::async_log::get_instance()->get_dropped();
+}
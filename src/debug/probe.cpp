@@ -0,0 +1,16 @@
+﻿
+#include "debug/probe.hpp"
+
+#if defined(ENABLE_USDT)
+
+//Semaphores of the probes, tracers count up while attached
+OMX_MF_PROBE_DEFINE(push_buffer);
+OMX_MF_PROBE_DEFINE(pop_buffer);
+OMX_MF_PROBE_DEFINE(push_buffer_done);
+OMX_MF_PROBE_DEFINE(buffer_done);
+OMX_MF_PROBE_DEFINE(command_send);
+OMX_MF_PROBE_DEFINE(command_start);
+OMX_MF_PROBE_DEFINE(command_done);
+OMX_MF_PROBE_DEFINE(state_change);
+
+#endif //ENABLE_USDT
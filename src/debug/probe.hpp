@@ -0,0 +1,79 @@
+﻿
+#ifndef OMX_MF_PROBE_HPP__
+#define OMX_MF_PROBE_HPP__
+
+#if defined(__linux__)
+//For autoconf
+#include "config.h"
+#endif
+
+/*
+ * USDT (User Statically-Defined Tracing) probes for perf, bpftrace and
+ * SystemTap, enabled by configure --enable-usdt.
+ *
+ * The probe is a nop instruction, arguments are evaluated only while
+ * a tracer is attached (the tracer increments the semaphore).
+ * See doc/usdt/ for examples.
+ *
+ * Provider: omxil_mf
+ *
+ * push_buffer     (comp name, port index, buffer header)
+ * pop_buffer      (comp name, port index, buffer header)
+ * push_buffer_done(comp name, port index, buffer header)
+ * buffer_done     (comp name, port index, buffer header)
+ *                  also fired when the buffer is handed directly to
+ *                  the tunneled peer port, after the peer accepted it
+ * command_send    (comp name, command, param)
+ * command_start   (comp name, command, param)
+ * command_done    (comp name, command, param, error)
+ * state_change    (comp name, old state, new state)
+ */
+
+#if defined(ENABLE_USDT)
+
+#define _SDT_HAS_SEMAPHORES    1
+#include <sys/sdt.h>
+
+#define OMX_MF_PROBE_SEMAPHORE(name)    omxil_mf_##name##_semaphore
+
+#define OMX_MF_PROBE_DECLARE(name) \
+	extern "C" unsigned short OMX_MF_PROBE_SEMAPHORE(name)
+
+#define OMX_MF_PROBE_DEFINE(name) \
+	extern "C" unsigned short OMX_MF_PROBE_SEMAPHORE(name) \
+		__attribute__((used, section(".probes"))) = 0
+
+#define OMX_MF_PROBE_ENABLED(name) \
+	__builtin_expect(OMX_MF_PROBE_SEMAPHORE(name) != 0, 0)
+
+#define OMX_MF_PROBE3(name, a1, a2, a3) \
+	do { \
+		if (OMX_MF_PROBE_ENABLED(name)) { \
+			DTRACE_PROBE3(omxil_mf, name, a1, a2, a3); \
+		} \
+	} while (0)
+
+#define OMX_MF_PROBE4(name, a1, a2, a3, a4) \
+	do { \
+		if (OMX_MF_PROBE_ENABLED(name)) { \
+			DTRACE_PROBE4(omxil_mf, name, a1, a2, a3, a4); \
+		} \
+	} while (0)
+
+OMX_MF_PROBE_DECLARE(push_buffer);
+OMX_MF_PROBE_DECLARE(pop_buffer);
+OMX_MF_PROBE_DECLARE(push_buffer_done);
+OMX_MF_PROBE_DECLARE(buffer_done);
+OMX_MF_PROBE_DECLARE(command_send);
+OMX_MF_PROBE_DECLARE(command_start);
+OMX_MF_PROBE_DECLARE(command_done);
+OMX_MF_PROBE_DECLARE(state_change);
+
+#else
+
+#define OMX_MF_PROBE3(name, a1, a2, a3)        do { } while (0)
+#define OMX_MF_PROBE4(name, a1, a2, a3, a4)    do { } while (0)
+
+#endif //ENABLE_USDT
+
+#endif //OMX_MF_PROBE_HPP__
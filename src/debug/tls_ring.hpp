@@ -0,0 +1,99 @@
+﻿
+#ifndef OMX_MF_TLS_RING_HPP__
+#define OMX_MF_TLS_RING_HPP__
+
+#include <atomic>
+
+namespace mf {
+
+/**
+ * Per-thread pointer to a ring buffer owned by a collector
+ * (the log thread, or the tracer).
+ *
+ * When the thread exits, the pointer is cleared before the ring is
+ * marked as orphaned, so the collector can free it safely.
+ * After that, the thread cannot get a new ring. Debug prints and
+ * trace events from later thread_local destructors must not use
+ * the ring (is_exiting() returns true).
+ *
+ * T must have a member 'std::atomic<bool> orphaned'.
+ */
+template <class T>
+class tls_ring {
+public:
+	/**
+	 * Get the ring buffer of the calling thread.
+	 *
+	 * @return Ring buffer, nullptr if not set yet or the thread is exiting
+	 */
+	static T *get()
+	{
+		return ring;
+	}
+
+	/**
+	 * Set the ring buffer of the calling thread.
+	 *
+	 * @param r Ring buffer
+	 * @return true if set, false if the thread is exiting
+	 * (the caller still owns r)
+	 */
+	static bool set(T *r)
+	{
+		if (f_exiting) {
+			return false;
+		}
+
+		//Register the destructor of the holder at the first use
+		holder.touch();
+		ring = r;
+
+		return true;
+	}
+
+	/**
+	 * Check whether the calling thread is exiting.
+	 *
+	 * @return true if the ring buffer of the thread has been released
+	 */
+	static bool is_exiting()
+	{
+		return f_exiting;
+	}
+
+private:
+	struct ring_holder {
+		void touch()
+		{
+		}
+
+		~ring_holder()
+		{
+			T *r = ring;
+
+			ring = nullptr;
+			f_exiting = true;
+			if (r != nullptr) {
+				r->orphaned.store(true, std::memory_order_release);
+			}
+		}
+	};
+
+	//Trivially destructible, readable even in other thread_local destructors
+	static thread_local T *ring;
+	static thread_local bool f_exiting;
+	static thread_local ring_holder holder;
+};
+
+template <class T>
+thread_local T *tls_ring<T>::ring = nullptr;
+
+template <class T>
+thread_local bool tls_ring<T>::f_exiting = false;
+
+template <class T>
+thread_local typename tls_ring<T>::ring_holder tls_ring<T>::holder;
+
+} //namespace mf
+
+#endif //OMX_MF_TLS_RING_HPP__
@@ -0,0 +1,240 @@
+﻿
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include "debug/tls_ring.hpp"
+#include "debug/trace.hpp"
+#include "util/util.hpp"
+
+namespace mf {
+
+std::atomic<bool> trace::f_enabled(false);
+
+/**
+ * Write the string as JSON string.
+ *
+ * @param f File
+ * @param s String
+ */
+static void write_json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			fputc('\\', f);
+			fputc(*s, f);
+		} else if ((unsigned char)*s < 0x20) {
+			fprintf(f, "\\u%04x", (unsigned char)*s);
+		} else {
+			fputc(*s, f);
+		}
+	}
+	fputc('"', f);
+}
+
+trace::trace()
+{
+	//NOTE: Do not use debug prints in this class, tracing must be cheap.
+}
+
+trace::~trace()
+{
+	for (trace_ring *r : rings) {
+		delete r;
+	}
+}
+
+void trace::start()
+{
+	std::lock_guard<std::mutex> lk(mut_rings);
+
+	//Discard old events, and free buffers of exited threads
+	for (auto it = rings.begin(); it != rings.end(); ) {
+		trace_ring *r = *it;
+
+		if (r->orphaned.load(std::memory_order_acquire)) {
+			delete r;
+			it = rings.erase(it);
+		} else {
+			//記録中のスレッドの数を書き換えないよう、開始位置を覚える
+			r->n_base = r->n_written.load(std::memory_order_acquire);
+			++it;
+		}
+	}
+
+	f_enabled.store(true, std::memory_order_release);
+}
+
+void trace::stop()
+{
+	f_enabled.store(false, std::memory_order_release);
+}
+
+bool trace::write_json(const char *path)
+{
+	std::lock_guard<std::mutex> lk(mut_rings);
+	FILE *f;
+	uint64_t n, i, oldest;
+	bool first = true;
+	int pid = get_process_id();
+
+	f = fopen(path, "w");
+	if (f == nullptr) {
+		return false;
+	}
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	for (trace_ring *r : rings) {
+		n = r->n_written.load(std::memory_order_acquire);
+
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+			"\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+			(first) ? "" : ",\n", pid, r->tid);
+		write_json_string(f, r->thname);
+		fprintf(f, "}}");
+		first = false;
+
+		//記録中のスレッドが上書きしているかもしれない、最も古いものは除く
+		oldest = (n > trace_ring::SIZE) ? n - trace_ring::SIZE + 1 : 0;
+		for (i = std::max(oldest, r->n_base); i < n; i++) {
+			const trace_event &e = r->events[i & (trace_ring::SIZE - 1)];
+			const trace_point *tp = e.point;
+
+			fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\","
+				"\"ts\":%lld.%03d,\"pid\":%d,\"tid\":%d",
+				tp->name, tp->cat, e.phase,
+				(long long)(e.time / 1000), (int)(e.time % 1000),
+				pid, r->tid);
+			if (e.phase == 'i') {
+				fprintf(f, ",\"s\":\"t\"");
+			}
+			if (tp->arg0 != nullptr || tp->arg1 != nullptr) {
+				fprintf(f, ",\"args\":{");
+				if (tp->arg0 != nullptr) {
+					fprintf(f, "\"%s\":%lld", tp->arg0,
+						(long long)e.arg0);
+				}
+				if (tp->arg1 != nullptr) {
+					fprintf(f, "%s\"%s\":", (tp->arg0 != nullptr) ? "," : "",
+						tp->arg1);
+					if (tp->arg1_hex) {
+						fprintf(f, "\"0x%llx\"", (unsigned long long)e.arg1);
+					} else {
+						fprintf(f, "%llu", (unsigned long long)e.arg1);
+					}
+				}
+				fprintf(f, "}");
+			}
+			fprintf(f, "}");
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+
+	if (fclose(f) != 0) {
+		return false;
+	}
+
+	return true;
+}
+
+void trace::set_thread_name(const char *name)
+{
+	trace_ring *r = tls_ring<trace_ring>::get();
+
+	if (r == nullptr) {
+		//Set when the thread records the first event
+		return;
+	}
+
+	std::lock_guard<std::mutex> lk(mut_rings);
+
+	strncpy(r->thname, name, sizeof(r->thname) - 1);
+}
+
+void trace::record(char phase, const trace_point *tp, int64_t arg0, uint64_t arg1)
+{
+	trace_ring *r = get_ring();
+	uint64_t n;
+
+	if (r == nullptr) {
+		return;
+	}
+
+	n = r->n_written.load(std::memory_order_relaxed);
+
+	trace_event &e = r->events[n & (trace_ring::SIZE - 1)];
+
+	e.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	e.point = tp;
+	e.arg0 = arg0;
+	e.arg1 = arg1;
+	e.phase = phase;
+
+	r->n_written.store(n + 1, std::memory_order_release);
+}
+
+//----------------------------------------
+//protected methods
+//----------------------------------------
+
+trace_ring *trace::get_ring()
+{
+	trace_ring *r = tls_ring<trace_ring>::get();
+
+	if (r != nullptr) {
+		return r;
+	}
+	if (tls_ring<trace_ring>::is_exiting()) {
+		//終了中のスレッドには新たに割り当てない
+		return nullptr;
+	}
+
+	//スレッドが初めて記録するときだけロックする
+	r = new(std::nothrow) trace_ring();
+	if (r == nullptr) {
+		return nullptr;
+	}
+	r->tid = get_thread_id();
+	get_thread_name(r->thname, sizeof(r->thname));
+
+	{
+		std::lock_guard<std::mutex> lk(mut_rings);
+
+		rings.push_back(r);
+	}
+	tls_ring<trace_ring>::set(r);
+
+	return r;
+}
+
+//----------------------------------------
+//static public methods
+//----------------------------------------
+
+static std::once_flag once_instance;
+static trace *g_trace = nullptr;
+
+trace *trace::get_instance(void)
+{
+	std::call_once(once_instance, create_instance_once);
+
+	return g_trace;
+}
+
+//----------------------------------------
+//static private methods
+//----------------------------------------
+
+void trace::create_instance_once(void)
+{
+	//NOTE: Never destruct, other threads may record until exit.
+	g_trace = new trace();
+}
+
+} //namespace mf
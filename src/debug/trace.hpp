@@ -0,0 +1,205 @@
+﻿
+#ifndef OMX_MF_TRACE_HPP__
+#define OMX_MF_TRACE_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace mf {
+
+/**
+ * Place in the code where the trace event is recorded.
+ *
+ * Define as a static constant for each place.
+ */
+struct trace_point {
+	//Name of the event
+	const char *name;
+	//Category of the event
+	const char *cat;
+	//Names of the arguments, nullptr if not used
+	const char *arg0;
+	const char *arg1;
+	//Show arg1 in hexadecimal (ex. address of the buffer)
+	bool arg1_hex;
+};
+
+/**
+ * Trace event in the ring buffer.
+ */
+struct trace_event {
+	int64_t time;
+	const trace_point *point;
+	int64_t arg0;
+	uint64_t arg1;
+	//'B': begin, 'E': end, 'i': instant
+	char phase;
+};
+
+/**
+ * Ring buffer of trace events recorded by one thread.
+ *
+ * If the buffer is full, the oldest events are overwritten.
+ */
+struct trace_ring {
+	//Number of events, must be a power of 2
+	static const size_t SIZE = 8192;
+
+	//Total number of events recorded, written only by the owner thread
+	std::atomic<uint64_t> n_written;
+	//n_written at the last start(), protected by trace::mut_rings
+	uint64_t n_base;
+	//The owner thread has exited
+	std::atomic<bool> orphaned;
+	int tid;
+	char thname[16];
+	trace_event events[SIZE];
+
+	trace_ring() : n_written(0), n_base(0), orphaned(false), tid(0), thname()
+	{
+	}
+};
+
+/**
+ * Record the timestamped events of the framework and
+ * write them as Chrome trace JSON (for chrome://tracing or Perfetto).
+ */
+class trace {
+public:
+	//親クラス
+	//typedef xxxx super;
+
+	/**
+	 * Start recording, discard the events recorded before.
+	 */
+	virtual void start();
+
+	/**
+	 * Stop recording.
+	 */
+	virtual void stop();
+
+	/**
+	 * Write the recorded events as Chrome trace JSON.
+	 *
+	 * Stop recording before calling this method.
+	 *
+	 * @param path Path of the file
+	 * @return true if success, false if failed to write the file
+	 */
+	virtual bool write_json(const char *path);
+
+	/**
+	 * Set the name of the calling thread shown in the trace.
+	 *
+	 * @param name Name of the thread
+	 */
+	virtual void set_thread_name(const char *name);
+
+	/**
+	 * Record the event on the ring buffer of the calling thread.
+	 *
+	 * @param phase 'B': begin, 'E': end, 'i': instant
+	 * @param tp    Place of the event
+	 * @param arg0  First argument
+	 * @param arg1  Second argument
+	 */
+	virtual void record(char phase, const trace_point *tp, int64_t arg0, uint64_t arg1);
+
+	/**
+	 * Is recording enabled or not?
+	 *
+	 * @return true if recording, false if not
+	 */
+	static bool is_enabled()
+	{
+		return f_enabled.load(std::memory_order_relaxed);
+	}
+
+protected:
+	/**
+	 * Get the ring buffer of the calling thread.
+	 *
+	 * @return Ring buffer, nullptr if failed to allocate
+	 */
+	virtual trace_ring *get_ring();
+
+private:
+	trace();
+	virtual ~trace();
+
+private:
+	static std::atomic<bool> f_enabled;
+
+	//Protect rings and names of the threads
+	std::mutex mut_rings;
+	std::vector<trace_ring *> rings;
+
+public:
+	/**
+	 * Get the singleton instance of this class.
+	 *
+	 * @return Pointer of singleton instance of this class.
+	 */
+	static trace *get_instance(void);
+
+private:
+	static void create_instance_once(void);
+};
+
+/**
+ * Record the begin event now and the end event at the end of the scope.
+ */
+class scoped_trace {
+public:
+	scoped_trace(const trace_point *tp, int64_t arg0, uint64_t arg1)
+		: point(tp), a0(arg0), a1(arg1), f_enabled(trace::is_enabled())
+	{
+		if (f_enabled) {
+			trace::get_instance()->record('B', point, a0, a1);
+		}
+	}
+
+	~scoped_trace()
+	{
+		if (f_enabled) {
+			trace::get_instance()->record('E', point, a0, a1);
+		}
+	}
+
+	/**
+	 * Change the second argument recorded with the end event.
+	 *
+	 * @param v New value
+	 */
+	void set_arg1(uint64_t v)
+	{
+		a1 = v;
+	}
+
+private:
+	const trace_point *point;
+	int64_t a0;
+	uint64_t a1;
+	bool f_enabled;
+};
+
+/**
+ * Record the instant event.
+ *
+ * @param tp   Place of the event
+ * @param arg0 First argument
+ * @param arg1 Second argument
+ */
+static inline void trace_instant(const trace_point *tp, int64_t arg0, uint64_t arg1)
+{
+	if (trace::is_enabled()) {
+		trace::get_instance()->record('i', tp, arg0, arg1);
+	}
+}
+
+} //namespace mf
+
+#endif //OMX_MF_TRACE_HPP__
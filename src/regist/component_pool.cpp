@@ -0,0 +1,338 @@
+﻿
+#define __OMX_MF_EXPORTS
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include <OMX_Core.h>
+
+#include <omxil_mf/omxil_mf.h>
+#include <omxil_mf/component.hpp>
+#include <omxil_mf/scoped_log.hpp>
+
+#include "regist/component_pool.hpp"
+#include "regist/register_component.hpp"
+
+namespace mf {
+
+component_pool::component_pool()
+{
+	scoped_log_begin;
+}
+
+component_pool::~component_pool()
+{
+	scoped_log_begin;
+
+	clear();
+}
+
+OMX_ERRORTYPE component_pool::set_capacity(const char *name, OMX_U32 n)
+{
+	scoped_log_begin;
+	std::vector<OMX_COMPONENTTYPE *> added, removed;
+	OMX_COMPONENTTYPE *omx_comp;
+	size_t n_create = 0;
+	OMX_ERRORTYPE err = OMX_ErrorNone;
+
+	if (name == nullptr) {
+		return OMX_ErrorBadParameter;
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(mut_pool);
+		auto it = map_pool.find(name);
+
+		if (n == 0) {
+			if (it != map_pool.end()) {
+				removed.swap(it->second.idle);
+				map_pool.erase(it);
+			}
+		} else {
+			pool_info &pinfo = map_pool[name];
+
+			pinfo.capacity = n;
+			while (pinfo.idle.size() > n) {
+				removed.push_back(pinfo.idle.back());
+				pinfo.idle.pop_back();
+			}
+			n_create = n - pinfo.idle.size();
+		}
+	}
+
+	//生成、破棄は時間がかかるためロックの外で行う
+	destroy_components(removed);
+	for (size_t i = 0; i < n_create; i++) {
+		err = create_component(name, &omx_comp, true);
+		if (err != OMX_ErrorNone) {
+			break;
+		}
+		added.push_back(omx_comp);
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(mut_pool);
+		auto it = map_pool.find(name);
+
+		if (err != OMX_ErrorNone && it != map_pool.end() &&
+			it->second.idle.empty() && added.empty()) {
+			//1つも生成できないプールは残さない
+			map_pool.erase(it);
+			it = map_pool.end();
+		}
+
+		removed.clear();
+		for (OMX_COMPONENTTYPE *c : added) {
+			//生成中に容量が変更された場合、超えた分は破棄する
+			if (it == map_pool.end() ||
+				it->second.idle.size() >= it->second.capacity) {
+				removed.push_back(c);
+				continue;
+			}
+			it->second.idle.push_back(c);
+		}
+	}
+
+	destroy_components(removed);
+
+	return err;
+}
+
+OMX_COMPONENTTYPE *component_pool::acquire(const char *name)
+{
+	scoped_log_begin;
+	std::lock_guard<std::mutex> lk(mut_pool);
+	OMX_COMPONENTTYPE *omx_comp;
+
+	if (name == nullptr) {
+		return nullptr;
+	}
+
+	auto it = map_pool.find(name);
+	if (it == map_pool.end() || it->second.idle.empty()) {
+		return nullptr;
+	}
+
+	omx_comp = it->second.idle.back();
+	it->second.idle.pop_back();
+
+	return omx_comp;
+}
+
+bool component_pool::release(OMX_COMPONENTTYPE *omx_comp)
+{
+	scoped_log_begin;
+	component *comp = component::get_instance(omx_comp);
+	OMX_ERRORTYPE err;
+
+	//set_capacity() で生成したインスタンスだけを再利用する
+	if (comp == nullptr || !comp->has_saved_defaults()) {
+		return false;
+	}
+
+	const std::string& name = comp->get_component_name();
+
+	{
+		std::lock_guard<std::mutex> lk(mut_pool);
+
+		auto it = map_pool.find(name);
+		if (it == map_pool.end() ||
+			it->second.idle.size() >= it->second.capacity) {
+			return false;
+		}
+	}
+
+	err = comp->reset_to_defaults();
+	if (err != OMX_ErrorNone) {
+		errprint("Cannot reset component '%s', not pooled.\n",
+			name.c_str());
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(mut_pool);
+
+		//リセット中に容量が変更されていたら改めて確認する
+		auto it = map_pool.find(name);
+		if (it == map_pool.end() ||
+			it->second.idle.size() >= it->second.capacity) {
+			return false;
+		}
+		it->second.idle.push_back(omx_comp);
+	}
+
+	return true;
+}
+
+void component_pool::clear()
+{
+	scoped_log_begin;
+	std::vector<OMX_COMPONENTTYPE *> removed;
+	map_pool_type m;
+
+	{
+		std::lock_guard<std::mutex> lk(mut_pool);
+
+		m.swap(map_pool);
+	}
+
+	for (auto& elem : m) {
+		removed.insert(removed.end(),
+			elem.second.idle.begin(), elem.second.idle.end());
+	}
+	destroy_components(removed);
+}
+
+//----------------------------------------
+//static public methods
+//----------------------------------------
+
+OMX_ERRORTYPE component_pool::create_component(const char *name, OMX_COMPONENTTYPE **omx_comp, bool f_pooled)
+{
+	scoped_log_begin;
+	register_component *rc = register_component::get_instance();
+	const register_info *rinfo = nullptr;
+	OMX_COMPONENTTYPE *c = nullptr;
+	void *ptr = nullptr;
+
+	rinfo = rc->load(name);
+	if (rinfo == nullptr) {
+		errprint("Not found component '%s'.\n", name);
+		return OMX_ErrorInvalidComponentName;
+	}
+
+	//Create base component
+	c = new OMX_COMPONENTTYPE;
+
+	//Create derived component.
+	//Call original constructor of extend libraries
+	//instead of 'new comp'.
+	//It is because we need not know the class type of
+	//derived component.
+	ptr = rinfo->comp_info->constructor(c, name);
+	if (ptr == nullptr) {
+		errprint("Failed to create component '%s'.\n", name);
+		delete c;
+		return OMX_ErrorInsufficientResources;
+	}
+
+	//Keep the settings to reuse this instance by the pool,
+	//other instances are destroyed by OMX_FreeHandle
+	if (f_pooled) {
+		component::get_instance(c)->save_defaults();
+	}
+
+	*omx_comp = c;
+
+	return OMX_ErrorNone;
+}
+
+void component_pool::destroy_component(OMX_COMPONENTTYPE *omx_comp)
+{
+	scoped_log_begin;
+	register_component *rc = register_component::get_instance();
+	const register_info *rinfo = nullptr;
+
+	//Stop all threads at once, destructors of the ports and workers
+	//only wait for the threads have already been stopping
+	if (omx_comp->pComponentPrivate != nullptr) {
+		component::get_instance(omx_comp)->shutdown_threads();
+	}
+
+	omx_comp->ComponentDeInit(omx_comp);
+
+	//Delete derived component
+	if (omx_comp->pComponentPrivate != nullptr) {
+		component *comp = component::get_instance(omx_comp);
+
+		//Call original destructor of extend libraries
+		//instead of 'delete comp'.
+		rinfo = rc->find(comp->get_component_name().c_str());
+		if (rinfo == nullptr) {
+			//not found
+			errprint("Not found component '%s'.\n", comp->get_component_name().c_str());
+		} else {
+			rinfo->comp_info->destructor(omx_comp);
+		}
+	}
+
+	//Delete base component
+	delete(omx_comp);
+}
+
+void component_pool::destroy_components(const std::vector<OMX_COMPONENTTYPE *>& omx_comps)
+{
+	scoped_log_begin;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> next(0);
+	size_t n_threads;
+
+	if (omx_comps.size() <= 1) {
+		for (OMX_COMPONENTTYPE *c : omx_comps) {
+			destroy_component(c);
+		}
+		return;
+	}
+
+	//全てのコンポーネントのスレッドに先に終了を指示する
+	for (OMX_COMPONENTTYPE *c : omx_comps) {
+		if (c->pComponentPrivate != nullptr) {
+			component::get_instance(c)->shutdown_threads();
+		}
+	}
+
+	//破棄はほとんどスレッドの終了待ちのため、CPU 数より多めに並べる
+	n_threads = std::max(std::thread::hardware_concurrency(), 2U) * 2;
+	n_threads = std::min(n_threads, omx_comps.size());
+
+	auto destroy_next = [&] {
+		size_t i;
+
+		while ((i = next++) < omx_comps.size()) {
+			destroy_component(omx_comps[i]);
+		}
+	};
+
+	for (size_t i = 1; i < n_threads; i++) {
+		try {
+			threads.push_back(std::thread(destroy_next));
+		} catch (const std::system_error& e) {
+			//スレッドを作れなければ、作れた分と自身で破棄する
+			errprint("failed to create thread '%s'.\n", e.what());
+			break;
+		}
+	}
+	destroy_next();
+
+	for (auto& th : threads) {
+		th.join();
+	}
+}
+
+static std::once_flag once_instance;
+static component_pool *g_comp_pool = nullptr;
+
+component_pool *component_pool::get_instance(void)
+{
+	scoped_log_begin;
+
+	std::call_once(once_instance, create_instance_once);
+
+	return g_comp_pool;
+}
+
+//----------------------------------------
+//static private methods
+//----------------------------------------
+
+void component_pool::create_instance_once(void)
+{
+	scoped_log_begin;
+
+	g_comp_pool = new component_pool();
+}
+
+} //namespace mf
@@ -0,0 +1,122 @@
+﻿
+#ifndef OMX_MF_COMPONENT_POOL_HPP__
+#define OMX_MF_COMPONENT_POOL_HPP__
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+namespace mf {
+
+struct pool_info {
+	//Maximum number of idle instances
+	OMX_U32 capacity;
+	//Constructed instances, these are in Loaded state
+	std::vector<OMX_COMPONENTTYPE *> idle;
+};
+
+class component_pool {
+public:
+	//親クラス
+	//typedef xxxx super;
+
+	typedef std::map<std::string, pool_info> map_pool_type;
+
+	/**
+	 * Set the capacity of the pool of the component.
+	 *
+	 * Construct instances until the pool has n idle instances,
+	 * or destruct instances over the capacity.
+	 *
+	 * @param name Name of the component
+	 * @param n    Maximum number of idle instances, 0 removes the pool
+	 * @return OpenMAX error value
+	 */
+	virtual OMX_ERRORTYPE set_capacity(const char *name, OMX_U32 n);
+
+	/**
+	 * Take an idle instance of the component from the pool.
+	 *
+	 * @param name Name of the component
+	 * @return Instance of the component,
+	 * nullptr if the pool does not exist or is empty.
+	 */
+	virtual OMX_COMPONENTTYPE *acquire(const char *name);
+
+	/**
+	 * Reset the instance to the defaults and return it to the pool.
+	 *
+	 * @param omx_comp Instance of the component in Loaded state
+	 * @return true if the pool takes the instance,
+	 * false if the pool is full, does not exist,
+	 * the instance was not created by set_capacity() or
+	 * the instance cannot be reset.
+	 */
+	virtual bool release(OMX_COMPONENTTYPE *omx_comp);
+
+	/**
+	 * Destruct all idle instances and remove all pools.
+	 *
+	 * We should call this method before unloading libraries of
+	 * the components.
+	 */
+	virtual void clear();
+
+	/**
+	 * Construct a new instance of the component.
+	 *
+	 * Only the instances for the pool save their defaults,
+	 * release() does not take back the other instances.
+	 *
+	 * @param name     Name of the component
+	 * @param omx_comp Pointer to receive the instance
+	 * @param f_pooled true if the instance is created for the pool
+	 * @return OpenMAX error value
+	 */
+	static OMX_ERRORTYPE create_component(const char *name, OMX_COMPONENTTYPE **omx_comp, bool f_pooled);
+
+	/**
+	 * Destruct the instance of the component.
+	 *
+	 * @param omx_comp Instance of the component
+	 */
+	static void destroy_component(OMX_COMPONENTTYPE *omx_comp);
+
+	/**
+	 * Destruct the instances of the components in parallel.
+	 *
+	 * Signal all threads of all components to stop first,
+	 * and then destruct the components on several threads.
+	 *
+	 * @param omx_comps Instances of the components,
+	 * must not contain the same instance twice.
+	 */
+	static void destroy_components(const std::vector<OMX_COMPONENTTYPE *>& omx_comps);
+
+private:
+	component_pool();
+	virtual ~component_pool();
+
+private:
+	std::mutex mut_pool;
+	map_pool_type map_pool;
+
+public:
+	/**
+	 * Get the singleton instance of this class.
+	 *
+	 * @return Pointer of singleton instance of this class.
+	 */
+	static component_pool *get_instance(void);
+
+private:
+	static void create_instance_once(void);
+};
+
+} //namespace mf
+
+#endif //OMX_MF_COMPONENT_POOL_HPP__
@@ -2,8 +2,12 @@
 #define __OMX_MF_EXPORTS
 
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <mutex>
+#include <sstream>
 
 #include <OMX_Core.h>
 
@@ -11,16 +15,87 @@
 #include <omxil_mf/component.hpp>
 #include <omxil_mf/scoped_log.hpp>
 
+#include "builtin/builtin_components.hpp"
 #include "regist/register_component.hpp"
 #include "util/util.hpp"
 
 namespace mf {
 
-register_component::register_component() : f_init(false)
+/**
+ * 名前のハッシュ値を計算します（FNV-1a）。
+ *
+ * @param name 名前
+ * @return ハッシュ値
+ */
+static uint32_t hash_name(const char *name)
+{
+	uint32_t h = 2166136261U;
+
+	for (const char *p = name; *p != '\0'; p++) {
+		h ^= (uint8_t)*p;
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+/**
+ * 名前の配列から、オープンアドレス法のハッシュ索引を作成します。
+ *
+ * 索引の大きさは 2の冪乗で、要素数の 2倍以上とします。
+ *
+ * @param names 名前を返す関数
+ * @param n     要素数
+ * @param index 作成した索引
+ */
+template <typename F>
+static void build_hash_index(F names, size_t n, std::vector<uint32_t> *index)
+{
+	size_t len = 16, mask, pos;
+
+	while (len < n * 2) {
+		len *= 2;
+	}
+	mask = len - 1;
+
+	index->assign(len, 0);
+	for (size_t i = 0; i < n; i++) {
+		pos = hash_name(names(i)) & mask;
+		while ((*index)[pos] != 0) {
+			pos = (pos + 1) & mask;
+		}
+		(*index)[pos] = (uint32_t)(i + 1);
+	}
+}
+
+/**
+ * ハッシュ索引から名前を探します。
+ *
+ * @param names 名前を返す関数
+ * @param index ハッシュ索引
+ * @param name  探す名前
+ * @return 見つかった要素の番号、見つからなければ -1
+ */
+template <typename F>
+static ssize_t find_hash_index(F names, const std::vector<uint32_t>& index, const char *name)
+{
+	size_t mask = index.size() - 1, pos;
+
+	for (pos = hash_name(name) & mask; index[pos] != 0; pos = (pos + 1) & mask) {
+		if (strcmp(names(index[pos] - 1), name) == 0) {
+			return index[pos] - 1;
+		}
+	}
+
+	return -1;
+}
+
+register_component::register_component()
+	: f_init(false), snap(nullptr), f_dirty(true)
 {
 	scoped_log_begin;
 
-	//do nothing
+	publish();
 }
 
 register_component::~register_component()
@@ -28,6 +103,7 @@ register_component::~register_component()
 	scoped_log_begin;
 
 	deinit();
+	delete snap.load();
 }
 
 void register_component::init()
@@ -35,6 +111,10 @@ void register_component::init()
 	std::lock_guard<std::recursive_mutex> lock(mut_map);
 
 	load_components();
+	publish();
+
+	//dump all registered components
+	dump();
 
 	f_init = true;
 }
@@ -45,6 +125,13 @@ void register_component::deinit()
 
 	clear();
 	unload_components();
+	publish();
+
+	//古いスナップショットを参照している読み手はもういないはず
+	for (register_snapshot *s : retired_snaps) {
+		delete s;
+	}
+	retired_snaps.clear();
 
 	f_init = false;
 }
@@ -54,12 +141,11 @@ bool register_component::is_init()
 	return f_init;
 }
 
-std::size_t register_component::size() const
+std::size_t register_component::size()
 {
 	scoped_log_begin;
-	std::lock_guard<std::recursive_mutex> lock(mut_map);
 
-	return map_comp_name.size();
+	return get_snapshot()->comps.size();
 }
 
 bool register_component::insert(const char *name, const char *cano, const OMX_MF_COMPONENT_INFO *info)
@@ -73,7 +159,18 @@ bool register_component::insert(const char *name, const char *cano, const OMX_MF
 	rinfo->name = strname;
 	rinfo->cano_name = cano;
 	rinfo->comp_info = info;
+	rinfo->lib_name = loading_lib_name;
 	pairret = map_comp_name.insert(map_component_type::value_type(strname, rinfo));
+	if (!pairret.second && pairret.first->second->comp_info == nullptr &&
+		!loading_lib_name.empty() &&
+		pairret.first->second->lib_name == loading_lib_name) {
+		//registered from the manifest cache, fill the info
+		pairret.first->second->cano_name = cano;
+		pairret.first->second->comp_info = info;
+		delete rinfo;
+		mark_dirty();
+		return true;
+	}
 	if (!pairret.second) {
 		//already existed
 		errprint("Component '%s' already existed.\n",
@@ -81,50 +178,119 @@ bool register_component::insert(const char *name, const char *cano, const OMX_MF
 		delete rinfo;
 		return false;
 	}
+	mark_dirty();
 
 	return true;
 }
 
-register_info *register_component::find(const char *name)
+bool register_component::insert_alias(const char *name, const char *alias)
 {
 	scoped_log_begin;
 	std::lock_guard<std::recursive_mutex> lock(mut_map);
-	std::string strname = name;
+	const OMX_MF_COMPONENT_INFO *comp_info = nullptr;
 	map_component_type::iterator it;
+	bool res;
 
-	it = map_comp_name.find(strname);
+	it = map_comp_name.find(name);
 	if (it == map_comp_name.end()) {
 		//not found
 		errprint("Component '%s' not found.\n",
-			strname.c_str());
+			name);
+		return false;
+	}
+
+	//Copy component info.
+	//Reason: OMX_FreeHandle() call 'delete' for all key.
+	//        If we use shallow copy of component_info,
+	//        OMX_FreeHandle() faces double-free and SEGV.
+	if (it->second->comp_info != nullptr) {
+		comp_info = new OMX_MF_COMPONENT_INFO(*it->second->comp_info);
+	}
+	res = insert(alias, it->second->cano_name.c_str(), comp_info);
+	if (!res) {
+		//Alias has already existed
+		delete comp_info;
+		return false;
+	}
+
+	return true;
+}
+
+const register_info *register_component::find(const char *name)
+{
+	scoped_log_begin;
+	const register_snapshot *s = get_snapshot();
+	ssize_t i;
+
+	i = find_hash_index([s](size_t n) { return s->comps[n].name.c_str(); },
+		s->comp_index, name);
+	if (i < 0) {
+		//not found
+		errprint("Component '%s' not found.\n",
+			name);
 		return nullptr;
 	}
 
-	return it->second;
+	return &s->comps[i];
 }
 
-register_info *register_component::find_index(int index)
+const register_info *register_component::load(const char *name)
 {
 	scoped_log_begin;
+	const register_info *rinfo;
+	map_library_type::iterator it;
+
+	rinfo = find(name);
+	if (rinfo == nullptr || rinfo->comp_info != nullptr) {
+		return rinfo;
+	}
+
+	//ライブラリを読み込むときだけロックする
 	std::lock_guard<std::recursive_mutex> lock(mut_map);
-	int i = 0;
 
-	if (i < 0 || (std::size_t)i >= map_comp_name.size()) {
+	//他のスレッドが読み込み済みかもしれない
+	rinfo = find(name);
+	if (rinfo == nullptr || rinfo->comp_info != nullptr) {
+		return rinfo;
+	}
+
+	it = map_lib_name.find(rinfo->lib_name);
+	if (it == map_lib_name.end()) {
+		errprint("Library '%s' of component '%s' not found.\n",
+			rinfo->lib_name.c_str(), name);
 		return nullptr;
 	}
 
-	for (auto& elem : map_comp_name) {
-		if (i == index) {
-			return elem.second;
-		}
-		i++;
+	if (it->second.handle == nullptr &&
+		!load_library(it->first, &it->second)) {
+		return nullptr;
+	}
+
+	publish();
+	rinfo = find(name);
+	if (rinfo == nullptr || rinfo->comp_info == nullptr) {
+		//manifest cache is broken?
+		errprint("Library '%s' did not register component '%s'.\n",
+			it->first.c_str(), name);
+		return nullptr;
 	}
 
-	//not found
-	errprint("Component index:%d not found.\n",
-		index);
+	return rinfo;
+}
+
+const register_info *register_component::find_index(int index)
+{
+	scoped_log_begin;
+	const register_snapshot *s = get_snapshot();
+
+	if (index < 0 || (std::size_t)index >= s->comps.size()) {
+		//not found
+		errprint("Component index:%d not found.\n",
+			index);
+		return nullptr;
+	}
 
-	return nullptr;
+	return &s->comps[index];
 }
 
 bool register_component::erase(const char *name)
@@ -144,6 +310,7 @@ bool register_component::erase(const char *name)
 
 	delete it->second;
 	map_comp_name.erase(it);
+	mark_dirty();
 
 	return true;
 }
@@ -159,6 +326,8 @@ void register_component::clear()
 	}
 
 	map_comp_name.clear();
+	map_role_name.clear();
+	mark_dirty();
 }
 
 bool register_component::insert_role(const char *name, const char *role)
@@ -181,6 +350,10 @@ bool register_component::insert_role(const char *name, const char *role)
 	}
 
 	reginfo = itc->second;
+	if (std::find(reginfo->roles.begin(), reginfo->roles.end(), strrole) != reginfo->roles.end()) {
+		//already registered from the manifest cache
+		return true;
+	}
 	reginfo->roles.push_back(strrole);
 
 	//Insert component of role
@@ -190,6 +363,7 @@ bool register_component::insert_role(const char *name, const char *role)
 		itr = pairret.first;
 	}
 	itr->second.push_back(strname);
+	mark_dirty();
 
 	return true;
 }
@@ -212,7 +386,7 @@ bool register_component::erase_role(const char *name, const char *role)
 	}
 
 	reginfo = itrolec->second;
-	auto itroler = std::find(reginfo->roles.begin(), reginfo->roles.end(), strname);
+	auto itroler = std::find(reginfo->roles.begin(), reginfo->roles.end(), strrole);
 	if (itroler == reginfo->roles.end()) {
 		//not found
 		errprint("Role '%s' not found.\n",
@@ -220,6 +394,7 @@ bool register_component::erase_role(const char *name, const char *role)
 		return false;
 	}
 	reginfo->roles.erase(itroler);
+	mark_dirty();
 
 	//Erase component of role
 	auto itcompr = map_role_name.find(strrole);
@@ -243,15 +418,19 @@ bool register_component::erase_role(const char *name, const char *role)
 
 const std::vector<std::string> *register_component::find_by_role(const char *role)
 {
-	//Erase component of role
-	auto itr = map_role_name.find(role);
-	if (itr == map_role_name.end()) {
+	scoped_log_begin;
+	const register_snapshot *s = get_snapshot();
+	ssize_t i;
+
+	i = find_hash_index([s](size_t n) { return s->roles[n].role.c_str(); },
+		s->role_index, role);
+	if (i < 0) {
 		errprint("Role '%s' not found.\n",
 			role);
 		return nullptr;
 	}
 
-	return &itr->second;
+	return &s->roles[i].comps;
 }
 
 void register_component::dump() const
@@ -273,6 +452,23 @@ void register_component::dump() const
 			roles = roles.substr(0, roles.size() - 2);
 		}
 
+		if (comp_info == nullptr) {
+			dprint("name      : %s\n"
+				"reginfo  : %p\n"
+				"  name     : %s\n"
+				"  cano_name: %s\n"
+				"  comp_info: (not loaded)\n"
+				"  lib_name : %s\n"
+				" roles     : %s\n",
+				elem.first.c_str(),
+				reginfo,
+				reginfo->name.c_str(),
+				reginfo->cano_name.c_str(),
+				reginfo->lib_name.c_str(),
+				roles.c_str());
+			continue;
+		}
+
 		dprint("name      : %s\n"
 			"reginfo  : %p\n"
 			"  name     : %s\n"
@@ -318,79 +514,140 @@ void register_component::dump() const
 //protected methods
 //----------------------------------------
 
+const register_snapshot *register_component::get_snapshot()
+{
+	//登録が変わっていれば、最初に読んだスレッドが作り直す
+	if (f_dirty.load(std::memory_order_acquire)) {
+		std::lock_guard<std::recursive_mutex> lock(mut_map);
+
+		publish();
+	}
+
+	return snap.load(std::memory_order_acquire);
+}
+
+void register_component::publish()
+{
+	scoped_log_begin;
+	std::lock_guard<std::recursive_mutex> lock(mut_map);
+	register_snapshot *s, *old;
+
+	if (!f_dirty.load(std::memory_order_relaxed)) {
+		//no changes
+		return;
+	}
+
+	s = new register_snapshot();
+
+	//std::map の順に並べるので名前順になる
+	s->comps.reserve(map_comp_name.size());
+	for (auto& elem : map_comp_name) {
+		s->comps.push_back(*elem.second);
+	}
+	build_hash_index([s](size_t n) { return s->comps[n].name.c_str(); },
+		s->comps.size(), &s->comp_index);
+
+	s->roles.reserve(map_role_name.size());
+	for (auto& elem : map_role_name) {
+		s->roles.push_back(role_info{elem.first, elem.second});
+	}
+	build_hash_index([s](size_t n) { return s->roles[n].role.c_str(); },
+		s->roles.size(), &s->role_index);
+
+	old = snap.exchange(s, std::memory_order_acq_rel);
+	if (old != nullptr) {
+		retired_snaps.push_back(old);
+	}
+	f_dirty.store(false, std::memory_order_release);
+}
+
+void register_component::mark_dirty()
+{
+	f_dirty.store(true, std::memory_order_release);
+}
+
 void register_component::load_components(void)
 {
 	scoped_log_begin;
 	const char *homedir = getenv("HOME");
 	std::string rcfilename = "/.omxilmfrc";
-	bool flag_err = false;
+	std::string cachefilename;
+	std::vector<std::string> libnames;
+	map_library_type libs;
+	bool flag_dirty = false;
+	int result;
+
+	//register components linked into this library
+	load_builtin_components();
 
 	if (homedir != nullptr) {
 		rcfilename.insert(0, homedir);
 	}
-	dprint("rcfile:%s\n", rcfilename.c_str());
+	cachefilename = rcfilename + ".cache";
+	dprint("rcfile:%s, cache:%s\n",
+		rcfilename.c_str(), cachefilename.c_str());
 
 	std::ifstream ifs(rcfilename, std::ifstream::in);
 
 	while (ifs.good()) {
 		std::string libname;
-		void *libhandle = nullptr;
-		OMX_MF_ENTRY_FUNC entry_func = nullptr;
-		OMX_ERRORTYPE libresult;
-		int result;
+		library_info libinfo = {nullptr, 0, 0};
 
 		std::getline(ifs, libname);
 		if (libname.compare("") == 0) {
 			//ignore empty line
 			continue;
 		}
-
-		//load library, get entry function
-		libhandle = open_library(libname.c_str());
-		if (libhandle == nullptr) {
-			//not found or error
-			errprint("Library '%s' is not found. "
-					"Skipped.\n",
-				libname.c_str());
+		if (libs.count(libname) != 0) {
+			//ignore duplicated line
 			continue;
 		}
 
-		entry_func = (OMX_MF_ENTRY_FUNC)
-			get_symbol(libhandle, OMX_MF_ENTRY_FUNCNAME);
-		if (entry_func == nullptr) {
-			//not have entry func
-			errprint("Library '%s' does not have entry '%s'. "
-					"Skipped.\n",
-				libname.c_str(), OMX_MF_ENTRY_FUNCNAME);
-			flag_err = true;
+		//library is not cached if we cannot get the status
+		result = get_file_status(libname.c_str(), &libinfo.mtime, &libinfo.size);
+		if (result != 0) {
+			libinfo.mtime = 0;
+			libinfo.size = 0;
 		}
 
-		//register components (by library)
-		if (entry_func) {
-			libresult = entry_func();
-			if (libresult != OMX_ErrorNone) {
-				//failed to regist
-				errprint("Library '%s' entry '%s' was failed. "
-					"Skipped.\n",
-					libname.c_str(), OMX_MF_ENTRY_FUNCNAME);
-				flag_err = true;
-			}
+		libs.insert(map_library_type::value_type(libname, libinfo));
+		libnames.push_back(libname);
+	}
+
+	//do not read nor write the cache if there is no rcfile,
+	//or it lists no libraries
+	if (libnames.empty()) {
+		dprint("No libraries in rcfile, skip the cache.\n");
+		return;
+	}
+
+	//register components of unchanged libraries without loading
+	if (!read_manifest(cachefilename, libs)) {
+		flag_dirty = true;
+	}
+
+	for (auto& libname : libnames) {
+		library_info& libinfo = libs[libname];
+
+		if (map_lib_name.count(libname) != 0) {
+			//already registered by the manifest cache
+			continue;
 		}
 
-		if (!flag_err) {
-			//success, remember it
-			map_lib_name.insert(map_library_type::value_type(libname, libhandle));
-		} else {
-			//failed, clean up
-			result = close_library(libhandle);
-			if (result != 0) {
-				errprint("Library '%s' cannot close. "
-						"Ignored.\n",
-					libname.c_str());
-			}
-			flag_err = false;
+		//load library and register components (by library)
+		if (!load_library(libname, &libinfo)) {
 			continue;
 		}
+
+		//success, remember it
+		map_lib_name.insert(map_library_type::value_type(libname, libinfo));
+		if (libinfo.size != 0) {
+			flag_dirty = true;
+		}
+	}
+
+	if (flag_dirty) {
+		write_manifest(cachefilename);
 	}
 }
 
@@ -399,7 +656,12 @@ void register_component::unload_components(void)
 	int result;
 
 	for (auto& elem: map_lib_name) {
-		result = close_library(elem.second);
+		if (elem.second.handle == nullptr) {
+			//not loaded
+			continue;
+		}
+
+		result = close_library(elem.second.handle);
 		if (result != 0) {
 			errprint("Library '%s' cannot close. "
 					"Ignored.\n",
@@ -409,6 +671,234 @@ void register_component::unload_components(void)
 	map_lib_name.clear();
 }
 
+void register_component::load_builtin_components(void)
+{
+	scoped_log_begin;
+	OMX_ERRORTYPE libresult;
+
+	for (const builtin_entry *ent = builtin_entries; ent->name != nullptr; ent++) {
+		libresult = ent->entry_func();
+		if (libresult != OMX_ErrorNone) {
+			//failed to regist
+			errprint("Builtin '%s' entry was failed. "
+					"Ignored.\n",
+				ent->name);
+		}
+	}
+}
+
+bool register_component::load_library(const std::string& libname, library_info *libinfo)
+{
+	scoped_log_begin;
+	void *libhandle = nullptr;
+	OMX_MF_ENTRY_FUNC entry_func = nullptr;
+	OMX_ERRORTYPE libresult;
+	bool flag_err = false;
+	int result;
+
+	//load library, get entry function
+	libhandle = open_library(libname.c_str());
+	if (libhandle == nullptr) {
+		//not found or error
+		errprint("Library '%s' is not found. "
+				"Skipped.\n",
+			libname.c_str());
+		return false;
+	}
+
+	entry_func = (OMX_MF_ENTRY_FUNC)
+		get_symbol(libhandle, OMX_MF_ENTRY_FUNCNAME);
+	if (entry_func == nullptr) {
+		//not have entry func
+		errprint("Library '%s' does not have entry '%s'. "
+				"Skipped.\n",
+			libname.c_str(), OMX_MF_ENTRY_FUNCNAME);
+		flag_err = true;
+	}
+
+	//register components (by library)
+	if (entry_func) {
+		loading_lib_name = libname;
+		libresult = entry_func();
+		loading_lib_name.clear();
+		if (libresult != OMX_ErrorNone) {
+			//failed to regist
+			errprint("Library '%s' entry '%s' was failed. "
+				"Skipped.\n",
+				libname.c_str(), OMX_MF_ENTRY_FUNCNAME);
+			flag_err = true;
+		}
+	}
+
+	if (flag_err) {
+		//failed, clean up
+		result = close_library(libhandle);
+		if (result != 0) {
+			errprint("Library '%s' cannot close. "
+					"Ignored.\n",
+				libname.c_str());
+		}
+		return false;
+	}
+
+	libinfo->handle = libhandle;
+
+	return true;
+}
+
+/**
+ * マニフェストキャッシュのヘッダ、
+ * 書式を変えたときはバージョンを上げてください。
+ */
+static const char manifest_header[] = "#omxil-mf manifest 1";
+
+bool register_component::read_manifest(const std::string& filename, const map_library_type& libs)
+{
+	scoped_log_begin;
+	std::ifstream ifs(filename, std::ifstream::in);
+	std::string line;
+	std::map<std::string, std::vector<std::vector<std::string> > > entries;
+	std::vector<std::vector<std::string> > *lib_entries = nullptr;
+	bool flag_uptodate = true;
+
+	std::getline(ifs, line);
+	if (!ifs.good() || line != manifest_header) {
+		dprint("Manifest '%s' is not found or old.\n",
+			filename.c_str());
+		return false;
+	}
+
+	//ライブラリごとに登録するコンポーネントとロールを集める
+	while (ifs.good()) {
+		std::vector<std::string> fields;
+		std::string field;
+
+		std::getline(ifs, line);
+		if (line.compare("") == 0) {
+			//ignore empty line
+			continue;
+		}
+
+		std::istringstream iss(line);
+		while (std::getline(iss, field, '\t')) {
+			fields.push_back(field);
+		}
+
+		if (fields.size() == 4 && fields[0] == "lib") {
+			auto it = libs.find(fields[3]);
+			if (it == libs.end() || it->second.size == 0 ||
+				it->second.mtime != strtoull(fields[1].c_str(), nullptr, 10) ||
+				it->second.size != strtoull(fields[2].c_str(), nullptr, 10)) {
+				//removed or modified
+				dprint("Library '%s' is not cached.\n",
+					fields[3].c_str());
+				lib_entries = nullptr;
+				flag_uptodate = false;
+				continue;
+			}
+
+			lib_entries = &entries[fields[3]];
+		} else if (fields.size() == 3 && (fields[0] == "comp" || fields[0] == "role")) {
+			if (lib_entries != nullptr) {
+				lib_entries->push_back(fields);
+			}
+		} else {
+			errprint("Manifest '%s' is broken. Ignored.\n",
+				filename.c_str());
+			return false;
+		}
+	}
+
+	for (auto& elem : entries) {
+		const std::string& libname = elem.first;
+
+		for (auto& fields : elem.second) {
+			register_info *rinfo;
+			bool res = true;
+
+			if (fields[0] == "comp") {
+				rinfo = new register_info();
+				rinfo->name = fields[1];
+				rinfo->cano_name = fields[2];
+				rinfo->comp_info = nullptr;
+				rinfo->lib_name = libname;
+				res = map_comp_name.insert(map_component_type::value_type(fields[1], rinfo)).second;
+				if (!res) {
+					delete rinfo;
+				}
+				mark_dirty();
+			} else {
+				res = insert_role(fields[1].c_str(), fields[2].c_str());
+			}
+			if (!res) {
+				errprint("Library '%s' registers '%s' again. "
+						"Ignored.\n",
+					libname.c_str(), fields[1].c_str());
+			}
+		}
+
+		map_lib_name.insert(map_library_type::value_type(libname, libs.at(libname)));
+	}
+
+	return flag_uptodate;
+}
+
+bool register_component::write_manifest(const std::string& filename) const
+{
+	scoped_log_begin;
+	std::string tmpfilename;
+	int result;
+
+	//途中まで書いたファイルを他のプロセスが読まないように、
+	//一時ファイルに書いてから置き換える
+	tmpfilename = filename + "." + std::to_string(get_process_id()) + ".tmp";
+
+	std::ofstream ofs(tmpfilename, std::ofstream::out | std::ofstream::trunc);
+
+	ofs << manifest_header << "\n";
+	for (auto& elem : map_lib_name) {
+		const library_info& libinfo = elem.second;
+
+		if (libinfo.size == 0) {
+			//cannot check modification, do not cache
+			continue;
+		}
+
+		ofs << "lib\t" << libinfo.mtime << "\t" << libinfo.size << "\t" << elem.first << "\n";
+		for (auto& elem_c : map_comp_name) {
+			if (elem_c.second->lib_name == elem.first) {
+				ofs << "comp\t" << elem_c.first << "\t" << elem_c.second->cano_name << "\n";
+			}
+		}
+		for (auto& elem_c : map_comp_name) {
+			if (elem_c.second->lib_name != elem.first) {
+				continue;
+			}
+			for (auto& elem_r : elem_c.second->roles) {
+				ofs << "role\t" << elem_c.first << "\t" << elem_r << "\n";
+			}
+		}
+	}
+	ofs.close();
+
+	if (!ofs.good()) {
+		errprint("Cannot write manifest '%s'. Ignored.\n",
+			tmpfilename.c_str());
+		std::remove(tmpfilename.c_str());
+		return false;
+	}
+
+	result = std::rename(tmpfilename.c_str(), filename.c_str());
+	if (result != 0) {
+		errprint("Cannot rename manifest '%s'. Ignored.\n",
+			filename.c_str());
+		std::remove(tmpfilename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 //----------------------------------------
 //static public methods
 //----------------------------------------
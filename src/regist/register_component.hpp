@@ -2,9 +2,12 @@
 #ifndef OMX_MF_REGISTER_COMPONENT_HPP__
 #define OMX_MF_REGISTER_COMPONENT_HPP__
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <map>
 #include <mutex>
+#include <vector>
 
 #include <OMX_Core.h>
 
@@ -16,8 +19,42 @@ namespace mf {
 struct register_info {
 	std::string name;
 	std::string cano_name;
+	//nullptr if the library has not been loaded yet
 	const OMX_MF_COMPONENT_INFO *comp_info;
 	std::vector<std::string> roles;
+	//empty if the component is not registered by the library
+	std::string lib_name;
+};
+
+struct role_info {
+	std::string role;
+	std::vector<std::string> comps;
+};
+
+/**
+ * Immutable copy of the registered components and roles.
+ *
+ * A new snapshot is built and published when the registration
+ * has been changed, readers look up it without any locks.
+ */
+struct register_snapshot {
+	//sorted by name
+	std::vector<register_info> comps;
+	//open addressing hash index of comps (index + 1, 0 is empty)
+	std::vector<uint32_t> comp_index;
+	//sorted by role
+	std::vector<role_info> roles;
+	//open addressing hash index of roles (index + 1, 0 is empty)
+	std::vector<uint32_t> role_index;
+};
+
+struct library_info {
+	//nullptr if the library has not been loaded yet
+	void *handle;
+	//Modified time (nanoseconds) and size (bytes) of the library,
+	//these are 0 if we cannot get the status of the library
+	uint64_t mtime;
+	uint64_t size;
 };
 
 class register_component {
@@ -25,7 +62,7 @@ public:
 	//親クラス
 	//typedef xxxx super;
 
-	typedef std::map<std::string, void *> map_library_type;
+	typedef std::map<std::string, library_info> map_library_type;
 	typedef std::map<std::string, register_info *> map_component_type;
 	typedef std::map<std::string, std::vector<std::string>> map_role_type;
 
@@ -56,7 +93,7 @@ public:
 	 *
 	 * @return counts of components.
 	 */
-	virtual std::size_t size() const;
+	virtual std::size_t size();
 
 	/**
 	 * Register new component to this OMX IL library.
@@ -68,13 +105,36 @@ public:
 	 */
 	virtual bool insert(const char *name, const char *cano, const OMX_MF_COMPONENT_INFO *info);
 
+	/**
+	 * Register alias name of the component to this OMX IL library.
+	 *
+	 * @param name  Name of component.
+	 * @param alias Alias name of component.
+	 * @return true if successful, false if failed.
+	 */
+	virtual bool insert_alias(const char *name, const char *alias);
+
 	/**
 	 * Find the registered component by name.
 	 *
 	 * @param name  Name of component.
 	 * @return Registration info of component.
 	 */
-	virtual register_info *find(const char *name);
+	virtual const register_info *find(const char *name);
+
+	/**
+	 * Find the registered component by name,
+	 * and load the library of component if not loaded yet.
+	 *
+	 * Components in the manifest cache are registered without
+	 * loading the library at init(). The library is loaded
+	 * at the first time we create one of the components.
+	 *
+	 * @param name  Name of component.
+	 * @return Registration info of component, nullptr if not found
+	 * or failed to load the library.
+	 */
+	virtual const register_info *load(const char *name);
 
 	/**
 	 * Find the registered component by index.
@@ -82,7 +142,7 @@ public:
 	 * @param index  Index of component.
 	 * @return Registration info of component.
 	 */
-	virtual register_info *find_index(int index);
+	virtual const register_info *find_index(int index);
 
 	/**
 	 * Unregister the component from this OMX IL library.
@@ -130,8 +190,16 @@ public:
 	virtual void dump() const;
 
 protected:
+	virtual const register_snapshot *get_snapshot();
+	virtual void publish();
+	virtual void mark_dirty();
+
 	virtual void load_components(void);
 	virtual void unload_components(void);
+	virtual void load_builtin_components(void);
+	virtual bool load_library(const std::string& libname, library_info *libinfo);
+	virtual bool read_manifest(const std::string& filename, const map_library_type& libs);
+	virtual bool write_manifest(const std::string& filename) const;
 
 private:
 	register_component();
@@ -143,7 +211,14 @@ private:
 	map_library_type map_lib_name;
 	map_component_type map_comp_name;
 	map_role_type map_role_name;
-
+	//Published snapshot, and snapshots replaced by newer one.
+	//Readers may still refer old snapshots, we release them at deinit().
+	std::atomic<register_snapshot *> snap;
+	std::vector<register_snapshot *> retired_snaps;
+	//true if the registration has been changed after publish()
+	std::atomic<bool> f_dirty;
+	//Name of the library that is registering components now
+	std::string loading_lib_name;
 
 public:
 	/**
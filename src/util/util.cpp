@@ -1,16 +1,21 @@
 
+#include <cstring>
 #include <vector>
 
 #if defined(__linux__)
 #include <unistd.h>
 #include <dlfcn.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #elif defined(_WINDOWS)
 #include <windows.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #endif
 
+#include "debug/trace.hpp"
 #include "util/util.hpp"
 
 namespace mf {
@@ -43,6 +48,9 @@ int get_thread_id()
 
 int set_thread_name(const char *name)
 {
+	//トレースにも名前を残す
+	trace::get_instance()->set_thread_name(name);
+
 #if defined(__linux__)
 	//Linux
 	return prctl(PR_SET_NAME, name);
@@ -51,6 +59,32 @@ int set_thread_name(const char *name)
 	return 0;
 }
 
+int get_thread_name(char *name, size_t len)
+{
+#if defined(__linux__)
+	//Linux
+	char buf[16] = {};
+	int result;
+
+	result = prctl(PR_GET_NAME, buf);
+	if (result != 0) {
+		return -1;
+	}
+	if (len > 0) {
+		strncpy(name, buf, len - 1);
+		name[len - 1] = '\0';
+	}
+
+	return 0;
+#endif
+	//Other
+	if (len > 0) {
+		name[0] = '\0';
+	}
+
+	return 0;
+}
+
 void *open_library(const char *name)
 {
 #if defined(__linux__)
@@ -97,6 +131,35 @@ int close_library(void *handle)
 	return -1;
 }
 
+int get_file_status(const char *name, uint64_t *mtime, uint64_t *size)
+{
+#if defined(__linux__)
+	//Linux
+	struct stat st;
+
+	if (stat(name, &st) != 0) {
+		return -1;
+	}
+	*mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+	*size = (uint64_t)st.st_size;
+
+	return 0;
+#elif defined(_WINDOWS)
+	//Windows
+	struct _stat64 st;
+
+	if (_stat64(name, &st) != 0) {
+		return -1;
+	}
+	*mtime = (uint64_t)st.st_mtime * 1000000000ULL;
+	*size = (uint64_t)st.st_size;
+
+	return 0;
+#endif
+	//Other, always failed
+	return -1;
+}
+
 uint32_t rev32(uint32_t v)
 {
 #ifdef __arm__
@@ -1,6 +1,7 @@
 #ifndef OMX_MF_UTIL_HPP__
 #define OMX_MF_UTIL_HPP__
 
+#include <cstddef>
 #include <cstdint>
 
 namespace mf {
@@ -27,6 +28,15 @@ int get_thread_id();
  */
 int set_thread_name(const char *name);
 
+/**
+ * Get thread name.
+ *
+ * @param name Buffer to receive the name of thread.
+ * @param len  Size of the buffer.
+ * @return 0 is success, -1 is error.
+ */
+int get_thread_name(char *name, size_t len);
+
 /**
  * Load a dynamic link library.
  *
@@ -52,6 +62,16 @@ void *get_symbol(void *handle, const char *name);
  */
 int close_library(void *handle);
 
+/**
+ * Get modified time and size of a file.
+ *
+ * @param name  Path of file.
+ * @param mtime Modified time of file (nanoseconds).
+ * @param size  Size of file (bytes).
+ * @return 0 is success, -1 is error.
+ */
+int get_file_status(const char *name, uint64_t *mtime, uint64_t *size);
+
 /**
  * do 4bytes-swap.
  *
@@ -0,0 +1,230 @@
+﻿
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <omxil_mf/dprint.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+
+//メッセージを出力するスレッドの数
+#define N_THREADS    4
+//スレッド毎に出力するメッセージの数
+#define N_MSGS       20000
+
+/**
+ * スレッドの終了時にメッセージを出力する。
+ *
+ * 最初のメッセージより先に構築するため、
+ * リングバッファを手放した後に破棄される。
+ */
+struct exit_logger {
+	int id;
+
+	~exit_logger()
+	{
+		if (id >= 0) {
+			infoprint("async_log_exit %d\n", id);
+		}
+	}
+};
+
+static thread_local exit_logger tls_exit_logger = { -1 };
+
+static void print_messages(int id)
+{
+	int i;
+
+	tls_exit_logger.id = id;
+
+	for (i = 0; i < N_MSGS; i++) {
+		infoprint("async_log_test %d %d\n", id, i);
+	}
+}
+
+/**
+ * スレッドを起動してメッセージを出力させる。
+ *
+ * @param n_threads スレッドの数
+ * @return メッセージ 1つあたりの時間（ナノ秒）
+ */
+static double run_threads(int n_threads)
+{
+	std::chrono::steady_clock::time_point t_start;
+	std::vector<std::thread> ths;
+	int i;
+
+	t_start = std::chrono::steady_clock::now();
+	for (i = 0; i < n_threads; i++) {
+		ths.emplace_back(print_messages, i);
+	}
+	for (std::thread &th : ths) {
+		th.join();
+	}
+
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now() - t_start).count() /
+		(n_threads * N_MSGS);
+}
+
+/**
+ * ファイルに書き出されたメッセージを確認する。
+ *
+ * 各スレッドのメッセージは出力した順に並び、
+ * 捨てられたものを除いて全て書き出されているはず。
+ */
+static int check_messages(const char *path, int n_threads, unsigned long long dropped)
+{
+	FILE *f;
+	char line[1024];
+	const char *p;
+	std::vector<int> last(n_threads, -1);
+	unsigned long long n_lines = 0, expected;
+	int id, seq, n_exit = 0;
+
+	f = fopen(path, "r");
+	if (f == nullptr) {
+		fprintf(stderr, "Cannot open '%s'.\n", path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f) != nullptr) {
+		if (strstr(line, "async_log_exit ") != nullptr) {
+			n_exit++;
+			continue;
+		}
+
+		p = strstr(line, "async_log_test ");
+		if (p == nullptr) {
+			//Messages of the framework
+			continue;
+		}
+
+		if (sscanf(p, "async_log_test %d %d", &id, &seq) != 2 ||
+			id < 0 || id >= n_threads || seq <= last[id] ||
+			line[strlen(line) - 1] != '\n') {
+			fprintf(stderr, "Broken or out of order message: %s", line);
+			fclose(f);
+			return -1;
+		}
+		last[id] = seq;
+		n_lines++;
+	}
+	fclose(f);
+
+	expected = (unsigned long long)n_threads * N_MSGS;
+	if (n_lines + dropped != expected) {
+		fprintf(stderr, "Written %llu + dropped %llu messages, "
+			"expected %llu.\n", n_lines, dropped, expected);
+		return -1;
+	}
+
+	//終了中のスレッドのメッセージは呼び出したスレッドで書き出される
+	if (n_exit != n_threads) {
+		fprintf(stderr, "Written %d messages at thread exit, "
+			"expected %d.\n", n_exit, n_threads);
+		return -1;
+	}
+
+	printf("written:%llu, dropped:%llu\n", n_lines, dropped);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	char path[] = "/tmp/omxil_mf_async_log_XXXXXX";
+	double ns_sync, ns_async;
+	unsigned long long dropped;
+	OMX_ERRORTYPE result;
+	int fd;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	fd = mkstemp(path);
+	if (fd == -1) {
+		fprintf(stderr, "mkstemp failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	close(fd);
+
+	if (OMX_MF_set_log_sink(OMX_MF_LOG_SINK_FILE, nullptr) != -1 ||
+		OMX_MF_set_log_sink(-1, nullptr) != -1) {
+		fprintf(stderr, "OMX_MF_set_log_sink() accepts invalid sink.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out3;
+	}
+
+	//呼び出したスレッドで書き出す
+	OMX_MF_set_debug_level(DPRINT_LEVEL_INFO);
+	if (OMX_MF_set_log_sink(OMX_MF_LOG_SINK_FILE, path) != 0) {
+		fprintf(stderr, "OMX_MF_set_log_sink(%s) failed.\n", path);
+		result = OMX_ErrorUndefined;
+		goto err_out3;
+	}
+	ns_sync = run_threads(N_THREADS);
+	if (check_messages(path, N_THREADS, 0) != 0) {
+		result = OMX_ErrorUndefined;
+		goto err_out3;
+	}
+
+	//ログスレッドで書き出す
+	if (truncate(path, 0) != 0 ||
+		OMX_MF_set_log_async(1) != 0) {
+		fprintf(stderr, "OMX_MF_set_log_async(1) failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out3;
+	}
+	dropped = OMX_MF_get_log_dropped();
+	ns_async = run_threads(N_THREADS);
+	OMX_MF_set_log_async(0);
+	dropped = OMX_MF_get_log_dropped() - dropped;
+
+	if (check_messages(path, N_THREADS, dropped) != 0) {
+		result = OMX_ErrorUndefined;
+		goto err_out3;
+	}
+
+	printf("infoprint to file from %d threads: "
+		"sync %.1fns, async %.1fns per message\n",
+		N_THREADS, ns_sync, ns_async);
+
+	OMX_MF_set_log_sink(OMX_MF_LOG_SINK_STDERR, nullptr);
+	unlink(path);
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out3:
+	OMX_MF_set_log_async(0);
+	OMX_MF_set_log_sink(OMX_MF_LOG_SINK_STDERR, nullptr);
+	unlink(path);
+
+err_out2:
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
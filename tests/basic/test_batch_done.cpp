@@ -0,0 +1,420 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <mutex>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//流すバッファ数
+#define N_BUFFERS       100
+//一度に返却されるバッファの最大数
+#define N_MAX_BATCH     4
+//後続のバッファを待つ最大の時間（マイクロ秒）
+#define MAX_DELAY_US    2000
+
+class comp_test_batch_done : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	comp_test_batch_done(const char *comp_name)
+		: omxil_comp(comp_name), port_in(0), cnt_single(0),
+		cnt_batch(0), cnt_in(0), cnt_out(0), max_batch(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_batch_done()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		std::unique_lock<std::mutex> lock(mut_cnt);
+
+		//まとめて返却するため、呼ばれないはず
+		cnt_single++;
+
+		return super::EmptyBufferDone(hComponent, pAppData, pBuffer);
+	}
+
+	virtual OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		std::unique_lock<std::mutex> lock(mut_cnt);
+
+		//まとめて返却するため、呼ばれないはず
+		cnt_single++;
+
+		return super::FillBufferDone(hComponent, pAppData, pBuffer);
+	}
+
+	virtual OMX_ERRORTYPE BuffersDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE **ppBuffers, OMX_U32 nBuffers)
+	{
+		std::unique_lock<std::mutex> lock(mut_cnt);
+		OMX_U32 i;
+
+		cnt_batch++;
+		if (max_batch < nBuffers) {
+			max_batch = nBuffers;
+		}
+
+		for (i = 0; i < nBuffers; i++) {
+			if (nPortIndex == port_in) {
+				cnt_in++;
+				super::EmptyBufferDone(hComponent, pAppData, ppBuffers[i]);
+			} else {
+				cnt_out++;
+				super::FillBufferDone(hComponent, pAppData, ppBuffers[i]);
+			}
+		}
+
+		return OMX_ErrorNone;
+	}
+
+	static OMX_ERRORTYPE gate_BuffersDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE **ppBuffers, OMX_U32 nBuffers)
+	{
+		comp_test_batch_done *c = static_cast<comp_test_batch_done *>(pAppData);
+
+		return c->BuffersDone(hComponent, pAppData, nPortIndex, ppBuffers, nBuffers);
+	}
+
+	virtual void set_input_port(OMX_U32 port)
+	{
+		std::unique_lock<std::mutex> lock(mut_cnt);
+
+		port_in = port;
+	}
+
+	virtual void print_result()
+	{
+		std::unique_lock<std::mutex> lock(mut_cnt);
+
+		printf("single:%d, batch:%d, in:%d, out:%d, max:%d, avg:%.2f\n",
+			cnt_single, cnt_batch, cnt_in, cnt_out, (int)max_batch,
+			(cnt_batch == 0) ? 0.0 : (double)(cnt_in + cnt_out) / cnt_batch);
+	}
+
+	virtual bool check_result(int n_in, int n_out)
+	{
+		std::unique_lock<std::mutex> lock(mut_cnt);
+
+		return cnt_single == 0 && cnt_in == n_in && cnt_out == n_out &&
+			max_batch <= N_MAX_BATCH;
+	}
+
+private:
+	std::mutex mut_cnt;
+	OMX_U32 port_in;
+	int cnt_single;
+	int cnt_batch;
+	int cnt_in, cnt_out;
+	OMX_U32 max_batch;
+
+};
+
+static OMX_ERRORTYPE set_batch_done(comp_test_batch_done *comp, OMX_U32 port, OMX_BOOL enabled)
+{
+	OMX_MF_PARAM_BATCHDONETYPE param;
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_PARAM_BATCH_DONE, &index);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	memset(&param, 0, sizeof(param));
+	param.nSize        = sizeof(param);
+	omxil_comp::fill_version(&param.nVersion);
+	param.nPortIndex   = port;
+	param.bEnabled     = enabled;
+	param.nMaxBatch    = N_MAX_BATCH;
+	param.nMaxDelayUs  = MAX_DELAY_US;
+	param.pBuffersDone = comp_test_batch_done::gate_BuffersDone;
+
+	return comp->SetParameter(index, &param);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	comp_test_batch_done *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in, def_out;
+	OMX_MF_PARAM_BATCHDONETYPE param_batch;
+	OMX_INDEXTYPE index;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+	OMX_U32 pnum_in, pnum_out;
+	std::future<int> fut_in;
+	std::future<int> fut_out;
+	int ret_in, ret_out;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+	pnum_out = 0;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new comp_test_batch_done(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	printf("OMX_GetHandle: name:%s, comp:%p\n",
+		arg_comp, comp);
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	pnum_in = param_v.nStartPortNumber;
+	pnum_out = param_v.nStartPortNumber + 1;
+	comp->set_input_port(pnum_in);
+
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->get_param_port_definition(pnum_out, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+
+	//Enable batched callback
+	result = set_batch_done(comp, pnum_in, OMX_TRUE);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "set_batch_done(in) failed.\n");
+		goto err_out2;
+	}
+	result = set_batch_done(comp, pnum_out, OMX_TRUE);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "set_batch_done(out) failed.\n");
+		goto err_out2;
+	}
+
+	//Read back
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_PARAM_BATCH_DONE, &index);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "GetExtensionIndex() failed.\n");
+		goto err_out2;
+	}
+	memset(&param_batch, 0, sizeof(param_batch));
+	param_batch.nSize      = sizeof(param_batch);
+	omxil_comp::fill_version(&param_batch.nVersion);
+	param_batch.nPortIndex = pnum_in;
+	result = comp->GetParameter(index, &param_batch);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "GetParameter(batchDone) failed.\n");
+		goto err_out2;
+	}
+	if (!param_batch.bEnabled ||
+		param_batch.nMaxBatch != N_MAX_BATCH ||
+		param_batch.nMaxDelayUs != MAX_DELAY_US ||
+		param_batch.pBuffersDone != comp_test_batch_done::gate_BuffersDone) {
+		fprintf(stderr, "GetParameter(batchDone) returns wrong value.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = comp->use_buffers(pnum_out, &buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	//Cannot change while the port is in use
+	result = set_batch_done(comp, pnum_in, OMX_FALSE);
+	if (result != OMX_ErrorIncorrectStateOperation) {
+		fprintf(stderr, "set_batch_done(in) in Idle is not rejected.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusExecuting
+	printf("wait for StateExecuting...\n");
+	comp->wait_state_changed(OMX_StateExecuting);
+	printf("wait for StateExecuting... Done!\n");
+
+	//EmptyThisBuffer
+	fut_in = std::async(std::launch::async,
+		[&] (int maxcnt) -> int {
+		for (int i = 0; i < maxcnt; i++) {
+			OMX_BUFFERHEADERTYPE *buf;
+			OMX_ERRORTYPE result;
+
+			comp->wait_buffer_free(pnum_in);
+
+			buf = comp->get_free_buffer(pnum_in);
+			if (buf == nullptr) {
+				fprintf(stderr, "get_free_buffer(%d) failed.\n",
+					(int)pnum_in);
+				return -1;
+			}
+
+			buf->pBuffer[0] = (OMX_U8)i;
+			buf->nFilledLen = 8;
+			result = comp->EmptyThisBuffer(buf);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "EmptyThisBuffer(%d) failed.\n",
+					(int)pnum_in);
+				return -1;
+			}
+		}
+
+		return 0;
+	}, N_BUFFERS);
+
+	//FillThisBuffer
+	fut_out = std::async(std::launch::async,
+		[&] (int maxcnt) -> int {
+		for (int i = 0; i < maxcnt; i++) {
+			OMX_BUFFERHEADERTYPE *buf;
+			OMX_ERRORTYPE result;
+
+			comp->wait_buffer_free(pnum_out);
+
+			buf = comp->get_free_buffer(pnum_out);
+			if (buf == nullptr) {
+				fprintf(stderr, "get_free_buffer(%d) failed.\n",
+					(int)pnum_out);
+				return -1;
+			}
+
+			buf->nFilledLen = 0;
+			result = comp->FillThisBuffer(buf);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "FillThisBuffer(%d) failed.\n",
+					(int)pnum_out);
+				return -1;
+			}
+		}
+
+		return 0;
+	}, N_BUFFERS);
+
+	//Get Empty/Fill result
+	ret_in = fut_in.get();
+	ret_out = fut_out.get();
+	if (ret_in != 0 || ret_out != 0) {
+		fprintf(stderr, "EmptyThisBuffer/FillThisBuffer failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	comp->wait_all_buffer_free(pnum_in);
+	comp->wait_all_buffer_free(pnum_out);
+
+	comp->print_result();
+	if (!comp->check_result(N_BUFFERS, N_BUFFERS)) {
+		fprintf(stderr, "Batched callback returns wrong buffers.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	//Wait for StatusLoaded
+	printf("wait for StateLoaded...\n");
+	comp->wait_state_changed(OMX_StateLoaded);
+	printf("wait for StateLoaded... Done!\n");
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
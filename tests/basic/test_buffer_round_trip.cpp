@@ -0,0 +1,237 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <omxil_mf/dprint.h>
+#include <omxil_mf/scoped_log.hpp>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//EmptyThisBuffer から EmptyBufferDone までを繰り返す回数
+#define N_ROUNDS    10000
+//ログを出力する関数を呼ぶ回数
+#define N_CALLS     1000000
+
+class comp_test_buffer_round_trip : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	comp_test_buffer_round_trip(const char *comp_name)
+		: omxil_comp(comp_name), cnt_done(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_buffer_round_trip()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		//測定の邪魔にならないよう、表示もロックもしない
+		cnt_done.fetch_add(1, std::memory_order_release);
+
+		return OMX_ErrorNone;
+	}
+
+	int get_count_done() const
+	{
+		return cnt_done.load(std::memory_order_acquire);
+	}
+
+private:
+	std::atomic<int> cnt_done;
+
+};
+
+//フレームワークの関数と同じく、入口でログを出力する関数
+static __attribute__((noinline)) int logged_func(int v)
+{
+	scoped_log_begin;
+
+	dprint("v:%d\n", v);
+
+	return v + 1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	comp_test_buffer_round_trip *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::chrono::steady_clock::time_point t_start;
+	std::chrono::nanoseconds t_total(0), t_log(0);
+	OMX_BUFFERHEADERTYPE *buf;
+	OMX_U32 pnum_in;
+	OMX_ERRORTYPE result;
+	int i, v;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.renderer.null";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new comp_test_buffer_round_trip(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	printf("OMX_GetHandle: name:%s, comp:%p\n",
+		arg_comp, comp);
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	pnum_in = param_v.nStartPortNumber;
+
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusExecuting
+	printf("wait for StateExecuting...\n");
+	comp->wait_state_changed(OMX_StateExecuting);
+	printf("wait for StateExecuting... Done!\n");
+
+	//1つのバッファを送出し、返却されるまで待つ
+	buf = buf_in[0];
+	t_start = std::chrono::steady_clock::now();
+	for (i = 0; i < N_ROUNDS; i++) {
+		buf->nFilledLen = 8;
+		buf->nOffset    = 0;
+		buf->nFlags     = 0;
+		result = comp->EmptyThisBuffer(buf);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_EmptyThisBuffer failed.\n");
+			goto err_out2;
+		}
+
+		while (comp->get_count_done() <= i) {
+			std::this_thread::yield();
+		}
+	}
+	t_total = std::chrono::steady_clock::now() - t_start;
+
+	//ログの出力を判定するだけの費用
+	v = 0;
+	t_start = std::chrono::steady_clock::now();
+	for (i = 0; i < N_CALLS; i++) {
+		v = logged_func(v);
+	}
+	t_log = std::chrono::steady_clock::now() - t_start;
+
+	printf("log max level:%d, runtime level:%d\n"
+		"EmptyThisBuffer -> EmptyBufferDone: %lldns per round (%d rounds)\n"
+		"scoped_log_begin + dprint: %.2fns per call (%d calls)\n",
+		OMX_MF_LOG_MAX_LEVEL, OMX_MF_get_debug_level(),
+		(long long)t_total.count() / N_ROUNDS, N_ROUNDS,
+		(double)t_log.count() / N_CALLS, v);
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+
+	//Wait for StatusLoaded
+	printf("wait for StateLoaded...\n");
+	comp->wait_state_changed(OMX_StateLoaded);
+	printf("wait for StateLoaded... Done!\n");
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->free_buffers(pnum_in, &buf_in);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
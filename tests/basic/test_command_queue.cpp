@@ -0,0 +1,413 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <omxil_mf/omxil_mf.h>
+#include <omxil_mf/component.hpp>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//続けて送るコマンド数
+#define N_COMMANDS    100
+//状態遷移のコマンド数（残りはフラッシュ）
+#define N_STATESET    3
+//失敗させるフラッシュのコマンド数
+#define N_FAILED      8
+
+#define TEST_COMP_NAME    "OMX.MF.test.command_queue"
+
+//ポートを持たず、フラッシュが必ず失敗するコンポーネント
+class comp_no_port : public mf::component {
+public:
+	typedef mf::component super;
+
+	comp_no_port(OMX_COMPONENTTYPE *c, const char *cname)
+		: super(c, cname)
+	{
+	}
+};
+
+static void *OMX_APIENTRY test_no_port_constructor(OMX_COMPONENTTYPE *cComponent, const char *name)
+{
+	return new comp_no_port(cComponent, name);
+}
+
+static void OMX_APIENTRY test_no_port_destructor(OMX_COMPONENTTYPE *cComponent)
+{
+	mf::component *comp = mf::component::get_instance(cComponent);
+
+	delete comp;
+}
+
+class comp_test_command_queue : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	comp_test_command_queue(const char *comp_name)
+		: omxil_comp(comp_name), cnt_state_done(0), cnt_same_state(0),
+		cnt_bad_port(0), f_hold(false), f_held(false)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_command_queue()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EventHandler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mut_ev);
+
+			if (eEvent == OMX_EventCmdComplete &&
+				nData1 == OMX_CommandFlush) {
+				map_flush_done[nData2]++;
+			}
+			if (eEvent == OMX_EventCmdComplete &&
+				nData1 == OMX_CommandStateSet) {
+				cnt_state_done++;
+			}
+			if (eEvent == OMX_EventError &&
+				nData1 == (OMX_U32)OMX_ErrorSameState) {
+				cnt_same_state++;
+			}
+			if (eEvent == OMX_EventError &&
+				nData1 == (OMX_U32)OMX_ErrorBadPortIndex) {
+				cnt_bad_port++;
+
+				//解放されるまでコマンドの処理を止める
+				f_held = true;
+				cond_ev.notify_all();
+				cond_ev.wait(lock, [&] { return !f_hold; });
+			}
+			cond_ev.notify_all();
+		}
+
+		return super::EventHandler(hComponent, pAppData, eEvent,
+			nData1, nData2, pEventData);
+	}
+
+	//フラッシュの完了通知数を取得する
+	virtual int get_flush_done(OMX_U32 port)
+	{
+		std::unique_lock<std::mutex> lock(mut_ev);
+
+		return map_flush_done[port];
+	}
+
+	//期待する数のイベントが届くまで待つ
+	virtual bool wait_events(const std::map<OMX_U32, int>& flush_exp, int state_exp, int same_exp)
+	{
+		std::unique_lock<std::mutex> lock(mut_ev);
+
+		return cond_ev.wait_for(lock, std::chrono::seconds(10), [&] {
+			for (auto& e : flush_exp) {
+				if (map_flush_done[e.first] < e.second) {
+					return false;
+				}
+			}
+			return cnt_state_done >= state_exp &&
+				cnt_same_state >= same_exp;
+		});
+	}
+
+	//コマンドの処理を止めるかどうか設定する
+	virtual void set_hold(bool f)
+	{
+		std::unique_lock<std::mutex> lock(mut_ev);
+
+		f_hold = f;
+		cond_ev.notify_all();
+	}
+
+	//コマンドの処理が止まるまで待つ
+	virtual bool wait_held()
+	{
+		std::unique_lock<std::mutex> lock(mut_ev);
+
+		return cond_ev.wait_for(lock, std::chrono::seconds(10), [&] {
+			return f_held;
+		});
+	}
+
+	//期待する数の OMX_ErrorBadPortIndex が届くまで待つ
+	virtual bool wait_bad_port(int bad_exp)
+	{
+		std::unique_lock<std::mutex> lock(mut_ev);
+
+		return cond_ev.wait_for(lock, std::chrono::seconds(10), [&] {
+			return cnt_bad_port >= bad_exp;
+		});
+	}
+
+	//イベントの数を表示する
+	virtual void dump_events()
+	{
+		std::unique_lock<std::mutex> lock(mut_ev);
+
+		for (auto& e : map_flush_done) {
+			printf("  flush done port:%d, %d events\n",
+				(int)e.first, e.second);
+		}
+		printf("  state set done %d events, same state %d events, "
+			"bad port %d events\n",
+			cnt_state_done, cnt_same_state, cnt_bad_port);
+	}
+
+private:
+	std::mutex mut_ev;
+	std::condition_variable cond_ev;
+	std::map<OMX_U32, int> map_flush_done;
+	int cnt_state_done;
+	int cnt_same_state;
+	int cnt_bad_port;
+	bool f_hold, f_held;
+
+};
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	comp_test_command_queue *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	OMX_U32 pnum_in;
+	std::map<OMX_U32, int> flush_exp;
+	std::chrono::steady_clock::time_point t_start, t_cmd;
+	std::chrono::nanoseconds t_total, t_max, t_elapsed;
+	OMX_MF_COMPONENT_INFO comp_info;
+	int i;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.renderer.null";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	//Reference:
+	//    OpenMAX IL specification version 1.1.2
+	//    3.2.2.2 OMX_SendCommand
+	//    (OMX_SendCommand is a non-blocking call)
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new comp_test_command_queue(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	printf("OMX_GetHandle: name:%s, comp:%p\n",
+		arg_comp, comp);
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	pnum_in = param_v.nStartPortNumber;
+
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusExecuting
+	printf("wait for StateExecuting...\n");
+	comp->wait_state_changed(OMX_StateExecuting);
+	printf("wait for StateExecuting... Done!\n");
+
+	//フラッシュと同じ状態への遷移を続けて送る
+	//まとめて処理されても、コマンドごとに完了が通知されるはず
+	flush_exp[pnum_in] = comp->get_flush_done(pnum_in);
+	t_total = std::chrono::nanoseconds::zero();
+	t_max = std::chrono::nanoseconds::zero();
+	t_start = std::chrono::steady_clock::now();
+	for (i = 0; i < N_COMMANDS; i++) {
+		t_cmd = std::chrono::steady_clock::now();
+
+		if (i >= N_COMMANDS - N_STATESET) {
+			result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+		} else if (i % 3 == 0) {
+			result = comp->SendCommand(OMX_CommandFlush, OMX_ALL, 0);
+			flush_exp[pnum_in]++;
+		} else {
+			result = comp->SendCommand(OMX_CommandFlush, pnum_in, 0);
+			flush_exp[pnum_in]++;
+		}
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(%d) failed.\n", i);
+			goto err_out2;
+		}
+
+		t_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - t_cmd);
+		t_total += t_elapsed;
+		if (t_max < t_elapsed) {
+			t_max = t_elapsed;
+		}
+	}
+
+	printf("commands:%d, caller blocked total:%lldns, max:%lldns\n",
+		N_COMMANDS, (long long)t_total.count(), (long long)t_max.count());
+
+	//Idle, Executing, Idle の 3回の遷移が完了し、
+	//残りの遷移要求は同じ状態への遷移としてエラーになるはず
+	if (!comp->wait_events(flush_exp, 3, N_STATESET - 1)) {
+		fprintf(stderr, "Completion events are missing.\n");
+		comp->dump_events();
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	printf("all completion events received in %lldus.\n",
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - t_start).count());
+	comp->dump_events();
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+
+	//Wait for StatusLoaded
+	printf("wait for StateLoaded...\n");
+	comp->wait_state_changed(OMX_StateLoaded);
+	printf("wait for StateLoaded... Done!\n");
+
+
+	//Terminate
+	delete comp;
+	comp = nullptr;
+
+
+	//まとめられたフラッシュが失敗すると、
+	//コマンドごとにエラーが通知されるはず
+	comp_info.constructor = test_no_port_constructor;
+	comp_info.destructor  = test_no_port_destructor;
+	result = OMX_MF_RegisterComponent(TEST_COMP_NAME, &comp_info);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_MF_RegisterComponent(%s) failed.\n",
+			TEST_COMP_NAME);
+		goto err_out2;
+	}
+
+	comp = new comp_test_command_queue(TEST_COMP_NAME);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle(%s) failed.\n", TEST_COMP_NAME);
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+
+	//最初のフラッシュのエラー通知で処理を止め、残りをまとめさせる
+	comp->set_hold(true);
+	for (i = 0; i < N_FAILED; i++) {
+		result = comp->SendCommand(OMX_CommandFlush, OMX_ALL, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(Flush, %d) failed.\n", i);
+			comp->set_hold(false);
+			goto err_out2;
+		}
+		if (i == 0 && !comp->wait_held()) {
+			fprintf(stderr, "Flush is not failed.\n");
+			comp->set_hold(false);
+			result = OMX_ErrorUndefined;
+			goto err_out2;
+		}
+	}
+	comp->set_hold(false);
+
+	if (!comp->wait_bad_port(N_FAILED)) {
+		fprintf(stderr, "Error events of coalesced flush are missing.\n");
+		comp->dump_events();
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	comp->dump_events();
+
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	if (comp != nullptr) {
+		comp->free_buffers(pnum_in, &buf_in);
+	}
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,381 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <omxil_mf/omxil_mf.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//生成するコンポーネントの数
+#define N_HANDLES    1000
+//バッファを待ってコマンドの処理をブロックさせるコンポーネントの数
+#define N_BLOCKED    8
+
+class comp_test_command_scale : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	comp_test_command_scale(const char *comp_name)
+		: omxil_comp(comp_name), cnt_done(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_command_scale()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EventHandler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+	{
+		OMX_ERRORTYPE result;
+
+		result = super::EventHandler(hComponent, pAppData, eEvent,
+			nData1, nData2, pEventData);
+
+		if (eEvent == OMX_EventCmdComplete &&
+			nData1 == OMX_CommandPortEnable) {
+			std::unique_lock<std::mutex> lock(mut_done);
+
+			t_done = std::chrono::steady_clock::now();
+			cnt_done++;
+			cond_done.notify_all();
+		}
+
+		return result;
+	}
+
+	//コマンドを送る
+	virtual OMX_ERRORTYPE send_port_enable()
+	{
+		t_send = std::chrono::steady_clock::now();
+
+		return SendCommand(OMX_CommandPortEnable, OMX_ALL, nullptr);
+	}
+
+	//バッファを割り当てる
+	virtual OMX_ERRORTYPE allocate_buffers(OMX_U32 port)
+	{
+		OMX_PARAM_PORTDEFINITIONTYPE def;
+		OMX_ERRORTYPE result;
+		OMX_U32 i;
+
+		result = get_param_port_definition(port, &def);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_port_definition(%d) failed.\n",
+				(int)port);
+			return result;
+		}
+
+		for (i = 0; i < def.nBufferCountActual; i++) {
+			OMX_BUFFERHEADERTYPE *buf;
+
+			result = AllocateBuffer(&buf, port, nullptr, def.nBufferSize);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "OMX_AllocateBuffer(%d) failed.\n",
+					(int)port);
+				return result;
+			}
+			bufs.push_back(buf);
+		}
+
+		return OMX_ErrorNone;
+	}
+
+	//バッファを解放する
+	virtual void free_allocated_buffers(OMX_U32 port)
+	{
+		for (OMX_BUFFERHEADERTYPE *buf : bufs) {
+			FreeBuffer(port, buf);
+		}
+		bufs.clear();
+	}
+
+	//n 回目のコマンドの完了を待ち、送ってから完了するまでの時間を返す
+	virtual bool wait_done(int n, long long *lat)
+	{
+		std::unique_lock<std::mutex> lock(mut_done);
+		bool res;
+
+		res = cond_done.wait_for(lock, std::chrono::seconds(10), [&] {
+			return cnt_done >= n;
+		});
+		*lat = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			t_done - t_send).count();
+
+		return res;
+	}
+
+private:
+	std::mutex mut_done;
+	std::condition_variable cond_done;
+	int cnt_done;
+	std::chrono::steady_clock::time_point t_send, t_done;
+	std::vector<OMX_BUFFERHEADERTYPE *> bufs;
+
+};
+
+//バッファを待ってブロックしているコマンドがあっても、
+//他のコンポーネントのコマンドは処理されるはず
+static OMX_ERRORTYPE run_blocked_commands(std::vector<comp_test_command_scale *> *comps, int round, double *lat_us)
+{
+	comp_test_command_scale *comp_probe = (*comps)[N_BLOCKED];
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_ERRORTYPE result;
+	long long lat;
+	int i;
+
+	result = comp_probe->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		return result;
+	}
+
+	for (i = 0; i < N_BLOCKED; i++) {
+		result = (*comps)[i]->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+			return result;
+		}
+	}
+
+	result = comp_probe->send_port_enable();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(PortEnable) failed.\n");
+		return result;
+	}
+	if (!comp_probe->wait_done(round, &lat)) {
+		fprintf(stderr, "OMX_CommandPortEnable is blocked.\n");
+		return OMX_ErrorTimeout;
+	}
+	*lat_us = (double)lat / 1000;
+
+	//ブロックしているコマンドを完了させ、元の状態に戻す
+	for (i = 0; i < N_BLOCKED; i++) {
+		result = (*comps)[i]->allocate_buffers(param_v.nStartPortNumber);
+		if (result != OMX_ErrorNone) {
+			return result;
+		}
+		(*comps)[i]->wait_state_changed(OMX_StateIdle);
+	}
+	for (i = 0; i < N_BLOCKED; i++) {
+		result = (*comps)[i]->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+			return result;
+		}
+		(*comps)[i]->free_allocated_buffers(param_v.nStartPortNumber);
+		(*comps)[i]->wait_state_changed(OMX_StateLoaded);
+	}
+
+	return OMX_ErrorNone;
+}
+
+//プロセスのスレッド数と RSS（KB）を取得する
+static void get_proc_status(int *threads, long *rss)
+{
+	FILE *fp;
+	char line[256];
+
+	*threads = 0;
+	*rss = 0;
+
+	fp = fopen("/proc/self/status", "r");
+	if (fp == nullptr) {
+		return;
+	}
+	while (fgets(line, sizeof(line), fp) != nullptr) {
+		if (strncmp(line, "Threads:", 8) == 0) {
+			*threads = atoi(line + 8);
+		} else if (strncmp(line, "VmRSS:", 6) == 0) {
+			*rss = atol(line + 6);
+		}
+	}
+	fclose(fp);
+}
+
+static OMX_ERRORTYPE set_command_thread(comp_test_command_scale *comp, OMX_BOOL dedicated)
+{
+	OMX_MF_PARAM_COMMANDTHREADTYPE param;
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex(
+		(OMX_STRING)OMX_MF_INDEX_PARAM_COMMAND_THREAD, &index);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_GetExtensionIndex(%s) failed.\n",
+			OMX_MF_INDEX_PARAM_COMMAND_THREAD);
+		return result;
+	}
+
+	memset(&param, 0, sizeof(param));
+	param.nSize = sizeof(param);
+	omxil_comp::fill_version(&param.nVersion);
+	param.bDedicated = dedicated;
+	result = comp->SetParameter(index, &param);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SetParameter(CommandThread) failed.\n");
+		return result;
+	}
+
+	return OMX_ErrorNone;
+}
+
+//全てのコンポーネントにコマンドを送り、完了までの平均時間を返す
+static OMX_ERRORTYPE run_commands(std::vector<comp_test_command_scale *> *comps, int round, bool burst, double *avg_us)
+{
+	OMX_ERRORTYPE result;
+	long long lat, sum = 0;
+
+	for (comp_test_command_scale *comp : *comps) {
+		result = comp->send_port_enable();
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(PortEnable) failed.\n");
+			return result;
+		}
+		if (burst) {
+			continue;
+		}
+
+		if (!comp->wait_done(round, &lat)) {
+			fprintf(stderr, "OMX_CommandPortEnable timeout.\n");
+			return OMX_ErrorTimeout;
+		}
+		sum += lat;
+	}
+	if (burst) {
+		for (comp_test_command_scale *comp : *comps) {
+			if (!comp->wait_done(round, &lat)) {
+				fprintf(stderr, "OMX_CommandPortEnable timeout.\n");
+				return OMX_ErrorTimeout;
+			}
+			sum += lat;
+		}
+	}
+
+	*avg_us = (double)sum / comps->size() / 1000;
+
+	return OMX_ErrorNone;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	OMX_BOOL dedicated = OMX_FALSE;
+	std::vector<comp_test_command_scale *> comps;
+	int th_init, th_opened, th_cmd;
+	long rss_init, rss_opened, rss_cmd;
+	double lat_serial, lat_burst, lat_blocked;
+	std::chrono::steady_clock::time_point t_start, t_end;
+	OMX_ERRORTYPE result;
+	int i;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.reader.zero";
+	} else {
+		arg_comp = argv[1];
+	}
+	if (argc >= 3 && strcmp(argv[2], "dedicated") == 0) {
+		dedicated = OMX_TRUE;
+	}
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+	get_proc_status(&th_init, &rss_init);
+
+	for (i = 0; i < N_HANDLES; i++) {
+		comp_test_command_scale *comp = new comp_test_command_scale(arg_comp);
+
+		comps.push_back(comp);
+		if (comp->get_component() == nullptr) {
+			fprintf(stderr, "OMX_GetHandle failed.\n");
+			result = OMX_ErrorInsufficientResources;
+			goto err_out2;
+		}
+
+		result = set_command_thread(comp, dedicated);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+	}
+	get_proc_status(&th_opened, &rss_opened);
+
+	//1つずつ完了を待つ場合と、まとめて送る場合の両方を測る
+	result = run_commands(&comps, 1, false, &lat_serial);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	t_start = std::chrono::steady_clock::now();
+	result = run_commands(&comps, 2, true, &lat_burst);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	t_end = std::chrono::steady_clock::now();
+	get_proc_status(&th_cmd, &rss_cmd);
+
+	result = run_blocked_commands(&comps, 3, &lat_blocked);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	printf("%s: %d handles, threads:%d -> %d -> %d, "
+		"rss:%ldkB -> %ldkB -> %ldkB\n",
+		(dedicated) ? "dedicated" : "shared", N_HANDLES,
+		th_init, th_opened, th_cmd, rss_init, rss_opened, rss_cmd);
+	printf("%s: command latency serial:%.1fus, burst:%.1fus (total %.1fms)\n",
+		(dedicated) ? "dedicated" : "shared", lat_serial, lat_burst,
+		(double)std::chrono::duration_cast<std::chrono::microseconds>(
+			t_end - t_start).count() / 1000);
+	printf("%s: command latency behind %d blocked components:%.1fus\n",
+		(dedicated) ? "dedicated" : "shared", N_BLOCKED, lat_blocked);
+
+	//共有のスレッドで処理する場合、コンポーネント毎にスレッドは増えないはず
+	if (!dedicated && th_cmd - th_opened >= N_HANDLES / 2) {
+		fprintf(stderr, "Too many threads for commands.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Terminate
+	for (comp_test_command_scale *comp : comps) {
+		delete comp;
+	}
+	comps.clear();
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	for (comp_test_command_scale *comp : comps) {
+		delete comp;
+	}
+	comps.clear();
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,366 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//フラッシュの回数（全ポートと入力ポートを交互にフラッシュする）
+#define N_FLUSHES    200
+
+class comp_test_flush_latency : public omxil_comp_free_queue {
+public:
+	typedef omxil_comp_free_queue super;
+
+	comp_test_flush_latency(const char *comp_name)
+		: omxil_comp_free_queue(comp_name), last_stamp(-1), cnt_stamp_reset(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_flush_latency()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EventHandler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+	{
+		if (eEvent == OMX_EventCmdComplete &&
+			nData1 == OMX_CommandFlush) {
+			std::unique_lock<std::mutex> lock(mut_free);
+
+			//完了を受け取った時刻を記録する
+			map_flush_done[nData2]++;
+			map_flush_time[nData2] = std::chrono::steady_clock::now();
+			cond_free.notify_all();
+
+			return OMX_ErrorNone;
+		}
+
+		return super::EventHandler(hComponent, pAppData, eEvent,
+			nData1, nData2, pEventData);
+	}
+
+	virtual OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		//フラッシュ後もタイムスタンプは増え続けるはず
+		if (pBuffer->nFilledLen > 0) {
+			std::unique_lock<std::mutex> lock(mut_free);
+
+			if (pBuffer->nTimeStamp <= last_stamp) {
+				cnt_stamp_reset++;
+			}
+			last_stamp = pBuffer->nTimeStamp;
+		}
+
+		put_free_buffer(pBuffer->nOutputPortIndex, pBuffer);
+
+		return OMX_ErrorNone;
+	}
+
+	//フラッシュの完了が n 回届くまで待ち、最後に届いた時刻を返す
+	virtual bool wait_flush_done(OMX_U32 port, int n, std::chrono::steady_clock::time_point *t)
+	{
+		std::unique_lock<std::mutex> lock(mut_free);
+		bool result;
+
+		result = cond_free.wait_for(lock, std::chrono::seconds(10), [&] {
+			return map_flush_done[port] >= n;
+		});
+		*t = map_flush_time[port];
+
+		return result;
+	}
+
+	//タイムスタンプが巻き戻った回数を取得する
+	virtual int get_stamp_reset()
+	{
+		std::unique_lock<std::mutex> lock(mut_free);
+
+		return cnt_stamp_reset;
+	}
+
+private:
+	std::map<OMX_U32, int> map_flush_done;
+	std::map<OMX_U32, std::chrono::steady_clock::time_point> map_flush_time;
+	OMX_TICKS last_stamp;
+	int cnt_stamp_reset;
+
+};
+
+static void print_latency(const char *name, std::vector<long long> *lat)
+{
+	long long sum = 0;
+
+	if (lat->empty()) {
+		return;
+	}
+
+	std::sort(lat->begin(), lat->end());
+	for (long long l : *lat) {
+		sum += l;
+	}
+	printf("flush %s: %d times, latency avg:%.1fus, median:%.1fus, max:%.1fus\n",
+		name, (int)lat->size(),
+		(double)sum / lat->size() / 1000,
+		(double)(*lat)[lat->size() / 2] / 1000,
+		(double)lat->back() / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	comp_test_flush_latency *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in, def_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+	OMX_U32 pnum_in, pnum_out, pnum_one;
+	std::vector<long long> lat_all, lat_one;
+	int cnt_one, cnt_out;
+	OMX_ERRORTYPE result;
+	int i;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	//Reference:
+	//    OpenMAX IL specification version 1.2.0
+	//    3.2.2.4  OMX_CommandFlush
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+	pnum_out = 0;
+	cnt_one = 0;
+	cnt_out = 0;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new comp_test_flush_latency(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	if (param_v.nPorts < 2) {
+		//出力ポートだけを持つコンポーネント
+		pnum_in = OMX_ALL;
+		pnum_out = param_v.nStartPortNumber;
+	} else {
+		pnum_in = param_v.nStartPortNumber;
+		pnum_out = param_v.nStartPortNumber + 1;
+	}
+
+	//入力ポートがなければ、出力ポートを単独でフラッシュする
+	pnum_one = (pnum_in != OMX_ALL) ? pnum_in : pnum_out;
+
+	if (pnum_in != OMX_ALL) {
+		result = comp->get_param_port_definition(pnum_in, &def_in);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_port_definition(in) failed.\n");
+			goto err_out2;
+		}
+	}
+	result = comp->get_param_port_definition(pnum_out, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+
+	//出力より入力のバッファを多くし、
+	//出力バッファを待つ入力バッファがある状態でフラッシュする
+	if (pnum_in != OMX_ALL &&
+		def_in.nBufferCountActual <= def_out.nBufferCountActual) {
+		def_in.nBufferCountActual = def_out.nBufferCountActual + 1;
+		result = comp->SetParameter(OMX_IndexParamPortDefinition, &def_in);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "set_port_definition(in) failed.\n");
+			goto err_out2;
+		}
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	if (pnum_in != OMX_ALL) {
+		result = comp->use_buffers(pnum_in, &buf_in);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+	}
+	result = comp->use_buffers(pnum_out, &buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusExecuting
+	comp->wait_state_changed(OMX_StateExecuting);
+
+	for (i = 0; i < N_FLUSHES; i++) {
+		OMX_U32 target = (i % 2 == 0) ? OMX_ALL : pnum_one;
+		std::chrono::steady_clock::time_point t_start, t_in, t_out;
+		long long lat;
+
+		//全ての出力バッファが処理されるまで流す
+		result = comp->send_all_buffers(pnum_in, OMX_DirInput, nullptr);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		result = comp->send_all_buffers(pnum_out, OMX_DirOutput, nullptr);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		if (!comp->wait_free_count(pnum_out, buf_out.size())) {
+			fprintf(stderr, "FillBufferDone(%d) timeout.\n",
+				(int)pnum_out);
+			result = OMX_ErrorTimeout;
+			goto err_out2;
+		}
+
+		//Send flush command
+		t_start = std::chrono::steady_clock::now();
+		result = comp->SendCommand(OMX_CommandFlush, target, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(CommandFlush, %d) failed.\n",
+				(int)target);
+			goto err_out2;
+		}
+
+		cnt_one++;
+		if (!comp->wait_flush_done(pnum_one, cnt_one, &t_in)) {
+			fprintf(stderr, "Flush(%d) command timeout at %d.\n",
+				(int)pnum_one, i);
+			result = OMX_ErrorTimeout;
+			goto err_out2;
+		}
+		if (target == OMX_ALL && pnum_one != pnum_out) {
+			cnt_out++;
+			if (!comp->wait_flush_done(pnum_out, cnt_out, &t_out)) {
+				fprintf(stderr, "Flush(out) command timeout at %d.\n", i);
+				result = OMX_ErrorTimeout;
+				goto err_out2;
+			}
+			t_in = std::max(t_in, t_out);
+		}
+		lat = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			t_in - t_start).count();
+		if (target == OMX_ALL) {
+			lat_all.push_back(lat);
+		} else {
+			lat_one.push_back(lat);
+		}
+
+		if (!comp->wait_free_count(pnum_in, buf_in.size())) {
+			fprintf(stderr, "EmptyBufferDone(%d) timeout.\n",
+				(int)pnum_in);
+			result = OMX_ErrorTimeout;
+			goto err_out2;
+		}
+	}
+
+	print_latency("all", &lat_all);
+	print_latency((pnum_one == pnum_in) ? "in" : "out", &lat_one);
+	printf("timestamp reset:%d\n", comp->get_stamp_reset());
+
+	//出力ポートだけを持つコンポーネントは、
+	//フラッシュでストリームを先頭から作り直すことがあるため調べない
+	if (pnum_in != OMX_ALL && comp->get_stamp_reset() != 0) {
+		fprintf(stderr, "Timestamp was reset by flush.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	//Wait for StatusLoaded
+	comp->wait_state_changed(OMX_StateLoaded);
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
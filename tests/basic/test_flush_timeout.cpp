@@ -0,0 +1,436 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//フラッシュの期限（ミリ秒）
+#define FLUSH_TIMEOUT_MS    50
+
+class comp_test_flush_timeout : public omxil_comp_free_queue {
+public:
+	typedef omxil_comp_free_queue super;
+
+	comp_test_flush_timeout(const char *comp_name)
+		: omxil_comp_free_queue(comp_name), f_block(false), f_blocking(false),
+		port_block(0), cnt_timeout(0), port_timeout(0), n_timeout(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_flush_timeout()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EventHandler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+	{
+		if (eEvent == OMX_EventCmdComplete &&
+			nData1 == OMX_CommandFlush) {
+			std::unique_lock<std::mutex> lock(mut_free);
+
+			//完了を受け取った時刻を記録する
+			map_flush_done[nData2]++;
+			map_flush_time[nData2] = std::chrono::steady_clock::now();
+			cond_free.notify_all();
+
+			return OMX_ErrorNone;
+		}
+		if (eEvent == OMX_EventError &&
+			nData1 == (OMX_U32)OMX_ErrorTimeout) {
+			std::unique_lock<std::mutex> lock(mut_free);
+
+			//期限内に返却されなかったポートとバッファ数を記録する
+			cnt_timeout++;
+			port_timeout = nData2;
+			n_timeout = (uintptr_t)pEventData;
+			cond_free.notify_all();
+
+			return OMX_ErrorNone;
+		}
+
+		return super::EventHandler(hComponent, pAppData, eEvent,
+			nData1, nData2, pEventData);
+	}
+
+	virtual OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		block_buffer_done(pBuffer->nInputPortIndex);
+		put_free_buffer(pBuffer->nInputPortIndex, pBuffer);
+
+		return OMX_ErrorNone;
+	}
+
+	virtual OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		block_buffer_done(pBuffer->nOutputPortIndex);
+		put_free_buffer(pBuffer->nOutputPortIndex, pBuffer);
+
+		return OMX_ErrorNone;
+	}
+
+	//クライアントがバッファを受け取ったまま止まった状態を作る
+	virtual void block_buffer_done(OMX_U32 port)
+	{
+		std::unique_lock<std::mutex> lock(mut_free);
+
+		if (f_block && port == port_block) {
+			f_blocking = true;
+			cond_free.notify_all();
+			cond_free.wait(lock, [&] { return !f_block; });
+			f_blocking = false;
+		}
+	}
+
+	//ポートのバッファの返却を止める、あるいは再開する
+	virtual void set_block(bool f, OMX_U32 port)
+	{
+		std::unique_lock<std::mutex> lock(mut_free);
+
+		f_block = f;
+		port_block = port;
+		cond_free.notify_all();
+	}
+
+	//バッファの返却が止まるまで待つ
+	virtual bool wait_blocking()
+	{
+		std::unique_lock<std::mutex> lock(mut_free);
+
+		return cond_free.wait_for(lock, std::chrono::seconds(10), [&] {
+			return f_blocking;
+		});
+	}
+
+	//フラッシュの完了が届くまで待ち、届いた時刻を返す
+	virtual bool wait_flush_done(OMX_U32 port, std::chrono::steady_clock::time_point *t)
+	{
+		std::unique_lock<std::mutex> lock(mut_free);
+		bool result;
+
+		result = cond_free.wait_for(lock, std::chrono::seconds(10), [&] {
+			return map_flush_done[port] >= 1;
+		});
+		*t = map_flush_time[port];
+
+		return result;
+	}
+
+	//期限切れの通知を取得する
+	virtual int get_timeout(OMX_U32 *port, uint64_t *n)
+	{
+		std::unique_lock<std::mutex> lock(mut_free);
+
+		*port = port_timeout;
+		*n = n_timeout;
+
+		return cnt_timeout;
+	}
+
+private:
+	std::map<OMX_U32, int> map_flush_done;
+	std::map<OMX_U32, std::chrono::steady_clock::time_point> map_flush_time;
+	bool f_block, f_blocking;
+	OMX_U32 port_block;
+	int cnt_timeout;
+	OMX_U32 port_timeout;
+	uint64_t n_timeout;
+
+};
+
+static OMX_ERRORTYPE set_flush_timeout(comp_test_flush_timeout *comp, OMX_U32 msec)
+{
+	OMX_MF_PARAM_FLUSHTIMEOUTTYPE param;
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_PARAM_FLUSH_TIMEOUT, &index);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	memset(&param, 0, sizeof(param));
+	param.nSize      = sizeof(param);
+	omxil_comp::fill_version(&param.nVersion);
+	param.nTimeoutMs = msec;
+
+	return comp->SetParameter(index, &param);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	comp_test_flush_timeout *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in, def_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> bufs;
+	std::chrono::steady_clock::time_point t_start, t_in, t_out;
+	OMX_U32 pnum_in, pnum_out, pnum_block, port_timeout;
+	size_t n_block;
+	uint64_t n_timeout;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	//Reference:
+	//    OpenMAX IL specification version 1.2.0
+	//    3.2.2.4  OMX_CommandFlush
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+	pnum_out = 0;
+	pnum_block = 0;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new comp_test_flush_timeout(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	if (param_v.nPorts < 2) {
+		//出力ポートだけを持つコンポーネント
+		pnum_in = OMX_ALL;
+		pnum_out = param_v.nStartPortNumber;
+	} else {
+		pnum_in = param_v.nStartPortNumber;
+		pnum_out = param_v.nStartPortNumber + 1;
+	}
+
+	//入力ポートがなければ、出力ポートの返却を止める
+	pnum_block = (pnum_in != OMX_ALL) ? pnum_in : pnum_out;
+
+	if (pnum_in != OMX_ALL) {
+		result = comp->get_param_port_definition(pnum_in, &def_in);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_port_definition(in) failed.\n");
+			goto err_out2;
+		}
+	}
+	result = comp->get_param_port_definition(pnum_out, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+
+	result = set_flush_timeout(comp, FLUSH_TIMEOUT_MS);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "set_flush_timeout() failed.\n");
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	if (pnum_in != OMX_ALL) {
+		result = comp->use_buffers(pnum_in, &buf_in);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+	}
+	result = comp->use_buffers(pnum_out, &buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusExecuting
+	comp->wait_state_changed(OMX_StateExecuting);
+
+	if (pnum_in != OMX_ALL) {
+		//出力バッファは渡さず、入力バッファだけを溜めておく
+		comp->take_all_free_buffers(pnum_in, &bufs);
+		for (OMX_BUFFERHEADERTYPE *buf : bufs) {
+			buf->nFilledLen = 8;
+			result = comp->EmptyThisBuffer(buf);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "EmptyThisBuffer(%d) failed.\n",
+					(int)pnum_in);
+				goto err_out2;
+			}
+		}
+
+		//入力ポートのバッファの返却を止めてからフラッシュする
+		comp->set_block(true, pnum_in);
+		n_block = buf_in.size();
+	} else {
+		//出力ポートのバッファの返却を止め、返却が止まってからフラッシュする
+		comp->set_block(true, pnum_out);
+		n_block = buf_out.size();
+
+		result = comp->send_all_buffers(pnum_out, OMX_DirOutput, nullptr);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		if (!comp->wait_blocking()) {
+			fprintf(stderr, "FillBufferDone(%d) timeout.\n",
+				(int)pnum_out);
+			result = OMX_ErrorTimeout;
+			goto err_out2;
+		}
+	}
+
+	t_start = std::chrono::steady_clock::now();
+	result = comp->SendCommand(OMX_CommandFlush, OMX_ALL, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(CommandFlush, all) failed.\n");
+		goto err_out2;
+	}
+
+	if (!comp->wait_flush_done(pnum_out, &t_out)) {
+		fprintf(stderr, "Flush(out) command timeout.\n");
+		result = OMX_ErrorTimeout;
+		goto err_out2;
+	}
+	t_in = t_out;
+	if (pnum_in != OMX_ALL && !comp->wait_flush_done(pnum_in, &t_in)) {
+		fprintf(stderr, "Flush(in) command timeout.\n");
+		result = OMX_ErrorTimeout;
+		goto err_out2;
+	}
+
+	printf("flush out:%dus, in:%dus\n",
+		(int)std::chrono::duration_cast<std::chrono::microseconds>(
+			t_out - t_start).count(),
+		(int)std::chrono::duration_cast<std::chrono::microseconds>(
+			t_in - t_start).count());
+
+	//返却の済んだ出力ポートは、入力ポートの期限切れを待たずに完了するはず
+	if (pnum_in != OMX_ALL && t_in <= t_out) {
+		fprintf(stderr, "Flush(out) was completed after flush(in).\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	if (t_in - t_start < std::chrono::milliseconds(FLUSH_TIMEOUT_MS)) {
+		fprintf(stderr, "Flush(in) was completed before deadline.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	if (comp->get_timeout(&port_timeout, &n_timeout) != 1 ||
+		port_timeout != pnum_block || n_timeout == 0) {
+		fprintf(stderr, "Timeout event is not reported "
+			"(port:%d, buffers:%d).\n",
+			(int)port_timeout, (int)n_timeout);
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	printf("timeout port:%d, buffers:%d\n",
+		(int)port_timeout, (int)n_timeout);
+
+	//返却を再開すると、止めていたポートの全てのバッファが 1回ずつ戻るはず
+	comp->set_block(false, pnum_block);
+
+	if (!comp->wait_free_count(pnum_block, n_block)) {
+		fprintf(stderr, "EmptyBufferDone/FillBufferDone(%d) timeout.\n",
+			(int)pnum_block);
+		result = OMX_ErrorTimeout;
+		goto err_out2;
+	}
+	usleep(10000);
+	if (comp->get_free_count(pnum_block) != n_block) {
+		fprintf(stderr, "Buffers are returned twice.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	//Wait for StatusLoaded
+	comp->wait_state_changed(OMX_StateLoaded);
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->set_block(false, pnum_block);
+
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
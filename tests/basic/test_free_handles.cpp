@@ -0,0 +1,277 @@
+﻿
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <omxil_mf/omxil_mf.h>
+#include <omxil_mf/component.hpp>
+#include <omxil_mf/component_worker.hpp>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+
+//一度に解放するコンポーネントの数
+#define N_COMPS        30
+//測定を繰り返す回数
+#define N_ROUNDS       10
+//テスト用コンポーネントのワーカーの数
+#define N_WORKERS      4
+//テスト用コンポーネントのワーカーが終了にかかる時間（ミリ秒）
+#define WIND_DOWN_MS   2
+
+#define TEST_COMP_NAME    "OMX.MF.test.free_handles"
+
+//終了を指示されてから、後片付けのため少し遅れて終了するワーカー
+class worker_slow_exit : public mf::component_worker {
+public:
+	typedef mf::component_worker super;
+
+	worker_slow_exit(mf::component *c)
+		: super(c)
+	{
+	}
+
+	virtual void wait_running() override
+	{
+		try {
+			super::wait_running();
+		} catch (const mf::interrupted_error& e) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(WIND_DOWN_MS));
+			throw;
+		}
+	}
+};
+
+//終了に時間がかかるワーカーを複数持つコンポーネント
+class comp_slow_exit : public mf::component {
+public:
+	typedef mf::component super;
+
+	comp_slow_exit(OMX_COMPONENTTYPE *c, const char *cname)
+		: super(c, cname)
+	{
+		for (int i = 0; i < N_WORKERS; i++) {
+			wk[i] = new worker_slow_exit(this);
+			register_worker_thread(wk[i]);
+			wk[i]->start();
+		}
+	}
+
+	virtual ~comp_slow_exit()
+	{
+		for (int i = 0; i < N_WORKERS; i++) {
+			unregister_worker_thread(wk[i]);
+			delete wk[i];
+		}
+	}
+
+private:
+	worker_slow_exit *wk[N_WORKERS];
+};
+
+static void *OMX_APIENTRY test_slow_exit_constructor(OMX_COMPONENTTYPE *cComponent, const char *name)
+{
+	return new comp_slow_exit(cComponent, name);
+}
+
+static void OMX_APIENTRY test_slow_exit_destructor(OMX_COMPONENTTYPE *cComponent)
+{
+	mf::component *comp = mf::component::get_instance(cComponent);
+
+	delete comp;
+}
+
+static OMX_ERRORTYPE OMX_APIENTRY dummy_event_handler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE OMX_APIENTRY dummy_empty_buffer_done(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE *pBuffer)
+{
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE OMX_APIENTRY dummy_fill_buffer_done(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE *pBuffer)
+{
+	return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE dummy_callbacks = {
+	dummy_event_handler,
+	dummy_empty_buffer_done,
+	dummy_fill_buffer_done,
+};
+
+static OMX_ERRORTYPE get_handles(const char *name, std::vector<OMX_HANDLETYPE> *handles)
+{
+	OMX_ERRORTYPE result;
+
+	handles->assign(N_COMPS, nullptr);
+	for (auto& h : *handles) {
+		result = OMX_GetHandle(&h, (OMX_STRING)name, nullptr, &dummy_callbacks);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_GetHandle(%s) failed.\n", name);
+			return result;
+		}
+	}
+
+	return OMX_ErrorNone;
+}
+
+//同じハンドルが含まれていたら、どれも解放しない
+static OMX_ERRORTYPE check_duplicated_handles(const char *name)
+{
+	std::vector<OMX_HANDLETYPE> handles;
+	OMX_HANDLETYPE dup[3];
+	OMX_ERRORTYPE result;
+
+	result = get_handles(name, &handles);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	dup[0] = handles[0];
+	dup[1] = handles[1];
+	dup[2] = handles[0];
+	result = OMX_MF_FreeHandles(dup, 3);
+	if (result != OMX_ErrorBadParameter) {
+		fprintf(stderr, "OMX_MF_FreeHandles(duplicated) "
+			"returns %s, expected ErrorBadParameter.\n",
+			get_omx_errortype_name(result));
+		return OMX_ErrorUndefined;
+	}
+
+	//拒否されたハンドルはまだ有効なはず
+	result = OMX_MF_FreeHandles(&handles[0], handles.size());
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_MF_FreeHandles after duplicated failed.\n");
+		return result;
+	}
+
+	return OMX_ErrorNone;
+}
+
+//1つずつ解放した場合と、まとめて解放した場合の時間を測る
+static OMX_ERRORTYPE measure_free_handles(const char *name)
+{
+	std::vector<OMX_HANDLETYPE> handles;
+	std::chrono::steady_clock::time_point t_begin;
+	double t_each = 0, t_bulk = 0;
+	OMX_ERRORTYPE result;
+	int i;
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		//1つずつ解放する
+		result = get_handles(name, &handles);
+		if (result != OMX_ErrorNone) {
+			return result;
+		}
+		t_begin = std::chrono::steady_clock::now();
+		for (auto h : handles) {
+			result = OMX_FreeHandle(h);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "OMX_FreeHandle failed.\n");
+				return result;
+			}
+		}
+		t_each += std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - t_begin).count();
+
+		//まとめて解放する
+		result = get_handles(name, &handles);
+		if (result != OMX_ErrorNone) {
+			return result;
+		}
+		t_begin = std::chrono::steady_clock::now();
+		result = OMX_MF_FreeHandles(&handles[0], handles.size());
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_MF_FreeHandles failed.\n");
+			return result;
+		}
+		t_bulk += std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - t_begin).count();
+	}
+
+	printf("free %d x %s: OMX_FreeHandle %.3f ms, "
+		"OMX_MF_FreeHandles %.3f ms (mean of %d rounds)\n",
+		N_COMPS, name, t_each / N_ROUNDS, t_bulk / N_ROUNDS, N_ROUNDS);
+
+	return OMX_ErrorNone;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	OMX_MF_COMPONENT_INFO comp_info;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.st.video_decoder.avc";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	result = OMX_ErrorNone;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	result = OMX_MF_FreeHandles(nullptr, N_COMPS);
+	if (result != OMX_ErrorBadParameter) {
+		fprintf(stderr, "OMX_MF_FreeHandles(nullptr) "
+			"returns %s, expected ErrorBadParameter.\n",
+			get_omx_errortype_name(result));
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	result = check_duplicated_handles(arg_comp);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	result = measure_free_handles(arg_comp);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//ワーカーの終了に時間がかかるコンポーネント
+	comp_info.constructor = test_slow_exit_constructor;
+	comp_info.destructor  = test_slow_exit_destructor;
+	result = OMX_MF_RegisterComponent(TEST_COMP_NAME, &comp_info);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_MF_RegisterComponent(%s) failed.\n",
+			TEST_COMP_NAME);
+		goto err_out2;
+	}
+
+	result = measure_free_handles(TEST_COMP_NAME);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,371 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <omxil_mf/omxil_mf.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//OMX_GetHandle, OMX_FreeHandle を繰り返す回数
+#define N_ROUNDS       200
+//プールに置くインスタンスの数
+#define N_POOLED       2
+//入力バッファに詰めるデータ量
+#define IN_SIZE        8
+
+static OMX_ERRORTYPE OMX_APIENTRY dummy_event_handler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE OMX_APIENTRY dummy_empty_buffer_done(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE *pBuffer)
+{
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE OMX_APIENTRY dummy_fill_buffer_done(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE *pBuffer)
+{
+	return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE dummy_callbacks = {
+	dummy_event_handler,
+	dummy_empty_buffer_done,
+	dummy_fill_buffer_done,
+};
+
+//OMX_GetHandle にかかった時間を測り、中央値と平均値を表示する
+static OMX_ERRORTYPE measure_get_handle(const char *name, const char *label)
+{
+	std::vector<double> lat;
+	std::chrono::steady_clock::time_point t_begin;
+	OMX_HANDLETYPE h;
+	OMX_ERRORTYPE result;
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		t_begin = std::chrono::steady_clock::now();
+		result = OMX_GetHandle(&h, (OMX_STRING)name, nullptr, &dummy_callbacks);
+		lat.push_back(std::chrono::duration<double, std::micro>(
+			std::chrono::steady_clock::now() - t_begin).count());
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_GetHandle(%s) failed.\n", name);
+			return result;
+		}
+
+		result = OMX_FreeHandle(h);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_FreeHandle(%s) failed.\n", name);
+			return result;
+		}
+	}
+
+	for (double v : lat) {
+		sum += v;
+	}
+	std::sort(lat.begin(), lat.end());
+	printf("%s: %d handles, p50 %.1f us, p99 %.1f us, mean %.1f us\n",
+		label, N_ROUNDS, lat[lat.size() / 2],
+		lat[lat.size() * 99 / 100], sum / lat.size());
+
+	return OMX_ErrorNone;
+}
+
+//最初のポートの番号を調べる
+static OMX_ERRORTYPE get_first_port(omxil_comp *comp, OMX_U32 *port)
+{
+	OMX_PORT_PARAM_TYPE param[4];
+	OMX_ERRORTYPE result;
+	int i;
+
+	result = comp->get_param_audio_init(&param[0]);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+	result = comp->get_param_video_init(&param[1]);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+	result = comp->get_param_image_init(&param[2]);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+	result = comp->get_param_other_init(&param[3]);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	for (i = 0; i < 4; i++) {
+		if (param[i].nPorts > 0) {
+			*port = param[i].nStartPortNumber;
+			return OMX_ErrorNone;
+		}
+	}
+
+	return OMX_ErrorNoMore;
+}
+
+static OMX_ERRORTYPE get_latency(omxil_comp *comp, OMX_U32 port, OMX_MF_CONFIG_PORTLATENCYTYPE *conf)
+{
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_CONFIG_PORT_LATENCY, &index);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	memset(conf, 0, sizeof(*conf));
+	conf->nSize      = sizeof(*conf);
+	omxil_comp::fill_version(&conf->nVersion);
+	conf->nPortIndex = port;
+
+	return comp->GetConfig(index, conf);
+}
+
+//入力ポートにバッファを通して統計を残し、Loaded に戻す
+//出力ポートは入力ポートの次の番号とする
+static OMX_ERRORTYPE pass_buffers(omxil_comp *comp, OMX_U32 port)
+{
+	std::vector<OMX_BUFFERHEADERTYPE *> bufs;
+	std::vector<OMX_BUFFERHEADERTYPE *> bufs_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> sub;
+	OMX_ERRORTYPE result;
+
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		return result;
+	}
+	result = comp->use_buffers(port, &bufs);
+	if (result == OMX_ErrorNone) {
+		result = comp->use_buffers(port + 1, &bufs_out);
+	}
+	if (result != OMX_ErrorNone) {
+		comp->free_buffers(port, &bufs);
+		return result;
+	}
+	comp->wait_state_changed(OMX_StateIdle);
+
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		comp->free_buffers(port, &bufs);
+		comp->free_buffers(port + 1, &bufs_out);
+		return result;
+	}
+	comp->wait_state_changed(OMX_StateExecuting);
+
+	//Idle に戻るときに全て返却される
+	comp->get_free_buffers(port, IN_SIZE, &sub);
+	for (OMX_BUFFERHEADERTYPE *buf : sub) {
+		result = comp->EmptyThisBuffer(buf);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_EmptyThisBuffer failed.\n");
+			break;
+		}
+	}
+
+	comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	comp->wait_state_changed(OMX_StateIdle);
+	comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	comp->free_buffers(port, &bufs);
+	comp->free_buffers(port + 1, &bufs_out);
+	comp->wait_state_changed(OMX_StateLoaded);
+
+	return result;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	omxil_comp *comp;
+	OMX_HANDLETYPE h_prev;
+	OMX_PARAM_PORTDEFINITIONTYPE def_init, def;
+	OMX_MF_CONFIG_PORTLATENCYTYPE lat;
+	OMX_U32 port = 0;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.st.video_decoder.avc";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	result = OMX_ErrorNone;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	result = OMX_MF_SetComponentPool((OMX_STRING)"OMX.MF.test.not_found", N_POOLED);
+	if (result != OMX_ErrorInvalidComponentName) {
+		fprintf(stderr, "OMX_MF_SetComponentPool(not found) "
+			"returns %s, expected ErrorInvalidComponentName.\n",
+			get_omx_errortype_name(result));
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//プールなし
+	result = measure_get_handle(arg_comp, "without pool");
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//プールあり
+	result = OMX_MF_SetComponentPool((OMX_STRING)arg_comp, N_POOLED);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_MF_SetComponentPool(%s) failed.\n", arg_comp);
+		goto err_out2;
+	}
+	result = measure_get_handle(arg_comp, "with pool   ");
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//クライアントが変えた設定は、プールに戻すと元に戻る
+	comp = new omxil_comp(arg_comp);
+	if (comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle(%s) failed.\n", arg_comp);
+		delete comp;
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	result = get_first_port(comp, &port);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "Cannot find ports of %s.\n", arg_comp);
+		delete comp;
+		goto err_out2;
+	}
+	result = comp->get_param_port_definition(port, &def_init);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_param_port_definition() failed.\n");
+		delete comp;
+		goto err_out2;
+	}
+	result = pass_buffers(comp, port);
+	if (result == OMX_ErrorNone) {
+		result = get_latency(comp, port, &lat);
+	}
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "Cannot pass buffers to %s.\n", arg_comp);
+		delete comp;
+		goto err_out2;
+	}
+	if (lat.nBytes == 0) {
+		fprintf(stderr, "Latency is not recorded.\n");
+		delete comp;
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	def = def_init;
+	def.nBufferCountActual = def_init.nBufferCountActual + 2;
+	result = comp->SetParameter(OMX_IndexParamPortDefinition, &def);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "SetParameter(PortDefinition) failed.\n");
+		delete comp;
+		goto err_out2;
+	}
+	//コールバックが新しいクライアントに届くことも確かめる
+	result = comp->SendCommand(OMX_CommandPortDisable, port, nullptr);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "SendCommand(PortDisable) failed.\n");
+		delete comp;
+		goto err_out2;
+	}
+	comp->wait_command_completed(OMX_CommandPortDisable, port);
+	h_prev = comp->get_component();
+	delete comp;
+
+	comp = new omxil_comp(arg_comp);
+	if (comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle(%s) failed.\n", arg_comp);
+		delete comp;
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	if (comp->get_component() != h_prev) {
+		fprintf(stderr, "Instance is not reused.\n");
+		delete comp;
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	result = comp->get_param_port_definition(port, &def);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_param_port_definition() failed.\n");
+		delete comp;
+		goto err_out2;
+	}
+	if (def.nBufferCountActual != def_init.nBufferCountActual ||
+		def.bEnabled != def_init.bEnabled) {
+		fprintf(stderr, "Port definition is not reset, "
+			"count:%d (expected %d), enabled:%d (expected %d).\n",
+			(int)def.nBufferCountActual, (int)def_init.nBufferCountActual,
+			(int)def.bEnabled, (int)def_init.bEnabled);
+		delete comp;
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	//前のクライアントの統計も見えない
+	result = get_latency(comp, port, &lat);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "Get latency failed.\n");
+		delete comp;
+		goto err_out2;
+	}
+	if (lat.nBuffers != 0 || lat.nBytes != 0 ||
+		lat.sStage[OMX_MF_LatencyStageTotal].nCount != 0) {
+		fprintf(stderr, "Latency is not reset, "
+			"buffers:%llu, bytes:%llu.\n",
+			(unsigned long long)lat.nBuffers,
+			(unsigned long long)lat.nBytes);
+		delete comp;
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+	result = comp->SendCommand(OMX_CommandPortDisable, port, nullptr);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "SendCommand(PortDisable) failed.\n");
+		delete comp;
+		goto err_out2;
+	}
+	comp->wait_command_completed(OMX_CommandPortDisable, port);
+	delete comp;
+
+	//プールを無くすと、プールにあるインスタンスも破棄される
+	result = OMX_MF_SetComponentPool((OMX_STRING)arg_comp, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_MF_SetComponentPool(%s, 0) failed.\n", arg_comp);
+		goto err_out2;
+	}
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,151 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//OMX_Init と OMX_Deinit を繰り返す回数
+#define N_ROUNDS       10
+//1つのコンポーネントから取得するロールの最大数
+#define N_MAX_ROLES    16
+
+//登録されているコンポーネントの名前と、指定したコンポーネントのロールを集める
+static OMX_ERRORTYPE enum_registered(const char *arg_comp, std::vector<std::string> *names, std::vector<std::string> *roles)
+{
+	char name_comp[OMX_MAX_STRINGNAME_SIZE];
+	char name_roles[N_MAX_ROLES][OMX_MAX_STRINGNAME_SIZE];
+	OMX_U8 *ptr_roles[N_MAX_ROLES];
+	OMX_U32 num_roles;
+	OMX_ERRORTYPE result;
+	OMX_U32 i;
+
+	names->clear();
+	for (i = 0; ; i++) {
+		result = OMX_ComponentNameEnum(name_comp,
+			sizeof(name_comp) - 1, i);
+		if (result == OMX_ErrorNoMore) {
+			break;
+		} else if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_ComponentNameEnum failed.\n");
+			return result;
+		}
+		names->push_back(name_comp);
+	}
+
+	strncpy(name_comp, arg_comp, sizeof(name_comp) - 1);
+	name_comp[sizeof(name_comp) - 1] = '\0';
+
+	num_roles = N_MAX_ROLES;
+	for (i = 0; i < N_MAX_ROLES; i++) {
+		ptr_roles[i] = (OMX_U8 *)name_roles[i];
+	}
+	result = OMX_GetRolesOfComponent(name_comp, &num_roles, ptr_roles);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_GetRolesOfComponent failed.\n");
+		return result;
+	}
+
+	roles->clear();
+	for (i = 0; i < num_roles && i < N_MAX_ROLES; i++) {
+		roles->push_back(name_roles[i]);
+	}
+
+	return OMX_ErrorNone;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	omxil_comp *comp;
+	std::vector<std::string> names_first, roles_first, names, roles;
+	std::chrono::steady_clock::time_point t_begin;
+	double t_init[N_ROUNDS], t_get[N_ROUNDS];
+	OMX_ERRORTYPE result;
+	int i;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.st.video_decoder.avc";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+
+	//1回目はマニフェストキャッシュが無いか古いかもしれない、
+	//2回目以降はキャッシュから同じ名前とロールが登録されることを確かめる
+	for (i = 0; i < N_ROUNDS; i++) {
+		t_begin = std::chrono::steady_clock::now();
+		result = OMX_Init();
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_Init failed.\n");
+			goto err_out1;
+		}
+		t_init[i] = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - t_begin).count();
+
+		result = enum_registered(arg_comp, &names, &roles);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		if (i == 0) {
+			names_first = names;
+			roles_first = roles;
+			printf("components:%d, roles of %s:%d\n",
+				(int)names.size(), arg_comp, (int)roles.size());
+		} else if (names != names_first || roles != roles_first) {
+			fprintf(stderr, "Registered components are changed "
+				"at round %d.\n", i);
+			result = OMX_ErrorUndefined;
+			goto err_out2;
+		}
+
+		//最初の OMX_GetHandle でライブラリが読み込まれる
+		t_begin = std::chrono::steady_clock::now();
+		comp = new omxil_comp(arg_comp);
+		if (comp == nullptr || comp->get_component() == nullptr) {
+			fprintf(stderr, "OMX_GetHandle failed.\n");
+			result = OMX_ErrorInsufficientResources;
+			goto err_out3;
+		}
+		t_get[i] = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - t_begin).count();
+
+		delete comp;
+		comp = nullptr;
+
+		result = OMX_Deinit();
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_Deinit failed.\n");
+			goto err_out1;
+		}
+	}
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		printf("round %2d: OMX_Init %8.3f ms, 1st OMX_GetHandle %8.3f ms\n",
+			i, t_init[i], t_get[i]);
+	}
+
+	return 0;
+
+err_out3:
+	delete comp;
+
+err_out2:
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
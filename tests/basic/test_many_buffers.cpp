@@ -0,0 +1,265 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <future>
+#include <chrono>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//入力ポートのバッファ数
+#define N_BUFFERS    32
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	omxil_comp *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in, def_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+	OMX_U32 pnum_in, pnum_out;
+	std::future<int> fut_in;
+	std::future<int> fut_out;
+	bool blocked;
+	int ret_in, ret_out;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	//Reference:
+	//    OpenMAX IL specification version 1.1.2
+	//    3.2.2.17 OMX_EmptyThisBuffer
+	//    (OMX_EmptyThisBuffer is a non-blocking call)
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+	pnum_out = 0;
+	blocked = false;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new omxil_comp(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	printf("OMX_GetHandle: name:%s, comp:%p\n",
+		arg_comp, comp);
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	pnum_in = param_v.nStartPortNumber;
+	pnum_out = param_v.nStartPortNumber + 1;
+
+	//Increase buffers of input port
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+	def_in.nBufferCountActual = N_BUFFERS;
+	result = comp->SetParameter(OMX_IndexParamPortDefinition, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "set_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone || def_in.nBufferCountActual != N_BUFFERS) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->get_param_port_definition(pnum_out, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = comp->use_buffers(pnum_out, &buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusExecuting
+	printf("wait for StateExecuting...\n");
+	comp->wait_state_changed(OMX_StateExecuting);
+	printf("wait for StateExecuting... Done!\n");
+
+	//出力バッファを渡していないため、コンポーネントは入力バッファを
+	//処理できないが、全ての入力バッファを送出してもブロックしないはず
+	fut_in = std::async(std::launch::async,
+		[&] (int maxcnt) -> int {
+		for (int i = 0; i < maxcnt; i++) {
+			OMX_BUFFERHEADERTYPE *buf;
+			OMX_ERRORTYPE result;
+
+			buf = comp->get_free_buffer(pnum_in);
+			if (buf == nullptr) {
+				fprintf(stderr, "get_free_buffer(%d) failed.\n",
+					(int)pnum_in);
+				return -1;
+			}
+
+			buf->pBuffer[0] = (OMX_U8)i;
+			buf->nFilledLen = 8;
+			result = comp->EmptyThisBuffer(buf);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "EmptyThisBuffer(%d) failed.\n",
+					(int)pnum_in);
+				return -1;
+			}
+		}
+
+		return 0;
+	}, N_BUFFERS);
+
+	if (fut_in.wait_for(std::chrono::seconds(5)) == std::future_status::timeout) {
+		fprintf(stderr, "EmptyThisBuffer(%d) blocked.\n",
+			(int)pnum_in);
+		blocked = true;
+	}
+
+	//FillThisBuffer
+	fut_out = std::async(std::launch::async,
+		[&] (int maxcnt) -> int {
+		for (int i = 0; i < maxcnt; i++) {
+			OMX_BUFFERHEADERTYPE *buf;
+			OMX_ERRORTYPE result;
+
+			comp->wait_buffer_free(pnum_out);
+
+			buf = comp->get_free_buffer(pnum_out);
+			if (buf == nullptr) {
+				fprintf(stderr, "get_free_buffer(%d) failed.\n",
+					(int)pnum_out);
+				return -1;
+			}
+
+			buf->nFilledLen = 0;
+			result = comp->FillThisBuffer(buf);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "FillThisBuffer(%d) failed.\n",
+					(int)pnum_out);
+				return -1;
+			}
+		}
+
+		return 0;
+	}, N_BUFFERS);
+
+	//Get Empty/Fill result
+	ret_in = fut_in.get();
+	ret_out = fut_out.get();
+	if (ret_in != 0 || ret_out != 0 || blocked) {
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	printf("wait for EmptyDone of all buffers...\n");
+	comp->wait_all_buffer_free(pnum_in);
+	printf("wait for EmptyDone of all buffers... Done!\n");
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	comp->wait_all_buffer_free(pnum_out);
+
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	//Wait for StatusLoaded
+	printf("wait for StateLoaded...\n");
+	comp->wait_state_changed(OMX_StateLoaded);
+	printf("wait for StateLoaded... Done!\n");
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,294 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//一時停止させるコンポーネントの数
+#define N_INSTANCES    100
+//一時停止中の CPU 使用時間を測る期間（ミリ秒）
+#define PAUSE_MS       500
+
+class comp_test_pause : public omxil_comp_free_queue {
+public:
+	typedef omxil_comp_free_queue super;
+
+	comp_test_pause(const char *comp_name)
+		: omxil_comp_free_queue(comp_name), pnum_in(0), pnum_out(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_pause()
+	{
+		//do nothing
+	}
+
+public:
+	OMX_U32 pnum_in, pnum_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+
+};
+
+//プロセスが使った CPU 時間（マイクロ秒）を取得する
+static long long get_cpu_time()
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL +
+		ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static OMX_ERRORTYPE set_state_all(std::vector<comp_test_pause *> *comps, OMX_STATETYPE s)
+{
+	OMX_ERRORTYPE result;
+
+	for (comp_test_pause *comp : *comps) {
+		result = comp->SendCommand(OMX_CommandStateSet, s, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, %s) failed.\n",
+				get_omx_statetype_name(s));
+			return result;
+		}
+	}
+	for (comp_test_pause *comp : *comps) {
+		comp->wait_state_changed(s);
+	}
+
+	return OMX_ErrorNone;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	std::vector<comp_test_pause *> comps;
+	std::vector<long long> lat_resume;
+	OMX_PORT_PARAM_TYPE param_v;
+	long long cpu_start, cpu_pause;
+	std::chrono::steady_clock::time_point t_start, t_end;
+	OMX_ERRORTYPE result;
+	int i;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	//Reference:
+	//    OpenMAX IL specification version 1.2.0
+	//    3.1.1.2.1.5  OMX_StatePause
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	for (i = 0; i < N_INSTANCES; i++) {
+		comp_test_pause *comp = new comp_test_pause(arg_comp);
+
+		comps.push_back(comp);
+		if (comp->get_component() == nullptr) {
+			fprintf(stderr, "OMX_GetHandle failed.\n");
+			result = OMX_ErrorInsufficientResources;
+			goto err_out2;
+		}
+
+		result = comp->get_param_video_init(&param_v);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_video_init() failed.\n");
+			goto err_out2;
+		}
+		if (param_v.nPorts < 2) {
+			//出力ポートだけを持つコンポーネント
+			comp->pnum_in = OMX_ALL;
+			comp->pnum_out = param_v.nStartPortNumber;
+		} else {
+			comp->pnum_in = param_v.nStartPortNumber;
+			comp->pnum_out = param_v.nStartPortNumber + 1;
+		}
+
+		//Set StateIdle
+		result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+			goto err_out2;
+		}
+
+		if (comp->pnum_in != OMX_ALL) {
+			result = comp->use_buffers(comp->pnum_in, &comp->buf_in);
+			if (result != OMX_ErrorNone) {
+				goto err_out2;
+			}
+		}
+		result = comp->use_buffers(comp->pnum_out, &comp->buf_out);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+
+		//Wait for StatusIdle
+		comp->wait_state_changed(OMX_StateIdle);
+	}
+
+	//半分は Executing を経由し、残りは Idle から直接一時停止する
+	for (i = 0; i < N_INSTANCES; i += 2) {
+		result = comps[i]->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+			goto err_out2;
+		}
+		comps[i]->wait_state_changed(OMX_StateExecuting);
+	}
+	result = set_state_all(&comps, OMX_StatePause);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//一時停止中もバッファは受け付けるが、処理はしないはず
+	for (comp_test_pause *comp : comps) {
+		result = comp->send_all_buffers(comp->pnum_in, OMX_DirInput, nullptr);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		result = comp->send_all_buffers(comp->pnum_out, OMX_DirOutput, nullptr);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+	}
+
+	cpu_start = get_cpu_time();
+	usleep(PAUSE_MS * 1000);
+	cpu_pause = get_cpu_time() - cpu_start;
+
+	printf("paused %d instances: cpu %.1fms in %dms\n",
+		N_INSTANCES, (double)cpu_pause / 1000, PAUSE_MS);
+
+	for (comp_test_pause *comp : comps) {
+		if (comp->get_free_count(comp->pnum_in) != 0 ||
+			comp->get_free_count(comp->pnum_out) != 0) {
+			fprintf(stderr, "Buffers are processed in Pause.\n");
+			result = OMX_ErrorUndefined;
+			goto err_out2;
+		}
+	}
+	if (cpu_pause > PAUSE_MS * 1000 / 10) {
+		fprintf(stderr, "Paused components use too much CPU.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//再開すると、一時停止中に渡したバッファが処理されるはず
+	for (comp_test_pause *comp : comps) {
+		t_start = std::chrono::steady_clock::now();
+		result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+			goto err_out2;
+		}
+		comp->wait_state_changed(OMX_StateExecuting);
+		t_end = std::chrono::steady_clock::now();
+
+		lat_resume.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			t_end - t_start).count());
+	}
+	for (comp_test_pause *comp : comps) {
+		if (!comp->wait_free_count(comp->pnum_out, comp->buf_out.size())) {
+			fprintf(stderr, "FillBufferDone(%d) timeout.\n",
+				(int)comp->pnum_out);
+			result = OMX_ErrorTimeout;
+			goto err_out2;
+		}
+	}
+
+	std::sort(lat_resume.begin(), lat_resume.end());
+	printf("resume: median:%.1fus, max:%.1fus\n",
+		(double)lat_resume[lat_resume.size() / 2] / 1000,
+		(double)lat_resume.back() / 1000);
+
+	//バッファを保持したまま一時停止し、Idle へ遷移すると全て返却されるはず
+	result = set_state_all(&comps, OMX_StatePause);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = set_state_all(&comps, OMX_StateIdle);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	for (comp_test_pause *comp : comps) {
+		if (!comp->wait_free_count(comp->pnum_in, comp->buf_in.size()) ||
+			!comp->wait_free_count(comp->pnum_out, comp->buf_out.size())) {
+			fprintf(stderr, "Buffers are not returned.\n");
+			result = OMX_ErrorTimeout;
+			goto err_out2;
+		}
+	}
+
+	//Set StateLoaded
+	for (comp_test_pause *comp : comps) {
+		result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+			goto err_out2;
+		}
+
+		//Free buffer
+		comp->free_buffers(comp->pnum_in, &comp->buf_in);
+		comp->free_buffers(comp->pnum_out, &comp->buf_out);
+
+		//Wait for StatusLoaded
+		comp->wait_state_changed(OMX_StateLoaded);
+	}
+
+
+	//Terminate
+	for (comp_test_pause *comp : comps) {
+		delete comp;
+	}
+	comps.clear();
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	for (comp_test_pause *comp : comps) {
+		comp->free_buffers(comp->pnum_in, &comp->buf_in);
+		comp->free_buffers(comp->pnum_out, &comp->buf_out);
+
+		delete comp;
+	}
+	comps.clear();
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
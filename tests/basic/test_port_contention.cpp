@@ -0,0 +1,295 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//同時に動作させるコンポーネント数（ポート数はこの 2倍）
+#define N_COMPS      2
+//各ポートに流すバッファ数
+#define N_BUFFERS    2000
+
+class comp_test_port_contention : public omxil_comp_free_queue {
+public:
+	typedef omxil_comp_free_queue super;
+
+	comp_test_port_contention(const char *comp_name)
+		: omxil_comp_free_queue(comp_name)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_port_contention()
+	{
+		//do nothing
+	}
+
+};
+
+struct port_info {
+	comp_test_port_contention *comp;
+	OMX_PARAM_PORTDEFINITIONTYPE def;
+	std::vector<OMX_BUFFERHEADERTYPE *> bufs;
+};
+
+static OMX_ERRORTYPE set_state_all(comp_test_port_contention *comp[], OMX_STATETYPE s)
+{
+	OMX_ERRORTYPE result;
+	int i;
+
+	for (i = 0; i < N_COMPS; i++) {
+		result = comp[i]->SendCommand(OMX_CommandStateSet, s, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(i:%d, StateSet, %s) failed.\n",
+				i, get_omx_statetype_name(s));
+			return result;
+		}
+	}
+
+	return OMX_ErrorNone;
+}
+
+static void wait_state_all(comp_test_port_contention *comp[], OMX_STATETYPE s)
+{
+	int i;
+
+	for (i = 0; i < N_COMPS; i++) {
+		comp[i]->wait_state_changed(s);
+	}
+}
+
+//ポートにバッファを送り続ける
+static int pump_port(port_info *pi, int maxcnt)
+{
+	OMX_U32 port = pi->def.nPortIndex;
+	int i;
+
+	for (i = 0; i < maxcnt; i++) {
+		OMX_BUFFERHEADERTYPE *buf;
+		OMX_ERRORTYPE result;
+
+		buf = pi->comp->take_free_buffer(port);
+
+		if (pi->def.eDir == OMX_DirInput) {
+			buf->nFilledLen = 16;
+			result = pi->comp->EmptyThisBuffer(buf);
+		} else {
+			buf->nFilledLen = 0;
+			result = pi->comp->FillThisBuffer(buf);
+		}
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "EmptyThisBuffer/FillThisBuffer(%d) failed.\n",
+				(int)port);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	comp_test_port_contention *comp[N_COMPS] = {nullptr, };
+	OMX_PORT_PARAM_TYPE param_v;
+	port_info ports[N_COMPS * 2];
+	std::vector<std::thread> pumps;
+	std::thread poller;
+	std::atomic<bool> f_poll;
+	std::atomic<uint64_t> cnt_poll;
+	int ret[N_COMPS * 2];
+	std::chrono::steady_clock::time_point t_start;
+	std::chrono::microseconds t_elapsed;
+	OMX_ERRORTYPE result;
+	int i;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	result = OMX_ErrorNone;
+	for (i = 0; i < N_COMPS * 2; i++) {
+		ports[i].comp = nullptr;
+	}
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	for (i = 0; i < N_COMPS; i++) {
+		comp[i] = new comp_test_port_contention(arg_comp);
+		if (comp[i] == nullptr || comp[i]->get_component() == nullptr) {
+			fprintf(stderr, "OMX_GetHandle failed.\n");
+			result = OMX_ErrorInsufficientResources;
+			goto err_out2;
+		}
+
+		result = comp[i]->get_param_video_init(&param_v);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_video_init() failed.\n");
+			goto err_out2;
+		}
+
+		//入力と出力のバッファ数を揃え、片方が詰まらないようにする
+		ports[i * 2].comp = comp[i];
+		ports[i * 2 + 1].comp = comp[i];
+		result = comp[i]->get_param_port_definition(param_v.nStartPortNumber,
+			&ports[i * 2].def);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_port_definition(in) failed.\n");
+			goto err_out2;
+		}
+		result = comp[i]->get_param_port_definition(param_v.nStartPortNumber + 1,
+			&ports[i * 2 + 1].def);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_port_definition(out) failed.\n");
+			goto err_out2;
+		}
+		ports[i * 2 + 1].def.nBufferCountActual = ports[i * 2].def.nBufferCountActual;
+		result = comp[i]->SetParameter(OMX_IndexParamPortDefinition,
+			&ports[i * 2 + 1].def);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "set_port_definition(out) failed.\n");
+			goto err_out2;
+		}
+	}
+
+	result = set_state_all(comp, OMX_StateIdle);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	for (i = 0; i < N_COMPS * 2; i++) {
+		result = ports[i].comp->use_buffers(ports[i].def.nPortIndex,
+			&ports[i].bufs);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+	}
+	wait_state_all(comp, OMX_StateIdle);
+
+	result = set_state_all(comp, OMX_StateExecuting);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	wait_state_all(comp, OMX_StateExecuting);
+
+	//バッファの受け渡しと同時にポートの情報を読み続ける
+	f_poll = true;
+	cnt_poll = 0;
+	poller = std::thread([&] {
+		OMX_PARAM_PORTDEFINITIONTYPE def;
+
+		while (f_poll) {
+			for (int j = 0; j < N_COMPS * 2; j++) {
+				ports[j].comp->get_param_port_definition(
+					ports[j].def.nPortIndex, &def);
+				cnt_poll++;
+			}
+		}
+	});
+
+	t_start = std::chrono::steady_clock::now();
+	for (i = 0; i < N_COMPS * 2; i++) {
+		pumps.push_back(std::thread([&ret, &ports, i] {
+			ret[i] = pump_port(&ports[i], N_BUFFERS);
+		}));
+	}
+	for (auto& th : pumps) {
+		th.join();
+	}
+	for (i = 0; i < N_COMPS * 2; i++) {
+		if (!ports[i].comp->wait_free_count(ports[i].def.nPortIndex,
+			ports[i].bufs.size())) {
+			fprintf(stderr, "wait_free_count(%d) timeout.\n", i);
+			ret[i] = -1;
+		}
+	}
+	t_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - t_start);
+
+	f_poll = false;
+	poller.join();
+
+	for (i = 0; i < N_COMPS * 2; i++) {
+		if (ret[i] != 0) {
+			fprintf(stderr, "pump_port(%d) failed.\n", i);
+			result = OMX_ErrorUndefined;
+			goto err_out2;
+		}
+	}
+
+	printf("ports:%d, buffers:%d, elapsed:%lldus, "
+		"%.1f buffers/s per port, getter calls:%llu\n",
+		N_COMPS * 2, N_BUFFERS, (long long)t_elapsed.count(),
+		(double)N_BUFFERS * 1000000 / t_elapsed.count(),
+		(unsigned long long)cnt_poll.load());
+
+	result = set_state_all(comp, OMX_StateIdle);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	wait_state_all(comp, OMX_StateIdle);
+
+	result = set_state_all(comp, OMX_StateLoaded);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	for (i = 0; i < N_COMPS * 2; i++) {
+		ports[i].comp->free_buffers(ports[i].def.nPortIndex,
+			&ports[i].bufs);
+	}
+	wait_state_all(comp, OMX_StateLoaded);
+
+
+	//Terminate
+	for (i = 0; i < N_COMPS; i++) {
+		delete comp[i];
+	}
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	for (i = 0; i < N_COMPS * 2; i++) {
+		if (ports[i].comp != nullptr) {
+			ports[i].comp->free_buffers(ports[i].def.nPortIndex,
+				&ports[i].bufs);
+		}
+	}
+	for (i = 0; i < N_COMPS; i++) {
+		delete comp[i];
+	}
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
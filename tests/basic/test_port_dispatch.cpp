@@ -0,0 +1,287 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//1回に渡すバッファ数
+#define N_BUFFERS    64
+//計測の回数
+#define N_ROUNDS     200
+
+class comp_test_port_dispatch : public omxil_comp_free_queue {
+public:
+	typedef omxil_comp_free_queue super;
+
+	comp_test_port_dispatch(const char *comp_name)
+		: omxil_comp_free_queue(comp_name), pnum_in(0), pnum_out(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_port_dispatch()
+	{
+		//do nothing
+	}
+
+public:
+	OMX_U32 pnum_in, pnum_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+
+};
+
+//1回に渡すバッファ数を設定する
+static OMX_ERRORTYPE set_buffer_count(comp_test_port_dispatch *comp, OMX_U32 port)
+{
+	OMX_PARAM_PORTDEFINITIONTYPE def;
+	OMX_ERRORTYPE result;
+
+	result = comp->get_param_port_definition(port, &def);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(%d) failed.\n",
+			(int)port);
+		return result;
+	}
+
+	def.nBufferCountActual = N_BUFFERS;
+	result = comp->SetParameter(OMX_IndexParamPortDefinition, &def);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "set_port_definition(%d) failed.\n",
+			(int)port);
+		return result;
+	}
+
+	return OMX_ErrorNone;
+}
+
+//全ての空きバッファをコンポーネントに渡し、1回あたりの時間を返す
+static OMX_ERRORTYPE measure_send(comp_test_port_dispatch *comp, OMX_U32 port, OMX_DIRTYPE dir, long long *lat)
+{
+	std::chrono::steady_clock::time_point t_start, t_end;
+	OMX_ERRORTYPE result;
+	size_t n = 0;
+
+	t_start = std::chrono::steady_clock::now();
+	result = comp->send_all_buffers(port, dir, &n);
+	t_end = std::chrono::steady_clock::now();
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+	if (n == 0) {
+		fprintf(stderr, "No free buffers(%d).\n",
+			(int)port);
+		return OMX_ErrorInsufficientResources;
+	}
+
+	*lat = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		t_end - t_start).count() / n;
+
+	return OMX_ErrorNone;
+}
+
+static void print_latency(const char *name, std::vector<long long> *lat)
+{
+	long long sum = 0;
+
+	if (lat->empty()) {
+		return;
+	}
+
+	std::sort(lat->begin(), lat->end());
+	for (long long l : *lat) {
+		sum += l;
+	}
+	printf("%s: %d rounds x %d buffers, per call avg:%lldns, median:%lldns, max:%lldns\n",
+		name, (int)lat->size(), N_BUFFERS,
+		sum / (long long)lat->size(),
+		(*lat)[lat->size() / 2],
+		lat->back());
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	comp_test_port_dispatch *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	std::vector<long long> lat_empty, lat_fill;
+	long long lat;
+	OMX_ERRORTYPE result;
+	int i;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	//Reference:
+	//    OpenMAX IL specification version 1.2.0
+	//    3.2.2.13  OMX_EmptyThisBuffer
+	//    3.2.2.14  OMX_FillThisBuffer
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new comp_test_port_dispatch(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+	comp->pnum_in = param_v.nStartPortNumber;
+	comp->pnum_out = param_v.nStartPortNumber + 1;
+
+	result = set_buffer_count(comp, comp->pnum_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = set_buffer_count(comp, comp->pnum_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(comp->pnum_in, &comp->buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = comp->use_buffers(comp->pnum_out, &comp->buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//一時停止中に渡し、ワーカースレッドと競合させずに受付の時間だけを測る
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StatePause, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Pause) failed.\n");
+		goto err_out2;
+	}
+	comp->wait_state_changed(OMX_StatePause);
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		result = measure_send(comp, comp->pnum_in, OMX_DirInput, &lat);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		lat_empty.push_back(lat);
+
+		result = measure_send(comp, comp->pnum_out, OMX_DirOutput, &lat);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		lat_fill.push_back(lat);
+
+		//再開して全て処理させ、また一時停止する
+		result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+			goto err_out2;
+		}
+		comp->wait_state_changed(OMX_StateExecuting);
+
+		if (!comp->wait_free_count(comp->pnum_in, comp->buf_in.size()) ||
+			!comp->wait_free_count(comp->pnum_out, comp->buf_out.size())) {
+			fprintf(stderr, "Buffers are not returned at %d.\n", i);
+			result = OMX_ErrorTimeout;
+			goto err_out2;
+		}
+
+		result = comp->SendCommand(OMX_CommandStateSet, OMX_StatePause, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, Pause) failed.\n");
+			goto err_out2;
+		}
+		comp->wait_state_changed(OMX_StatePause);
+	}
+
+	print_latency("EmptyThisBuffer", &lat_empty);
+	print_latency("FillThisBuffer", &lat_fill);
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(comp->pnum_in, &comp->buf_in);
+	comp->free_buffers(comp->pnum_out, &comp->buf_out);
+
+	//Wait for StatusLoaded
+	comp->wait_state_changed(OMX_StateLoaded);
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->free_buffers(comp->pnum_in, &comp->buf_in);
+	comp->free_buffers(comp->pnum_out, &comp->buf_out);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,365 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//繰り返し回数
+#define N_ROUNDS    100
+//入力バッファに詰めるデータ量
+#define IN_SIZE     8
+
+static const char *stage_names[] = {
+	"queued",
+	"held",
+	"returning",
+	"callback",
+	"total",
+};
+
+static OMX_ERRORTYPE get_latency(omxil_comp *comp, OMX_U32 port, OMX_MF_CONFIG_PORTLATENCYTYPE *conf)
+{
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_CONFIG_PORT_LATENCY, &index);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	memset(conf, 0, sizeof(*conf));
+	conf->nSize      = sizeof(*conf);
+	omxil_comp::fill_version(&conf->nVersion);
+	conf->nPortIndex = port;
+
+	return comp->GetConfig(index, conf);
+}
+
+static OMX_ERRORTYPE reset_latency(omxil_comp *comp, OMX_U32 port)
+{
+	OMX_MF_CONFIG_PORTLATENCYTYPE conf;
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_CONFIG_PORT_LATENCY, &index);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	memset(&conf, 0, sizeof(conf));
+	conf.nSize      = sizeof(conf);
+	omxil_comp::fill_version(&conf.nVersion);
+	conf.nPortIndex = port;
+
+	return comp->SetConfig(index, &conf);
+}
+
+static bool check_latency(const char *name, const OMX_MF_CONFIG_PORTLATENCYTYPE *conf, OMX_U64 n_bufs, OMX_U64 n_bytes)
+{
+	bool f_ok = true;
+	int i;
+
+	printf("%s: buffers:%llu, bytes:%llu, elapsed:%lluus\n", name,
+		(unsigned long long)conf->nBuffers,
+		(unsigned long long)conf->nBytes,
+		(unsigned long long)conf->nElapsedUs);
+
+	if (conf->nBuffers != n_bufs || conf->nBytes != n_bytes) {
+		fprintf(stderr, "%s: buffers:%llu/%llu, bytes:%llu/%llu.\n", name,
+			(unsigned long long)conf->nBuffers,
+			(unsigned long long)n_bufs,
+			(unsigned long long)conf->nBytes,
+			(unsigned long long)n_bytes);
+		f_ok = false;
+	}
+
+	for (i = 0; i < OMX_MF_LatencyStageMax; i++) {
+		const OMX_MF_LATENCYSTATSTYPE *st = &conf->sStage[i];
+
+		printf("  %-9s: count:%llu, min:%lluns, mean:%lluns, "
+			"p50:%lluns, p99:%lluns, p999:%lluns, max:%lluns\n",
+			stage_names[i],
+			(unsigned long long)st->nCount,
+			(unsigned long long)st->nMinNs,
+			(unsigned long long)st->nMeanNs,
+			(unsigned long long)st->nP50Ns,
+			(unsigned long long)st->nP99Ns,
+			(unsigned long long)st->nP999Ns,
+			(unsigned long long)st->nMaxNs);
+
+		//全てのバッファがコンポーネントを通り、コールバックで返却される
+		if (st->nCount != n_bufs) {
+			fprintf(stderr, "%s: %s count:%llu/%llu.\n",
+				name, stage_names[i],
+				(unsigned long long)st->nCount,
+				(unsigned long long)n_bufs);
+			f_ok = false;
+		}
+		if (st->nCount == 0) {
+			continue;
+		}
+		if (st->nMinNs > st->nP50Ns || st->nP50Ns > st->nP99Ns ||
+			st->nP99Ns > st->nP999Ns || st->nP999Ns > st->nMaxNs ||
+			st->nMeanNs < st->nMinNs || st->nMeanNs > st->nMaxNs) {
+			fprintf(stderr, "%s: %s percentiles are not ordered.\n",
+				name, stage_names[i]);
+			f_ok = false;
+		}
+	}
+
+	//バッファごとの全体の遅延は、各段階の遅延より短くならない
+	for (i = 0; n_bufs > 0 && i < OMX_MF_LatencyStageTotal; i++) {
+		if (conf->sStage[OMX_MF_LatencyStageTotal].nMinNs <
+			conf->sStage[i].nMinNs) {
+			fprintf(stderr, "%s: total is shorter than %s.\n",
+				name, stage_names[i]);
+			f_ok = false;
+		}
+	}
+
+	return f_ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	omxil_comp *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in, def_out;
+	OMX_MF_CONFIG_PORTLATENCYTYPE lat_in, lat_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> sub_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> sub_out;
+	OMX_U32 pnum_in, pnum_out;
+	OMX_ERRORTYPE result;
+	int i, n_in, n_out;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+	pnum_out = 0;
+	n_in = 0;
+	n_out = 0;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new omxil_comp(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	printf("OMX_GetHandle: name:%s, comp:%p\n",
+		arg_comp, comp);
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	pnum_in = param_v.nStartPortNumber;
+	pnum_out = param_v.nStartPortNumber + 1;
+
+	//存在しないポートは読めない
+	result = get_latency(comp, pnum_out + 1, &lat_in);
+	if (result != OMX_ErrorBadPortIndex) {
+		fprintf(stderr, "Invalid port is not rejected.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+
+	//入力と出力のバッファ数を揃え、一巡ごとに全て返却させる
+	result = comp->get_param_port_definition(pnum_out, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+	def_out.nBufferCountActual = def_in.nBufferCountActual;
+	result = comp->SetParameter(OMX_IndexParamPortDefinition, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "set_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = comp->use_buffers(pnum_out, &buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusExecuting
+	printf("wait for StateExecuting...\n");
+	comp->wait_state_changed(OMX_StateExecuting);
+	printf("wait for StateExecuting... Done!\n");
+
+	//ここまでの統計を消去する
+	result = reset_latency(comp, pnum_in);
+	if (result == OMX_ErrorNone) {
+		result = reset_latency(comp, pnum_out);
+	}
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "Reset latency failed.\n");
+		goto err_out2;
+	}
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		comp->get_free_buffers(pnum_in, IN_SIZE, &sub_in);
+		comp->get_free_buffers(pnum_out, 0, &sub_out);
+
+		for (OMX_BUFFERHEADERTYPE *buf : sub_out) {
+			result = comp->FillThisBuffer(buf);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "OMX_FillThisBuffer failed.\n");
+				goto err_out2;
+			}
+		}
+		for (OMX_BUFFERHEADERTYPE *buf : sub_in) {
+			result = comp->EmptyThisBuffer(buf);
+			if (result != OMX_ErrorNone) {
+				fprintf(stderr, "OMX_EmptyThisBuffer failed.\n");
+				goto err_out2;
+			}
+		}
+		n_in += sub_in.size();
+		n_out += sub_out.size();
+
+		comp->wait_all_buffer_free(pnum_in);
+		comp->wait_all_buffer_free(pnum_out);
+	}
+
+	//Set StateIdle
+	//全てのバッファのコールバックが戻るまで待つ
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	result = get_latency(comp, pnum_in, &lat_in);
+	if (result == OMX_ErrorNone) {
+		result = get_latency(comp, pnum_out, &lat_out);
+	}
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "Get latency failed.\n");
+		goto err_out2;
+	}
+
+	//出力ポートの返却データ量はコンポーネントが詰めた量
+	if (!check_latency("in", &lat_in, n_in, (OMX_U64)n_in * IN_SIZE) ||
+		!check_latency("out", &lat_out, n_out, lat_out.nBytes)) {
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//消去すると何も残らない
+	result = reset_latency(comp, pnum_in);
+	if (result == OMX_ErrorNone) {
+		result = get_latency(comp, pnum_in, &lat_in);
+	}
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "Reset latency failed.\n");
+		goto err_out2;
+	}
+	if (!check_latency("in(reset)", &lat_in, 0, 0)) {
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	//Wait for StatusLoaded
+	printf("wait for StateLoaded...\n");
+	comp->wait_state_changed(OMX_StateLoaded);
+	printf("wait for StateLoaded... Done!\n");
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,255 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <omxil_mf/omxil_mf.h>
+#include <omxil_mf/component.hpp>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//登録するコンポーネントの数
+#define N_COMPS        5000
+//登録するロールの数、コンポーネントは順に割り当てる
+#define N_ROLES        50
+//同時に検索するスレッドの数
+#define N_THREADS      8
+//各スレッドが検索する回数
+#define N_LOOKUPS      2000
+//この回数の検索ごとに OMX_GetHandle を呼ぶ
+#define GET_INTERVAL   40
+
+#define TEST_COMP_NAME    "OMX.MF.test.registry.%04d"
+#define TEST_ROLE_NAME    "test_registry.%02d"
+
+static std::atomic<bool> f_start;
+static std::atomic<int> cnt_errors;
+static std::atomic<int> cnt_handles;
+
+static void *OMX_APIENTRY test_registry_constructor(OMX_COMPONENTTYPE *cComponent, const char *name)
+{
+	return new mf::component(cComponent, name);
+}
+
+static void OMX_APIENTRY test_registry_destructor(OMX_COMPONENTTYPE *cComponent)
+{
+	mf::component *comp = mf::component::get_instance(cComponent);
+
+	delete comp;
+}
+
+//ランダムに選んだコンポーネントのロールを調べ、ときどき生成する
+static void lookup_components(int id)
+{
+	char name_comp[OMX_MAX_STRINGNAME_SIZE];
+	char name_role[OMX_MAX_STRINGNAME_SIZE];
+	char name_expect[OMX_MAX_STRINGNAME_SIZE];
+	OMX_U8 *ptr_role = (OMX_U8 *)name_role;
+	OMX_U32 num_roles;
+	uint32_t seed = 12345 + id;
+	omxil_comp *comp;
+	OMX_ERRORTYPE result;
+	int i, n;
+
+	while (!f_start) {
+		std::this_thread::yield();
+	}
+
+	for (i = 0; i < N_LOOKUPS; i++) {
+		seed = seed * 1103515245 + 12345;
+		n = (seed >> 8) % N_COMPS;
+
+		snprintf(name_comp, sizeof(name_comp), TEST_COMP_NAME, n);
+		snprintf(name_expect, sizeof(name_expect), TEST_ROLE_NAME, n % N_ROLES);
+
+		num_roles = 1;
+		result = OMX_GetRolesOfComponent(name_comp, &num_roles, &ptr_role);
+		if (result != OMX_ErrorNone || num_roles != 1 ||
+			strcmp(name_role, name_expect) != 0) {
+			fprintf(stderr, "OMX_GetRolesOfComponent(%s) failed.\n",
+				name_comp);
+			cnt_errors++;
+		}
+
+		if (i % GET_INTERVAL != 0) {
+			continue;
+		}
+
+		comp = new omxil_comp(name_comp);
+		if (comp->get_component() == nullptr) {
+			fprintf(stderr, "OMX_GetHandle(%s) failed.\n",
+				name_comp);
+			cnt_errors++;
+		} else {
+			cnt_handles++;
+		}
+		delete comp;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	char name_comp[OMX_MAX_STRINGNAME_SIZE];
+	char name_role[OMX_MAX_STRINGNAME_SIZE];
+	std::string name_prev;
+	std::vector<std::thread> threads;
+	std::chrono::steady_clock::time_point t_begin;
+	double t_regist, t_enum, t_lookup;
+	OMX_MF_COMPONENT_INFO comp_info;
+	omxil_comp *comp;
+	OMX_ERRORTYPE result;
+	OMX_U8 *ptr_comp = (OMX_U8 *)name_comp;
+	OMX_U32 i, n_enum, n_role_comps;
+	int n_test;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.st.video_decoder.avc";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	result = OMX_ErrorNone;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	//大量のコンポーネントとロールを登録する
+	t_begin = std::chrono::steady_clock::now();
+	comp_info.constructor = test_registry_constructor;
+	comp_info.destructor  = test_registry_destructor;
+	for (i = 0; i < N_COMPS; i++) {
+		snprintf(name_comp, sizeof(name_comp), TEST_COMP_NAME, (int)i);
+		snprintf(name_role, sizeof(name_role), TEST_ROLE_NAME, (int)(i % N_ROLES));
+
+		result = OMX_MF_RegisterComponent(name_comp, &comp_info);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_MF_RegisterComponent(%s) failed.\n",
+				name_comp);
+			goto err_out2;
+		}
+		result = OMX_MF_RegisterComponentRole(name_comp, name_role);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_MF_RegisterComponentRole(%s) failed.\n",
+				name_comp);
+			goto err_out2;
+		}
+	}
+	t_regist = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - t_begin).count();
+
+	//全てのコンポーネントを番号順に列挙する、名前順に並んでいるはず
+	t_begin = std::chrono::steady_clock::now();
+	n_test = 0;
+	for (i = 0; ; i++) {
+		result = OMX_ComponentNameEnum(name_comp,
+			sizeof(name_comp) - 1, i);
+		if (result == OMX_ErrorNoMore) {
+			break;
+		} else if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_ComponentNameEnum failed.\n");
+			goto err_out2;
+		}
+
+		if (i > 0 && name_prev.compare(name_comp) >= 0) {
+			fprintf(stderr, "Components are not sorted: '%s', '%s'.\n",
+				name_prev.c_str(), name_comp);
+			result = OMX_ErrorUndefined;
+			goto err_out2;
+		}
+		name_prev = name_comp;
+
+		if (strncmp(name_comp, "OMX.MF.test.registry.", 21) == 0) {
+			n_test++;
+		}
+	}
+	n_enum = i;
+	t_enum = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - t_begin).count();
+	if (n_test != N_COMPS) {
+		fprintf(stderr, "Enumerated %d test components, expected %d.\n",
+			n_test, N_COMPS);
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//ロールから引いたコンポーネントの数
+	snprintf(name_role, sizeof(name_role), TEST_ROLE_NAME, 0);
+	n_role_comps = 0;
+	result = OMX_GetComponentsOfRole(name_role, &n_role_comps, &ptr_comp);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_GetComponentsOfRole failed.\n");
+		goto err_out2;
+	}
+	if (n_role_comps != N_COMPS / N_ROLES) {
+		fprintf(stderr, "Role '%s' has %d components, expected %d.\n",
+			name_role, (int)n_role_comps, N_COMPS / N_ROLES);
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//rc ファイルから登録したコンポーネントも変わらず生成できる
+	comp = new omxil_comp(arg_comp);
+	if (comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle(%s) failed.\n", arg_comp);
+		delete comp;
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	delete comp;
+
+	//複数のスレッドから同時に検索、生成する
+	f_start = false;
+	cnt_errors = 0;
+	cnt_handles = 0;
+	for (int j = 0; j < N_THREADS; j++) {
+		threads.push_back(std::thread(lookup_components, j));
+	}
+	t_begin = std::chrono::steady_clock::now();
+	f_start = true;
+	for (auto& th : threads) {
+		th.join();
+	}
+	t_lookup = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - t_begin).count();
+
+	printf("register %d comps: %.3f ms\n"
+		"enumerate %d comps: %.3f ms\n"
+		"%d threads x %d lookups, %d handles: %.3f ms, errors:%d\n",
+		N_COMPS, t_regist, (int)n_enum, t_enum,
+		N_THREADS, N_LOOKUPS, (int)cnt_handles, t_lookup, (int)cnt_errors);
+	if (cnt_errors != 0) {
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,294 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//状態やポート定義を読み続けるスレッドの数
+#define N_POLLERS      4
+//ポート定義を書き換え続ける期間（ミリ秒）
+#define REWRITE_MS     200
+//Idle と Executing を往復する回数
+#define N_CYCLES       50
+
+//ポート定義を書き換える 2通りの値
+struct def_pattern {
+	OMX_U32 count;
+	OMX_U32 width;
+	OMX_U32 height;
+};
+
+static const def_pattern patterns[2] = {
+	{ 4, 320, 240 },
+	{ 8, 640, 480 },
+};
+
+static std::atomic<bool> f_stop;
+static std::atomic<long long> cnt_polls;
+static std::atomic<long long> cnt_torn;
+static std::atomic<long long> cnt_bad_state;
+
+//ポート定義を読み続け、書き換え途中の値が見えないことを確かめる
+static void poll_definition(omxil_comp *comp, OMX_U32 port)
+{
+	OMX_PARAM_PORTDEFINITIONTYPE def;
+	OMX_ERRORTYPE result;
+	long long n = 0;
+
+	while (!f_stop) {
+		result = comp->get_param_port_definition(port, &def);
+		if (result != OMX_ErrorNone) {
+			cnt_torn++;
+			continue;
+		}
+
+		bool found = false;
+		for (const def_pattern& p : patterns) {
+			if (def.nBufferCountActual == p.count &&
+				def.format.video.nFrameWidth == p.width &&
+				def.format.video.nFrameHeight == p.height &&
+				def.format.video.nStride == (OMX_S32)p.width) {
+				found = true;
+			}
+		}
+		if (def.nPortIndex != port || !found) {
+			cnt_torn++;
+		}
+		n++;
+	}
+
+	cnt_polls += n;
+}
+
+//状態を読み続ける
+static void poll_state(omxil_comp *comp)
+{
+	OMX_STATETYPE s;
+	long long n = 0;
+
+	while (!f_stop) {
+		comp->GetState(&s);
+		if (s != OMX_StateIdle && s != OMX_StateExecuting) {
+			cnt_bad_state++;
+		}
+		n++;
+	}
+
+	cnt_polls += n;
+}
+
+static OMX_ERRORTYPE set_definition(omxil_comp *comp, OMX_U32 port, const def_pattern& p)
+{
+	OMX_PARAM_PORTDEFINITIONTYPE def;
+	OMX_ERRORTYPE result;
+
+	result = comp->get_param_port_definition(port, &def);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(%d) failed.\n",
+			(int)port);
+		return result;
+	}
+
+	def.nBufferCountActual = p.count;
+	def.format.video.nFrameWidth  = p.width;
+	def.format.video.nFrameHeight = p.height;
+	def.format.video.nStride      = p.width;
+	result = comp->SetParameter(OMX_IndexParamPortDefinition, &def);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SetParameter(PortDefinition) failed.\n");
+		return result;
+	}
+
+	return OMX_ErrorNone;
+}
+
+static void stop_pollers(std::vector<std::thread *> *ths)
+{
+	f_stop = true;
+	for (std::thread *th : *ths) {
+		th->join();
+		delete th;
+	}
+	ths->clear();
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	omxil_comp *comp = nullptr;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in, buf_out;
+	std::vector<std::thread *> ths;
+	std::vector<long long> lat_trans;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_U32 pnum_in = 0, pnum_out = 0;
+	std::chrono::steady_clock::time_point t_start, t_end;
+	OMX_ERRORTYPE result;
+	int i, n_rewrites;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new omxil_comp(arg_comp);
+	if (comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+	pnum_in = param_v.nStartPortNumber;
+	pnum_out = param_v.nStartPortNumber + 1;
+
+	//ポート定義の書き換え中に読み出しても、
+	//書き換え前か書き換え後のどちらかが見えるはず
+	result = set_definition(comp, pnum_in, patterns[0]);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	f_stop = false;
+	for (i = 0; i < N_POLLERS; i++) {
+		ths.push_back(new std::thread(poll_definition, comp, pnum_in));
+	}
+	t_start = std::chrono::steady_clock::now();
+	n_rewrites = 0;
+	do {
+		n_rewrites++;
+		result = set_definition(comp, pnum_in, patterns[n_rewrites & 1]);
+		if (result != OMX_ErrorNone) {
+			stop_pollers(&ths);
+			goto err_out2;
+		}
+		t_end = std::chrono::steady_clock::now();
+	} while (t_end - t_start < std::chrono::milliseconds(REWRITE_MS));
+	stop_pollers(&ths);
+
+	printf("definition: rewrites:%d, polls:%lld, torn:%lld\n",
+		n_rewrites, (long long)cnt_polls, (long long)cnt_torn);
+	if (cnt_torn != 0) {
+		fprintf(stderr, "Torn port definition is read.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = comp->use_buffers(pnum_out, &buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//状態を読み続けるスレッドがいても、状態遷移は遅くならないはず
+	cnt_polls = 0;
+	f_stop = false;
+	for (i = 0; i < N_POLLERS; i++) {
+		ths.push_back(new std::thread(poll_state, comp));
+	}
+	for (i = 0; i < N_CYCLES * 2; i++) {
+		OMX_STATETYPE s = (i & 1) ? OMX_StateIdle : OMX_StateExecuting;
+
+		t_start = std::chrono::steady_clock::now();
+		result = comp->SendCommand(OMX_CommandStateSet, s, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(StateSet, %s) failed.\n",
+				get_omx_statetype_name(s));
+			stop_pollers(&ths);
+			goto err_out2;
+		}
+		comp->wait_state_changed(s);
+		t_end = std::chrono::steady_clock::now();
+
+		lat_trans.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			t_end - t_start).count());
+	}
+	stop_pollers(&ths);
+
+	std::sort(lat_trans.begin(), lat_trans.end());
+	printf("state: polls:%lld, transition median:%.1fus, max:%.1fus\n",
+		(long long)cnt_polls,
+		(double)lat_trans[lat_trans.size() / 2] / 1000,
+		(double)lat_trans.back() / 1000);
+	if (cnt_bad_state != 0) {
+		fprintf(stderr, "Unexpected state is read.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	//Wait for StatusLoaded
+	comp->wait_state_changed(OMX_StateLoaded);
+
+
+	//Terminate
+	delete comp;
+	comp = nullptr;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	if (comp != nullptr) {
+		comp->free_buffers(pnum_in, &buf_in);
+		comp->free_buffers(pnum_out, &buf_out);
+	}
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,233 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <unistd.h>
+#include <dirent.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//停止と再生を繰り返す回数
+#define N_CYCLES    50
+
+//プロセス内のスレッド数を数える、数えられなければ -1 を返す
+static int count_threads()
+{
+	DIR *dir;
+	struct dirent *ent;
+	int cnt = 0;
+
+	dir = opendir("/proc/self/task");
+	if (dir == nullptr) {
+		return -1;
+	}
+	while ((ent = readdir(dir)) != nullptr) {
+		if (ent->d_name[0] != '.') {
+			cnt++;
+		}
+	}
+	closedir(dir);
+
+	return cnt;
+}
+
+//状態遷移を要求し、完了するまでの時間を測る
+static OMX_ERRORTYPE set_state_timed(omxil_comp *comp, OMX_STATETYPE s, std::chrono::microseconds *elapsed)
+{
+	std::chrono::steady_clock::time_point t_start;
+	OMX_ERRORTYPE result;
+
+	t_start = std::chrono::steady_clock::now();
+
+	result = comp->SendCommand(OMX_CommandStateSet, s, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, %s) failed.\n",
+			get_omx_statetype_name(s));
+		return result;
+	}
+	comp->wait_state_changed(s);
+
+	*elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - t_start);
+
+	return OMX_ErrorNone;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	omxil_comp *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in, def_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+	OMX_U32 pnum_in, pnum_out;
+	std::chrono::microseconds t_play, t_stop;
+	long long play_total, play_max, stop_total, stop_max;
+	int th_exec, th_idle;
+	int i;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+	pnum_out = 0;
+	th_exec = -1;
+	th_idle = -1;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new omxil_comp(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	printf("OMX_GetHandle: name:%s, comp:%p\n",
+		arg_comp, comp);
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	pnum_in = param_v.nStartPortNumber;
+	pnum_out = param_v.nStartPortNumber + 1;
+
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+	result = comp->get_param_port_definition(pnum_out, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = comp->use_buffers(pnum_out, &buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	//再生（Idle -> Executing）と停止（Executing -> Idle）を繰り返す
+	play_total = 0;
+	play_max = 0;
+	stop_total = 0;
+	stop_max = 0;
+	for (i = 0; i < N_CYCLES; i++) {
+		result = set_state_timed(comp, OMX_StateExecuting, &t_play);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		if (i == 0) {
+			th_exec = count_threads();
+		}
+
+		result = set_state_timed(comp, OMX_StateIdle, &t_stop);
+		if (result != OMX_ErrorNone) {
+			goto err_out2;
+		}
+		if (i == 0) {
+			th_idle = count_threads();
+		}
+
+		play_total += t_play.count();
+		play_max = std::max(play_max, (long long)t_play.count());
+		stop_total += t_stop.count();
+		stop_max = std::max(stop_max, (long long)t_stop.count());
+	}
+
+	printf("cycles:%d, play(Idle->Executing) avg:%lldus, max:%lldus, "
+		"stop(Executing->Idle) avg:%lldus, max:%lldus\n",
+		N_CYCLES, play_total / N_CYCLES, play_max,
+		stop_total / N_CYCLES, stop_max);
+	printf("threads: executing:%d, idle:%d\n", th_exec, th_idle);
+
+	//停止してもワーカースレッドは破棄されないはず
+	if (th_exec >= 0 && th_idle >= 0 && th_exec != th_idle) {
+		fprintf(stderr, "Worker threads are not kept while idle.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	//Wait for StatusLoaded
+	printf("wait for StateLoaded...\n");
+	comp->wait_state_changed(OMX_StateLoaded);
+	printf("wait for StateLoaded... Done!\n");
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,327 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <chrono>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//繰り返し回数
+#define N_ROUNDS    100
+
+class comp_test_submit_buffers : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	comp_test_submit_buffers(const char *comp_name)
+		: omxil_comp(comp_name), cnt_in(0), cnt_out(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_submit_buffers()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		cnt_in++;
+
+		return super::EmptyBufferDone(hComponent, pAppData, pBuffer);
+	}
+
+	virtual OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		cnt_out++;
+
+		return super::FillBufferDone(hComponent, pAppData, pBuffer);
+	}
+
+	int get_count_in() const
+	{
+		return cnt_in;
+	}
+
+	int get_count_out() const
+	{
+		return cnt_out;
+	}
+
+private:
+	int cnt_in, cnt_out;
+
+};
+
+static OMX_ERRORTYPE submit_buffers(comp_test_submit_buffers *comp, OMX_U32 port, std::vector<OMX_BUFFERHEADERTYPE *> *bufs)
+{
+	OMX_MF_CONFIG_SUBMITBUFFERSTYPE param;
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_CONFIG_SUBMIT_BUFFERS, &index);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	memset(&param, 0, sizeof(param));
+	param.nSize      = sizeof(param);
+	omxil_comp::fill_version(&param.nVersion);
+	param.nPortIndex = port;
+	param.nBuffers   = bufs->size();
+	param.ppBuffers  = &(*bufs)[0];
+
+	return comp->SetConfig(index, &param);
+}
+
+static OMX_ERRORTYPE submit_buffers_single(comp_test_submit_buffers *comp, OMX_U32 port, OMX_DIRTYPE dir, std::vector<OMX_BUFFERHEADERTYPE *> *bufs)
+{
+	OMX_ERRORTYPE result;
+
+	for (OMX_BUFFERHEADERTYPE *buf : *bufs) {
+		if (dir == OMX_DirInput) {
+			result = comp->EmptyThisBuffer(buf);
+		} else {
+			result = comp->FillThisBuffer(buf);
+		}
+		if (result != OMX_ErrorNone) {
+			return result;
+		}
+	}
+
+	return OMX_ErrorNone;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	comp_test_submit_buffers *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in, def_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> sub_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> sub_out;
+	std::vector<OMX_BUFFERHEADERTYPE *> sub_dup;
+	std::chrono::steady_clock::time_point t_start;
+	std::chrono::nanoseconds t_single(0), t_batch(0);
+	OMX_U32 pnum_in, pnum_out;
+	OMX_ERRORTYPE result;
+	int i, n_in, n_out;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+	pnum_out = 0;
+	n_in = 0;
+	n_out = 0;
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	comp = new comp_test_submit_buffers(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+	printf("OMX_GetHandle: name:%s, comp:%p\n",
+		arg_comp, comp);
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	pnum_in = param_v.nStartPortNumber;
+	pnum_out = param_v.nStartPortNumber + 1;
+
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+
+	//入力と出力のバッファ数を揃え、一巡ごとに全て返却させる
+	result = comp->get_param_port_definition(pnum_out, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+	def_out.nBufferCountActual = def_in.nBufferCountActual;
+	result = comp->SetParameter(OMX_IndexParamPortDefinition, &def_out);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "set_port_definition(out) failed.\n");
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+	result = comp->use_buffers(pnum_out, &buf_out);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusExecuting
+	printf("wait for StateExecuting...\n");
+	comp->wait_state_changed(OMX_StateExecuting);
+	printf("wait for StateExecuting... Done!\n");
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		comp->get_free_buffers(pnum_in, 8, &sub_in);
+		comp->get_free_buffers(pnum_out, 0, &sub_out);
+
+		if (i == 0) {
+			//不正なバッファが含まれていれば、何も受け付けない
+			sub_in.push_back(nullptr);
+			result = submit_buffers(comp, pnum_in, &sub_in);
+			if (result != OMX_ErrorBadParameter) {
+				fprintf(stderr, "Invalid buffer is not rejected.\n");
+				result = OMX_ErrorUndefined;
+				goto err_out2;
+			}
+			sub_in.pop_back();
+
+			//ポートが保持できる数を超えていれば、何も受け付けない
+			sub_dup = sub_in;
+			sub_dup.insert(sub_dup.end(), sub_in.begin(), sub_in.end());
+			result = submit_buffers(comp, pnum_in, &sub_dup);
+			if (result != OMX_ErrorBadParameter) {
+				fprintf(stderr, "Too many buffers are not rejected.\n");
+				result = OMX_ErrorUndefined;
+				goto err_out2;
+			}
+		}
+
+		t_start = std::chrono::steady_clock::now();
+		if (i % 2 == 0) {
+			result = submit_buffers(comp, pnum_out, &sub_out);
+			if (result == OMX_ErrorNone) {
+				result = submit_buffers(comp, pnum_in, &sub_in);
+			}
+			t_batch += std::chrono::steady_clock::now() - t_start;
+		} else {
+			result = submit_buffers_single(comp, pnum_out, OMX_DirOutput, &sub_out);
+			if (result == OMX_ErrorNone) {
+				result = submit_buffers_single(comp, pnum_in, OMX_DirInput, &sub_in);
+			}
+			t_single += std::chrono::steady_clock::now() - t_start;
+		}
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "Submit buffers failed.\n");
+			goto err_out2;
+		}
+		n_in += sub_in.size();
+		n_out += sub_out.size();
+
+		comp->wait_all_buffer_free(pnum_in);
+		comp->wait_all_buffer_free(pnum_out);
+	}
+
+	printf("submit: single:%lldns, batch:%lldns (per round)\n",
+		(long long)t_single.count() / (N_ROUNDS / 2),
+		(long long)t_batch.count() / (N_ROUNDS / 2));
+
+	if (comp->get_count_in() != n_in || comp->get_count_out() != n_out) {
+		fprintf(stderr, "Returned buffers in:%d/%d, out:%d/%d.\n",
+			comp->get_count_in(), n_in,
+			comp->get_count_out(), n_out);
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	//Wait for StatusIdle
+	printf("wait for StateIdle...\n");
+	comp->wait_state_changed(OMX_StateIdle);
+	printf("wait for StateIdle... Done!\n");
+
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	//Wait for StatusLoaded
+	printf("wait for StateLoaded...\n");
+	comp->wait_state_changed(OMX_StateLoaded);
+	printf("wait for StateLoaded... Done!\n");
+
+
+	//Terminate
+	delete comp;
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	comp->free_buffers(pnum_in, &buf_in);
+	comp->free_buffers(pnum_out, &buf_out);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,324 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <omxil_mf/omxil_mf.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//EmptyThisBuffer から EmptyBufferDone までを繰り返す回数
+#define N_ROUNDS    2000
+
+class comp_test_trace : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	comp_test_trace(const char *comp_name)
+		: omxil_comp(comp_name), cnt_done(0)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_trace()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		cnt_done.fetch_add(1, std::memory_order_release);
+
+		return OMX_ErrorNone;
+	}
+
+	int get_count_done() const
+	{
+		return cnt_done.load(std::memory_order_acquire);
+	}
+
+private:
+	std::atomic<int> cnt_done;
+
+};
+
+/**
+ * 1つのバッファを送出し、返却されるまで待つことを繰り返す。
+ *
+ * @return 1回あたりの時間（ナノ秒）、失敗したら負の値
+ */
+static long long round_trip(comp_test_trace *comp, OMX_BUFFERHEADERTYPE *buf)
+{
+	std::chrono::steady_clock::time_point t_start;
+	int i, base;
+
+	base = comp->get_count_done();
+	t_start = std::chrono::steady_clock::now();
+	for (i = 0; i < N_ROUNDS; i++) {
+		buf->nFilledLen = 8;
+		buf->nOffset    = 0;
+		buf->nFlags     = 0;
+		if (comp->EmptyThisBuffer(buf) != OMX_ErrorNone) {
+			return -1;
+		}
+
+		while (comp->get_count_done() <= base + i) {
+			std::this_thread::yield();
+		}
+	}
+
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - t_start).count() / N_ROUNDS;
+}
+
+/**
+ * 書き出されたトレースを確認する。
+ *
+ * @return 0 if success, -1 if failed
+ */
+static int check_trace(const char *path)
+{
+	static const char *expected[] = {
+		"\"name\":\"thread_name\"",
+		"\"name\":\"omx:",
+		"\"name\":\"push_buffer\"",
+		"\"name\":\"pop_buffer\"",
+		"\"name\":\"push_buffer_done\"",
+		"\"name\":\"EmptyBufferDone\"",
+		"\"name\":\"EventHandler\"",
+		"\"name\":\"command\"",
+		"\"name\":\"state_set\"",
+		"\"name\":\"state\"",
+		"\"name\":\"flush:",
+	};
+	std::string json;
+	char buf[4096];
+	FILE *f;
+	size_t n;
+	int depth = 0;
+
+	f = fopen(path, "r");
+	if (f == nullptr) {
+		fprintf(stderr, "Cannot open '%s'.\n", path);
+		return -1;
+	}
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		json.append(buf, n);
+	}
+	fclose(f);
+
+	for (const char *e : expected) {
+		if (json.find(e) == std::string::npos) {
+			fprintf(stderr, "Trace has no %s.\n", e);
+			return -1;
+		}
+	}
+
+	//名前に括弧を含むものはないので、数が合えば閉じている
+	for (char c : json) {
+		if (c == '{' || c == '[') {
+			depth++;
+		} else if (c == '}' || c == ']') {
+			depth--;
+		}
+		if (depth < 0) {
+			break;
+		}
+	}
+	if (json.compare(0, 1, "{") != 0 || depth != 0) {
+		fprintf(stderr, "Trace is broken.\n");
+		return -1;
+	}
+
+	printf("trace: %d bytes\n", (int)json.size());
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	char path[] = "/tmp/omxil_mf_trace_XXXXXX";
+	comp_test_trace *comp;
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_PARAM_PORTDEFINITIONTYPE def_in;
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in;
+	long long ns_off, ns_on;
+	OMX_U32 pnum_in;
+	OMX_ERRORTYPE result;
+	int fd;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.renderer.null";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	comp = nullptr;
+	result = OMX_ErrorNone;
+	pnum_in = 0;
+
+	fd = mkstemp(path);
+	if (fd == -1) {
+		fprintf(stderr, "mkstemp failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out1;
+	}
+	close(fd);
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	result = OMX_MF_StopTrace((OMX_STRING)"/nonexistent/trace.json");
+	if (result == OMX_ErrorNone) {
+		fprintf(stderr, "OMX_MF_StopTrace(nonexistent) succeeded.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	comp = new comp_test_trace(arg_comp);
+	if (comp == nullptr || comp->get_component() == nullptr) {
+		fprintf(stderr, "OMX_GetHandle failed.\n");
+		result = OMX_ErrorInsufficientResources;
+		goto err_out2;
+	}
+
+	//Get port definition
+	result = comp->get_param_video_init(&param_v);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_video_init() failed.\n");
+		goto err_out2;
+	}
+
+	pnum_in = param_v.nStartPortNumber;
+
+	result = comp->get_param_port_definition(pnum_in, &def_in);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(in) failed.\n");
+		goto err_out2;
+	}
+
+	//状態の変更から記録する
+	OMX_MF_StartTrace();
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	result = comp->use_buffers(pnum_in, &buf_in);
+	if (result != OMX_ErrorNone) {
+		goto err_out2;
+	}
+
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//Set StateExecuting
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Executing) failed.\n");
+		goto err_out2;
+	}
+
+	comp->wait_state_changed(OMX_StateExecuting);
+
+	//記録する場合としない場合の時間を比べる
+	OMX_MF_StopTrace(nullptr);
+	ns_off = round_trip(comp, buf_in[0]);
+	OMX_MF_StartTrace();
+	ns_on = round_trip(comp, buf_in[0]);
+	if (ns_off < 0 || ns_on < 0) {
+		fprintf(stderr, "OMX_EmptyThisBuffer failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Flush
+	result = comp->SendCommand(OMX_CommandFlush, pnum_in, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(Flush) failed.\n");
+		goto err_out2;
+	}
+
+	comp->wait_command_completed(OMX_CommandFlush, pnum_in);
+
+	//Set StateIdle
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateIdle, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Idle) failed.\n");
+		goto err_out2;
+	}
+
+	comp->wait_state_changed(OMX_StateIdle);
+
+	//Set StateLoaded
+	result = comp->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, 0);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_SendCommand(StateSet, Loaded) failed.\n");
+		goto err_out2;
+	}
+
+	//Free buffer
+	comp->free_buffers(pnum_in, &buf_in);
+
+	comp->wait_state_changed(OMX_StateLoaded);
+
+	result = OMX_MF_StopTrace(path);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_MF_StopTrace(%s) failed.\n", path);
+		goto err_out2;
+	}
+
+	if (check_trace(path) != 0) {
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	printf("EmptyThisBuffer -> EmptyBufferDone: "
+		"trace off %lldns, on %lldns per round (%d rounds)\n",
+		ns_off, ns_on, N_ROUNDS);
+
+	//Terminate
+	delete comp;
+	unlink(path);
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	OMX_MF_StopTrace(nullptr);
+	comp->free_buffers(pnum_in, &buf_in);
+
+	delete comp;
+
+	OMX_Deinit();
+
+err_out1:
+	unlink(path);
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
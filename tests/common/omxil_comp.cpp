@@ -2,6 +2,7 @@
 #include <cstring>
 #include <algorithm>
 #include <string>
+#include <chrono>
 
 #include <OMX_Component.h>
 
@@ -502,6 +503,71 @@ void omxil_comp::dump_all_buffer(OMX_U32 port) const
 	printf("\n");
 }
 
+OMX_ERRORTYPE omxil_comp::use_buffers(OMX_U32 port, buflist_type *bufs)
+{
+	OMX_PARAM_PORTDEFINITIONTYPE def;
+	OMX_ERRORTYPE result;
+	OMX_U32 i;
+
+	result = get_param_port_definition(port, &def);
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "get_port_definition(%d) failed.\n",
+			(int)port);
+		return result;
+	}
+
+	for (i = 0; i < def.nBufferCountActual; i++) {
+		OMX_BUFFERHEADERTYPE *buf;
+		OMX_U8 *pb = nullptr;
+		buffer_attr *pbattr = nullptr;
+
+		pb = new OMX_U8[def.nBufferSize];
+		pbattr = new buffer_attr{0, };
+
+		result = UseBuffer(&buf,
+			port, pbattr, def.nBufferSize, pb);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_UseBuffer(%d) failed.\n",
+				(int)port);
+			delete pbattr;
+			delete[] pb;
+			return result;
+		}
+
+		register_buffer(port, buf);
+		bufs->push_back(buf);
+	}
+
+	return OMX_ErrorNone;
+}
+
+void omxil_comp::free_buffers(OMX_U32 port, buflist_type *bufs)
+{
+	for (OMX_BUFFERHEADERTYPE *buf : *bufs) {
+		OMX_U8 *pb = buf->pBuffer;
+		buffer_attr *pbattr = static_cast<buffer_attr *>(buf->pAppPrivate);
+
+		unregister_buffer(port, buf);
+
+		FreeBuffer(port, buf);
+
+		delete pbattr;
+		delete[] pb;
+	}
+	bufs->clear();
+}
+
+void omxil_comp::get_free_buffers(OMX_U32 port, OMX_U32 size, buflist_type *bufs) const
+{
+	OMX_BUFFERHEADERTYPE *buf;
+
+	bufs->clear();
+	while ((buf = get_free_buffer(port)) != nullptr) {
+		buf->nFilledLen = size;
+		bufs->push_back(buf);
+	}
+}
+
 
 OMX_ERRORTYPE omxil_comp::get_param_port_definition(OMX_U32 port_index, OMX_PARAM_PORTDEFINITIONTYPE *def) const
 {
@@ -792,3 +858,129 @@ OMX_ERRORTYPE omxil_comp::fill_version(OMX_VERSIONTYPE *v)
 
 	return OMX_ErrorNone;
 }
+
+
+
+/*
+ * omxil_comp_free_queue
+ */
+
+omxil_comp_free_queue::omxil_comp_free_queue(const char *comp_name)
+	: omxil_comp(comp_name)
+{
+	//do nothing
+}
+
+omxil_comp_free_queue::~omxil_comp_free_queue()
+{
+	//do nothing
+}
+
+OMX_ERRORTYPE omxil_comp_free_queue::EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+	put_free_buffer(pBuffer->nInputPortIndex, pBuffer);
+
+	return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE omxil_comp_free_queue::FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+	put_free_buffer(pBuffer->nOutputPortIndex, pBuffer);
+
+	return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE omxil_comp_free_queue::use_buffers(OMX_U32 port, buflist_type *bufs)
+{
+	size_t i = bufs->size();
+	OMX_ERRORTYPE result;
+
+	result = super::use_buffers(port, bufs);
+	for (; i < bufs->size(); i++) {
+		put_free_buffer(port, (*bufs)[i]);
+	}
+
+	return result;
+}
+
+void omxil_comp_free_queue::free_buffers(OMX_U32 port, buflist_type *bufs)
+{
+	super::free_buffers(port, bufs);
+
+	std::unique_lock<std::mutex> lock(mut_free);
+
+	map_free.erase(port);
+}
+
+void omxil_comp_free_queue::put_free_buffer(OMX_U32 port, OMX_BUFFERHEADERTYPE *buf)
+{
+	std::unique_lock<std::mutex> lock(mut_free);
+
+	map_free[port].push_back(buf);
+	cond_free.notify_all();
+}
+
+OMX_BUFFERHEADERTYPE *omxil_comp_free_queue::take_free_buffer(OMX_U32 port)
+{
+	std::unique_lock<std::mutex> lock(mut_free);
+	std::deque<OMX_BUFFERHEADERTYPE *>& q = map_free[port];
+	OMX_BUFFERHEADERTYPE *buf;
+
+	cond_free.wait(lock, [&] { return !q.empty(); });
+	buf = q.front();
+	q.pop_front();
+
+	return buf;
+}
+
+void omxil_comp_free_queue::take_all_free_buffers(OMX_U32 port, buflist_type *bufs)
+{
+	std::unique_lock<std::mutex> lock(mut_free);
+	std::deque<OMX_BUFFERHEADERTYPE *>& q = map_free[port];
+
+	bufs->assign(q.begin(), q.end());
+	q.clear();
+}
+
+OMX_ERRORTYPE omxil_comp_free_queue::send_all_buffers(OMX_U32 port, OMX_DIRTYPE dir, size_t *n_sent)
+{
+	buflist_type bufs;
+	OMX_ERRORTYPE result;
+
+	take_all_free_buffers(port, &bufs);
+	for (OMX_BUFFERHEADERTYPE *buf : bufs) {
+		if (dir == OMX_DirInput) {
+			buf->nFilledLen = 8;
+			result = EmptyThisBuffer(buf);
+		} else {
+			buf->nFilledLen = 0;
+			result = FillThisBuffer(buf);
+		}
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "EmptyThisBuffer/FillThisBuffer(%d) failed.\n",
+				(int)port);
+			return result;
+		}
+	}
+	if (n_sent != nullptr) {
+		*n_sent = bufs.size();
+	}
+
+	return OMX_ErrorNone;
+}
+
+bool omxil_comp_free_queue::wait_free_count(OMX_U32 port, size_t n)
+{
+	std::unique_lock<std::mutex> lock(mut_free);
+
+	return cond_free.wait_for(lock, std::chrono::seconds(10), [&] {
+		return map_free[port].size() >= n;
+	});
+}
+
+size_t omxil_comp_free_queue::get_free_count(OMX_U32 port)
+{
+	std::unique_lock<std::mutex> lock(mut_free);
+
+	return map_free[port].size();
+}
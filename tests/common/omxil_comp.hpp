@@ -4,6 +4,7 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <map>
 #include <condition_variable>
 #include <mutex>
@@ -176,6 +177,38 @@ public:
 	 */
 	virtual void dump_all_buffer(OMX_U32 port) const;
 
+	/**
+	 * ポートにバッファを nBufferCountActual 個割り当て、
+	 * ポートと関連付けます。
+	 *
+	 * バッファの領域はクライアントが確保し（OMX_UseBuffer）、
+	 * pAppPrivate には buffer_attr を設定します。
+	 *
+	 * @param port ポート番号
+	 * @param bufs 割り当てたバッファを追加するリスト
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE use_buffers(OMX_U32 port, buflist_type *bufs);
+
+	/**
+	 * use_buffers() で割り当てたバッファを全て解放します。
+	 *
+	 * @param port ポート番号
+	 * @param bufs 解放するバッファのリスト、解放後は空になります
+	 */
+	virtual void free_buffers(OMX_U32 port, buflist_type *bufs);
+
+	/**
+	 * 指定したポートの未使用のバッファを全て取得します。
+	 *
+	 * バッファには使用中の印が付けられます。
+	 *
+	 * @param port ポート番号
+	 * @param size 各バッファに設定するデータの長さ（nFilledLen）
+	 * @param bufs 取得したバッファのリスト
+	 */
+	virtual void get_free_buffers(OMX_U32 port, OMX_U32 size, buflist_type *bufs) const;
+
 	virtual OMX_ERRORTYPE get_param_port_definition(OMX_U32 port_index, OMX_PARAM_PORTDEFINITIONTYPE *def) const;
 	virtual OMX_ERRORTYPE get_param_audio_init(OMX_PORT_PARAM_TYPE *param) const;
 	virtual OMX_ERRORTYPE get_param_video_init(OMX_PORT_PARAM_TYPE *param) const;
@@ -214,4 +247,103 @@ private:
 
 };
 
+/**
+ * 返却されたバッファを空きバッファの列で管理するコンポーネントです。
+ *
+ * EmptyBufferDone, FillBufferDone で返却されたバッファは
+ * ポートごとの空きバッファの列に入ります。
+ */
+class omxil_comp_free_queue : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	omxil_comp_free_queue(const char *comp_name);
+	virtual ~omxil_comp_free_queue();
+
+	virtual OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer);
+	virtual OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer);
+
+	/**
+	 * バッファを割り当て、全て空きバッファとして登録します。
+	 *
+	 * @param port ポート番号
+	 * @param bufs 割り当てたバッファを追加するリスト
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE use_buffers(OMX_U32 port, buflist_type *bufs);
+
+	/**
+	 * バッファを解放し、ポートの空きバッファの列を空にします。
+	 *
+	 * @param port ポート番号
+	 * @param bufs 解放するバッファのリスト、解放後は空になります
+	 */
+	virtual void free_buffers(OMX_U32 port, buflist_type *bufs);
+
+	/**
+	 * 返却されたバッファを空きバッファとして登録します。
+	 *
+	 * @param port ポート番号
+	 * @param buf  OpenMAX IL バッファ
+	 */
+	virtual void put_free_buffer(OMX_U32 port, OMX_BUFFERHEADERTYPE *buf);
+
+	/**
+	 * 空きバッファを1つ取り出します。
+	 * 空きバッファがなければ返却されるまで待ちます。
+	 *
+	 * @param port ポート番号
+	 * @return OpenMAX IL バッファ
+	 */
+	virtual OMX_BUFFERHEADERTYPE *take_free_buffer(OMX_U32 port);
+
+	/**
+	 * 空きバッファを全て取り出します。
+	 *
+	 * @param port ポート番号
+	 * @param bufs 取り出したバッファのリスト
+	 */
+	virtual void take_all_free_buffers(OMX_U32 port, buflist_type *bufs);
+
+	/**
+	 * 空きバッファを全て取り出し、コンポーネントに渡します。
+	 *
+	 * 入力ポートには 8 バイトのデータを持つバッファとして
+	 * EmptyThisBuffer で、出力ポートには空のバッファとして
+	 * FillThisBuffer で渡します。
+	 *
+	 * @param port   ポート番号
+	 * @param dir    ポートの方向
+	 * @param n_sent 渡したバッファの数、不要ならば nullptr
+	 * @return OpenMAX エラー値
+	 */
+	virtual OMX_ERRORTYPE send_all_buffers(OMX_U32 port, OMX_DIRTYPE dir, size_t *n_sent);
+
+	/**
+	 * 空きバッファが n 個になるまで待ちます。
+	 *
+	 * @param port ポート番号
+	 * @param n    空きバッファの数
+	 * @return 10秒以内に n 個になれば true、そうでなければ false
+	 */
+	virtual bool wait_free_count(OMX_U32 port, size_t n);
+
+	/**
+	 * 空きバッファの数を取得します。
+	 *
+	 * @param port ポート番号
+	 * @return 空きバッファの数
+	 */
+	virtual size_t get_free_count(OMX_U32 port);
+
+protected:
+	//空きバッファの列を守るロック、派生クラスの状態の保護にも使えます
+	std::mutex mut_free;
+	std::condition_variable cond_free;
+
+private:
+	std::map<OMX_U32, std::deque<OMX_BUFFERHEADERTYPE *> > map_free;
+
+};
+
 #endif //OMXIL_COMP_HPP__
@@ -0,0 +1,7 @@
+#!/bin/sh
+
+set -xe
+
+TEST_NAME=pipeline_state
+
+./${TEST_NAME} OMX.MF.filter.copy
@@ -0,0 +1,289 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//パイプラインの段数
+#define N_STAGES       5
+//計測する回数
+#define N_ROUNDS       10
+//パイプライン全体の状態遷移を待つ時間（ミリ秒）
+#define STATE_TIMEOUT  10000
+
+/**
+ * 1つずつ状態遷移を指示し、完了を待ってから次に進みます。
+ *
+ * トンネル接続の供給側のポートを持つ後段のコンポーネントから順に遷移させます。
+ *
+ * @param comp     コンポーネントの配列
+ * @param s        新たな状態
+ * @param func_cli パイプライン両端のクライアント側のポートを準備、片付ける処理
+ * @return OpenMAX エラー値
+ */
+static OMX_ERRORTYPE set_state_sequential(omxil_comp *comp[], OMX_STATETYPE s, std::function<OMX_ERRORTYPE(int)> func_cli)
+{
+	OMX_ERRORTYPE result;
+	int i;
+
+	for (i = N_STAGES - 1; i >= 0; i--) {
+		result = comp[i]->SendCommand(OMX_CommandStateSet, s, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(i:%d, StateSet, %s) failed.\n",
+				i, get_omx_statetype_name(s));
+			return result;
+		}
+
+		result = func_cli(i);
+		if (result != OMX_ErrorNone) {
+			return result;
+		}
+
+		comp[i]->wait_state_changed(s);
+	}
+
+	return OMX_ErrorNone;
+}
+
+/**
+ * パイプライン全体の状態遷移を、別のスレッドで
+ * OMX_MF_SetPipelineState() に任せます。
+ *
+ * @param handles  コンポーネントの配列
+ * @param s        新たな状態
+ * @param func_cli パイプライン両端のクライアント側のポートを準備、片付ける処理
+ * @return OpenMAX エラー値
+ */
+static OMX_ERRORTYPE set_state_pipeline(OMX_HANDLETYPE handles[], OMX_STATETYPE s, std::function<OMX_ERRORTYPE()> func_cli)
+{
+	OMX_ERRORTYPE result, result_th = OMX_ErrorUndefined;
+
+	std::thread th([&] {
+		result_th = OMX_MF_SetPipelineState(handles, N_STAGES, s, STATE_TIMEOUT);
+	});
+
+	result = func_cli();
+	th.join();
+
+	if (result_th != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_MF_SetPipelineState(%s) failed.\n",
+			get_omx_statetype_name(s));
+		return result_th;
+	}
+
+	return result;
+}
+
+/**
+ * 5段のトンネル接続パイプラインを Loaded から Executing に遷移させ、
+ * Loaded に戻すまでの時間を計測します。
+ *
+ * @param arg_comp  コンポーネント名
+ * @param pipeline  OMX_MF_SetPipelineState() を使うなら true、
+ * 	1つずつ遷移させるなら false
+ * @param to_exec   Executing に遷移するまでの時間（ミリ秒）を受け取るベクタ
+ * @param to_loaded Loaded に戻るまでの時間（ミリ秒）を受け取るベクタ
+ * @return 成功なら 0、失敗なら -1
+ */
+static int measure_state(const char *arg_comp, bool pipeline, std::vector<double> *to_exec, std::vector<double> *to_loaded)
+{
+	omxil_comp *comp[N_STAGES] = {};
+	OMX_HANDLETYPE handles[N_STAGES];
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_U32 pnum_in[N_STAGES], pnum_out[N_STAGES];
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in, buf_out;
+	std::chrono::steady_clock::time_point t_start;
+	std::chrono::duration<double, std::milli> t_span;
+	OMX_ERRORTYPE result;
+	int ret = -1;
+	int i;
+
+	for (i = 0; i < N_STAGES; i++) {
+		comp[i] = new omxil_comp(arg_comp);
+		if (comp[i]->get_component() == nullptr) {
+			fprintf(stderr, "OMX_GetHandle(%d) failed.\n", i);
+			goto err_out;
+		}
+		handles[i] = comp[i]->get_component();
+
+		result = comp[i]->get_param_video_init(&param_v);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_param_video_init() failed.\n");
+			goto err_out;
+		}
+		pnum_in[i] = param_v.nStartPortNumber;
+		pnum_out[i] = param_v.nStartPortNumber + 1;
+	}
+
+	//Setup tunnel: [0]out -> [1]in, ..., [3]out -> [4]in
+	for (i = 0; i < N_STAGES - 1; i++) {
+		result = OMX_SetupTunnel(comp[i]->get_component(), pnum_out[i],
+			comp[i + 1]->get_component(), pnum_in[i + 1]);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SetupTunnel(comp:%d:%d, comp:%d:%d) failed.\n",
+				i, (int)pnum_out[i], i + 1, (int)pnum_in[i + 1]);
+			goto err_out;
+		}
+	}
+
+	//Loaded -> Idle -> Executing
+	t_start = std::chrono::steady_clock::now();
+	if (pipeline) {
+		result = set_state_pipeline(handles, OMX_StateExecuting, [&] {
+			OMX_ERRORTYPE res;
+
+			res = comp[N_STAGES - 1]->use_buffers(pnum_out[N_STAGES - 1], &buf_out);
+			if (res == OMX_ErrorNone) {
+				res = comp[0]->use_buffers(pnum_in[0], &buf_in);
+			}
+			return res;
+		});
+	} else {
+		result = set_state_sequential(comp, OMX_StateIdle, [&] (int i) {
+			if (i == N_STAGES - 1) {
+				return comp[i]->use_buffers(pnum_out[i], &buf_out);
+			}
+			if (i == 0) {
+				return comp[i]->use_buffers(pnum_in[i], &buf_in);
+			}
+			return OMX_ErrorNone;
+		});
+		if (result == OMX_ErrorNone) {
+			result = set_state_sequential(comp, OMX_StateExecuting, [&] (int i) {
+				return OMX_ErrorNone;
+			});
+		}
+	}
+	if (result != OMX_ErrorNone) {
+		goto err_out;
+	}
+	t_span = std::chrono::steady_clock::now() - t_start;
+	to_exec->push_back(t_span.count());
+
+	//Executing -> Idle -> Loaded
+	t_start = std::chrono::steady_clock::now();
+	if (pipeline) {
+		result = set_state_pipeline(handles, OMX_StateLoaded, [&] {
+			comp[N_STAGES - 1]->wait_state_changed(OMX_StateIdle);
+			comp[N_STAGES - 1]->free_buffers(pnum_out[N_STAGES - 1], &buf_out);
+			comp[0]->wait_state_changed(OMX_StateIdle);
+			comp[0]->free_buffers(pnum_in[0], &buf_in);
+			return OMX_ErrorNone;
+		});
+	} else {
+		result = set_state_sequential(comp, OMX_StateIdle, [&] (int i) {
+			return OMX_ErrorNone;
+		});
+		if (result == OMX_ErrorNone) {
+			result = set_state_sequential(comp, OMX_StateLoaded, [&] (int i) {
+				if (i == N_STAGES - 1) {
+					comp[i]->free_buffers(pnum_out[i], &buf_out);
+				}
+				if (i == 0) {
+					comp[i]->free_buffers(pnum_in[i], &buf_in);
+				}
+				return OMX_ErrorNone;
+			});
+		}
+	}
+	if (result != OMX_ErrorNone) {
+		goto err_out;
+	}
+	t_span = std::chrono::steady_clock::now() - t_start;
+	to_loaded->push_back(t_span.count());
+
+	ret = 0;
+
+err_out:
+	for (i = 0; i < N_STAGES; i++) {
+		delete comp[i];
+	}
+
+	return ret;
+}
+
+static void print_time(const char *name, std::vector<double> *t)
+{
+	double sum = 0;
+
+	for (double v : *t) {
+		sum += v;
+	}
+	std::sort(t->begin(), t->end());
+
+	printf("%-20s: n:%d, avg:%8.3f ms, p50:%8.3f ms, max:%8.3f ms\n",
+		name, (int)t->size(), sum / t->size(),
+		(*t)[t->size() / 2], t->back());
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	std::vector<double> exec_seq, loaded_seq, exec_pipe, loaded_pipe;
+	OMX_ERRORTYPE result;
+	int i;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		//One by one (before)
+		if (measure_state(arg_comp, false, &exec_seq, &loaded_seq) != 0) {
+			fprintf(stderr, "measure_state(sequential) failed.\n");
+			result = OMX_ErrorUndefined;
+			goto err_out2;
+		}
+
+		//Whole pipeline (after)
+		if (measure_state(arg_comp, true, &exec_pipe, &loaded_pipe) != 0) {
+			fprintf(stderr, "measure_state(pipeline) failed.\n");
+			result = OMX_ErrorUndefined;
+			goto err_out2;
+		}
+	}
+
+	printf("%d-stage pipeline state transition -----\n", N_STAGES);
+	print_time("sequential:Executing", &exec_seq);
+	print_time("pipeline  :Executing", &exec_pipe);
+	print_time("sequential:Loaded", &loaded_seq);
+	print_time("pipeline  :Loaded", &loaded_pipe);
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,345 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//パイプラインの段数
+#define N_STAGES       3
+//計測前に流すバッファ数
+#define N_WARMUP       50
+//計測するバッファ数
+#define N_MEASURE      1000
+//バッファの先頭に書き込む識別子
+#define LATENCY_MAGIC  0x54414c4d
+
+class comp_test_tunnel_latency : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	comp_test_tunnel_latency(const char *comp_name)
+		: omxil_comp(comp_name), f_refill(true), seq_done(-1)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_tunnel_latency()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+		OMX_U32 *p = (OMX_U32 *)pBuffer->pBuffer;
+
+		//パイプライン開始時に流れる空のバッファは無視する
+		if (pBuffer->nFilledLen >= sizeof(OMX_U32) * 2 &&
+			p[1] == LATENCY_MAGIC) {
+			seq_done = (int)p[0];
+			cond_seq.notify_all();
+		}
+
+		//出力バッファはすぐに戻す
+		if (f_refill) {
+			pBuffer->nFilledLen = 0;
+			OMX_FillThisBuffer(hComponent, pBuffer);
+		}
+
+		return OMX_ErrorNone;
+	}
+
+	virtual void set_refill(bool f)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+
+		f_refill = f;
+	}
+
+	virtual bool wait_sequence(int seq)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+
+		return cond_seq.wait_for(lock, std::chrono::seconds(5),
+			[&] { return seq_done >= seq; });
+	}
+
+private:
+	std::mutex mut_seq;
+	std::condition_variable cond_seq;
+	bool f_refill;
+	int seq_done;
+
+};
+
+static OMX_ERRORTYPE set_tunnel_direct(comp_test_tunnel_latency *comp, OMX_U32 port, OMX_BOOL direct)
+{
+	OMX_MF_PARAM_TUNNELDIRECTTYPE param;
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_PARAM_TUNNEL_DIRECT, &index);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	memset(&param, 0, sizeof(param));
+	param.nSize      = sizeof(param);
+	omxil_comp::fill_version(&param.nVersion);
+	param.nPortIndex = port;
+	param.bEnabled   = direct;
+
+	return comp->SetParameter(index, &param);
+}
+
+static OMX_ERRORTYPE set_state_all(comp_test_tunnel_latency *comp[], OMX_STATETYPE s)
+{
+	OMX_ERRORTYPE result;
+	int i;
+
+	for (i = 0; i < N_STAGES; i++) {
+		result = comp[i]->SendCommand(OMX_CommandStateSet, s, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(i:%d, StateSet, %s) failed.\n",
+				i, get_omx_statetype_name(s));
+			return result;
+		}
+	}
+
+	return OMX_ErrorNone;
+}
+
+static void wait_state_all(comp_test_tunnel_latency *comp[], OMX_STATETYPE s)
+{
+	int i;
+
+	for (i = 0; i < N_STAGES; i++) {
+		printf("wait for %s i:%d...\n", get_omx_statetype_name(s), i);
+		comp[i]->wait_state_changed(s);
+		printf("wait for %s i:%d... Done!\n", get_omx_statetype_name(s), i);
+	}
+}
+
+/**
+ * 3段のトンネル接続パイプラインに 1つずつバッファを流し、
+ * 入力してから出力されるまでの時間を計測します。
+ *
+ * @param arg_comp コンポーネント名
+ * @param direct   トンネル接続先への直接受け渡しを使うなら OMX_TRUE
+ * @param lat      バッファ 1つ当たりの遅延（マイクロ秒）を受け取るベクタ
+ * @return 成功なら 0、失敗なら -1
+ */
+static int measure_latency(const char *arg_comp, OMX_BOOL direct, std::vector<double> *lat)
+{
+	comp_test_tunnel_latency *comp[N_STAGES] = {};
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_U32 pnum_in[N_STAGES], pnum_out[N_STAGES];
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in, buf_out;
+	OMX_ERRORTYPE result;
+	int ret = -1;
+	int i, seq;
+
+	for (i = 0; i < N_STAGES; i++) {
+		comp[i] = new comp_test_tunnel_latency(arg_comp);
+		if (comp[i]->get_component() == nullptr) {
+			fprintf(stderr, "OMX_GetHandle(%d) failed.\n", i);
+			goto err_out;
+		}
+
+		result = comp[i]->get_param_video_init(&param_v);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_param_video_init() failed.\n");
+			goto err_out;
+		}
+		pnum_in[i] = param_v.nStartPortNumber;
+		pnum_out[i] = param_v.nStartPortNumber + 1;
+
+		result = set_tunnel_direct(comp[i], pnum_in[i], direct);
+		if (result == OMX_ErrorNone) {
+			result = set_tunnel_direct(comp[i], pnum_out[i], direct);
+		}
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "set_tunnel_direct(%d) failed.\n", i);
+			goto err_out;
+		}
+	}
+
+	//Setup tunnel: [0]out -> [1]in, [1]out -> [2]in
+	for (i = 0; i < N_STAGES - 1; i++) {
+		result = OMX_SetupTunnel(comp[i]->get_component(), pnum_out[i],
+			comp[i + 1]->get_component(), pnum_in[i + 1]);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SetupTunnel(comp:%d:%d, comp:%d:%d) failed.\n",
+				i, (int)pnum_out[i], i + 1, (int)pnum_in[i + 1]);
+			goto err_out;
+		}
+	}
+
+	//Set StateIdle
+	if (set_state_all(comp, OMX_StateIdle) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	if (comp[0]->use_buffers(pnum_in[0], &buf_in) != OMX_ErrorNone ||
+		comp[N_STAGES - 1]->use_buffers(pnum_out[N_STAGES - 1], &buf_out) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	wait_state_all(comp, OMX_StateIdle);
+
+	//Set StateExecuting
+	if (set_state_all(comp, OMX_StateExecuting) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	wait_state_all(comp, OMX_StateExecuting);
+
+	for (OMX_BUFFERHEADERTYPE *buf : buf_out) {
+		result = comp[N_STAGES - 1]->FillThisBuffer(buf);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "FillThisBuffer(%d) failed.\n",
+				(int)pnum_out[N_STAGES - 1]);
+			goto err_out;
+		}
+	}
+
+	for (seq = 0; seq < N_WARMUP + N_MEASURE; seq++) {
+		std::chrono::steady_clock::time_point t_start;
+		std::chrono::duration<double, std::micro> t_span;
+		OMX_BUFFERHEADERTYPE *buf;
+		OMX_U32 *p;
+
+		comp[0]->wait_buffer_free(pnum_in[0]);
+		buf = comp[0]->get_free_buffer(pnum_in[0]);
+		if (buf == nullptr) {
+			fprintf(stderr, "get_free_buffer(%d) failed.\n",
+				(int)pnum_in[0]);
+			goto err_out;
+		}
+
+		p = (OMX_U32 *)buf->pBuffer;
+		p[0] = seq;
+		p[1] = LATENCY_MAGIC;
+		buf->nFilledLen = sizeof(OMX_U32) * 2;
+		buf->nOffset = 0;
+
+		t_start = std::chrono::steady_clock::now();
+		result = comp[0]->EmptyThisBuffer(buf);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "EmptyThisBuffer(%d) failed.\n",
+				(int)pnum_in[0]);
+			goto err_out;
+		}
+		if (!comp[N_STAGES - 1]->wait_sequence(seq)) {
+			fprintf(stderr, "Timeout to receive buffer %d.\n", seq);
+			goto err_out;
+		}
+		t_span = std::chrono::steady_clock::now() - t_start;
+
+		if (seq >= N_WARMUP) {
+			lat->push_back(t_span.count());
+		}
+	}
+
+	//Set StateIdle
+	comp[N_STAGES - 1]->set_refill(false);
+	if (set_state_all(comp, OMX_StateIdle) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	wait_state_all(comp, OMX_StateIdle);
+
+	//Set StateLoaded
+	if (set_state_all(comp, OMX_StateLoaded) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	comp[0]->free_buffers(pnum_in[0], &buf_in);
+	comp[N_STAGES - 1]->free_buffers(pnum_out[N_STAGES - 1], &buf_out);
+	wait_state_all(comp, OMX_StateLoaded);
+
+	ret = 0;
+
+err_out:
+	for (i = 0; i < N_STAGES; i++) {
+		delete comp[i];
+	}
+
+	return ret;
+}
+
+static void print_latency(const char *name, std::vector<double> *lat)
+{
+	double sum = 0;
+
+	for (double v : *lat) {
+		sum += v;
+	}
+	std::sort(lat->begin(), lat->end());
+
+	printf("%-8s: n:%d, avg:%8.2f us, p50:%8.2f us, p99:%8.2f us\n",
+		name, (int)lat->size(), sum / lat->size(),
+		(*lat)[lat->size() / 2], (*lat)[lat->size() * 99 / 100]);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	std::vector<double> lat_thread, lat_direct;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	//Returning thread (before)
+	if (measure_latency(arg_comp, OMX_FALSE, &lat_thread) != 0) {
+		fprintf(stderr, "measure_latency(thread) failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Direct handoff (after)
+	if (measure_latency(arg_comp, OMX_TRUE, &lat_direct) != 0) {
+		fprintf(stderr, "measure_latency(direct) failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	printf("%d-stage tunnel latency per buffer -----\n", N_STAGES);
+	print_latency("thread", &lat_thread);
+	print_latency("direct", &lat_direct);
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,400 @@
+﻿
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include <unistd.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "common/test_omxil.h"
+#include "common/omxil_utils.h"
+#include "common/omxil_comp.hpp"
+
+//パイプラインの段数
+#define N_STAGES       10
+//計測前に流すバッファ数
+#define N_WARMUP       200
+//計測するバッファ数
+#define N_MEASURE      5000
+//バッファに書き込むデータの大きさ
+#define PAYLOAD_SIZE   1024
+//バッファの先頭に書き込む識別子
+#define THROUGHPUT_MAGIC  0x50485454
+
+class comp_test_tunnel_throughput : public omxil_comp {
+public:
+	typedef omxil_comp super;
+
+	comp_test_tunnel_throughput(const char *comp_name)
+		: omxil_comp(comp_name), f_refill(true), seq_done(-1),
+		f_out_of_order(false)
+	{
+		//do nothing
+	}
+
+	virtual ~comp_test_tunnel_throughput()
+	{
+		//do nothing
+	}
+
+	virtual OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+
+		//計測を邪魔しないよう、ログを出さずに空きバッファに戻す
+		free_in.push_back(pBuffer);
+		cond_seq.notify_all();
+
+		return OMX_ErrorNone;
+	}
+
+	virtual OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+		OMX_U32 *p = (OMX_U32 *)pBuffer->pBuffer;
+
+		//パイプライン開始時に流れる空のバッファは無視する
+		if (pBuffer->nFilledLen == PAYLOAD_SIZE &&
+			p[1] == THROUGHPUT_MAGIC) {
+			//バッファは入力した順に出てくるはず
+			if ((int)p[0] != seq_done + 1) {
+				f_out_of_order = true;
+			}
+			seq_done = (int)p[0];
+			cond_seq.notify_all();
+		}
+
+		//出力バッファはすぐに戻す
+		if (f_refill) {
+			pBuffer->nFilledLen = 0;
+			OMX_FillThisBuffer(hComponent, pBuffer);
+		}
+
+		return OMX_ErrorNone;
+	}
+
+	virtual void set_refill(bool f)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+
+		f_refill = f;
+	}
+
+	virtual void add_free_buffer(OMX_BUFFERHEADERTYPE *buf)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+
+		free_in.push_back(buf);
+	}
+
+	virtual OMX_BUFFERHEADERTYPE *wait_free_buffer()
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+		OMX_BUFFERHEADERTYPE *buf;
+
+		if (!cond_seq.wait_for(lock, std::chrono::seconds(5),
+			[&] { return !free_in.empty(); })) {
+			return nullptr;
+		}
+		buf = free_in.front();
+		free_in.pop_front();
+
+		return buf;
+	}
+
+	virtual void wait_all_free_buffer(size_t n)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+
+		cond_seq.wait_for(lock, std::chrono::seconds(5),
+			[&] { return free_in.size() >= n; });
+	}
+
+	virtual bool wait_sequence(int seq)
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+
+		return cond_seq.wait_for(lock, std::chrono::seconds(5),
+			[&] { return seq_done >= seq; });
+	}
+
+	virtual bool is_out_of_order()
+	{
+		std::unique_lock<std::mutex> lock(mut_seq);
+
+		return f_out_of_order;
+	}
+
+private:
+	std::mutex mut_seq;
+	std::condition_variable cond_seq;
+	std::deque<OMX_BUFFERHEADERTYPE *> free_in;
+	bool f_refill;
+	int seq_done;
+	bool f_out_of_order;
+
+};
+
+static OMX_ERRORTYPE set_worker_pool(comp_test_tunnel_throughput *comp, OMX_BOOL pooled)
+{
+	OMX_MF_PARAM_WORKERPOOLTYPE param;
+	OMX_INDEXTYPE index;
+	OMX_ERRORTYPE result;
+
+	result = comp->GetExtensionIndex((OMX_STRING)OMX_MF_INDEX_PARAM_WORKER_POOL, &index);
+	if (result != OMX_ErrorNone) {
+		return result;
+	}
+
+	memset(&param, 0, sizeof(param));
+	param.nSize    = sizeof(param);
+	omxil_comp::fill_version(&param.nVersion);
+	param.bEnabled = pooled;
+	param.nLane    = -1;
+
+	return comp->SetParameter(index, &param);
+}
+
+static OMX_ERRORTYPE set_state_all(comp_test_tunnel_throughput *comp[], OMX_STATETYPE s)
+{
+	OMX_ERRORTYPE result;
+	int i;
+
+	for (i = 0; i < N_STAGES; i++) {
+		result = comp[i]->SendCommand(OMX_CommandStateSet, s, 0);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SendCommand(i:%d, StateSet, %s) failed.\n",
+				i, get_omx_statetype_name(s));
+			return result;
+		}
+	}
+
+	return OMX_ErrorNone;
+}
+
+static void wait_state_all(comp_test_tunnel_throughput *comp[], OMX_STATETYPE s)
+{
+	int i;
+
+	for (i = 0; i < N_STAGES; i++) {
+		comp[i]->wait_state_changed(s);
+	}
+	printf("wait for %s all... Done!\n", get_omx_statetype_name(s));
+}
+
+/**
+ * 10段のトンネル接続パイプラインにバッファを流し続け、
+ * 1秒あたりに出力されるバッファ数を計測します。
+ *
+ * @param arg_comp コンポーネント名
+ * @param pooled   ワーカーをワーカープールで実行するなら OMX_TRUE
+ * @param fps      1秒あたりのバッファ数を受け取る変数
+ * @return 成功なら 0、失敗なら -1
+ */
+static int measure_throughput(const char *arg_comp, OMX_BOOL pooled, double *fps)
+{
+	comp_test_tunnel_throughput *comp[N_STAGES] = {};
+	OMX_PORT_PARAM_TYPE param_v;
+	OMX_U32 pnum_in[N_STAGES], pnum_out[N_STAGES];
+	std::vector<OMX_BUFFERHEADERTYPE *> buf_in, buf_out;
+	std::chrono::steady_clock::time_point t_start;
+	std::chrono::duration<double> t_span;
+	OMX_ERRORTYPE result;
+	int ret = -1;
+	int i, seq;
+
+	for (i = 0; i < N_STAGES; i++) {
+		comp[i] = new comp_test_tunnel_throughput(arg_comp);
+		if (comp[i]->get_component() == nullptr) {
+			fprintf(stderr, "OMX_GetHandle(%d) failed.\n", i);
+			goto err_out;
+		}
+
+		result = comp[i]->get_param_video_init(&param_v);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "get_param_video_init() failed.\n");
+			goto err_out;
+		}
+		pnum_in[i] = param_v.nStartPortNumber;
+		pnum_out[i] = param_v.nStartPortNumber + 1;
+
+		result = set_worker_pool(comp[i], pooled);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "set_worker_pool(%d) failed.\n", i);
+			goto err_out;
+		}
+	}
+
+	//Setup tunnel: [0]out -> [1]in, ..., [8]out -> [9]in
+	for (i = 0; i < N_STAGES - 1; i++) {
+		result = OMX_SetupTunnel(comp[i]->get_component(), pnum_out[i],
+			comp[i + 1]->get_component(), pnum_in[i + 1]);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "OMX_SetupTunnel(comp:%d:%d, comp:%d:%d) failed.\n",
+				i, (int)pnum_out[i], i + 1, (int)pnum_in[i + 1]);
+			goto err_out;
+		}
+	}
+
+	//Set StateIdle
+	if (set_state_all(comp, OMX_StateIdle) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	if (comp[0]->use_buffers(pnum_in[0], &buf_in) != OMX_ErrorNone ||
+		comp[N_STAGES - 1]->use_buffers(pnum_out[N_STAGES - 1], &buf_out) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	wait_state_all(comp, OMX_StateIdle);
+
+	for (OMX_BUFFERHEADERTYPE *buf : buf_in) {
+		comp[0]->add_free_buffer(buf);
+	}
+
+	//Set StateExecuting
+	if (set_state_all(comp, OMX_StateExecuting) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	wait_state_all(comp, OMX_StateExecuting);
+
+	for (OMX_BUFFERHEADERTYPE *buf : buf_out) {
+		result = comp[N_STAGES - 1]->FillThisBuffer(buf);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "FillThisBuffer(%d) failed.\n",
+				(int)pnum_out[N_STAGES - 1]);
+			goto err_out;
+		}
+	}
+
+	//入力バッファが空くたびに次のバッファを流し続ける
+	for (seq = 0; seq < N_WARMUP + N_MEASURE; seq++) {
+		OMX_BUFFERHEADERTYPE *buf;
+		OMX_U32 *p;
+
+		if (seq == N_WARMUP) {
+			if (!comp[N_STAGES - 1]->wait_sequence(N_WARMUP - 1)) {
+				fprintf(stderr, "Timeout to receive warmup buffers.\n");
+				goto err_out;
+			}
+			t_start = std::chrono::steady_clock::now();
+		}
+
+		buf = comp[0]->wait_free_buffer();
+		if (buf == nullptr) {
+			fprintf(stderr, "Timeout to get free buffer %d.\n", seq);
+			goto err_out;
+		}
+
+		p = (OMX_U32 *)buf->pBuffer;
+		memset(p, 0, PAYLOAD_SIZE);
+		p[0] = seq;
+		p[1] = THROUGHPUT_MAGIC;
+		buf->nFilledLen = PAYLOAD_SIZE;
+		buf->nOffset = 0;
+
+		result = comp[0]->EmptyThisBuffer(buf);
+		if (result != OMX_ErrorNone) {
+			fprintf(stderr, "EmptyThisBuffer(%d) failed.\n",
+				(int)pnum_in[0]);
+			goto err_out;
+		}
+	}
+	if (!comp[N_STAGES - 1]->wait_sequence(N_WARMUP + N_MEASURE - 1)) {
+		fprintf(stderr, "Timeout to receive buffer %d.\n",
+			N_WARMUP + N_MEASURE - 1);
+		goto err_out;
+	}
+	t_span = std::chrono::steady_clock::now() - t_start;
+	*fps = N_MEASURE / t_span.count();
+
+	if (comp[N_STAGES - 1]->is_out_of_order()) {
+		fprintf(stderr, "Buffers were lost or reordered.\n");
+		goto err_out;
+	}
+
+	//Set StateIdle
+	comp[N_STAGES - 1]->set_refill(false);
+	if (set_state_all(comp, OMX_StateIdle) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	wait_state_all(comp, OMX_StateIdle);
+	comp[0]->wait_all_free_buffer(buf_in.size());
+
+	//Set StateLoaded
+	if (set_state_all(comp, OMX_StateLoaded) != OMX_ErrorNone) {
+		goto err_out;
+	}
+	comp[0]->free_buffers(pnum_in[0], &buf_in);
+	comp[N_STAGES - 1]->free_buffers(pnum_out[N_STAGES - 1], &buf_out);
+	wait_state_all(comp, OMX_StateLoaded);
+
+	ret = 0;
+
+err_out:
+	for (i = 0; i < N_STAGES; i++) {
+		delete comp[i];
+	}
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *arg_comp;
+	double fps_thread = 0, fps_pool = 0;
+	OMX_ERRORTYPE result;
+
+	//get arguments
+	if (argc < 2) {
+		arg_comp = "OMX.MF.filter.copy";
+	} else {
+		arg_comp = argv[1];
+	}
+
+	result = OMX_Init();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Init failed.\n");
+		goto err_out1;
+	}
+
+	//A thread per worker (before)
+	if (measure_throughput(arg_comp, OMX_FALSE, &fps_thread) != 0) {
+		fprintf(stderr, "measure_throughput(thread) failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	//Shared worker pool (after)
+	if (measure_throughput(arg_comp, OMX_TRUE, &fps_pool) != 0) {
+		fprintf(stderr, "measure_throughput(pool) failed.\n");
+		result = OMX_ErrorUndefined;
+		goto err_out2;
+	}
+
+	printf("%d-stage tunnel throughput (%d bytes/buffer, %d CPUs) -----\n",
+		N_STAGES, PAYLOAD_SIZE, (int)sysconf(_SC_NPROCESSORS_ONLN));
+	printf("thread  : %10.1f buffers/s\n", fps_thread);
+	printf("pool    : %10.1f buffers/s\n", fps_pool);
+
+	result = OMX_Deinit();
+	if (result != OMX_ErrorNone) {
+		fprintf(stderr, "OMX_Deinit failed.\n");
+		goto err_out1;
+	}
+
+	return 0;
+
+err_out2:
+	OMX_Deinit();
+
+err_out1:
+	fprintf(stderr, "ErrorCode:0x%08x(%s).\n",
+		result, get_omx_errortype_name(result));
+
+	return -1;
+}
@@ -0,0 +1,7 @@
+#!/bin/sh
+
+set -xe
+
+TEST_NAME=tunnel_throughput
+
+./${TEST_NAME} OMX.MF.filter.copy